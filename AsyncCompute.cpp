@@ -0,0 +1,252 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "AsyncCompute.h"
+
+AsyncCompute::~AsyncCompute() {
+    destroy(); // In case someone forgets destroy the command pool and semaphores.
+}
+
+void AsyncCompute::init(const AsyncComputeStructs::CreateInfo& info) {
+    m_info = info;
+
+    VkCommandPoolCreateInfo cmdPoolInfo = {};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = m_info.queueFamilyIndex;
+    // Command buffers are re-recorded every frame.
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(*m_device, &cmdPoolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create async compute command pool.");
+    }
+
+    m_commandBuffers.resize(m_info.frameCount);
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
+
+    if (vkAllocateCommandBuffers(*m_device, &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate async compute command buffers.");
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    m_computeFinishedSemaphores.resize(m_info.frameCount, VK_NULL_HANDLE);
+    m_graphicsReleasedSemaphores.resize(m_info.frameCount, VK_NULL_HANDLE);
+    for (size_t i = 0; i < m_info.frameCount; ++i) {
+        if (vkCreateSemaphore(*m_device, &semaphoreInfo, nullptr, &m_computeFinishedSemaphores[i]) != VK_SUCCESS ||
+            vkCreateSemaphore(*m_device, &semaphoreInfo, nullptr, &m_graphicsReleasedSemaphores[i]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create async compute semaphores.");
+        }
+    }
+}
+
+AsyncCompute::Handle AsyncCompute::addTask(const AsyncComputeStructs::RecordFunc& record, VkPipelineStageFlags graphicsWaitStages) {
+    m_tasks.push_back({ record, graphicsWaitStages, true });
+    return static_cast<Handle>(m_tasks.size() - 1);
+}
+
+void AsyncCompute::setTaskEnabled(Handle task, bool isEnabled) {
+    if (task >= m_tasks.size()) {
+        throw std::runtime_error("Failed to find async compute task.");
+    }
+    m_tasks[task].isEnabled = isEnabled;
+}
+
+void AsyncCompute::addSharedBuffer(const AsyncComputeStructs::SharedBuffer& sharedBuffer) {
+    m_sharedBuffers.push_back({ sharedBuffer, false });
+}
+
+void AsyncCompute::removeSharedBuffer(VkBuffer buffer) {
+    m_sharedBuffers.erase(std::remove_if(m_sharedBuffers.begin(), m_sharedBuffers.end(),
+                                         [&](const SharedBufferState& state) { return state.info.buffer == buffer; }),
+                          m_sharedBuffers.end());
+}
+
+VkSemaphore AsyncCompute::submit(size_t frameIndex) {
+    m_frameIndex = frameIndex;
+    m_graphicsWaitStages = 0;
+    m_isReleasedToGraphics = false;
+    m_isReleasedByGraphics = false;
+
+    for (const auto& task : m_tasks) {
+        if (task.isEnabled) m_graphicsWaitStages |= task.graphicsWaitStages;
+    }
+    // The shared buffers stay where they are, and a pending release is waited for by the next submission.
+    if (m_graphicsWaitStages == 0) return VK_NULL_HANDLE;
+
+    auto commandBuffer = m_commandBuffers[frameIndex];
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin async compute command buffer.");
+    }
+
+    // Not before the previous graphics work is done reading. On a single queue family this orders
+    // against it on the same queue; otherwise it acquires what that work released, after the semaphore.
+    std::vector<VkBufferMemoryBarrier> barriers = {};
+    VkPipelineStageFlags srcStages = 0, dstStages = 0;
+    for (auto& sharedBuffer : m_sharedBuffers) {
+        if (hasDedicatedQueue() && !sharedBuffer.isReleasedByGraphics) continue;
+        barriers.push_back(makeBarrier(sharedBuffer.info, false));
+        srcStages |= hasDedicatedQueue() ? sharedBuffer.info.computeStages : sharedBuffer.info.graphicsStages;
+        dstStages |= sharedBuffer.info.computeStages;
+        sharedBuffer.isReleasedByGraphics = false;
+    }
+    if (!barriers.empty()) {
+        vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+
+    for (const auto& task : m_tasks) {
+        if (task.isEnabled) task.record(commandBuffer, frameIndex);
+    }
+
+    // Release to graphics; the semaphore makes the writes visible on a single queue family.
+    if (hasDedicatedQueue() && !m_sharedBuffers.empty()) {
+        barriers.clear();
+        srcStages = 0;
+        for (const auto& sharedBuffer : m_sharedBuffers) {
+            barriers.push_back(makeBarrier(sharedBuffer.info, true));
+            srcStages |= sharedBuffer.info.computeStages;
+        }
+        vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+        m_isReleasedToGraphics = true;
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record async compute command buffer.");
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    for (const auto& sharedBuffer : m_sharedBuffers) {
+        waitStage |= sharedBuffer.info.computeStages;
+    }
+    if (m_pendingGraphicsRelease != VK_NULL_HANDLE) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &m_pendingGraphicsRelease;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_computeFinishedSemaphores[frameIndex];
+
+    // The graphics submission of the frame waits for this one, so the frame's fence covers both.
+    if (vkQueueSubmit(m_info.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit async compute queue.");
+    }
+    m_pendingGraphicsRelease = VK_NULL_HANDLE;
+
+    return m_computeFinishedSemaphores[frameIndex];
+}
+
+void AsyncCompute::recordGraphicsAcquire(VkCommandBuffer commandBuffer) const {
+    if (!m_isReleasedToGraphics) return;
+
+    std::vector<VkBufferMemoryBarrier> barriers = {};
+    VkPipelineStageFlags dstStages = 0;
+    for (const auto& sharedBuffer : m_sharedBuffers) {
+        barriers.push_back(makeBarrier(sharedBuffer.info, true));
+        dstStages |= sharedBuffer.info.graphicsStages;
+    }
+    // Chained to the semaphore wait of the graphics submission.
+    vkCmdPipelineBarrier(commandBuffer, m_graphicsWaitStages, dstStages, 0, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+}
+
+void AsyncCompute::recordGraphicsRelease(VkCommandBuffer commandBuffer) {
+    if (!m_isReleasedToGraphics) return;
+
+    std::vector<VkBufferMemoryBarrier> barriers = {};
+    VkPipelineStageFlags srcStages = 0;
+    for (auto& sharedBuffer : m_sharedBuffers) {
+        barriers.push_back(makeBarrier(sharedBuffer.info, false));
+        srcStages |= sharedBuffer.info.graphicsStages;
+        sharedBuffer.isReleasedByGraphics = true;
+    }
+    vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+    m_isReleasedByGraphics = true;
+    m_pendingGraphicsRelease = m_graphicsReleasedSemaphores[m_frameIndex];
+}
+
+VkSemaphore AsyncCompute::graphicsReleaseSemaphore() const {
+    return m_isReleasedByGraphics ? m_graphicsReleasedSemaphores[m_frameIndex] : VK_NULL_HANDLE;
+}
+
+void AsyncCompute::destroy() {
+    if (m_device == nullptr) return;
+
+    for (auto& semaphore : m_computeFinishedSemaphores) {
+        vkDestroySemaphore(*m_device, semaphore, nullptr);
+    }
+    m_computeFinishedSemaphores.clear();
+
+    for (auto& semaphore : m_graphicsReleasedSemaphores) {
+        vkDestroySemaphore(*m_device, semaphore, nullptr);
+    }
+    m_graphicsReleasedSemaphores.clear();
+
+    // Frees the command buffers as well.
+    if (m_commandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(*m_device, m_commandPool, nullptr);
+        m_commandPool = VK_NULL_HANDLE;
+    }
+    m_commandBuffers.clear();
+
+    m_tasks.clear();
+    m_sharedBuffers.clear();
+    m_pendingGraphicsRelease = VK_NULL_HANDLE;
+}
+
+VkBufferMemoryBarrier AsyncCompute::makeBarrier(const AsyncComputeStructs::SharedBuffer& sharedBuffer, bool isToGraphics) const {
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.buffer = sharedBuffer.buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    if (!hasDedicatedQueue()) {
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+    else if (isToGraphics) {
+        barrier.srcQueueFamilyIndex = m_info.queueFamilyIndex;
+        barrier.dstQueueFamilyIndex = m_info.graphicsQueueFamilyIndex;
+    }
+    else {
+        barrier.srcQueueFamilyIndex = m_info.graphicsQueueFamilyIndex;
+        barrier.dstQueueFamilyIndex = m_info.queueFamilyIndex;
+    }
+
+    // The access masks are ignored on the side of a transfer they do not belong to.
+    barrier.srcAccessMask = isToGraphics ? sharedBuffer.computeAccess : sharedBuffer.graphicsAccess;
+    barrier.dstAccessMask = isToGraphics ? sharedBuffer.graphicsAccess : sharedBuffer.computeAccess;
+    return barrier;
+}
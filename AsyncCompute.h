@@ -0,0 +1,154 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef ASYNC_COMPUTE_H
+#define ASYNC_COMPUTE_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace AsyncComputeStructs {
+    struct CreateInfo {
+        // A dedicated compute queue, or the graphics queue itself when the device has none.
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t queueFamilyIndex = 0;
+
+        // Where the results are consumed. Ownership of shared buffers only changes hands
+        // when it differs from queueFamilyIndex.
+        uint32_t graphicsQueueFamilyIndex = 0;
+
+        size_t frameCount = 1;
+    };
+
+    // Records a task into the compute command buffer of the given frame in flight.
+    using RecordFunc = std::function<void(VkCommandBuffer, size_t)>;
+
+    // A buffer written by the tasks and read by the graphics work of the same frame. With a dedicated
+    // queue family it is released to graphics after the tasks and handed back once the frame is done,
+    // so the next tasks never overwrite what graphics is still reading.
+    struct SharedBuffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+
+        VkPipelineStageFlags computeStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        VkAccessFlags computeAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        VkPipelineStageFlags graphicsStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        VkAccessFlags graphicsAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    };
+}
+
+// Compute work that overlaps the rasterization of the same frame. The tasks of a frame are recorded
+// into one command buffer and submitted ahead of the graphics work, which waits for them only at the
+// stages that consume their results. Without a dedicated compute queue everything goes on the graphics
+// queue in the same order, so the results are the same, only without the overlap.
+class AsyncCompute {
+public:
+    using Handle = uint32_t;
+
+    constexpr static Handle InvalidHandle = UINT32_MAX;
+
+public:
+    AsyncCompute() = default;
+    ~AsyncCompute();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const AsyncComputeStructs::CreateInfo& info);
+
+    inline bool hasDedicatedQueue() const { return m_info.queueFamilyIndex != m_info.graphicsQueueFamilyIndex; }
+
+    inline bool hasTasks() const { return !m_tasks.empty(); }
+
+    // Recorded every frame in the order added. The graphics work waits for them at graphicsWaitStages.
+    // Shared buffers read by the graphics work should be read at or after these stages.
+    Handle addTask(const AsyncComputeStructs::RecordFunc& record, VkPipelineStageFlags graphicsWaitStages);
+
+    void setTaskEnabled(Handle task, bool isEnabled);
+
+    // Only contents written by the tasks are guaranteed to reach graphics; what was uploaded on another
+    // queue before adding it is undefined to them with a dedicated queue family.
+    void addSharedBuffer(const AsyncComputeStructs::SharedBuffer& sharedBuffer);
+
+    // Before destroying it. Nothing may be in flight.
+    void removeSharedBuffer(VkBuffer buffer);
+
+    // Record and submit the enabled tasks of the frame, after the graphics work of the previous frame
+    // has been submitted and before the graphics work of this one is recorded.
+    // Return the semaphore that the graphics submission has to wait for at graphicsWaitStages(),
+    // or VK_NULL_HANDLE when no task is enabled.
+    VkSemaphore submit(size_t frameIndex);
+
+    // Of the last submit().
+    inline VkPipelineStageFlags graphicsWaitStages() const { return m_graphicsWaitStages; }
+
+    // Around the graphics work of the frame last submitted: take the shared buffers over from the
+    // compute queue family before any of it, and hand them back after all of it.
+    void recordGraphicsAcquire(VkCommandBuffer commandBuffer) const;
+
+    void recordGraphicsRelease(VkCommandBuffer commandBuffer);
+
+    // To be signaled by the graphics submission when recordGraphicsRelease() recorded anything;
+    // the next submit() waits for it. VK_NULL_HANDLE otherwise.
+    VkSemaphore graphicsReleaseSemaphore() const;
+
+    void destroy();
+
+private:
+    struct Task {
+        AsyncComputeStructs::RecordFunc record = {};
+        VkPipelineStageFlags graphicsWaitStages = 0;
+        bool isEnabled = true;
+    };
+
+    struct SharedBufferState {
+        AsyncComputeStructs::SharedBuffer info = {};
+
+        // Released by the graphics work last submitted, so the next submit() has to acquire it.
+        bool isReleasedByGraphics = false;
+    };
+
+    // Between the queue families, or within the single one when they are the same.
+    VkBufferMemoryBarrier makeBarrier(const AsyncComputeStructs::SharedBuffer& sharedBuffer, bool isToGraphics) const;
+
+private:
+    VkDevice* m_device = nullptr;
+
+    AsyncComputeStructs::CreateInfo m_info = {};
+
+    VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+    // Per frame in flight.
+    std::vector<VkCommandBuffer> m_commandBuffers = {};
+    std::vector<VkSemaphore> m_computeFinishedSemaphores = {};
+    std::vector<VkSemaphore> m_graphicsReleasedSemaphores = {};
+
+    std::vector<Task> m_tasks = {};
+
+    std::vector<SharedBufferState> m_sharedBuffers = {};
+
+    // Signaled by the graphics work last submitted, when it released any shared buffer.
+    VkSemaphore m_pendingGraphicsRelease = VK_NULL_HANDLE;
+
+    VkPipelineStageFlags m_graphicsWaitStages = 0;
+
+    // Of the last submit().
+    size_t m_frameIndex = 0;
+
+    // Whether the last submit() released the shared buffers to graphics.
+    bool m_isReleasedToGraphics = false;
+
+    // Whether the graphics work of that frame hands them back.
+    bool m_isReleasedByGraphics = false;
+};
+
+#endif // ASYNC_COMPUTE_H
@@ -0,0 +1,123 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef BENCHMARK_COMMON_H
+#define BENCHMARK_COMMON_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace BenchmarkCommon {
+    // Run the body repeatedly and return the median duration in milliseconds.
+    inline double measureMedianMs(const std::function<void()>& body, int iterations = 5) {
+        std::vector<double> samples = {};
+        for (int i = 0; i < iterations; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    inline double toMiB(uint64_t bytes) {
+        return double(bytes) / (1024.0 * 1024.0);
+    }
+
+    inline void printRule(int width = 96) {
+        printf("%s\n", std::string(width, '-').c_str());
+    }
+
+    // Nearest-rank percentile of sorted samples, p in [0, 100]: the smallest sample with at least
+    // p percent of the samples at or below it.
+    inline double percentile(const std::vector<double>& sortedSamples, double p) {
+        if (sortedSamples.empty()) return 0.0;
+        auto rank = std::ceil(p / 100.0 * static_cast<double>(sortedSamples.size())) - 1.0;
+        auto index = static_cast<size_t>(std::max(rank, 0.0));
+        return sortedSamples[std::min(index, sortedSamples.size() - 1)];
+    }
+
+    // Mean, median and p95 of the collected frame times in milliseconds.
+    inline void printFrameTimes(std::vector<double> frameTimes, int width = 48) {
+        if (frameTimes.empty()) return;
+        std::sort(frameTimes.begin(), frameTimes.end());
+
+        double sum = 0.0;
+        for (auto time : frameTimes) sum += time;
+
+        printRule(width);
+        printf("%-12s %10.3f ms\n", "mean", sum / frameTimes.size());
+        printf("%-12s %10.3f ms\n", "median", percentile(frameTimes, 50.0));
+        printf("%-12s %10.3f ms\n", "p95", percentile(frameTimes, 95.0));
+        printRule(width);
+    }
+
+    // Total GPU time of the profiler scopes whose names start with any of the given prefixes, e.g.
+    // "shadow_cascade" for all cascades. GPU scopes arrive the frames in flight after their frame was
+    // recorded, so every collect() looks at the whole snapshot and counts the frames it has not seen yet.
+    // Frames are told apart by their index, not their times: those are placed relative to when recording
+    // started, so with the GPU behind, a frame may seem to begin before the previous one ended.
+    class GpuScopeAccumulator {
+    public:
+        explicit GpuScopeAccumulator(std::vector<std::string> prefixes)
+                : m_prefixes(std::move(prefixes)), m_totalNs(m_prefixes.size(), 0) {}
+
+        // Profiler::gpuFrameCount(); the frames begun so far are left out, e.g. the warmup frames.
+        inline void start(uint64_t gpuFrameCount) { m_lastFrameIndex = gpuFrameCount; }
+
+        // The events of Profiler::snapshot(), taken between frames; a frame's events all arrive at once.
+        template<typename Events>
+        void collect(const Events& events) {
+            uint64_t lastFrameIndex = m_lastFrameIndex;
+            for (const auto& event : events) {
+                if (!event.isGpu || event.gpuFrameIndex <= m_lastFrameIndex) continue;
+
+                if (event.gpuFrameIndex > lastFrameIndex) {
+                    lastFrameIndex = event.gpuFrameIndex;
+                    ++m_frameCount;
+                }
+                for (size_t i = 0; i < m_prefixes.size(); ++i) {
+                    if (strncmp(event.name, m_prefixes[i].c_str(), m_prefixes[i].size()) == 0) {
+                        m_totalNs[i] += event.endNs - event.beginNs;
+                        break;
+                    }
+                }
+            }
+            m_lastFrameIndex = lastFrameIndex;
+        }
+
+        // Frames whose scopes have been counted; 0 without GPU timestamps.
+        inline uint64_t frameCount() const { return m_frameCount; }
+
+        // Of the prefix at the given index, per counted frame.
+        inline double averageMs(size_t prefix) const {
+            return m_frameCount == 0 ? 0.0 : 1e-6 * static_cast<double>(m_totalNs[prefix]) / static_cast<double>(m_frameCount);
+        }
+
+    private:
+        std::vector<std::string> m_prefixes = {};
+
+        uint64_t m_lastFrameIndex = 0;
+
+        uint64_t m_frameCount = 0;
+        std::vector<uint64_t> m_totalNs = {};
+    };
+}
+
+#endif // BENCHMARK_COMMON_H
@@ -0,0 +1,72 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef BENCHMARK_WINDOW_H
+#define BENCHMARK_WINDOW_H
+
+#include <QApplication>
+
+#include <chrono>
+#include <vector>
+
+#include "BenchmarkCommon.h"
+#include "DisplayWindow.h"
+
+// The frame loop of the benchmarks that render a scene: the warmup frames, then the measured frames,
+// then the report, then quit. Subclasses declare the scene and hook into the loop where they need to.
+class BenchmarkWindow : public DisplayWindow {
+public:
+    BenchmarkWindow(int warmupFrameCount, int frameCount)
+            : m_warmupFrameCount(warmupFrameCount), m_frameCount(frameCount) {}
+
+protected:
+    void paintEvent(QPaintEvent* event) final {
+        if (m_frameIndex == m_warmupFrameCount) beginMeasuring();
+        prepareFrame(m_frameIndex);
+
+        auto start = std::chrono::steady_clock::now();
+        DisplayWindow::paintEvent(event);
+        auto end = std::chrono::steady_clock::now();
+
+        if (++m_frameIndex > m_warmupFrameCount) {
+            m_frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            collectFrame();
+
+            if (static_cast<int>(m_frameTimes.size()) == m_frameCount) {
+                report();
+                QApplication::quit();
+            }
+        }
+    }
+
+    // Before every frame, the warmup frames included.
+    virtual void prepareFrame(int frameIndex) { FUNC_PARAM_UNUSED(frameIndex); }
+
+    // Once, right before the first measured frame.
+    virtual void beginMeasuring() {}
+
+    // After every measured frame.
+    virtual void collectFrame() {}
+
+    // After the last measured frame.
+    virtual void report() = 0;
+
+    // Of the measured frames, in milliseconds.
+    inline const std::vector<double>& frameTimes() const { return m_frameTimes; }
+
+private:
+    int m_warmupFrameCount = 0;
+    int m_frameCount = 0;
+
+    int m_frameIndex = 0;
+    std::vector<double> m_frameTimes = {};
+};
+
+#endif // BENCHMARK_WINDOW_H
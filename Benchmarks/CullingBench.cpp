@@ -0,0 +1,121 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Frustum culling throughput over scattered objects:
+//   - building the hierarchy, as is done when draw items are attached to other nodes;
+//   - refitting it after a fraction of the objects moved;
+//   - culling with the hierarchy against testing every box on its own;
+// for a camera sweeping through the field, so the visible fraction changes between views.
+//
+//   CullingBench [--objects N] [--radius R]
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchmarkCommon.h"
+#include "CullingBvh.h"
+
+int main(int argc, char** argv) {
+    size_t objectCount = 1000000;
+    float radius = 500.0f;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--objects" && i + 1 < argc) objectCount = std::stoul(argv[++i]);
+        else if (arg == "--radius" && i + 1 < argc) radius = std::stof(argv[++i]);
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-radius, radius);
+    std::uniform_real_distribution<float> extent(0.25f, 1.0f);
+
+    std::vector<CullingBvh::Bounds> bounds(objectCount);
+    for (auto& box : bounds) {
+        box = { { position(random), position(random), position(random) }, glm::vec3(extent(random)) };
+    }
+
+    // Looking down +z from points along x, the way the engine's camera starts out.
+    auto projMat = glm::perspectiveFovLH_ZO(glm::radians(45.0f), 1600.0f, 900.0f, 0.1f, 2.0f * radius);
+    std::vector<CullingBvh::Frustum> frustums = {};
+    for (float x : { -radius, -0.5f * radius, 0.0f, 0.5f * radius, radius }) {
+        auto viewMat = glm::translate(glm::mat4(1.0f), { -x, 0.0f, radius });
+        frustums.push_back(CullingBvh::extractFrustum(projMat * viewMat));
+    }
+
+    printf("Frustum culling, %zu objects, %zu views\n", objectCount, frustums.size());
+    BenchmarkCommon::printRule(64);
+    printf("%-28s %12s %16s\n", "case", "median (ms)", "objects/ms");
+    BenchmarkCommon::printRule(64);
+
+    auto printRow = [&](const char* label, double ms, size_t objects) {
+        printf("%-28s %12.3f %16.0f\n", label, ms, ms > 0.0 ? static_cast<double>(objects) / ms : 0.0);
+    };
+
+    CullingBvh bvh = {};
+    double buildMs = BenchmarkCommon::measureMedianMs([&]() { bvh.build(bounds); });
+    printRow("build", buildMs, objectCount);
+
+    for (double fraction : { 0.1, 0.01 }) {
+        auto movedCount = static_cast<size_t>(fraction * objectCount);
+        std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(objectCount - 1));
+        std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+
+        // Small steps, the way animated objects move between frames.
+        std::vector<uint32_t> movedObjects(movedCount);
+        double ms = BenchmarkCommon::measureMedianMs([&]() {
+            for (auto& object : movedObjects) {
+                object = pick(random);
+                bounds[object].center += glm::vec3(step(random), step(random), step(random));
+            }
+            bvh.refit(bounds, movedObjects);
+        });
+        char label[32];
+        snprintf(label, sizeof(label), "refit %.0f%% moved (incl. set)", fraction * 100.0);
+        printRow(label, ms, movedCount);
+    }
+
+    std::vector<uint32_t> visibleObjects = {};
+    visibleObjects.reserve(objectCount);
+    size_t visibleCount = 0;
+
+    double bvhMs = BenchmarkCommon::measureMedianMs([&]() {
+        visibleCount = 0;
+        for (const auto& frustum : frustums) {
+            visibleObjects.clear();
+            bvh.cull(frustum, visibleObjects);
+            visibleCount += visibleObjects.size();
+        }
+    });
+    size_t bvhVisibleCount = visibleCount;
+    printRow("cull bvh", bvhMs / frustums.size(), objectCount);
+
+    double bruteMs = BenchmarkCommon::measureMedianMs([&]() {
+        visibleCount = 0;
+        for (const auto& frustum : frustums) {
+            visibleObjects.clear();
+            for (uint32_t i = 0; i < objectCount; ++i) {
+                if (CullingBvh::isBoundsVisible(frustum, bounds[i])) visibleObjects.push_back(i);
+            }
+            visibleCount += visibleObjects.size();
+        }
+    });
+    printRow("cull brute force", bruteMs / frustums.size(), objectCount);
+    BenchmarkCommon::printRule(64);
+
+    printf("visible per view: %.1f%% (bvh %zu, brute force %zu), speedup %.1fx\n",
+           100.0 * bvhVisibleCount / (objectCount * frustums.size()), bvhVisibleCount / frustums.size(),
+           visibleCount / frustums.size(), bvhMs > 0.0 ? bruteMs / bvhMs : 0.0);
+
+    return bvhVisibleCount == visibleCount ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Reproducible frame times: a fixed scene seen along a recorded camera path, with no live input.
+//
+//   FrameBench [--path FILE] [--grid N] [--frames N] [--prepass] [--samples N] [--visible]
+//              [--present immediate|mailbox|fifo|fifo_relaxed] [--images N] [--low-latency] [--no-culling]
+//              [--output FILE] [--baseline FILE] [--threshold PERCENT]
+//
+// Camera paths are recorded in the main app with F9; without --path a built-in fly-over is used.
+// Frames are driven back to back by the benchmark rather than by the window system, and the window
+// is kept off screen unless --visible is given. Results are written as JSON (to stdout by default);
+// with --baseline the p50/p95/p99 of both runs are compared on stderr and the exit code is 1
+// when any of them got slower by more than the threshold.
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+#include "BenchmarkCommon.h"
+#include "CameraPath.h"
+#include "DisplayWindow.h"
+
+struct FrameBenchOptions {
+    QString pathFilename = {};
+    int gridSize = 24;
+    int warmupFrameCount = 60;
+    int frameCount = 0; // 0 means the length of the camera path.
+    bool enableDepthPrepass = false;
+    VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+    bool isVisible = false;
+    VulkanEngineStructs::PresentSettings present = {};
+    bool enableFrustumCulling = true;
+
+    QString outputFilename = {};
+    QString baselineFilename = {};
+    double thresholdPercent = 5.0;
+};
+
+static VkPresentModeKHR parsePresentMode(const QString& name) {
+    if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "fifo_relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    throw std::runtime_error("Unknown present mode " + name.toStdString());
+}
+
+static CameraPath makeDefaultCameraPath() {
+    // Forward over the grid while looking from side to side, then back up to the start.
+    CameraPath path = {};
+    path.addKeyframe({ 0, { 0.0f, 0.0f, -1.0f }, 0.0f, 0.0f });
+    path.addKeyframe({ 300, { 0.0f, 2.0f, 12.0f }, 0.6f, 0.2f });
+    path.addKeyframe({ 600, { 6.0f, 2.0f, 24.0f }, -0.6f, 0.2f });
+    path.addKeyframe({ 900, { 0.0f, 4.0f, 36.0f }, 0.0f, 0.4f });
+    path.addKeyframe({ 1199, { 0.0f, 0.0f, -1.0f }, 0.0f, 0.0f });
+    return path;
+}
+
+static QJsonObject summarizeFrameTimes(std::vector<double> frameTimes) {
+    std::sort(frameTimes.begin(), frameTimes.end());
+
+    double sum = 0.0;
+    for (auto time : frameTimes) sum += time;
+
+    QJsonObject summary = {};
+    summary["mean"] = frameTimes.empty() ? 0.0 : sum / frameTimes.size();
+    summary["p50"] = BenchmarkCommon::percentile(frameTimes, 50.0);
+    summary["p95"] = BenchmarkCommon::percentile(frameTimes, 95.0);
+    summary["p99"] = BenchmarkCommon::percentile(frameTimes, 99.0);
+    summary["max"] = frameTimes.empty() ? 0.0 : frameTimes.back();
+    return summary;
+}
+
+class FrameBenchWindow : public DisplayWindow {
+public:
+    FrameBenchWindow(const FrameBenchOptions& options, const CameraPath& path) : m_options(options), m_path(path) {}
+
+    void declareRenderResourceData() override {
+        DisplayWindow::declareRenderResourceData(); // The cube.
+
+        // A grid of cubes on the ground ahead of the camera, placed by scene nodes so they can be culled.
+        m_scene.reserve(static_cast<size_t>(m_options.gridSize) * m_options.gridSize);
+        for (int x = 0; x < m_options.gridSize; ++x) {
+            for (int z = 0; z < m_options.gridSize; ++z) {
+                auto node = m_scene.createNode(Scene::InvalidNode, { glm::vec3(0.0f), glm::vec3(0.5f) });
+                m_scene.setLocalTransform(node, glm::vec3(2.0f * x - m_options.gridSize, -1.5f, 2.0f * z + 2.0f),
+                                          glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+
+                float u = static_cast<float>(x) / m_options.gridSize, v = static_cast<float>(z) / m_options.gridSize;
+                auto material = engine.declareMaterial(glm::vec4(u, v, 1.0f - u, 1.0f));
+
+                auto drawItem = engine.declareDrawItem("cube", "cube", glm::mat4(1.0f), material);
+                engine.setDrawItemNode(drawItem, node);
+            }
+        }
+        engine.setScene(&m_scene);
+    }
+
+    // Place the camera on the path and render; returns the CPU time of the frame in milliseconds.
+    double runFrame(uint32_t frame) {
+        if (frame == 0) engine.resetCamera();
+
+        auto keyframe = m_path.sample(frame % m_path.frameCount());
+        engine.moveCameraTo(keyframe.eye);
+        engine.rotateCamera(keyframe.yaw - engine.cameraYaw(), keyframe.pitch - engine.cameraPitch());
+
+        auto start = std::chrono::steady_clock::now();
+        engine.renderFrame();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    inline VulkanEngine& vulkanEngine() { return engine; }
+
+protected:
+    // Frames are driven by the benchmark loop, and input must not move the camera.
+    void paintEvent(QPaintEvent* event) override { FUNC_PARAM_UNUSED(event); }
+    void mouseMoveEvent(QMouseEvent* event) override { FUNC_PARAM_UNUSED(event); }
+    void wheelEvent(QWheelEvent* event) override { FUNC_PARAM_UNUSED(event); }
+    void keyPressEvent(QKeyEvent* event) override { FUNC_PARAM_UNUSED(event); }
+    void keyReleaseEvent(QKeyEvent* event) override { FUNC_PARAM_UNUSED(event); }
+
+private:
+    FrameBenchOptions m_options = {};
+    CameraPath m_path = {};
+
+    Scene m_scene = {};
+};
+
+// Print the percentile deltas against the baseline; return whether any regressed beyond the threshold.
+static bool compareWithBaseline(const QJsonObject& result, const QJsonObject& baseline, double thresholdPercent) {
+    bool isRegressed = false;
+
+    fprintf(stderr, "%-20s %-6s %12s %12s %10s\n", "metric", "", "baseline ms", "current ms", "delta");
+    for (const auto& metric : { "cpu_frame_ms", "gpu_frame_ms", "input_to_present_ms" }) {
+        if (!result.contains(metric) || !baseline.contains(metric)) continue;
+
+        auto current = result[metric].toObject();
+        auto previous = baseline[metric].toObject();
+        for (const auto& key : { "p50", "p95", "p99" }) {
+            double before = previous[key].toDouble(), after = current[key].toDouble();
+            if (before <= 0.0) continue;
+
+            double deltaPercent = (after - before) / before * 100.0;
+            bool isSlower = deltaPercent > thresholdPercent;
+            isRegressed = isRegressed || isSlower;
+
+            fprintf(stderr, "%-20s %-6s %12.3f %12.3f %+9.1f%%%s\n",
+                    metric, key, before, after, deltaPercent, isSlower ? "  REGRESSION" : "");
+        }
+    }
+    return isRegressed;
+}
+
+static QJsonObject loadJson(const QString& filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Failed to open " + filename.toStdString());
+    }
+    auto document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject()) {
+        throw std::runtime_error("Failed to parse " + filename.toStdString());
+    }
+    return document.object();
+}
+
+int main(int argc, char** argv) {
+    try {
+        QApplication a(argc, argv);
+
+        FrameBenchOptions options = {};
+        auto args = QApplication::arguments();
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i] == "--path" && i + 1 < args.size()) options.pathFilename = args[++i];
+            else if (args[i] == "--grid" && i + 1 < args.size()) options.gridSize = args[++i].toInt();
+            else if (args[i] == "--frames" && i + 1 < args.size()) options.frameCount = args[++i].toInt();
+            else if (args[i] == "--prepass") options.enableDepthPrepass = true;
+            else if (args[i] == "--samples" && i + 1 < args.size()) options.sampleCount = static_cast<VkSampleCountFlagBits>(args[++i].toInt());
+            else if (args[i] == "--visible") options.isVisible = true;
+            else if (args[i] == "--present" && i + 1 < args.size()) options.present.presentMode = parsePresentMode(args[++i]);
+            else if (args[i] == "--images" && i + 1 < args.size()) options.present.imageCount = args[++i].toUInt();
+            else if (args[i] == "--low-latency") options.present.latencyMode = VulkanEngineStructs::LatencyMode::Low;
+            else if (args[i] == "--no-culling") options.enableFrustumCulling = false;
+            else if (args[i] == "--output" && i + 1 < args.size()) options.outputFilename = args[++i];
+            else if (args[i] == "--baseline" && i + 1 < args.size()) options.baselineFilename = args[++i];
+            else if (args[i] == "--threshold" && i + 1 < args.size()) options.thresholdPercent = args[++i].toDouble();
+        }
+
+        CameraPath path = {};
+        if (options.pathFilename.isEmpty()) path = makeDefaultCameraPath();
+        else path.load(options.pathFilename.toStdString());
+        if (path.isEmpty()) {
+            throw std::runtime_error("Camera path is empty");
+        }
+        if (options.frameCount <= 0) options.frameCount = static_cast<int>(path.frameCount());
+
+        VulkanEngineStructs::CreateInfo info = {};
+        info.enableDepthPrepass = options.enableDepthPrepass;
+        info.sampleCount = options.sampleCount;
+        info.present = options.present;
+        info.enableFrustumCulling = options.enableFrustumCulling;
+
+        FrameBenchWindow w(options, path);
+        w.setAttribute(Qt::WA_DontShowOnScreen, !options.isVisible);
+        w.declareRenderResourceData();
+        w.initVulkanEngine(info);
+        w.show();
+
+        auto& engine = w.vulkanEngine();
+
+        // The warm-up replays the start of the path, then the measured run starts over from frame 0.
+        for (int i = 0; i < options.warmupFrameCount; ++i) {
+            QApplication::processEvents();
+            w.runFrame(i);
+        }
+
+        std::vector<double> cpuFrameTimes = {};
+        std::vector<double> gpuFrameTimes = {};
+        std::vector<double> inputToPresentTimes = {};
+        for (int i = 0; i < options.frameCount; ++i) {
+            QApplication::processEvents();
+            cpuFrameTimes.push_back(w.runFrame(i));
+
+            // Every frame moves the camera, so every frame carries input.
+            auto inputToPresentNs = engine.telemetry().frame.inputToPresentNs;
+            if (inputToPresentNs > 0) inputToPresentTimes.push_back(inputToPresentNs / 1e6);
+
+            // GPU times arrive frames in flight later; it is the distribution that matters here.
+            auto gpuFrameMs = engine.profiler().frameSummary().gpuFrameMs;
+            if (gpuFrameMs > 0.0) gpuFrameTimes.push_back(gpuFrameMs);
+        }
+
+        QJsonObject result = {};
+        result["benchmark"] = "FrameBench";
+        result["path"] = options.pathFilename.isEmpty() ? QString("default") : options.pathFilename;
+        result["grid"] = options.gridSize;
+        result["draws"] = static_cast<int>(engine.telemetry().frame.drawCount);
+        result["culled_draws"] = static_cast<int>(engine.telemetry().frame.culledDrawCount);
+        result["culling"] = options.enableFrustumCulling;
+        result["occluded_draws"] = static_cast<int>(engine.telemetry().frame.occludedDrawCount);
+        result["occlusion_culling"] = engine.isOcclusionCullingEnabled();
+        result["cluster_culled_triangles"] = static_cast<double>(engine.telemetry().frame.clusterCulledTriangleCount);
+        result["meshlet_culling"] = engine.isMeshletCullingEnabled();
+        result["samples"] = static_cast<int>(engine.sampleCount());
+        result["prepass"] = options.enableDepthPrepass;
+        result["frames"] = options.frameCount;
+        result["present_mode"] = static_cast<int>(engine.telemetry().presentMode);
+        result["images"] = static_cast<int>(engine.telemetry().swapchainImageCount);
+        result["low_latency"] = options.present.latencyMode == VulkanEngineStructs::LatencyMode::Low;
+        result["cpu_frame_ms"] = summarizeFrameTimes(cpuFrameTimes);
+        if (!gpuFrameTimes.empty()) {
+            result["gpu_frame_ms"] = summarizeFrameTimes(gpuFrameTimes);
+        }
+        if (!inputToPresentTimes.empty()) {
+            result["input_to_present_ms"] = summarizeFrameTimes(inputToPresentTimes);
+        }
+
+        auto json = QJsonDocument(result).toJson(QJsonDocument::Indented);
+        if (options.outputFilename.isEmpty()) {
+            fwrite(json.constData(), 1, json.size(), stdout);
+        }
+        else {
+            QFile file(options.outputFilename);
+            if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+                throw std::runtime_error("Failed to write " + options.outputFilename.toStdString());
+            }
+        }
+
+        if (!options.baselineFilename.isEmpty()) {
+            return compareWithBaseline(result, loadJson(options.baselineFilename), options.thresholdPercent) ? 1 : 0;
+        }
+        return 0;
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+        return 2;
+    }
+}
@@ -0,0 +1,190 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Clustered point lights: a field of boxes on the ground with lights of random colors scattered over it,
+// bobbing up and down, seen by a camera looking down on the field. Shadows are off, so the point lights
+// are all the shading there is.
+//
+//   LightBench [--lights N] [--radius R] [--no-clusters] [--grid N] [--frames N]
+//
+// Reports frame times and the GPU time of light culling and of the main passes per frame. Run with
+// --lights 100, 1000 and 10000 to see how it scales; --no-clusters puts every light into a single
+// cluster, i.e. every fragment loops over all lights, for comparison.
+
+#include <glm/gtc/constants.hpp>
+
+#include <QApplication>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <random>
+#include <vector>
+
+#include "BenchmarkWindow.h"
+
+struct LightBenchOptions {
+    uint32_t lightCount = 1000;
+    float radius = 3.0f;
+    bool enableClusters = true;
+    int gridSize = 32;
+    int warmupFrameCount = 60;
+    int frameCount = 600;
+};
+
+class LightBenchWindow : public BenchmarkWindow {
+public:
+    explicit LightBenchWindow(const LightBenchOptions& options)
+            : BenchmarkWindow(options.warmupFrameCount, options.frameCount), m_options(options) {}
+
+    void declareRenderResourceData() override {
+        DisplayWindow::declareRenderResourceData(); // The cube.
+
+        int n = m_options.gridSize;
+        m_scene.reserve(static_cast<size_t>(n) * n + 1);
+
+        // The ground, a flat cube under everything.
+        auto ground = m_scene.createNode(Scene::InvalidNode, { glm::vec3(0.0f), glm::vec3(0.5f) });
+        m_scene.setLocalTransform(ground, glm::vec3(0.0f, -2.1f, 1.5f * n), glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                                  glm::vec3(4.0f * n, 0.2f, 4.0f * n));
+        auto groundItem = engine.declareDrawItem("cube", "cube", glm::mat4(1.0f), engine.declareMaterial(glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)));
+        engine.setDrawItemNode(groundItem, ground);
+
+        // Boxes of varying height with room between them for the lights.
+        for (int x = 0; x < n; ++x) {
+            for (int z = 0; z < n; ++z) {
+                float height = 1.0f + static_cast<float>((x * 7 + z * 13) % 5);
+                auto node = m_scene.createNode(Scene::InvalidNode, { glm::vec3(0.0f), glm::vec3(0.5f) });
+                m_scene.setLocalTransform(node, glm::vec3(3.0f * x - 1.5f * n, -2.0f + 0.5f * height, 3.0f * z + 2.0f),
+                                          glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f, height, 1.0f));
+
+                auto drawItem = engine.declareDrawItem("cube", "cube", glm::mat4(1.0f), engine.declareMaterial(glm::vec4(1.0f)));
+                engine.setDrawItemNode(drawItem, node);
+            }
+        }
+        engine.setScene(&m_scene);
+
+        // The same lights every run, spread over the field.
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        m_lights.resize(m_options.lightCount);
+        for (auto& light : m_lights) {
+            light.basePosition = glm::vec3((unit(random) - 0.5f) * 3.0f * n, -1.5f + 2.0f * unit(random), 3.0f * n * unit(random));
+            light.phase = 2.0f * glm::pi<float>() * unit(random);
+            light.colorIntensity = glm::vec4(unit(random), unit(random), unit(random), 2.0f);
+            light.id = engine.declarePointLight({ glm::vec4(light.basePosition, m_options.radius), light.colorIntensity });
+        }
+    }
+
+protected:
+    void prepareFrame(int frameIndex) override {
+        if (frameIndex == 0) {
+            engine.resetCamera();
+            engine.moveCameraTo(glm::vec3(0.0f, 6.0f, -4.0f));
+            engine.rotateCamera(0.0f, -0.4f); // Looking down on the field.
+        }
+        animate(frameIndex);
+    }
+
+    void beginMeasuring() override {
+        m_passTimes.start(engine.profiler().gpuFrameCount());
+    }
+
+    void collectFrame() override {
+        const auto& frame = engine.telemetry().frame;
+        m_lightIndexCount += frame.lightIndexCount;
+        m_droppedLightIndexCount += frame.droppedLightIndexCount;
+        m_passTimes.collect(engine.profiler().snapshot());
+    }
+
+private:
+    struct Light {
+        uint32_t id = 0;
+        glm::vec3 basePosition = {};
+        float phase = 0.0f;
+        glm::vec4 colorIntensity = {};
+    };
+
+    // Every light moves every frame, so the culling never sees the same lights twice.
+    void animate(int frame) {
+        float t = static_cast<float>(frame) / 60.0f;
+        for (const auto& light : m_lights) {
+            auto position = light.basePosition + glm::vec3(0.0f, 0.5f * std::sin(t + light.phase), 0.0f);
+            engine.setPointLight(light.id, { glm::vec4(position, m_options.radius), light.colorIntensity });
+        }
+    }
+
+    void report() override {
+        printf("Light bench: %d boxes, %u lights of radius %.1f, clusters %s\n",
+               m_options.gridSize * m_options.gridSize, m_options.lightCount, m_options.radius,
+               m_options.enableClusters ? "on" : "off");
+        if (!engine.isClusteredLightingEnabled()) {
+            printf("clustered lighting is disabled\n");
+            return;
+        }
+        BenchmarkCommon::printFrameTimes(frameTimes());
+
+        if (m_passTimes.frameCount() > 0) {
+            printf("%-24s %12.3f ms\n", "gpu light cull per frame", m_passTimes.averageMs(LightCullPass));
+            printf("%-24s %12.3f ms\n", "gpu main per frame", m_passTimes.averageMs(MainPass));
+        }
+        double frameCount = static_cast<double>(frameTimes().size());
+        printf("%-24s %12.1f\n", "light indices per frame", static_cast<double>(m_lightIndexCount) / frameCount);
+        printf("%-24s %12.1f\n", "dropped per frame", static_cast<double>(m_droppedLightIndexCount) / frameCount);
+    }
+
+private:
+    LightBenchOptions m_options = {};
+
+    Scene m_scene = {};
+    std::vector<Light> m_lights = {};
+
+    uint64_t m_lightIndexCount = 0;
+    uint64_t m_droppedLightIndexCount = 0;
+
+    // In the order of the prefixes below.
+    enum { LightCullPass, MainPass };
+    BenchmarkCommon::GpuScopeAccumulator m_passTimes = BenchmarkCommon::GpuScopeAccumulator({ "light_cull", "main" });
+};
+
+int main(int argc, char** argv) {
+    try {
+        QApplication a(argc, argv);
+
+        LightBenchOptions options = {};
+        auto args = QApplication::arguments();
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i] == "--lights" && i + 1 < args.size()) options.lightCount = args[++i].toUInt();
+            else if (args[i] == "--radius" && i + 1 < args.size()) options.radius = args[++i].toFloat();
+            else if (args[i] == "--no-clusters") options.enableClusters = false;
+            else if (args[i] == "--grid" && i + 1 < args.size()) options.gridSize = args[++i].toInt();
+            else if (args[i] == "--frames" && i + 1 < args.size()) options.frameCount = args[++i].toInt();
+        }
+
+        VulkanEngineStructs::CreateInfo info = {};
+        info.shadowCascadeCount = 0;
+        if (!options.enableClusters) {
+            // One cluster holding every light.
+            info.lightClusterCountX = info.lightClusterCountY = info.lightClusterCountZ = 1;
+            info.averageLightsPerCluster = std::max(options.lightCount, 1u);
+        }
+
+        LightBenchWindow w(options);
+        w.declareRenderResourceData();
+        w.initVulkanEngine(info);
+        w.show();
+        return a.exec();
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+    }
+}
@@ -0,0 +1,113 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Meshlet building and normal cone rejection on a UV sphere:
+//   - building, as is done for every declared mesh at load;
+//   - how full the meshlets get against their vertex and triangle limits;
+//   - the triangles whose meshlet the cone test rejects, against those that actually face away,
+//     seen from points around the sphere.
+// A rejected triangle that does not face away would be a visible hole, so any is a failure.
+//
+//   MeshletBench [--segments N] [--views N]
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/constants.hpp>
+
+#include "BenchmarkCommon.h"
+#include "MeshletBuilder.h"
+
+int main(int argc, char** argv) {
+    int segmentCount = 1024;
+    int viewCount = 64;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--segments" && i + 1 < argc) segmentCount = std::stoi(argv[++i]);
+        else if (arg == "--views" && i + 1 < argc) viewCount = std::stoi(argv[++i]);
+    }
+
+    // The sphere of OcclusionBench, with slices and stacks in the same order.
+    int sliceCount = std::max(segmentCount, 3), stackCount = std::max(segmentCount / 2, 2);
+    std::vector<glm::vec3> positions = {};
+    for (int stack = 0; stack <= stackCount; ++stack) {
+        float phi = glm::pi<float>() * static_cast<float>(stack) / stackCount;
+        for (int slice = 0; slice <= sliceCount; ++slice) {
+            float theta = 2.0f * glm::pi<float>() * static_cast<float>(slice) / sliceCount;
+            positions.push_back(0.5f * glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+        }
+    }
+    std::vector<uint32_t> sourceIndices = {};
+    for (int stack = 0; stack < stackCount; ++stack) {
+        for (int slice = 0; slice < sliceCount; ++slice) {
+            uint32_t a = stack * (sliceCount + 1) + slice, b = a + sliceCount + 1;
+            sourceIndices.insert(sourceIndices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    size_t triangleCount = sourceIndices.size() / 3;
+
+    printf("Meshlets, sphere of %zu triangles, %d views\n", triangleCount, viewCount);
+    BenchmarkCommon::printRule(64);
+
+    std::vector<uint32_t> indices = {};
+    std::vector<MeshletStructs::Meshlet> meshlets = {};
+    double buildMs = BenchmarkCommon::measureMedianMs([&]() {
+        indices = sourceIndices;
+        meshlets = MeshletBuilder::build(positions, indices);
+    });
+    printf("%-28s %12.3f ms %12.0f triangles/ms\n", "build (incl. copy)", buildMs,
+           buildMs > 0.0 ? static_cast<double>(triangleCount) / buildMs : 0.0);
+
+    MeshletStructs::BuildParams params = {};
+    size_t vertexSum = 0, coneCount = 0;
+    for (const auto& meshlet : meshlets) {
+        vertexSum += meshlet.vertexCount;
+        if (meshlet.cone.w < 1.0f) ++coneCount;
+    }
+    printf("%-28s %12zu\n", "meshlets", meshlets.size());
+    printf("%-28s %11.1f%% of %u\n", "average triangles", 100.0 * triangleCount / meshlets.size() / params.maxTriangleCount,
+           params.maxTriangleCount);
+    printf("%-28s %11.1f%% of %u\n", "average vertices", 100.0 * vertexSum / meshlets.size() / params.maxVertexCount,
+           params.maxVertexCount);
+    printf("%-28s %11.1f%%\n", "with a usable cone", 100.0 * coneCount / meshlets.size());
+
+    // Points around the sphere, from close up to far away.
+    std::mt19937 random(42);
+    std::normal_distribution<float> direction(0.0f, 1.0f);
+    std::uniform_real_distribution<float> distance(0.75f, 8.0f);
+
+    size_t rejectedCount = 0, backfacingCount = 0, wrongCount = 0;
+    for (int view = 0; view < viewCount; ++view) {
+        glm::vec3 camera = glm::normalize(glm::vec3(direction(random), direction(random), direction(random))) * distance(random);
+
+        for (const auto& meshlet : meshlets) {
+            bool isRejected = MeshletBuilder::isBackfacing(meshlet, camera);
+            for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+                const auto& a = positions[indices[i]];
+                auto normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+                bool isBackfacing = glm::dot(normal, a - camera) >= 0.0f;
+
+                if (isBackfacing) ++backfacingCount;
+                if (isRejected) ++rejectedCount;
+                if (isRejected && !isBackfacing) ++wrongCount;
+            }
+        }
+    }
+    BenchmarkCommon::printRule(64);
+
+    printf("backfacing per view: %.1f%%, rejected by cones %.1f%% (%.1f%% of backfacing), wrongly rejected %zu\n",
+           100.0 * backfacingCount / (triangleCount * viewCount), 100.0 * rejectedCount / (triangleCount * viewCount),
+           backfacingCount > 0 ? 100.0 * rejectedCount / backfacingCount : 0.0, wrongCount);
+
+    return wrongCount == 0 ? 0 : 1;
+}
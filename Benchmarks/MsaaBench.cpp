@@ -0,0 +1,98 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Edge-heavy scene: a fan of thin spokes, so that most covered pixels sit on a triangle edge.
+//
+//   MsaaBench [--samples 1|2|4|8] [--spokes N] [--frames N]
+//
+// Run once per sample count and compare the reported frame times and transient attachment
+// memory. On tile-based GPUs the multisampled attachments live in lazily allocated memory,
+// so the reported size is what is reserved, not necessarily what is committed.
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QApplication>
+#include <QDebug>
+
+#include <cstdio>
+#include <exception>
+
+#include "BenchmarkWindow.h"
+
+struct MsaaBenchOptions {
+    VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+    int spokeCount = 720;
+    int warmupFrameCount = 60;
+    int frameCount = 600;
+};
+
+class MsaaBenchWindow : public BenchmarkWindow {
+public:
+    explicit MsaaBenchWindow(const MsaaBenchOptions& options)
+            : BenchmarkWindow(options.warmupFrameCount, options.frameCount), m_options(options) {}
+
+    void declareRenderResourceData() override {
+        // A long sliver from the center to the right, rotated around the view axis per spoke.
+        engine.declareVertices("spoke", true,
+                               {
+                                       { { 0.0f, -0.002f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
+                                       { { 0.0f, +0.002f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+                                       { { 4.0f, +0.020f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+                                       { { 4.0f, -0.020f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+                               });
+        engine.declareIndices("spoke", { 0, 1, 2, 0, 2, 3 });
+
+        auto material = engine.declareMaterial(glm::vec4(1.0f));
+        for (int i = 0; i < m_options.spokeCount; ++i) {
+            float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(m_options.spokeCount);
+            auto modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+            modelMat = glm::rotate(modelMat, angle, glm::vec3(0.0f, 0.0f, 1.0f));
+
+            engine.declareDrawItem("spoke", "spoke", modelMat, material);
+        }
+    }
+
+private:
+    void report() override {
+        printf("MSAA bench: %d spokes, %dx requested, %dx used, %.2f MiB transient attachments\n",
+               m_options.spokeCount, static_cast<int>(m_options.sampleCount), static_cast<int>(engine.sampleCount()),
+               BenchmarkCommon::toMiB(engine.transientAttachmentMemorySize()));
+        BenchmarkCommon::printFrameTimes(frameTimes());
+    }
+
+private:
+    MsaaBenchOptions m_options = {};
+};
+
+int main(int argc, char** argv) {
+    try {
+        QApplication a(argc, argv);
+
+        MsaaBenchOptions options = {};
+        auto args = QApplication::arguments();
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i] == "--samples" && i + 1 < args.size()) options.sampleCount = static_cast<VkSampleCountFlagBits>(args[++i].toInt());
+            else if (args[i] == "--spokes" && i + 1 < args.size()) options.spokeCount = args[++i].toInt();
+            else if (args[i] == "--frames" && i + 1 < args.size()) options.frameCount = args[++i].toInt();
+        }
+
+        VulkanEngineStructs::CreateInfo info = {};
+        info.sampleCount = options.sampleCount;
+
+        MsaaBenchWindow w(options);
+        w.declareRenderResourceData();
+        w.initVulkanEngine(info);
+        w.show();
+        return a.exec();
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+    }
+}
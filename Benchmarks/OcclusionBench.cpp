@@ -0,0 +1,202 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Occlusion-heavy scene: a wall filling the view in front of a dense block of high-poly spheres.
+//
+//   OcclusionBench [--no-occlusion] [--no-meshlets] [--no-wall] [--grid N] [--segments N] [--prepass] [--frames N]
+//
+// Every sphere is inside the frustum, so frustum culling keeps all of them; only occlusion culling
+// can tell that the wall hides them. Besides frame times, the triangles skipped on the GPU are
+// reported next to the primitives that actually reached input assembly. Run with and without
+// --no-occlusion and compare; --no-wall shows the cost of culling when nothing is hidden, and
+// with meshlets how many of the back halves of the spheres their normal cones reject.
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QApplication>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <vector>
+
+#include "BenchmarkWindow.h"
+
+struct OcclusionBenchOptions {
+    bool enableOcclusionCulling = true;
+    bool enableMeshletCulling = true;
+    bool hasWall = true;
+    bool enableDepthPrepass = false;
+    int gridSize = 16;
+    int segmentCount = 64;
+    int warmupFrameCount = 60;
+    int frameCount = 600;
+};
+
+class OcclusionBenchWindow : public BenchmarkWindow {
+public:
+    explicit OcclusionBenchWindow(const OcclusionBenchOptions& options)
+            : BenchmarkWindow(options.warmupFrameCount, options.frameCount), m_options(options) {}
+
+    void declareRenderResourceData() override {
+        declareSphere(m_options.segmentCount);
+
+        engine.declareVertices("wall", true,
+                               {
+                                       { { -1.0f, -1.0f, 0.0f }, { 0.6f, 0.6f, 0.6f }, { 0.0f, 1.0f } },
+                                       { { -1.0f, +1.0f, 0.0f }, { 0.6f, 0.6f, 0.6f }, { 0.0f, 0.0f } },
+                                       { { +1.0f, +1.0f, 0.0f }, { 0.6f, 0.6f, 0.6f }, { 1.0f, 0.0f } },
+                                       { { +1.0f, -1.0f, 0.0f }, { 0.6f, 0.6f, 0.6f }, { 1.0f, 1.0f } },
+                               });
+        engine.declareIndices("wall", { 0, 1, 2, 0, 2, 3 });
+
+        // The camera sits at z = -1 looking at +z with a 90 degree vertical fov. The wall is not
+        // attached to the scene, so it has no bounds and is always drawn in the first phase.
+        if (m_options.hasWall) {
+            float z = 1.0f, scale = 4.0f * (z + 1.0f);
+            auto modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, z));
+            modelMat = glm::scale(modelMat, glm::vec3(scale, scale, 1.0f));
+            engine.declareDrawItem("wall", "wall", modelMat);
+        }
+
+        // A block of spheres right behind it, sized to stay inside the frustum.
+        int n = m_options.gridSize;
+        m_scene.reserve(static_cast<size_t>(n) * n * 2);
+        for (int layer = 0; layer < 2; ++layer) {
+            for (int x = 0; x < n; ++x) {
+                for (int y = 0; y < n; ++y) {
+                    float z = 3.0f + 1.5f * static_cast<float>(layer);
+                    float spacing = 2.0f * (z + 1.0f) / static_cast<float>(n);
+                    glm::vec3 position = { spacing * (x + 0.5f) - 0.5f * spacing * n, spacing * (y + 0.5f) - 0.5f * spacing * n, z };
+
+                    auto node = m_scene.createNode(Scene::InvalidNode, { glm::vec3(0.0f), glm::vec3(0.5f) });
+                    m_scene.setLocalTransform(node, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+
+                    float u = static_cast<float>(x) / n, v = static_cast<float>(y) / n;
+                    auto material = engine.declareMaterial(glm::vec4(u, v, 1.0f - u, 1.0f));
+
+                    auto drawItem = engine.declareDrawItem("sphere", "sphere", glm::mat4(1.0f), material);
+                    engine.setDrawItemNode(drawItem, node);
+                }
+            }
+        }
+        engine.setScene(&m_scene);
+    }
+
+protected:
+    // Read back from the GPU frames in flight later; the scene is static, so they settle.
+    void collectFrame() override {
+        auto telemetry = engine.telemetry();
+        m_occludedDrawCount = telemetry.frame.occludedDrawCount;
+        m_occludedTriangleCount = telemetry.frame.occludedTriangleCount;
+        m_clusterCulledCount = telemetry.frame.clusterCulledCount;
+        m_clusterCulledTriangleCount = telemetry.frame.clusterCulledTriangleCount;
+        m_drawCount = telemetry.frame.drawCount;
+        if (telemetry.isPipelineStatisticsSupported) {
+            m_inputAssemblyPrimitives = telemetry.pipelineStatistics.inputAssemblyPrimitives;
+        }
+    }
+
+private:
+    // A UV sphere of radius 0.5 with segmentCount slices and segmentCount / 2 stacks.
+    void declareSphere(int segmentCount) {
+        int sliceCount = std::max(segmentCount, 3), stackCount = std::max(segmentCount / 2, 2);
+
+        std::vector<Vertex> vertices = {};
+        for (int stack = 0; stack <= stackCount; ++stack) {
+            float phi = glm::pi<float>() * static_cast<float>(stack) / stackCount;
+            for (int slice = 0; slice <= sliceCount; ++slice) {
+                float theta = 2.0f * glm::pi<float>() * static_cast<float>(slice) / sliceCount;
+                glm::vec3 normal = { std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta) };
+                glm::vec2 uv = { static_cast<float>(slice) / sliceCount, static_cast<float>(stack) / stackCount };
+                vertices.push_back({ 0.5f * normal, 0.5f * normal + 0.5f, uv });
+            }
+        }
+
+        std::vector<uint32_t> indices = {};
+        for (int stack = 0; stack < stackCount; ++stack) {
+            for (int slice = 0; slice < sliceCount; ++slice) {
+                uint32_t a = stack * (sliceCount + 1) + slice, b = a + sliceCount + 1;
+                indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+            }
+        }
+        m_sphereTriangleCount = indices.size() / 3;
+
+        engine.declareVertices("sphere", true, vertices);
+        engine.declareIndices("sphere", indices);
+    }
+
+    void report() override {
+        size_t sphereCount = 2 * static_cast<size_t>(m_options.gridSize) * m_options.gridSize;
+        printf("Occlusion bench: %zu spheres of %zu triangles, wall %s, occlusion culling %s, meshlets %s, depth pre-pass %s\n",
+               sphereCount, m_sphereTriangleCount, m_options.hasWall ? "on" : "off",
+               engine.isOcclusionCullingEnabled() ? "on" : "off", engine.isMeshletCullingEnabled() ? "on" : "off",
+               m_options.enableDepthPrepass ? "on" : "off");
+        BenchmarkCommon::printFrameTimes(frameTimes());
+        printf("%-24s %12u\n", "draws recorded", m_drawCount);
+        printf("%-24s %12u\n", "draws occluded", m_occludedDrawCount);
+        printf("%-24s %12llu\n", "triangles occluded", static_cast<unsigned long long>(m_occludedTriangleCount));
+        if (engine.isMeshletCullingEnabled()) {
+            printf("%-24s %12u\n", "meshlets culled", m_clusterCulledCount);
+            printf("%-24s %12llu\n", "triangles in them", static_cast<unsigned long long>(m_clusterCulledTriangleCount));
+        }
+        printf("%-24s %12llu\n", "triangles submitted", static_cast<unsigned long long>(sphereCount * m_sphereTriangleCount));
+        if (m_inputAssemblyPrimitives != 0) {
+            printf("%-24s %12llu\n", "primitives assembled", static_cast<unsigned long long>(m_inputAssemblyPrimitives));
+        }
+    }
+
+private:
+    OcclusionBenchOptions m_options = {};
+
+    Scene m_scene = {};
+    size_t m_sphereTriangleCount = 0;
+
+    uint32_t m_drawCount = 0;
+    uint32_t m_occludedDrawCount = 0;
+    uint64_t m_occludedTriangleCount = 0;
+    uint32_t m_clusterCulledCount = 0;
+    uint64_t m_clusterCulledTriangleCount = 0;
+    uint64_t m_inputAssemblyPrimitives = 0;
+};
+
+int main(int argc, char** argv) {
+    try {
+        QApplication a(argc, argv);
+
+        OcclusionBenchOptions options = {};
+        auto args = QApplication::arguments();
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i] == "--no-occlusion") options.enableOcclusionCulling = false;
+            else if (args[i] == "--no-meshlets") options.enableMeshletCulling = false;
+            else if (args[i] == "--no-wall") options.hasWall = false;
+            else if (args[i] == "--prepass") options.enableDepthPrepass = true;
+            else if (args[i] == "--grid" && i + 1 < args.size()) options.gridSize = args[++i].toInt();
+            else if (args[i] == "--segments" && i + 1 < args.size()) options.segmentCount = args[++i].toInt();
+            else if (args[i] == "--frames" && i + 1 < args.size()) options.frameCount = args[++i].toInt();
+        }
+
+        VulkanEngineStructs::CreateInfo info = {};
+        info.enableOcclusionCulling = options.enableOcclusionCulling;
+        info.enableMeshletCulling = options.enableMeshletCulling;
+        info.enableDepthPrepass = options.enableDepthPrepass;
+
+        OcclusionBenchWindow w(options);
+        w.declareRenderResourceData();
+        w.initVulkanEngine(info);
+        w.show();
+        return a.exec();
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+    }
+}
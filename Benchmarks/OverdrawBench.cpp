@@ -0,0 +1,106 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Overdraw-heavy scene: a stack of full-screen quads, each covering every pixel.
+//
+//   OverdrawBench [--prepass] [--front-to-back] [--layers N] [--frames N]
+//
+// Back-to-front submission is the worst case for depth testing alone, since every layer
+// passes the test when it is drawn; with --prepass the color pass shades each pixel once
+// regardless of order. Run with and without --prepass and compare the reported frame times.
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QApplication>
+#include <QDebug>
+
+#include <cstdio>
+#include <exception>
+
+#include "BenchmarkWindow.h"
+
+struct OverdrawBenchOptions {
+    bool enableDepthPrepass = false;
+    bool frontToBack = false;
+    int layerCount = 64;
+    int warmupFrameCount = 60;
+    int frameCount = 600;
+};
+
+class OverdrawBenchWindow : public BenchmarkWindow {
+public:
+    explicit OverdrawBenchWindow(const OverdrawBenchOptions& options)
+            : BenchmarkWindow(options.warmupFrameCount, options.frameCount), m_options(options) {}
+
+    void declareRenderResourceData() override {
+        engine.declareVertices("quad", true,
+                               {
+                                       { { -1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
+                                       { { -1.0f, +1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+                                       { { +1.0f, +1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+                                       { { +1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+                               });
+        engine.declareIndices("quad", { 0, 1, 2, 0, 2, 3 });
+
+        // The camera sits at z = -1 looking at +z with a 90 degree vertical fov;
+        // scale every layer well beyond the view so that it covers the whole screen.
+        for (int i = 0; i < m_options.layerCount; ++i) {
+            int layer = m_options.frontToBack ? i : m_options.layerCount - 1 - i;
+            float z = 1.0f + 0.05f * static_cast<float>(layer);
+            float scale = 4.0f * (z + 1.0f);
+
+            auto modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, z));
+            modelMat = glm::scale(modelMat, glm::vec3(scale, scale, 1.0f));
+
+            float t = static_cast<float>(layer) / static_cast<float>(m_options.layerCount);
+            auto material = engine.declareMaterial(glm::vec4(1.0f - t, t, 0.5f, 1.0f));
+
+            engine.declareDrawItem("quad", "quad", modelMat, material);
+        }
+    }
+
+private:
+    void report() override {
+        printf("Overdraw bench: %d layers, %s, depth pre-pass %s\n", m_options.layerCount,
+               m_options.frontToBack ? "front-to-back" : "back-to-front",
+               m_options.enableDepthPrepass ? "on" : "off");
+        BenchmarkCommon::printFrameTimes(frameTimes());
+    }
+
+private:
+    OverdrawBenchOptions m_options = {};
+};
+
+int main(int argc, char** argv) {
+    try {
+        QApplication a(argc, argv);
+
+        OverdrawBenchOptions options = {};
+        auto args = QApplication::arguments();
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i] == "--prepass") options.enableDepthPrepass = true;
+            else if (args[i] == "--front-to-back") options.frontToBack = true;
+            else if (args[i] == "--layers" && i + 1 < args.size()) options.layerCount = args[++i].toInt();
+            else if (args[i] == "--frames" && i + 1 < args.size()) options.frameCount = args[++i].toInt();
+        }
+
+        VulkanEngineStructs::CreateInfo info = {};
+        info.enableDepthPrepass = options.enableDepthPrepass;
+
+        OverdrawBenchWindow w(options);
+        w.declareRenderResourceData();
+        w.initVulkanEngine(info);
+        w.show();
+        return a.exec();
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+    }
+}
@@ -0,0 +1,156 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Particle-heavy scene: emitters on a ring in front of the camera, spawning at a rate that keeps
+// about the requested number of particles alive.
+//
+//   ParticleBench [--particles N] [--emitters N] [--no-async-compute] [--frames N]
+//
+// The CPU only writes the emitters, so its frame time should not grow with the particle count;
+// the GPU frame time covers the billboards, and the simulation too when async compute shares the
+// graphics queue. Run with increasing --particles and compare.
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <QApplication>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <vector>
+
+#include "BenchmarkWindow.h"
+
+struct ParticleBenchOptions {
+    int particleCount = 1 << 20;
+    int emitterCount = 16;
+    bool enableAsyncCompute = true;
+    int warmupFrameCount = 240; // Long enough for the oldest particles to die and the count to settle.
+    int frameCount = 600;
+};
+
+class ParticleBenchWindow : public BenchmarkWindow {
+public:
+    explicit ParticleBenchWindow(const ParticleBenchOptions& options)
+            : BenchmarkWindow(options.warmupFrameCount, options.frameCount), m_options(options) {}
+
+    void declareRenderResourceData() override {
+        // A backdrop, so that the particles are depth tested against something.
+        engine.declareVertices("quad", true,
+                               {
+                                       { { -1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 1.0f } },
+                                       { { -1.0f, +1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f } },
+                                       { { +1.0f, +1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.0f } },
+                                       { { +1.0f, -1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } },
+                               });
+        engine.declareIndices("quad", { 0, 1, 2, 0, 2, 3 });
+
+        auto modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 4.0f));
+        modelMat = glm::scale(modelMat, glm::vec3(20.0f, 20.0f, 1.0f));
+        engine.declareDrawItem("quad", "quad", modelMat, engine.declareMaterial(glm::vec4(0.1f, 0.1f, 0.15f, 1.0f)));
+
+        // The camera sits at z = -1 looking at +z; the ring is around the center of the view.
+        int emitterCount = std::max(m_options.emitterCount, 1);
+        for (int i = 0; i < emitterCount; ++i) {
+            float angle = 2.0f * glm::pi<float>() * static_cast<float>(i) / emitterCount;
+            float t = static_cast<float>(i) / emitterCount;
+
+            ParticleStructs::Emitter emitter = {};
+            emitter.position = glm::vec3(std::cos(angle), std::sin(angle), 2.0f);
+            emitter.positionSpread = 0.05f;
+            emitter.velocity = glm::vec3(0.0f, 0.5f, 0.0f);
+            emitter.velocitySpread = 0.5f;
+            emitter.acceleration = glm::vec3(0.0f, -0.5f, 0.0f);
+            emitter.drag = 0.1f;
+            emitter.startColor = glm::vec4(1.0f - t, t, 1.0f, 0.8f);
+            emitter.endColor = glm::vec4(1.0f, 0.5f, 0.0f, 0.0f);
+            emitter.minLifetime = 1.5f;
+            emitter.maxLifetime = 2.5f;
+            emitter.size = 0.005f;
+
+            // Alive on average: rate times mean lifetime.
+            emitter.rate = static_cast<float>(m_options.particleCount) / emitterCount /
+                           (0.5f * (emitter.minLifetime + emitter.maxLifetime));
+            engine.declareParticleEmitter(emitter);
+        }
+    }
+
+protected:
+    void collectFrame() override {
+        auto gpuFrameMs = engine.profiler().frameSummary().gpuFrameMs;
+        if (gpuFrameMs > 0.0) m_gpuFrameTimes.push_back(gpuFrameMs);
+
+        // Read back from the GPU frames in flight later.
+        m_particleCounts.push_back(engine.telemetry().frame.particleCount);
+    }
+
+private:
+    void report() override {
+        printf("Particle bench: %d particles targeted from %d emitters, async compute %s (%s queue)\n",
+               m_options.particleCount, m_options.emitterCount, m_options.enableAsyncCompute ? "on" : "off",
+               engine.isAsyncComputeQueueDedicated() ? "dedicated" : "graphics");
+        if (!engine.isParticleSystemEnabled()) {
+            printf("particles are disabled\n");
+            return;
+        }
+        BenchmarkCommon::printFrameTimes(frameTimes());
+
+        double particleSum = 0.0;
+        for (auto count : m_particleCounts) particleSum += count;
+        double meanParticleCount = particleSum / m_particleCounts.size();
+        printf("%-24s %12.0f\n", "particles per frame", meanParticleCount);
+        printf("%-24s %12u\n", "particles max", *std::max_element(m_particleCounts.begin(), m_particleCounts.end()));
+
+        if (!m_gpuFrameTimes.empty()) {
+            std::sort(m_gpuFrameTimes.begin(), m_gpuFrameTimes.end());
+            double gpuFrameMs = m_gpuFrameTimes[m_gpuFrameTimes.size() / 2];
+            printf("%-24s %12.3f ms\n", "gpu frame median", gpuFrameMs);
+            printf("%-24s %12.3f ns\n", "gpu per particle", meanParticleCount > 0.0 ? 1e6 * gpuFrameMs / meanParticleCount : 0.0);
+        }
+    }
+
+private:
+    ParticleBenchOptions m_options = {};
+
+    std::vector<double> m_gpuFrameTimes = {};
+    std::vector<uint32_t> m_particleCounts = {};
+};
+
+int main(int argc, char** argv) {
+    try {
+        QApplication a(argc, argv);
+
+        ParticleBenchOptions options = {};
+        auto args = QApplication::arguments();
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i] == "--no-async-compute") options.enableAsyncCompute = false;
+            else if (args[i] == "--particles" && i + 1 < args.size()) options.particleCount = args[++i].toInt();
+            else if (args[i] == "--emitters" && i + 1 < args.size()) options.emitterCount = args[++i].toInt();
+            else if (args[i] == "--frames" && i + 1 < args.size()) options.frameCount = args[++i].toInt();
+        }
+
+        // Room for the fluctuation around the target, so emission is never cut short.
+        VulkanEngineStructs::CreateInfo info = {};
+        info.maxParticleCount = static_cast<uint32_t>(std::max(options.particleCount, 1)) * 2;
+        info.enableAsyncCompute = options.enableAsyncCompute;
+
+        ParticleBenchWindow w(options);
+        w.declareRenderResourceData();
+        w.initVulkanEngine(info);
+        w.show();
+        return a.exec();
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+    }
+}
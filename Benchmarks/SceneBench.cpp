@@ -0,0 +1,98 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Update cost of the scene transform hierarchy at 1M nodes:
+//   - a full update, after every local transform changed;
+//   - incremental updates with a fraction of the nodes moved, which also recompute their subtrees;
+//   - an update with nothing changed, which is the linear scan alone;
+//   - copying the world matrices out, as is done into the per-frame instance buffer.
+//
+//   SceneBench [--nodes N] [--fanout N]
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BenchmarkCommon.h"
+#include "Scene.h"
+
+int main(int argc, char** argv) {
+    size_t nodeCount = 1000000;
+    size_t fanout = 8;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--nodes" && i + 1 < argc) nodeCount = std::stoul(argv[++i]);
+        else if (arg == "--fanout" && i + 1 < argc) fanout = std::stoul(argv[++i]);
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    auto randomRotation = [&]() {
+        return glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+    };
+
+    // Parents are picked at random among the earlier nodes, so the arrays start out of depth order
+    // and the first update also pays for the sort, like a scene loaded from a file would.
+    Scene scene = {};
+    scene.reserve(nodeCount);
+    std::vector<Scene::NodeId> nodes = {};
+    nodes.reserve(nodeCount);
+    for (size_t i = 0; i < nodeCount; ++i) {
+        Scene::NodeId parent = i < fanout ? Scene::InvalidNode : nodes[std::uniform_int_distribution<size_t>(0, i / fanout)(random)];
+        nodes.push_back(scene.createNode(parent, { glm::vec3(0.0f), glm::vec3(0.5f) }));
+        scene.setLocalTransform(nodes.back(), { unit(random), unit(random), unit(random) }, randomRotation());
+    }
+
+    printf("Scene update, %zu nodes\n", nodeCount);
+    BenchmarkCommon::printRule(64);
+    printf("%-28s %12s %16s\n", "case", "median (ms)", "nodes updated");
+    BenchmarkCommon::printRule(64);
+
+    double firstMs = BenchmarkCommon::measureMedianMs([&]() { scene.update(); }, 1);
+    printf("%-28s %12.3f %16zu\n", "first (sort + full)", firstMs, scene.updatedNodeCount());
+
+    double fullMs = BenchmarkCommon::measureMedianMs([&]() {
+        for (auto node : nodes) {
+            scene.setLocalTransform(node, { unit(random), unit(random), unit(random) }, randomRotation());
+        }
+        scene.update();
+    });
+    printf("%-28s %12.3f %16zu\n", "full (incl. set)", fullMs, scene.updatedNodeCount());
+
+    for (double fraction : { 0.1, 0.01, 0.001 }) {
+        auto movedCount = static_cast<size_t>(fraction * nodeCount);
+        std::uniform_int_distribution<size_t> pick(0, nodeCount - 1);
+
+        double ms = BenchmarkCommon::measureMedianMs([&]() {
+            for (size_t i = 0; i < movedCount; ++i) {
+                scene.setLocalTransform(nodes[pick(random)], { unit(random), unit(random), unit(random) }, randomRotation());
+            }
+            scene.update();
+        });
+        char label[32];
+        snprintf(label, sizeof(label), "%.1f%% moved (incl. set)", fraction * 100.0);
+        printf("%-28s %12.3f %16zu\n", label, ms, scene.updatedNodeCount());
+    }
+
+    double idleMs = BenchmarkCommon::measureMedianMs([&]() { scene.update(); });
+    printf("%-28s %12.3f %16zu\n", "nothing moved", idleMs, scene.updatedNodeCount());
+
+    std::vector<glm::mat4> instanceData(nodeCount + 1);
+    double copyMs = BenchmarkCommon::measureMedianMs([&]() {
+        memcpy(instanceData.data() + 1, scene.worldMatrices().data(), sizeof(glm::mat4) * nodeCount);
+    });
+    printf("%-28s %12.3f %13.1f MiB\n", "copy world matrices", copyMs, BenchmarkCommon::toMiB(sizeof(glm::mat4) * nodeCount));
+    BenchmarkCommon::printRule(64);
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Shadowed scene: a field of boxes on the ground, a few of them moving near the camera, seen by a camera
+// flying slowly over it under a fixed directional light.
+//
+//   ShadowBench [--no-cache] [--cascades N] [--resolution N] [--movers N] [--grid N] [--frames N]
+//
+// Reports the GPU time of all shadow cascade passes per frame and how many cascades were rendered.
+// With caching the distant cascades are only rendered again when the camera nears their edge or
+// a mover enters them; run with and without --no-cache and compare.
+
+#include <glm/gtc/constants.hpp>
+
+#include <QApplication>
+#include <QDebug>
+
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <vector>
+
+#include "BenchmarkWindow.h"
+
+struct ShadowBenchOptions {
+    bool enableCache = true;
+    uint32_t cascadeCount = 4;
+    uint32_t resolution = 2048;
+    int moverCount = 4;
+    int gridSize = 32;
+    int warmupFrameCount = 60;
+    int frameCount = 600;
+};
+
+class ShadowBenchWindow : public BenchmarkWindow {
+public:
+    explicit ShadowBenchWindow(const ShadowBenchOptions& options)
+            : BenchmarkWindow(options.warmupFrameCount, options.frameCount), m_options(options) {}
+
+    void declareRenderResourceData() override {
+        DisplayWindow::declareRenderResourceData(); // The cube.
+
+        int n = m_options.gridSize;
+        m_scene.reserve(static_cast<size_t>(n) * n + m_options.moverCount + 1);
+
+        // The ground, a flat cube under everything.
+        auto ground = m_scene.createNode(Scene::InvalidNode, { glm::vec3(0.0f), glm::vec3(0.5f) });
+        m_scene.setLocalTransform(ground, glm::vec3(0.0f, -2.1f, 1.5f * n), glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                                  glm::vec3(4.0f * n, 0.2f, 4.0f * n));
+        auto groundItem = engine.declareDrawItem("cube", "cube", glm::mat4(1.0f), engine.declareMaterial(glm::vec4(0.8f, 0.8f, 0.8f, 1.0f)));
+        engine.setDrawItemNode(groundItem, ground);
+
+        // Boxes of varying height, far enough apart for their shadows to fall on the ground.
+        for (int x = 0; x < n; ++x) {
+            for (int z = 0; z < n; ++z) {
+                float height = 1.0f + static_cast<float>((x * 7 + z * 13) % 5);
+                auto node = m_scene.createNode(Scene::InvalidNode, { glm::vec3(0.0f), glm::vec3(0.5f) });
+                m_scene.setLocalTransform(node, glm::vec3(3.0f * x - 1.5f * n, -2.0f + 0.5f * height, 3.0f * z + 2.0f),
+                                          glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f, height, 1.0f));
+
+                float u = static_cast<float>(x) / n, v = static_cast<float>(z) / n;
+                auto drawItem = engine.declareDrawItem("cube", "cube", glm::mat4(1.0f), engine.declareMaterial(glm::vec4(u, v, 1.0f - u, 1.0f)));
+                engine.setDrawItemNode(drawItem, node);
+            }
+        }
+
+        for (int i = 0; i < m_options.moverCount; ++i) {
+            m_movers.push_back(m_scene.createNode(Scene::InvalidNode, { glm::vec3(0.0f), glm::vec3(0.5f) }));
+            auto drawItem = engine.declareDrawItem("cube", "cube", glm::mat4(1.0f), engine.declareMaterial(glm::vec4(1.0f, 0.5f, 0.0f, 1.0f)));
+            engine.setDrawItemNode(drawItem, m_movers.back());
+        }
+        engine.setScene(&m_scene);
+    }
+
+protected:
+    void prepareFrame(int frameIndex) override {
+        if (frameIndex == 0) {
+            engine.resetCamera();
+            engine.rotateCamera(0.0f, -0.3f); // Looking down on the field.
+        }
+        animate(frameIndex);
+    }
+
+    void beginMeasuring() override {
+        m_shadowPassTimes.start(engine.profiler().gpuFrameCount());
+    }
+
+    void collectFrame() override {
+        m_renderedCascadeCount += engine.telemetry().frame.shadowCascadeRenderCount;
+        m_shadowPassTimes.collect(engine.profiler().snapshot());
+    }
+
+private:
+    // The camera flies forward and the movers circle in front of it, both slowly enough
+    // for the cached cascades to hold for a while.
+    void animate(int frame) {
+        float t = static_cast<float>(frame) / 60.0f;
+        auto eye = glm::vec3(0.0f, 4.0f, -1.0f + 0.5f * t);
+        engine.moveCameraTo(eye);
+
+        for (size_t i = 0; i < m_movers.size(); ++i) {
+            float angle = t + 2.0f * glm::pi<float>() * static_cast<float>(i) / m_movers.size();
+            auto position = glm::vec3(3.0f * std::cos(angle), -1.5f, eye.z + 6.0f + 3.0f * std::sin(angle));
+            m_scene.setLocalTransform(m_movers[i], position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+        }
+    }
+
+    void report() override {
+        printf("Shadow bench: %d boxes, %d movers, %u cascades of %u x %u, caching %s\n",
+               m_options.gridSize * m_options.gridSize, m_options.moverCount,
+               m_options.cascadeCount, m_options.resolution, m_options.resolution, m_options.enableCache ? "on" : "off");
+        if (!engine.isShadowEnabled()) {
+            printf("shadows are disabled\n");
+            return;
+        }
+        BenchmarkCommon::printFrameTimes(frameTimes());
+
+        if (m_shadowPassTimes.frameCount() > 0) {
+            printf("%-24s %12.3f ms\n", "gpu shadow per frame", m_shadowPassTimes.averageMs(0));
+        }
+        printf("%-24s %12.2f\n", "cascades per frame", static_cast<double>(m_renderedCascadeCount) / frameTimes().size());
+    }
+
+private:
+    ShadowBenchOptions m_options = {};
+
+    Scene m_scene = {};
+    std::vector<Scene::NodeId> m_movers = {};
+
+    uint64_t m_renderedCascadeCount = 0;
+
+    BenchmarkCommon::GpuScopeAccumulator m_shadowPassTimes = BenchmarkCommon::GpuScopeAccumulator({ "shadow_cascade" });
+};
+
+int main(int argc, char** argv) {
+    try {
+        QApplication a(argc, argv);
+
+        ShadowBenchOptions options = {};
+        auto args = QApplication::arguments();
+        for (int i = 1; i < args.size(); ++i) {
+            if (args[i] == "--no-cache") options.enableCache = false;
+            else if (args[i] == "--cascades" && i + 1 < args.size()) options.cascadeCount = args[++i].toUInt();
+            else if (args[i] == "--resolution" && i + 1 < args.size()) options.resolution = args[++i].toUInt();
+            else if (args[i] == "--movers" && i + 1 < args.size()) options.moverCount = args[++i].toInt();
+            else if (args[i] == "--grid" && i + 1 < args.size()) options.gridSize = args[++i].toInt();
+            else if (args[i] == "--frames" && i + 1 < args.size()) options.frameCount = args[++i].toInt();
+        }
+
+        VulkanEngineStructs::CreateInfo info = {};
+        info.shadowCascadeCount = options.cascadeCount;
+        info.shadowMapResolution = options.resolution;
+        if (!options.enableCache) info.firstCachedShadowCascade = options.cascadeCount;
+
+        ShadowBenchWindow w(options);
+        w.declareRenderResourceData();
+        w.initVulkanEngine(info);
+        w.show();
+        return a.exec();
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+    }
+}
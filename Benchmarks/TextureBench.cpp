@@ -0,0 +1,92 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// Compare block compressed textures with uncompressed RGBA8:
+//   - memory of the full mip chain;
+//   - bytes fetched by a full-screen pass sampling one texel per pixel, which is what
+//     bounds texture bandwidth once the texture no longer fits in cache;
+//   - cost of the offline (CPU) mip generation path for uncompressed sources.
+
+#include <cstdio>
+#include <vector>
+
+#include "BenchmarkCommon.h"
+#include "TextureFormats.h"
+
+struct FormatCase {
+    const char* name;
+    VkFormat format;
+};
+
+int main() {
+    const std::vector<FormatCase> formats = {
+            { "RGBA8", VK_FORMAT_R8G8B8A8_SRGB },
+            { "BC1", VK_FORMAT_BC1_RGBA_SRGB_BLOCK },
+            { "BC7", VK_FORMAT_BC7_SRGB_BLOCK },
+            { "ASTC 4x4", VK_FORMAT_ASTC_4x4_SRGB_BLOCK },
+            { "ASTC 8x8", VK_FORMAT_ASTC_8x8_SRGB_BLOCK }
+    };
+    const std::vector<uint32_t> sizes = { 512, 1024, 2048, 4096 };
+
+    // 1080p, every pixel sampling the mip level whose texel density matches the screen.
+    const uint64_t screenPixels = 1920ull * 1080ull;
+
+    printf("Texture memory and bandwidth\n");
+    BenchmarkCommon::printRule();
+    printf("%-10s %6s %6s %14s %10s %14s %10s\n",
+           "format", "size", "mips", "chain (MiB)", "vs RGBA8", "frame (MiB)", "bits/texel");
+    BenchmarkCommon::printRule();
+
+    for (auto size : sizes) {
+        auto levelCount = TextureFormats::fullMipLevelCount(size, size);
+        auto referenceSize = TextureFormats::mipChainSize(VK_FORMAT_R8G8B8A8_SRGB, size, size, levelCount);
+
+        for (const auto& item : formats) {
+            auto info = TextureFormats::queryFormatInfo(item.format);
+            auto chainSize = TextureFormats::mipChainSize(item.format, size, size, levelCount);
+
+            double bitsPerTexel = 8.0 * info.bytesPerBlock / (info.blockWidth * info.blockHeight);
+            uint64_t frameBytes = uint64_t(screenPixels * bitsPerTexel / 8.0);
+
+            printf("%-10s %6u %6u %14.2f %9.2fx %14.2f %10.2f\n",
+                   item.name, size, levelCount, BenchmarkCommon::toMiB(chainSize),
+                   double(referenceSize) / double(chainSize), BenchmarkCommon::toMiB(frameBytes), bitsPerTexel);
+        }
+        BenchmarkCommon::printRule();
+    }
+
+    printf("\nOffline mip generation (RGBA8, 2x2 box filter)\n");
+    BenchmarkCommon::printRule();
+    printf("%6s %14s %14s\n", "size", "median (ms)", "MiB/s");
+    BenchmarkCommon::printRule();
+
+    for (auto size : sizes) {
+        TextureFormats::ImageData source = {};
+        source.format = VK_FORMAT_R8G8B8A8_SRGB;
+        source.width = size;
+        source.height = size;
+        source.levelOffsets = { 0 };
+        source.levelSizes = { uint64_t(size) * size * 4 };
+        source.bytes.resize(source.levelSizes[0]);
+        for (size_t i = 0; i < source.bytes.size(); ++i) {
+            source.bytes[i] = static_cast<unsigned char>(i * 2654435761u >> 24);
+        }
+
+        auto ms = BenchmarkCommon::measureMedianMs([&]() {
+            auto image = source;
+            TextureFormats::generateMipChainRGBA8(image);
+        });
+
+        printf("%6u %14.3f %14.1f\n", size, ms, BenchmarkCommon::toMiB(source.levelSizes[0]) / (ms / 1000.0));
+    }
+    BenchmarkCommon::printRule();
+
+    return 0;
+}
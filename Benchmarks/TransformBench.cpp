@@ -0,0 +1,139 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+// CPU cost of transform math, batched SIMD against the scalar glm path it replaces:
+//   - world matrices composed from translation, rotation and scale of N objects;
+//   - parent * local matrix products of N objects;
+//   - a camera rotated and turned into a view matrix every frame, quaternion against
+//     the former basis vectors that were renormalized per frame.
+// The largest element difference to the glm reference is printed next to each timing.
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "BenchmarkCommon.h"
+#include "Camera.h"
+#include "TransformMath.h"
+
+static float maxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                difference = std::max(difference, std::abs(a[i][c][r] - b[i][c][r]));
+            }
+        }
+    }
+    return difference;
+}
+
+// The camera before it kept a quaternion: two 4x4 rotations per rotate and a renormalized basis per frame.
+struct LegacyCamera {
+    glm::vec3 eye = { 0.0f, 0.0f, -1.0f };
+    glm::vec3 right = { 1.0f, 0.0f, 0.0f }, up = { 0.0f, 1.0f, 0.0f }, lookAt = { 0.0f, 0.0f, 1.0f };
+
+    void rotate(float pitch, float yaw) {
+        auto doPitchYaw = glm::rotate(glm::rotate(glm::mat4(1.0f), pitch, right), yaw, up);
+        right = glm::vec3(glm::vec4(right, 0.0f) * doPitchYaw);
+        up = glm::vec3(glm::vec4(up, 0.0f) * doPitchYaw);
+        lookAt = glm::vec3(glm::vec4(lookAt, 0.0f) * doPitchYaw);
+    }
+
+    void updateViewMatrix(glm::mat4& viewMat) {
+        right.y = 0.0f;
+        right = glm::normalize(right);
+        lookAt = glm::normalize(glm::cross(right, up));
+        up = glm::cross(lookAt, right);
+        viewMat = glm::lookAtLH(eye, eye + lookAt, up);
+    }
+};
+
+int main() {
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    printf("Transform math (%s)\n", TransformMath::instructionSet());
+    BenchmarkCommon::printRule();
+    printf("%-10s %10s %14s %14s %10s %12s\n", "case", "objects", "scalar (ms)", "batch (ms)", "speedup", "max diff");
+    BenchmarkCommon::printRule();
+
+    for (size_t count : { 1000, 10000, 100000 }) {
+        TransformMath::TransformSoA transforms = {};
+        transforms.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            auto rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+            transforms.set(i, { 100.0f * unit(random), 100.0f * unit(random), 100.0f * unit(random) }, rotation,
+                           { 1.5f + unit(random), 1.5f + unit(random), 1.5f + unit(random) });
+        }
+
+        std::vector<glm::mat4> scalarMats(count), batchMats(count);
+        int repeats = static_cast<int>(1000000 / count);
+
+        double scalarMs = BenchmarkCommon::measureMedianMs([&]() {
+            for (int r = 0; r < repeats; ++r) TransformMath::composeMatricesScalar(transforms, scalarMats.data());
+        }) / repeats;
+        double batchMs = BenchmarkCommon::measureMedianMs([&]() {
+            for (int r = 0; r < repeats; ++r) TransformMath::composeMatrices(transforms, batchMats.data());
+        }) / repeats;
+        printf("%-10s %10zu %14.4f %14.4f %9.2fx %12.2e\n", "compose", count, scalarMs, batchMs,
+               scalarMs / batchMs, maxDifference(scalarMats, batchMats));
+
+        // Every object parented to the one before it, as a flattened hierarchy level would be.
+        std::vector<glm::mat4> parentMats(batchMats.begin(), batchMats.end());
+        std::rotate(parentMats.begin(), parentMats.begin() + 1, parentMats.end());
+
+        scalarMs = BenchmarkCommon::measureMedianMs([&]() {
+            for (int r = 0; r < repeats; ++r) TransformMath::multiplyMatricesScalar(parentMats.data(), batchMats.data(), scalarMats.data(), count);
+        }) / repeats;
+        std::vector<glm::mat4> productMats(count);
+        batchMs = BenchmarkCommon::measureMedianMs([&]() {
+            for (int r = 0; r < repeats; ++r) TransformMath::multiplyMatrices(parentMats.data(), batchMats.data(), productMats.data(), count);
+        }) / repeats;
+        printf("%-10s %10zu %14.4f %14.4f %9.2fx %12.2e\n", "multiply", count, scalarMs, batchMs,
+               scalarMs / batchMs, maxDifference(scalarMats, productMats));
+    }
+    BenchmarkCommon::printRule();
+
+    // A small rotation and a view matrix per frame, as mouse look does.
+    const int frameCount = 100000;
+
+    LegacyCamera legacyCamera = {};
+    glm::mat4 legacyViewMat = glm::mat4(1.0f);
+    double legacyMs = BenchmarkCommon::measureMedianMs([&]() {
+        for (int i = 0; i < frameCount; ++i) {
+            legacyCamera.rotate(0.001f, 0.002f);
+            legacyCamera.updateViewMatrix(legacyViewMat);
+        }
+    });
+
+    Camera camera(1920, 1080, 90.0f);
+    camera.setEye({ 0.0f, 0.0f, -1.0f });
+    camera.setBasis({ 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f });
+    glm::mat4 viewMat = glm::mat4(1.0f);
+    double quaternionMs = BenchmarkCommon::measureMedianMs([&]() {
+        for (int i = 0; i < frameCount; ++i) {
+            camera.rotate(0.001f, 0.002f);
+            camera.updateViewMatrix(viewMat);
+        }
+    });
+
+    printf("\nCamera rotate + view matrix, %d frames\n", frameCount);
+    BenchmarkCommon::printRule(48);
+    printf("%-12s %10.3f ms\n", "glm basis", legacyMs);
+    printf("%-12s %10.3f ms\n", "quaternion", quaternionMs);
+    BenchmarkCommon::printRule(48);
+
+    return 0;
+}
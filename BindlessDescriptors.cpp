@@ -0,0 +1,292 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "BindlessDescriptors.h"
+
+BindlessDescriptors::~BindlessDescriptors() {
+    destroy(); // In case someone forgets destroy created descriptor objects.
+}
+
+void BindlessDescriptors::init(const BindlessDescriptorsStructs::CreateInfo& info) {
+    m_info = info;
+
+    // Every slot starts out pointing at the fallback buffer (or nothing with partially bound sets).
+    VkDescriptorBufferInfo emptyInfo = {};
+    emptyInfo.buffer = m_info.fallbackBuffer;
+    emptyInfo.offset = 0;
+    emptyInfo.range = VK_WHOLE_SIZE;
+
+    m_bufferInfos.assign(m_info.bufferCapacity, emptyInfo);
+
+    // Hand out low slots first.
+    m_freeBufferSlots.resize(m_info.bufferCapacity);
+    for (uint32_t i = 0; i < m_info.bufferCapacity; ++i) {
+        m_freeBufferSlots[i] = m_info.bufferCapacity - 1 - i;
+    }
+
+    m_imageInfos.assign(m_info.imageCapacity, m_fallbackImageInfo);
+
+    m_freeImageSlots.resize(m_info.imageCapacity);
+    for (uint32_t i = 0; i < m_info.imageCapacity; ++i) {
+        m_freeImageSlots[i] = m_info.imageCapacity - 1 - i;
+    }
+
+    createLayout();
+
+    createPool();
+
+    allocateSets();
+
+    // Fallback sets must be fully written before their first use; images follow in setFallbackImage().
+    if (!m_info.updateAfterBind) {
+        for (auto& set : m_sets) {
+            writeBufferSlots(set, 0, m_info.bufferCapacity);
+        }
+        m_setVersions.assign(m_sets.size(), m_version);
+    }
+}
+
+BindlessDescriptors::Slot BindlessDescriptors::registerBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    if (m_freeBufferSlots.empty()) {
+        throw std::runtime_error("Bindless buffer table is full.");
+    }
+
+    Slot slot = m_freeBufferSlots.back();
+    m_freeBufferSlots.pop_back();
+
+    m_bufferInfos[slot].buffer = buffer;
+    m_bufferInfos[slot].offset = offset;
+    m_bufferInfos[slot].range = range;
+
+    m_pendingBufferSlots.push_back(slot);
+    ++m_version;
+
+    return slot;
+}
+
+void BindlessDescriptors::unregisterBuffer(Slot slot) {
+    m_bufferInfos[slot].buffer = m_info.fallbackBuffer;
+    m_bufferInfos[slot].offset = 0;
+    m_bufferInfos[slot].range = VK_WHOLE_SIZE;
+
+    m_freeBufferSlots.push_back(slot);
+
+    // Partially bound sets simply leave the stale descriptor unused.
+    if (!m_info.updateAfterBind) {
+        ++m_version;
+    }
+}
+
+BindlessDescriptors::Slot BindlessDescriptors::registerImage(VkImageView view, VkSampler sampler) {
+    if (m_freeImageSlots.empty()) {
+        throw std::runtime_error("Bindless image table is full.");
+    }
+
+    Slot slot = m_freeImageSlots.back();
+    m_freeImageSlots.pop_back();
+
+    m_imageInfos[slot].imageView = view;
+    m_imageInfos[slot].sampler = sampler;
+    m_imageInfos[slot].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    m_pendingImageSlots.push_back(slot);
+    ++m_version;
+
+    return slot;
+}
+
+void BindlessDescriptors::unregisterImage(Slot slot) {
+    m_imageInfos[slot] = m_fallbackImageInfo;
+
+    m_freeImageSlots.push_back(slot);
+
+    if (!m_info.updateAfterBind) {
+        ++m_version;
+    }
+}
+
+void BindlessDescriptors::setFallbackImage(VkImageView view, VkSampler sampler) {
+    m_fallbackImageInfo.imageView = view;
+    m_fallbackImageInfo.sampler = sampler;
+    m_fallbackImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    // Only free slots refer to the fallback image.
+    for (auto slot : m_freeImageSlots) {
+        m_imageInfos[slot] = m_fallbackImageInfo;
+    }
+
+    if (!m_info.updateAfterBind) {
+        ++m_version;
+    }
+}
+
+VkDescriptorSet BindlessDescriptors::prepareFrame(size_t frameIndex) {
+    if (m_info.updateAfterBind) {
+        // Newly registered slots are not used by any pending command buffer,
+        // so they can be written even while the set is bound.
+        for (auto slot : m_pendingBufferSlots) {
+            // Skip slots released again before they were ever written.
+            if (m_bufferInfos[slot].buffer != VK_NULL_HANDLE) {
+                writeBufferSlots(m_sets[0], slot, 1);
+            }
+        }
+        m_pendingBufferSlots.clear();
+
+        for (auto slot : m_pendingImageSlots) {
+            if (m_imageInfos[slot].imageView != VK_NULL_HANDLE) {
+                writeImageSlots(m_sets[0], slot, 1);
+            }
+        }
+        m_pendingImageSlots.clear();
+
+        return m_sets[0];
+    }
+
+    // The frame's fence has been waited, so its own set is idle and can be rewritten.
+    m_pendingBufferSlots.clear();
+    m_pendingImageSlots.clear();
+    if (m_setVersions[frameIndex] != m_version) {
+        writeBufferSlots(m_sets[frameIndex], 0, m_info.bufferCapacity);
+        writeImageSlots(m_sets[frameIndex], 0, m_info.imageCapacity);
+        m_setVersions[frameIndex] = m_version;
+    }
+
+    return m_sets[frameIndex];
+}
+
+void BindlessDescriptors::destroy() {
+    if (m_pool != VK_NULL_HANDLE) {
+        // Destroying the pool frees all sets allocated from it.
+        vkDestroyDescriptorPool(*m_device, m_pool, nullptr);
+        m_pool = VK_NULL_HANDLE;
+    }
+    m_sets.clear();
+
+    if (m_layout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(*m_device, m_layout, nullptr);
+        m_layout = VK_NULL_HANDLE;
+    }
+}
+
+void BindlessDescriptors::createLayout() {
+    VkDescriptorSetLayoutBinding bindings[2] = {};
+    bindings[0].binding = BufferBinding;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[0].descriptorCount = m_info.bufferCapacity;
+    bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+    bindings[0].pImmutableSamplers = nullptr;
+
+    bindings[1].binding = ImageBinding;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].descriptorCount = m_info.imageCapacity;
+    bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+    bindings[1].pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+
+    VkDescriptorBindingFlagsEXT flags =
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+
+    VkDescriptorBindingFlagsEXT bindingFlags[2] = { flags, flags };
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = 2;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    if (m_info.updateAfterBind) {
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layoutInfo.pNext = &bindingFlagsInfo;
+    }
+
+    if (vkCreateDescriptorSetLayout(*m_device, &layoutInfo, nullptr, &m_layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create bindless descriptor set layout.");
+    }
+}
+
+void BindlessDescriptors::createPool() {
+    uint32_t setCount = m_info.updateAfterBind ? 1 : m_info.framesInFlight;
+
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = m_info.bufferCapacity * setCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = m_info.imageCapacity * setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = m_info.updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
+    poolInfo.poolSizeCount = m_info.imageCapacity > 0 ? 2 : 1;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = setCount;
+
+    if (vkCreateDescriptorPool(*m_device, &poolInfo, nullptr, &m_pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create bindless descriptor pool.");
+    }
+}
+
+void BindlessDescriptors::allocateSets() {
+    uint32_t setCount = m_info.updateAfterBind ? 1 : m_info.framesInFlight;
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, m_layout);
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_pool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    m_sets.resize(setCount);
+    if (vkAllocateDescriptorSets(*m_device, &allocInfo, m_sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate bindless descriptor sets.");
+    }
+}
+
+void BindlessDescriptors::writeBufferSlots(VkDescriptorSet set, uint32_t first, uint32_t count) {
+    if (count == 0) return;
+
+    VkWriteDescriptorSet descWrite = {};
+    descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descWrite.dstSet = set;
+    descWrite.dstBinding = BufferBinding;
+    descWrite.dstArrayElement = first;
+    descWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descWrite.descriptorCount = count;
+    descWrite.pBufferInfo = m_bufferInfos.data() + first;
+    descWrite.pImageInfo = nullptr;
+    descWrite.pTexelBufferView = nullptr;
+
+    vkUpdateDescriptorSets(*m_device, 1, &descWrite, 0, nullptr);
+}
+
+void BindlessDescriptors::writeImageSlots(VkDescriptorSet set, uint32_t first, uint32_t count) {
+    if (count == 0) return;
+
+    VkWriteDescriptorSet descWrite = {};
+    descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descWrite.dstSet = set;
+    descWrite.dstBinding = ImageBinding;
+    descWrite.dstArrayElement = first;
+    descWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descWrite.descriptorCount = count;
+    descWrite.pBufferInfo = nullptr;
+    descWrite.pImageInfo = m_imageInfos.data() + first;
+    descWrite.pTexelBufferView = nullptr;
+
+    vkUpdateDescriptorSets(*m_device, 1, &descWrite, 0, nullptr);
+}
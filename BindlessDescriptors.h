@@ -0,0 +1,126 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef BINDLESS_DESCRIPTORS_H
+#define BINDLESS_DESCRIPTORS_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace BindlessDescriptorsStructs {
+    struct CreateInfo {
+        // Use VK_EXT_descriptor_indexing: one update-after-bind set shared by all frames.
+        // Otherwise fall back to one ordinary set per frame in flight, rewritten when the table changes.
+        bool updateAfterBind = false;
+
+        uint32_t bufferCapacity = 0;
+
+        uint32_t imageCapacity = 0;
+
+        uint32_t framesInFlight = 1;
+
+        // Written into every unused slot in fallback mode, since sets can not be partially bound there.
+        // Unused image slots are filled by setFallbackImage() instead, since images are created later.
+        VkBuffer fallbackBuffer = VK_NULL_HANDLE;
+    };
+}
+
+// A single large table of descriptors indexed from shaders: storage buffers at (set = 1, binding = 0)
+// and combined image samplers at (set = 1, binding = 1). The array sizes are passed to shaders
+// as specialization constants 0 and 1 respectively.
+class BindlessDescriptors {
+public:
+    using Slot = uint32_t;
+    constexpr static Slot InvalidSlot = UINT32_MAX;
+
+    constexpr static uint32_t SetIndex = 1;
+    constexpr static uint32_t BufferBinding = 0;
+    constexpr static uint32_t ImageBinding = 1;
+
+public:
+    BindlessDescriptors() = default;
+    ~BindlessDescriptors();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const BindlessDescriptorsStructs::CreateInfo& info);
+
+    inline bool isUpdateAfterBind() const { return m_info.updateAfterBind; }
+
+    inline uint32_t bufferCapacity() const { return m_info.bufferCapacity; }
+
+    inline uint32_t imageCapacity() const { return m_info.imageCapacity; }
+
+    inline VkDescriptorSetLayout layout() const { return m_layout; }
+
+    Slot registerBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    // Caller must guarantee that no pending command buffer still reads the slot.
+    void unregisterBuffer(Slot slot);
+
+    // The image must stay in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while registered.
+    Slot registerImage(VkImageView view, VkSampler sampler);
+
+    void unregisterImage(Slot slot);
+
+    // Required in fallback mode before the first prepareFrame() if the table holds images.
+    void setFallbackImage(VkImageView view, VkSampler sampler);
+
+    // Make all registrations visible to the set used by the given frame and return that set.
+    // Must be called after the frame's fence has been waited, before recording.
+    VkDescriptorSet prepareFrame(size_t frameIndex);
+
+    void destroy();
+
+private:
+    void createLayout();
+
+    void createPool();
+
+    void allocateSets();
+
+    void writeBufferSlots(VkDescriptorSet set, uint32_t first, uint32_t count);
+
+    void writeImageSlots(VkDescriptorSet set, uint32_t first, uint32_t count);
+
+private:
+    VkDevice* m_device = nullptr;
+
+    BindlessDescriptorsStructs::CreateInfo m_info = {};
+
+    VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+
+    // Single set in update-after-bind mode; one set per frame in flight otherwise.
+    std::vector<VkDescriptorSet> m_sets = {};
+
+    std::vector<VkDescriptorBufferInfo> m_bufferInfos = {};
+
+    std::vector<Slot> m_freeBufferSlots = {};
+
+    std::vector<VkDescriptorImageInfo> m_imageInfos = {};
+
+    std::vector<Slot> m_freeImageSlots = {};
+
+    VkDescriptorImageInfo m_fallbackImageInfo = {};
+
+    // Slots written since the last prepareFrame() (update-after-bind mode).
+    std::vector<Slot> m_pendingBufferSlots = {};
+    std::vector<Slot> m_pendingImageSlots = {};
+
+    // Table version each fallback set was last synchronized with.
+    uint64_t m_version = 0;
+    std::vector<uint64_t> m_setVersions = {};
+};
+
+#endif // BINDLESS_DESCRIPTORS_H
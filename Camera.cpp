@@ -13,19 +13,42 @@
 #include "Camera.h"
 
 void Camera::updateViewMatrix(glm::mat4& viewMat) {
-    m_right.y = 0.0f;
-    m_right = glm::normalize(m_right);
-    m_lookAt = glm::normalize(glm::cross(m_right, m_up));
-    m_up = glm::cross(m_lookAt, m_right);
-
-    viewMat = glm::lookAtLH(m_eye, m_eye + m_lookAt, m_up);
+    // Same as glm::lookAtLH(m_eye, m_eye + m_lookAt, m_up), whose side vector is m_right
+    // since the basis is kept orthonormal by construction.
+    viewMat = glm::mat4(1.0f);
+    viewMat[0][0] = m_right.x;
+    viewMat[1][0] = m_right.y;
+    viewMat[2][0] = m_right.z;
+    viewMat[0][1] = m_up.x;
+    viewMat[1][1] = m_up.y;
+    viewMat[2][1] = m_up.z;
+    viewMat[0][2] = m_lookAt.x;
+    viewMat[1][2] = m_lookAt.y;
+    viewMat[2][2] = m_lookAt.z;
+    viewMat[3][0] = -glm::dot(m_right, m_eye);
+    viewMat[3][1] = -glm::dot(m_up, m_eye);
+    viewMat[3][2] = -glm::dot(m_lookAt, m_eye);
 }
 
 void Camera::updateProjMatrix(glm::mat4& projMat) {
-    projMat = glm::perspectiveFovLH(glm::radians(m_verticalFov),
-                                    static_cast<float>(m_viewWidth),
-                                    static_cast<float>(m_viewHeight),
-                                    m_nearZ, m_farZ);
+    // Vulkan clips depth to [0, 1].
+    projMat = glm::perspectiveFovLH_ZO(glm::radians(m_verticalFov),
+                                       static_cast<float>(m_viewWidth),
+                                       static_cast<float>(m_viewHeight),
+                                       m_nearZ, m_farZ);
+}
+
+void Camera::setBasis(const glm::vec3& right, const glm::vec3& up, const glm::vec3& lookAt) {
+    m_worldUp = glm::normalize(up);
+    m_orientation = glm::normalize(glm::quat_cast(glm::mat3(glm::normalize(right), m_worldUp, glm::normalize(lookAt))));
+    updateBasis();
+}
+
+void Camera::updateBasis() {
+    auto basis = glm::mat3_cast(m_orientation);
+    m_right = basis[0];
+    m_up = basis[1];
+    m_lookAt = basis[2];
 }
 
 void Camera::translate(float dx, float dy, float dz) {
@@ -33,21 +56,15 @@ void Camera::translate(float dx, float dy, float dz) {
 }
 
 void Camera::rotate(float pitch, float yaw, float roll) {
-    auto doPitch = glm::rotate(glm::mat4(1.0f), pitch, m_right);
-    auto doPitchYaw = glm::rotate(doPitch, yaw, m_up);
-//    auto doRoll = glm::rotate(doPitchYaw, roll, m_lookAt);
-
-    auto right4 = glm::vec4(m_right, 0.0f);
-    auto up4 = glm::vec4(m_up, 0.0f);
-    auto lookAt4 = glm::vec4(m_lookAt, 0.0f);
-
-    right4 = right4 * doPitchYaw;
-    up4 = up4 * doPitchYaw;
-    lookAt4 = lookAt4 * doPitchYaw;
+    // Pitch around the camera right axis, yaw around the world up axis; the angles keep
+    // the sign of the former row-vector rotation matrices.
+    auto doPitch = glm::angleAxis(-pitch, glm::vec3(1.0f, 0.0f, 0.0f));
+    auto doYaw = glm::angleAxis(-yaw, m_worldUp);
+    auto doRoll = glm::angleAxis(-roll, glm::vec3(0.0f, 0.0f, 1.0f));
 
-    m_right = glm::vec3(right4);
-    m_up = glm::vec3(up4);
-    m_lookAt = glm::vec3(lookAt4);
+    // Renormalize once per rotation rather than once per frame.
+    m_orientation = glm::normalize(doYaw * m_orientation * doPitch * doRoll);
+    updateBasis();
 }
 
 void Camera::zoom(float delta) {
@@ -12,7 +12,10 @@
 #define CAMERA_H
 
 #include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
 
+// The orientation is a unit quaternion taking the camera axes (right, up, lookAt) = (x, y, z)
+// to world space; the basis vectors are derived from it only when it changes.
 class Camera {
 public:
     Camera(int viewWidth, int viewHeight, float verticalFov) // View size in pixel unit.
@@ -24,17 +27,23 @@ public:
 
     inline void setFrustumDepth(float nearZ, float farZ) { m_nearZ = nearZ; m_farZ = farZ; }
 
+    inline float nearZ() const { return m_nearZ; }
+    inline float farZ() const { return m_farZ; }
+
+    inline float verticalFov() const { return m_verticalFov; } // In degrees.
+    inline float aspectRatio() const { return static_cast<float>(m_viewWidth) / static_cast<float>(m_viewHeight); }
+
     inline glm::vec3 eye() const { return m_eye; }
     inline void setEye(const glm::vec3& value) { m_eye = value; }
 
     inline glm::vec3 right() const { return m_right; }
-    inline void setRight(const glm::vec3& value) { m_right = value; }
-
     inline glm::vec3 up() const { return m_up; }
-    inline void setUp(const glm::vec3& value) { m_up = value; }
-
     inline glm::vec3 lookAt() const { return m_lookAt; }
-    inline void setLookAt(const glm::vec3& value) { m_lookAt = value; }
+
+    // The up vector is also the world up that yaw turns around, which keeps the camera free of roll.
+    void setBasis(const glm::vec3& right, const glm::vec3& up, const glm::vec3& lookAt);
+
+    inline glm::quat orientation() const { return m_orientation; }
 
 private:
     int m_viewWidth = 0, m_viewHeight = 0;
@@ -43,7 +52,13 @@ private:
 
     glm::vec3 m_eye = {};
 
-    glm::vec3 m_right = {}, m_up = {}, m_lookAt = {};
+    glm::quat m_orientation = { 1.0f, 0.0f, 0.0f, 0.0f };
+    glm::vec3 m_worldUp = { 0.0f, 1.0f, 0.0f };
+
+    // Derived from the orientation.
+    glm::vec3 m_right = { 1.0f, 0.0f, 0.0f }, m_up = { 0.0f, 1.0f, 0.0f }, m_lookAt = { 0.0f, 0.0f, 1.0f };
+
+    void updateBasis();
 
 public:
     void translate(float dx, float dy, float dz);
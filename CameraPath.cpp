@@ -0,0 +1,91 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "CameraPath.h"
+
+void CameraPath::load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open camera path " + filename);
+    }
+
+    m_keyframes.clear();
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        auto start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+
+        Keyframe keyframe = {};
+        std::istringstream fields(line);
+        if (!(fields >> keyframe.frame >> keyframe.eye.x >> keyframe.eye.y >> keyframe.eye.z >> keyframe.yaw >> keyframe.pitch)) {
+            throw std::runtime_error("Failed to parse camera path " + filename + " at line " + std::to_string(lineNumber));
+        }
+        if (!m_keyframes.empty() && keyframe.frame <= m_keyframes.back().frame) {
+            throw std::runtime_error("Camera path " + filename + " has unordered frames at line " + std::to_string(lineNumber));
+        }
+        m_keyframes.push_back(keyframe);
+    }
+}
+
+void CameraPath::save(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open camera path " + filename);
+    }
+
+    // Enough digits for floats to survive the round trip.
+    file.precision(9);
+    file << "# frame eye.x eye.y eye.z yaw pitch\n";
+    for (const auto& keyframe : m_keyframes) {
+        file << keyframe.frame << ' ' << keyframe.eye.x << ' ' << keyframe.eye.y << ' ' << keyframe.eye.z << ' '
+             << keyframe.yaw << ' ' << keyframe.pitch << '\n';
+    }
+
+    if (!file) {
+        throw std::runtime_error("Failed to write camera path " + filename);
+    }
+}
+
+void CameraPath::addKeyframe(const Keyframe& keyframe) {
+    if (!m_keyframes.empty() && keyframe.frame <= m_keyframes.back().frame) {
+        throw std::runtime_error("Camera path keyframes must be added in increasing frame order");
+    }
+    m_keyframes.push_back(keyframe);
+}
+
+CameraPath::Keyframe CameraPath::sample(uint32_t frame) const {
+    if (m_keyframes.empty()) return {};
+    if (frame <= m_keyframes.front().frame) return m_keyframes.front();
+    if (frame >= m_keyframes.back().frame) return m_keyframes.back();
+
+    // First keyframe after the frame; there is always one before it.
+    auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), frame, [](uint32_t value, const Keyframe& keyframe) {
+        return value < keyframe.frame;
+    });
+    auto prev = next - 1;
+
+    float t = static_cast<float>(frame - prev->frame) / static_cast<float>(next->frame - prev->frame);
+
+    Keyframe keyframe = {};
+    keyframe.frame = frame;
+    keyframe.eye = glm::mix(prev->eye, next->eye, t);
+    keyframe.yaw = glm::mix(prev->yaw, next->yaw, t);
+    keyframe.pitch = glm::mix(prev->pitch, next->pitch, t);
+    return keyframe;
+}
@@ -0,0 +1,67 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace CameraPathStructs {
+    struct Keyframe {
+        uint32_t frame = 0;
+
+        glm::vec3 eye = {};
+
+        // Accumulated rotateCamera() input since the camera was reset, in radians.
+        float yaw = 0.0f;
+        float pitch = 0.0f;
+    };
+}
+
+// Camera keyframes by frame index, stored as text so that paths can be diffed and edited:
+//
+//   # frame eye.x eye.y eye.z yaw pitch
+//   0 0 0 -1 0 0
+//   120 0 0.5 -3 0.4 -0.1
+//
+// Frames between keyframes are interpolated linearly.
+class CameraPath {
+public:
+    using Keyframe = CameraPathStructs::Keyframe;
+
+public:
+    void load(const std::string& filename);
+
+    void save(const std::string& filename) const;
+
+    // Frames must be added in increasing order.
+    void addKeyframe(const Keyframe& keyframe);
+
+    inline void clear() { m_keyframes.clear(); }
+
+    inline bool isEmpty() const { return m_keyframes.empty(); }
+
+    inline const std::vector<Keyframe>& keyframes() const { return m_keyframes; }
+
+    // Frames from 0 up to the last keyframe.
+    inline uint32_t frameCount() const { return m_keyframes.empty() ? 0 : m_keyframes.back().frame + 1; }
+
+    // Clamped to the first and last keyframe.
+    Keyframe sample(uint32_t frame) const;
+
+private:
+    std::vector<Keyframe> m_keyframes = {};
+};
+
+#endif // CAMERA_PATH_H
@@ -0,0 +1,186 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "ClusteredLighting.h"
+
+ClusteredLighting::~ClusteredLighting() {
+    destroy(); // In case someone forgets destroy the buffers.
+}
+
+ClusteredLighting::Handle ClusteredLighting::addLight(const PointLight& light) {
+    m_lights.push_back(light);
+    return static_cast<Handle>(m_lights.size() - 1);
+}
+
+void ClusteredLighting::init(const ClusteredLightingStructs::CreateInfo& info) {
+    m_info = info;
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+    m_indexCapacity = std::max(clusterCount() * m_info.averageLightsPerCluster, 1u);
+
+    createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(glm::uvec2) * std::max(clusterCount(), 1u),
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_gridResource);
+    createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(uint32_t) * m_indexCapacity,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexResource);
+
+    m_lightResources.resize(m_info.frameCount);
+    m_lightMappedData.resize(m_info.frameCount, nullptr);
+    m_uploadedLightVersions.resize(m_info.frameCount, 0);
+    for (size_t i = 0; i < m_info.frameCount; ++i) {
+        createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     sizeof(ClusteredLightingStructs::LightListHeader) + sizeof(PointLight) * m_lights.size(),
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_lightResources[i]);
+        vkMapMemory(*m_device, m_lightResources[i].memory, 0, VK_WHOLE_SIZE, 0, &m_lightMappedData[i]);
+        *static_cast<ClusteredLightingStructs::LightListHeader*>(m_lightMappedData[i]) = {};
+    }
+
+    auto& bindless = *m_info.bindlessDescriptors;
+    m_gridResource.slot = bindless.registerBuffer(m_gridResource.buffer);
+    m_indexResource.slot = bindless.registerBuffer(m_indexResource.buffer);
+    for (auto& resource : m_lightResources) {
+        resource.slot = bindless.registerBuffer(resource.buffer);
+    }
+}
+
+void ClusteredLighting::setLight(Handle light, const PointLight& data) {
+    m_lights[light] = data;
+    ++m_lightVersion;
+}
+
+void ClusteredLighting::update(size_t frameIndex) {
+    auto* header = static_cast<ClusteredLightingStructs::LightListHeader*>(m_lightMappedData[frameIndex]);
+    m_lightIndexCount = std::min(header->indexCount, m_indexCapacity);
+    m_droppedLightIndexCount = header->droppedIndexCount;
+    *header = {};
+    m_uploadSize = sizeof(*header);
+
+    // The frame's copy may be several changes behind, so all lights go at once.
+    if (m_uploadedLightVersions[frameIndex] != m_lightVersion && !m_lights.empty()) {
+        memcpy(header + 1, m_lights.data(), sizeof(PointLight) * m_lights.size());
+        m_uploadedLightVersions[frameIndex] = m_lightVersion;
+        m_uploadSize += sizeof(PointLight) * m_lights.size();
+    }
+}
+
+void ClusteredLighting::recordCulling(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipeline pipeline, VkPipelineLayout pipelineLayout,
+                                      const glm::mat4& viewMat, const glm::mat4& projMat, float nearZ, float farZ) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    ClusteredLightingStructs::Params params = {};
+    params.viewMat = viewMat;
+    params.lightBufferIndex = m_lightResources[frameIndex].slot;
+    params.gridBufferIndex = m_gridResource.slot;
+    params.indexBufferIndex = m_indexResource.slot;
+    params.lightCount = static_cast<uint32_t>(m_lights.size());
+    params.indexCapacity = m_indexCapacity;
+    params.clusterCountX = m_info.clusterCounts.x;
+    params.clusterCountY = m_info.clusterCounts.y;
+    params.clusterCountZ = m_info.clusterCounts.z;
+    params.nearZ = nearZ;
+    params.farZ = farZ;
+    // Whatever the projection is made of, these take view x and y at depth 1 to NDC.
+    params.tanHalfFovX = 1.0f / projMat[0][0];
+    params.tanHalfFovY = 1.0f / projMat[1][1];
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+    vkCmdDispatch(commandBuffer, (clusterCount() + GroupSize - 1) / GroupSize, 1, 1);
+
+    // The counters are read on the host once the frame's fence is signaled.
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_lightResources[frameIndex].buffer;
+    barrier.offset = 0;
+    barrier.size = sizeof(ClusteredLightingStructs::LightListHeader);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+VkDeviceSize ClusteredLighting::memorySize() const {
+    VkDeviceSize size = m_gridResource.size + m_indexResource.size;
+    for (const auto& resource : m_lightResources) size += resource.size;
+    return size;
+}
+
+size_t ClusteredLighting::allocationCount() const {
+    return isInited() ? 2 + m_lightResources.size() : 0;
+}
+
+void ClusteredLighting::destroy() {
+    // The bindless table may be gone by the time the destructor runs.
+    if (m_device == nullptr || !isInited()) return;
+
+    destroyBuffer(m_gridResource);
+    destroyBuffer(m_indexResource);
+
+    for (auto& resource : m_lightResources) {
+        destroyBuffer(resource);
+    }
+    m_lightResources.clear();
+    m_lightMappedData.clear();
+    m_uploadedLightVersions.clear();
+}
+
+void ClusteredLighting::createBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags properties, BufferResource& resource) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(*m_device, &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create clustered lighting buffer.");
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetBufferMemoryRequirements(*m_device, resource.buffer, &requirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = findAdequateMemoryType(requirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(*m_device, &allocInfo, nullptr, &resource.memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate clustered lighting buffer memory.");
+    }
+    vkBindBufferMemory(*m_device, resource.buffer, resource.memory, 0);
+
+    resource.size = requirements.size;
+}
+
+void ClusteredLighting::destroyBuffer(BufferResource& resource) {
+    if (resource.buffer == VK_NULL_HANDLE) return;
+
+    if (resource.slot != BindlessDescriptors::InvalidSlot) {
+        m_info.bindlessDescriptors->unregisterBuffer(resource.slot);
+    }
+    // Freeing the memory unmaps it as well.
+    vkDestroyBuffer(*m_device, resource.buffer, nullptr);
+    vkFreeMemory(*m_device, resource.memory, nullptr);
+
+    resource = {};
+}
+
+uint32_t ClusteredLighting::findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find an adequate memory type.");
+}
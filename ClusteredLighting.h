@@ -0,0 +1,185 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "BindlessDescriptors.h"
+
+namespace ClusteredLightingStructs {
+    // std430 layout, as read by light_cull.comp and shader.frag.
+    struct PointLight {
+        glm::vec4 positionRadius; // xyz: world position; w: no light beyond this distance.
+        glm::vec4 colorIntensity; // rgb: color; a: intensity.
+    };
+
+    // At the start of every light buffer, followed by the lights; the counters are bumped by light_cull.comp.
+    struct LightListHeader {
+        uint32_t indexCount; // Reserved in the index list, including what did not fit.
+        uint32_t droppedIndexCount; // Beyond the capacity of the index list.
+        uint32_t padding[2]; // The lights that follow are 16-byte aligned.
+    };
+
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // All buffers read or written by light_cull.comp are registered there.
+        BindlessDescriptors* bindlessDescriptors = nullptr;
+
+        size_t frameCount = 1;
+
+        // Clusters across the screen and along the view depth.
+        glm::uvec3 clusterCounts = glm::uvec3(16, 9, 24);
+
+        // Sizes the index list shared by all clusters; a cluster may hold many more as long as others hold fewer.
+        uint32_t averageLightsPerCluster = 32;
+    };
+
+    // Push constants of light_cull.comp, one dispatch per frame.
+    struct Params {
+        glm::mat4 viewMat;
+
+        uint32_t lightBufferIndex; // Bindless slots.
+        uint32_t gridBufferIndex;
+        uint32_t indexBufferIndex;
+        uint32_t lightCount;
+
+        uint32_t indexCapacity;
+        uint32_t clusterCountX;
+        uint32_t clusterCountY;
+        uint32_t clusterCountZ;
+
+        float nearZ; // View depths the slices span.
+        float farZ;
+        float tanHalfFovX;
+        float tanHalfFovY;
+    };
+
+    static_assert(sizeof(Params) <= 128, "Push constants exceed the guaranteed minimum size.");
+}
+
+// Point lights binned into clusters of the view frustum for clustered forward shading. The screen is cut
+// into tiles and the view depth into slices growing logarithmically, and a compute pass tests every light
+// against the box around every cluster. What it finds goes into one compact index list, a range per cluster,
+// so a fragment only loops over the lights of its own cluster rather than over all of them.
+class ClusteredLighting {
+public:
+    using Handle = uint32_t;
+
+    using PointLight = ClusteredLightingStructs::PointLight;
+
+    // Must match local_size_x of light_cull.comp.
+    constexpr static uint32_t GroupSize = 64;
+
+public:
+    ClusteredLighting() = default;
+    ~ClusteredLighting();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    // Before init; the light count is fixed from then on.
+    Handle addLight(const PointLight& light);
+
+    void init(const ClusteredLightingStructs::CreateInfo& info);
+
+    inline bool isInited() const { return m_gridResource.buffer != VK_NULL_HANDLE; }
+
+    inline size_t lightCount() const { return m_lights.size(); }
+
+    void setLight(Handle light, const PointLight& data);
+
+    inline const PointLight& light(Handle light) const { return m_lights[light]; }
+
+    inline glm::uvec3 clusterCounts() const { return m_info.clusterCounts; }
+
+    inline uint32_t clusterCount() const { return m_info.clusterCounts.x * m_info.clusterCounts.y * m_info.clusterCounts.z; }
+
+    inline uint32_t indexCapacity() const { return m_indexCapacity; }
+
+    // An offset and count into the index list per cluster, x fastest, then y from the top of the screen, then depth.
+    inline BindlessDescriptors::Slot gridSlot() const { return m_gridResource.slot; }
+    inline BindlessDescriptors::Slot indexSlot() const { return m_indexResource.slot; }
+    inline BindlessDescriptors::Slot lightSlot(size_t frameIndex) const { return m_lightResources[frameIndex].slot; }
+
+    inline VkBuffer gridBuffer() const { return m_gridResource.buffer; }
+    inline VkBuffer indexBuffer() const { return m_indexResource.buffer; }
+
+    // After the frame's fence has been waited: read back the counters of the frame's last culling,
+    // reset them and write the lights into the frame's light buffer if they changed since.
+    void update(size_t frameIndex);
+
+    // Bytes the last update() wrote.
+    inline VkDeviceSize uploadSize() const { return m_uploadSize; }
+
+    // Of the culling the last update() read back, which ran the frames in flight earlier.
+    inline uint32_t lightIndexCount() const { return m_lightIndexCount; }
+    inline uint32_t droppedLightIndexCount() const { return m_droppedLightIndexCount; }
+
+    // One dispatch over all clusters for a camera of the given view, projection and depth range, with
+    // the bindless table bound at set 1 of the layout. The grid and index list are written in the compute
+    // stage; synchronizing their reads is up to the caller.
+    void recordCulling(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipeline pipeline, VkPipelineLayout pipelineLayout,
+                       const glm::mat4& viewMat, const glm::mat4& projMat, float nearZ, float farZ);
+
+    VkDeviceSize memorySize() const;
+
+    size_t allocationCount() const;
+
+    void destroy();
+
+private:
+    struct BufferResource {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        BindlessDescriptors::Slot slot = BindlessDescriptors::InvalidSlot;
+    };
+
+    void createBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags properties, BufferResource& resource);
+
+    void destroyBuffer(BufferResource& resource);
+
+    uint32_t findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+    VkDevice* m_device = nullptr;
+
+    ClusteredLightingStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    std::vector<PointLight> m_lights = {};
+
+    // Bumped by every change; each light buffer holds the lights of its version.
+    uint64_t m_lightVersion = 1;
+    std::vector<uint64_t> m_uploadedLightVersions = {};
+
+    uint32_t m_indexCapacity = 0;
+
+    BufferResource m_gridResource = {};
+    BufferResource m_indexResource = {};
+
+    // Per frame in flight, persistently mapped; header first, then the lights.
+    std::vector<BufferResource> m_lightResources = {};
+    std::vector<void*> m_lightMappedData = {};
+
+    VkDeviceSize m_uploadSize = 0;
+
+    uint32_t m_lightIndexCount = 0;
+    uint32_t m_droppedLightIndexCount = 0;
+};
+
+#endif // CLUSTERED_LIGHTING_H
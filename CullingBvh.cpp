@@ -0,0 +1,221 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "CullingBvh.h"
+#include "SimdLane.h"
+
+// Empty slots get negative extents, which every plane rejects.
+constexpr static float EMPTY_EXTENT = -1.0e30f;
+
+CullingBvh::Frustum CullingBvh::extractFrustum(const glm::mat4& viewProjMat) {
+    auto row = [&](int r) { return glm::vec4(viewProjMat[0][r], viewProjMat[1][r], viewProjMat[2][r], viewProjMat[3][r]); };
+
+    // Gribb-Hartmann, with the near plane at z = 0 of the clip volume.
+    Frustum frustum = {};
+    frustum.planes[0] = row(3) + row(0); // Left
+    frustum.planes[1] = row(3) - row(0); // Right
+    frustum.planes[2] = row(3) + row(1); // Bottom
+    frustum.planes[3] = row(3) - row(1); // Top
+    frustum.planes[4] = row(2);          // Near
+    frustum.planes[5] = row(3) - row(2); // Far
+
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+bool CullingBvh::isBoundsVisible(const Frustum& frustum, const Bounds& bounds) {
+    for (const auto& plane : frustum.planes) {
+        glm::vec3 normal = glm::vec3(plane);
+        float distance = glm::dot(normal, bounds.center) + plane.w;
+        float radius = glm::dot(glm::abs(normal), bounds.extents);
+        if (distance + radius < 0.0f) return false;
+    }
+    return true;
+}
+
+void CullingBvh::build(const std::vector<Bounds>& bounds) {
+    m_nodes.clear();
+    m_objectSlots.assign(bounds.size(), ObjectSlot{ InvalidNode, 0 });
+    if (bounds.empty()) {
+        m_isNodeDirty.clear();
+        return;
+    }
+
+    std::vector<uint32_t> objects(bounds.size());
+    std::iota(objects.begin(), objects.end(), 0);
+
+    // About one node per three objects at four children per node.
+    m_nodes.reserve(bounds.size() / 3 + 1);
+    buildNode(bounds, objects.data(), objects.data() + objects.size(), InvalidNode, 0);
+
+    m_isNodeDirty.assign(m_nodes.size(), 0);
+}
+
+uint32_t CullingBvh::buildNode(const std::vector<Bounds>& bounds, uint32_t* first, uint32_t* last, uint32_t parent, uint32_t slotInParent) {
+    auto nodeIndex = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+    m_nodes[nodeIndex].parent = parent;
+    m_nodes[nodeIndex].slotInParent = slotInParent;
+
+    // Four groups of objects: one each when there are few, otherwise two median splits
+    // along the longest axis of the centers.
+    uint32_t* groups[5] = { first, first, first, first, first };
+    size_t count = last - first;
+    if (count <= 4) {
+        for (size_t i = 0; i <= 4; ++i) groups[i] = first + std::min(i, count);
+    }
+    else {
+        auto split = [&](uint32_t* begin, uint32_t* end) {
+            glm::vec3 minCenter = bounds[*begin].center, maxCenter = bounds[*begin].center;
+            for (auto object = begin; object != end; ++object) {
+                minCenter = glm::min(minCenter, bounds[*object].center);
+                maxCenter = glm::max(maxCenter, bounds[*object].center);
+            }
+            auto size = maxCenter - minCenter;
+            int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+            auto middle = begin + (end - begin) / 2;
+            std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) {
+                return bounds[a].center[axis] < bounds[b].center[axis];
+            });
+            return middle;
+        };
+
+        groups[2] = split(first, last);
+        groups[1] = split(first, groups[2]);
+        groups[3] = split(groups[2], last);
+        groups[4] = last;
+    }
+
+    for (uint32_t slot = 0; slot < 4; ++slot) {
+        auto groupBegin = groups[slot], groupEnd = groups[slot + 1];
+
+        if (groupBegin == groupEnd) {
+            m_nodes[nodeIndex].children[slot] = EmptyChild;
+            setSlotBounds(m_nodes[nodeIndex], slot, { glm::vec3(0.0f), glm::vec3(EMPTY_EXTENT) });
+        }
+        else if (groupEnd - groupBegin == 1) {
+            m_nodes[nodeIndex].children[slot] = ObjectBit | *groupBegin;
+            setSlotBounds(m_nodes[nodeIndex], slot, bounds[*groupBegin]);
+            m_objectSlots[*groupBegin] = { nodeIndex, slot };
+        }
+        else {
+            // Note m_nodes may reallocate during the recursion.
+            uint32_t child = buildNode(bounds, groupBegin, groupEnd, nodeIndex, slot);
+            m_nodes[nodeIndex].children[slot] = child;
+            setSlotBounds(m_nodes[nodeIndex], slot, nodeBounds(m_nodes[child]));
+        }
+    }
+    return nodeIndex;
+}
+
+void CullingBvh::setSlotBounds(Node& node, uint32_t slot, const Bounds& bounds) {
+    node.centerX[slot] = bounds.center.x;
+    node.centerY[slot] = bounds.center.y;
+    node.centerZ[slot] = bounds.center.z;
+    node.extentX[slot] = bounds.extents.x;
+    node.extentY[slot] = bounds.extents.y;
+    node.extentZ[slot] = bounds.extents.z;
+}
+
+CullingBvh::Bounds CullingBvh::nodeBounds(const Node& node) const {
+    glm::vec3 minCorner = glm::vec3(INFINITY), maxCorner = glm::vec3(-INFINITY);
+    for (uint32_t slot = 0; slot < 4; ++slot) {
+        if (node.children[slot] == EmptyChild) continue;
+
+        glm::vec3 center = { node.centerX[slot], node.centerY[slot], node.centerZ[slot] };
+        glm::vec3 extents = { node.extentX[slot], node.extentY[slot], node.extentZ[slot] };
+        minCorner = glm::min(minCorner, center - extents);
+        maxCorner = glm::max(maxCorner, center + extents);
+    }
+    return { 0.5f * (minCorner + maxCorner), 0.5f * (maxCorner - minCorner) };
+}
+
+void CullingBvh::refit(const std::vector<Bounds>& bounds, const std::vector<uint32_t>& movedObjects) {
+    if (movedObjects.empty()) return;
+
+    for (auto object : movedObjects) {
+        auto location = m_objectSlots[object];
+        setSlotBounds(m_nodes[location.node], location.slot, bounds[object]);
+        m_isNodeDirty[location.node] = 1;
+    }
+
+    // Children come after their parents, so a reverse sweep sees every child before its parent.
+    for (size_t i = m_nodes.size(); i-- > 1;) {
+        if (!m_isNodeDirty[i]) continue;
+        m_isNodeDirty[i] = 0;
+
+        auto& node = m_nodes[i];
+        setSlotBounds(m_nodes[node.parent], node.slotInParent, nodeBounds(node));
+        m_isNodeDirty[node.parent] = 1;
+    }
+    m_isNodeDirty[0] = 0;
+}
+
+void CullingBvh::cull(const Frustum& frustum, std::vector<uint32_t>& visibleObjects) const {
+    using namespace SimdLane;
+
+    if (m_nodes.empty()) return;
+
+    Lane planeX[6], planeY[6], planeZ[6], planeW[6];
+    Lane absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+    for (int p = 0; p < 6; ++p) {
+        const auto& plane = frustum.planes[p];
+        planeX[p] = splat(plane.x);
+        planeY[p] = splat(plane.y);
+        planeZ[p] = splat(plane.z);
+        planeW[p] = splat(plane.w);
+        absPlaneX[p] = splat(std::abs(plane.x));
+        absPlaneY[p] = splat(std::abs(plane.y));
+        absPlaneZ[p] = splat(std::abs(plane.z));
+    }
+    const Lane zero = splat(0.0f);
+
+    // Depth is about log4 of the object count, so the stack stays small.
+    uint32_t stack[256];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const auto& node = m_nodes[stack[--stackSize]];
+
+        Lane centerX = load(node.centerX), centerY = load(node.centerY), centerZ = load(node.centerZ);
+        Lane extentX = load(node.extentX), extentY = load(node.extentY), extentZ = load(node.extentZ);
+
+        // A box is outside when it lies entirely behind any plane: distance of the center < -projected radius.
+        Mask outside = lessThan(zero, zero);
+        for (int p = 0; p < 6; ++p) {
+            Lane distance = add(add(mul(planeX[p], centerX), mul(planeY[p], centerY)), add(mul(planeZ[p], centerZ), planeW[p]));
+            Lane radius = add(add(mul(absPlaneX[p], extentX), mul(absPlaneY[p], extentY)), mul(absPlaneZ[p], extentZ));
+            outside = maskOr(outside, lessThan(add(distance, radius), zero));
+        }
+
+        int insideBits = ~maskBits(outside) & 0xF;
+        for (uint32_t slot = 0; slot < 4; ++slot) {
+            if (!(insideBits & (1 << slot))) continue;
+
+            uint32_t child = node.children[slot];
+            if (child == EmptyChild) continue;
+
+            if (child & ObjectBit) {
+                visibleObjects.push_back(child & ~ObjectBit);
+            }
+            else {
+                stack[stackSize++] = child;
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef CULLING_BVH_H
+#define CULLING_BVH_H
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "Scene.h"
+
+namespace CullingBvhStructs {
+    // Normalized planes pointing inwards: p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+    struct Frustum {
+        glm::vec4 planes[6] = {};
+    };
+}
+
+// A 4-wide bounding volume hierarchy over object bounds for frustum culling. Each node keeps
+// the boxes of its four children side by side, so one SIMD test checks all of them against
+// a plane. Moved objects are refit in place; build() again when objects are added or removed,
+// or after so much movement that the tree has lost its shape.
+class CullingBvh {
+public:
+    using Bounds = SceneStructs::Bounds;
+    using Frustum = CullingBvhStructs::Frustum;
+
+public:
+    // Planes of the clip volume of a Vulkan (depth in [0, 1]) projection * view matrix.
+    static Frustum extractFrustum(const glm::mat4& viewProjMat);
+
+    // Scalar reference for a single box.
+    static bool isBoundsVisible(const Frustum& frustum, const Bounds& bounds);
+
+    // Object i has bounds[i].
+    void build(const std::vector<Bounds>& bounds);
+
+    // Only the bounds of movedObjects differ from the last build() or refit().
+    void refit(const std::vector<Bounds>& bounds, const std::vector<uint32_t>& movedObjects);
+
+    // Append the objects whose bounds intersect the frustum; conservative near the frustum corners.
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visibleObjects) const;
+
+    inline size_t objectCount() const { return m_objectSlots.size(); }
+
+    inline size_t nodeCount() const { return m_nodes.size(); }
+
+private:
+    constexpr static uint32_t EmptyChild = UINT32_MAX;
+    constexpr static uint32_t ObjectBit = 0x80000000u; // Set in children that are objects rather than nodes.
+    constexpr static uint32_t InvalidNode = UINT32_MAX;
+
+    struct Node {
+        float centerX[4], centerY[4], centerZ[4];
+        float extentX[4], extentY[4], extentZ[4];
+        uint32_t children[4];
+
+        uint32_t parent;
+        uint32_t slotInParent;
+    };
+
+    // Children are created after their parents.
+    std::vector<Node> m_nodes = {};
+
+    struct ObjectSlot {
+        uint32_t node;
+        uint32_t slot;
+    };
+
+    std::vector<ObjectSlot> m_objectSlots = {};
+
+    std::vector<uint8_t> m_isNodeDirty = {};
+
+    uint32_t buildNode(const std::vector<Bounds>& bounds, uint32_t* first, uint32_t* last, uint32_t parent, uint32_t slotInParent);
+
+    void setSlotBounds(Node& node, uint32_t slot, const Bounds& bounds);
+
+    Bounds nodeBounds(const Node& node) const;
+};
+
+#endif // CULLING_BVH_H
@@ -0,0 +1,187 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "DescriptorAllocator.h"
+
+namespace DescriptorAllocatorStructs {
+    bool LayoutKey::operator==(const LayoutKey& other) const {
+        if (bindings.size() != other.bindings.size()) return false;
+
+        for (size_t i = 0; i < bindings.size(); ++i) {
+            const auto& lhs = bindings[i];
+            const auto& rhs = other.bindings[i];
+            if (lhs.binding != rhs.binding || lhs.type != rhs.type ||
+                lhs.count != rhs.count || lhs.stages != rhs.stages) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t LayoutKeyHasher::operator()(const LayoutKey& key) const {
+        size_t hash = key.bindings.size();
+        auto combine = [&](size_t value) {
+            hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        };
+        for (const auto& binding : key.bindings) {
+            combine(binding.binding);
+            combine(binding.type);
+            combine(binding.count);
+            combine(binding.stages);
+        }
+        return hash;
+    }
+}
+
+DescriptorAllocator::~DescriptorAllocator() {
+    destroy(); // In case someone forgets destroy created pools and layouts.
+}
+
+void DescriptorAllocator::init(size_t framesInFlight) {
+    m_framePools.resize(framesInFlight);
+}
+
+VkDescriptorSetLayout DescriptorAllocator::acquireLayout(const std::vector<LayoutBinding>& bindings) {
+    DescriptorAllocatorStructs::LayoutKey key = {};
+    key.bindings = bindings;
+    // Binding order does not change the layout.
+    std::sort(key.bindings.begin(), key.bindings.end(), [](const LayoutBinding& lhs, const LayoutBinding& rhs) {
+        return lhs.binding < rhs.binding;
+    });
+
+    auto itor = m_layoutCache.find(key);
+    if (itor != m_layoutCache.end()) {
+        return itor->second;
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings(key.bindings.size());
+    for (size_t i = 0; i < key.bindings.size(); ++i) {
+        layoutBindings[i].binding = key.bindings[i].binding;
+        layoutBindings[i].descriptorType = key.bindings[i].type;
+        layoutBindings[i].descriptorCount = key.bindings[i].count;
+        layoutBindings[i].stageFlags = key.bindings[i].stages;
+        layoutBindings[i].pImmutableSamplers = nullptr;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = layoutBindings.size();
+    layoutInfo.pBindings = layoutBindings.data();
+
+    VkDescriptorSetLayout layout = {};
+    if (vkCreateDescriptorSetLayout(*m_device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor set layouts.");
+    }
+
+    m_layoutCache.insert({ key, layout });
+
+    // Pools created from now on have room for sets of this layout too.
+    std::unordered_map<VkDescriptorType, uint32_t> counts = {};
+    for (const auto& binding : key.bindings) {
+        counts[binding.type] += binding.count;
+    }
+    for (const auto& count : counts) {
+        auto& maxCount = m_maxDescriptorCounts[count.first];
+        maxCount = std::max(maxCount, count.second);
+    }
+    return layout;
+}
+
+void DescriptorAllocator::resetFrame(size_t frameIndex) {
+    auto& frame = m_framePools[frameIndex];
+
+    // Resetting a pool frees all of its sets at once, without touching them one by one.
+    for (auto& pool : frame.pools) {
+        vkResetDescriptorPool(*m_device, pool, 0);
+    }
+    frame.currPoolIndex = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(size_t frameIndex, VkDescriptorSetLayout layout) {
+    auto& frame = m_framePools[frameIndex];
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    // Try pools already owned by the frame first, then grow.
+    while (true) {
+        bool isNewPool = frame.currPoolIndex == frame.pools.size();
+        if (isNewPool) {
+            frame.pools.push_back(acquirePool());
+        }
+        allocInfo.descriptorPool = frame.pools[frame.currPoolIndex];
+
+        VkDescriptorSet set = {};
+        auto result = vkAllocateDescriptorSets(*m_device, &allocInfo, &set);
+        if (result == VK_SUCCESS) {
+            return set;
+        }
+        // An empty pool that can not hold the set means no pool ever will.
+        if (isNewPool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)) {
+            throw std::runtime_error("Failed to allocate descriptor sets.");
+        }
+        ++frame.currPoolIndex;
+    }
+}
+
+void DescriptorAllocator::destroy() {
+    for (auto& frame : m_framePools) {
+        for (auto& pool : frame.pools) {
+            vkDestroyDescriptorPool(*m_device, pool, nullptr);
+        }
+        frame.pools.clear();
+        frame.currPoolIndex = 0;
+    }
+    m_poolCount = 0;
+
+    for (auto& layoutGroup : m_layoutCache) {
+        vkDestroyDescriptorSetLayout(*m_device, layoutGroup.second, nullptr);
+    }
+    m_layoutCache.clear();
+    m_maxDescriptorCounts.clear();
+}
+
+VkDescriptorPool DescriptorAllocator::acquirePool() {
+    auto pool = createPool(m_nextPoolMaxSets);
+    m_nextPoolMaxSets = std::min(m_nextPoolMaxSets * 2, 4096u);
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t maxSets) {
+    // Every set may be of the largest cached layout of each descriptor type.
+    std::vector<VkDescriptorPoolSize> poolSizes = {};
+    for (const auto& count : m_maxDescriptorCounts) {
+        poolSizes.push_back({ count.first, count.second * maxSets });
+    }
+    if (poolSizes.empty()) {
+        poolSizes.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, maxSets }); // No layout yet; must not be empty.
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0; // Sets are never freed individually.
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = maxSets;
+
+    VkDescriptorPool pool = {};
+    if (vkCreateDescriptorPool(*m_device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor pool.");
+    }
+
+    ++m_poolCount;
+    return pool;
+}
@@ -0,0 +1,96 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef DESCRIPTOR_ALLOCATOR_H
+#define DESCRIPTOR_ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace DescriptorAllocatorStructs {
+    // Binding description without immutable samplers, which makes it comparable by value.
+    struct LayoutBinding {
+        uint32_t binding;
+        VkDescriptorType type;
+        uint32_t count;
+        VkShaderStageFlags stages;
+    };
+
+    struct LayoutKey {
+        std::vector<LayoutBinding> bindings = {};
+
+        bool operator==(const LayoutKey& other) const;
+    };
+
+    struct LayoutKeyHasher {
+        size_t operator()(const LayoutKey& key) const;
+    };
+}
+
+// Hands out transient descriptor sets from per-frame pools that are reset wholesale once
+// the frame retires, and caches descriptor set layouts by their binding description.
+class DescriptorAllocator {
+public:
+    using LayoutBinding = DescriptorAllocatorStructs::LayoutBinding;
+
+public:
+    DescriptorAllocator() = default;
+    ~DescriptorAllocator();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(size_t framesInFlight);
+
+    // Layouts are owned by the cache and live until destroy(). Pools are sized for the layouts acquired
+    // so far, so only sets of layouts from here can be allocated.
+    VkDescriptorSetLayout acquireLayout(const std::vector<LayoutBinding>& bindings);
+
+    // Must be called after the frame's fence has been waited; invalidates all sets allocated for it.
+    void resetFrame(size_t frameIndex);
+
+    // The returned set is valid until the next resetFrame() of the same frame. Throws if the set
+    // does not fit even into a new pool.
+    VkDescriptorSet allocate(size_t frameIndex, VkDescriptorSetLayout layout);
+
+    inline size_t poolCount() const { return m_poolCount; }
+
+    void destroy();
+
+private:
+    VkDescriptorPool acquirePool();
+
+    VkDescriptorPool createPool(uint32_t maxSets);
+
+private:
+    VkDevice* m_device = nullptr;
+
+    std::unordered_map<DescriptorAllocatorStructs::LayoutKey, VkDescriptorSetLayout,
+                       DescriptorAllocatorStructs::LayoutKeyHasher> m_layoutCache = {};
+
+    struct FramePools {
+        std::vector<VkDescriptorPool> pools = {};
+        size_t currPoolIndex = 0;
+    };
+
+    std::vector<FramePools> m_framePools = {};
+
+    // Most descriptors of each type any cached layout holds; every new pool has room for that many per set.
+    std::unordered_map<VkDescriptorType, uint32_t> m_maxDescriptorCounts = {};
+
+    // Pools are only created when every pool of a frame is exhausted; they grow geometrically.
+    uint32_t m_nextPoolMaxSets = 64;
+
+    size_t m_poolCount = 0;
+};
+
+#endif // DESCRIPTOR_ALLOCATOR_H
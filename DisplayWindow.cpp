@@ -82,12 +82,10 @@ void DisplayWindow::declareRenderResourceData() {
     engine.setCurrBindIndexBufferLabel("cube");
 }
 
-void DisplayWindow::initVulkanEngine() {
+void DisplayWindow::initVulkanEngine(VulkanEngineStructs::CreateInfo info) {
     void* surfaceHandle = reinterpret_cast<void*>(windowHandle()->winId());
     int dpr = QApplication::desktop()->screen()->devicePixelRatio();
 
-    VulkanEngineStructs::CreateInfo info = {};
-
     info.surface.handle = makePlatformSurfaceVulkanCompatible(surfaceHandle, dpr);
     info.surface.DPR = dpr;
     info.surface.screenCoordWidth = this->width();
@@ -96,14 +94,41 @@ void DisplayWindow::initVulkanEngine() {
     info.surface.pixelHeight = dpr * this->height();
 
     engine.init(info);
+
+    if (engine.isRenderThreadRunning()) {
+        connect(&m_inputTimer, &QTimer::timeout, this, &DisplayWindow::onInputTimer);
+        m_inputTimer.start(16);
+    }
 }
 
 void DisplayWindow::paintEvent(QPaintEvent* event) {
-    handleInputEvent();
+    FUNC_PARAM_UNUSED(event);
+    if (engine.isRenderThreadRunning()) return;
+
     engine.renderFrame();
+    recordCameraPathFrame();
+    updateProfilerOverlay();
     this->update();
 }
 
+void DisplayWindow::onInputTimer() {
+    if (engine.hasRenderThreadFailed()) {
+        m_inputTimer.stop();
+        try {
+            engine.stopRenderThread();
+        }
+        catch (const std::exception& e) {
+            qDebug() << "Render thread stopped:" << e.what();
+        }
+        // Nothing is rendered any more; leave as a failure on the GUI thread would.
+        QApplication::exit(1);
+        return;
+    }
+
+    recordCameraPathFrame();
+    updateProfilerOverlay();
+}
+
 QPaintEngine* DisplayWindow::paintEngine() const {
     // Discard Qt paint engine in case of it conflicts with Vulkan.
     return nullptr;
@@ -117,11 +142,34 @@ void DisplayWindow::resizeEvent(QResizeEvent* event) {
 }
 
 void DisplayWindow::keyPressEvent(QKeyEvent* event) {
+    if (event->key() == Qt::Key::Key_F7 && !event->isAutoRepeat()) {
+        cyclePresentMode();
+    }
+    else if (event->key() == Qt::Key::Key_F8 && !event->isAutoRepeat()) {
+        toggleLatencyMode();
+    }
+    else if (event->key() == Qt::Key::Key_F11 && !event->isAutoRepeat()) {
+        engine.profiler().setEnabled(!engine.profiler().isEnabled());
+    }
+    else if (event->key() == Qt::Key::Key_F9 && !event->isAutoRepeat()) {
+        toggleCameraPathRecording();
+    }
+    else if (event->key() == Qt::Key::Key_F12 && !event->isAutoRepeat()) {
+        try {
+            engine.profiler().exportChromeTrace("RenderStationTrace.json");
+            qDebug() << "Trace exported to RenderStationTrace.json";
+        }
+        catch (const std::exception& e) {
+            qDebug() << e.what();
+        }
+    }
     m_keyStatusTable[Qt::Key(event->key())] = true;
+    handleInputEvent();
 }
 
 void DisplayWindow::keyReleaseEvent(QKeyEvent* event) {
     m_keyStatusTable[Qt::Key(event->key())] = false;
+    handleInputEvent();
 }
 
 void DisplayWindow::mouseMoveEvent(QMouseEvent* event) {
@@ -139,6 +187,98 @@ void DisplayWindow::wheelEvent(QWheelEvent* event) {
     engine.zoomCamera(static_cast<float>(event->delta()) * m_cameraZoomSpeedScale);
 }
 
+void DisplayWindow::toggleCameraPathRecording() {
+    if (!m_isRecordingCameraPath) {
+        m_recordedCameraPath.clear();
+        m_recordedFrameIndex = 0;
+        m_isRecordingCameraPath = true;
+        qDebug() << "Camera path recording started";
+        return;
+    }
+
+    m_isRecordingCameraPath = false;
+    try {
+        m_recordedCameraPath.save("RenderStationCameraPath.txt");
+        qDebug() << "Camera path of" << m_recordedFrameIndex << "frames saved to RenderStationCameraPath.txt";
+    }
+    catch (const std::exception& e) {
+        qDebug() << e.what();
+    }
+}
+
+void DisplayWindow::recordCameraPathFrame() {
+    if (!m_isRecordingCameraPath) return;
+
+    // Camera of the last rendered frame; with the render thread one keyframe is taken per input tick.
+    auto state = engine.cameraState();
+
+    CameraPath::Keyframe keyframe = {};
+    keyframe.frame = m_recordedFrameIndex++;
+    keyframe.eye = state.eye;
+    keyframe.yaw = state.yaw;
+    keyframe.pitch = state.pitch;
+    m_recordedCameraPath.addKeyframe(keyframe);
+}
+
+static const char* presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo relaxed";
+        default: return "unknown";
+    }
+}
+
+void DisplayWindow::cyclePresentMode() {
+    auto settings = engine.presentSettings();
+    switch (settings.presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR; break;
+        case VK_PRESENT_MODE_MAILBOX_KHR: settings.presentMode = VK_PRESENT_MODE_FIFO_KHR; break;
+        case VK_PRESENT_MODE_FIFO_KHR: settings.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR; break;
+        default: settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+    }
+    engine.setPresentSettings(settings);
+    qDebug() << "Present mode requested:" << presentModeName(settings.presentMode);
+}
+
+void DisplayWindow::toggleLatencyMode() {
+    auto settings = engine.presentSettings();
+    bool isLowLatency = settings.latencyMode != VulkanEngineStructs::LatencyMode::Low;
+    settings.latencyMode = isLowLatency ? VulkanEngineStructs::LatencyMode::Low : VulkanEngineStructs::LatencyMode::Throughput;
+    engine.setPresentSettings(settings);
+    qDebug() << "Low latency mode" << (isLowLatency ? "on" : "off");
+}
+
+void DisplayWindow::updateProfilerOverlay() {
+    // Refreshing the title every frame would cost more than what it measures.
+    if (m_overlayTimer.isValid() && m_overlayTimer.elapsed() < 500) return;
+    m_overlayTimer.start();
+
+    if (!engine.isInited() || !engine.profiler().isEnabled()) {
+        this->setWindowTitle("Render Station 渲染作坊");
+        return;
+    }
+
+    auto summary = engine.profiler().frameSummary();
+    auto title = QString("Render Station 渲染作坊 - CPU %1 ms").arg(summary.cpuFrameMs, 0, 'f', 2);
+    if (engine.profiler().isGpuTimingSupported()) {
+        title += QString(" | GPU %1 ms").arg(summary.gpuFrameMs, 0, 'f', 2);
+    }
+
+    // Published by the thread rendering; the swapchain and everything else may be rebuilt meanwhile.
+    auto telemetry = engine.telemetry();
+    auto inputToPresentNs = telemetry.frame.inputToPresentNs;
+    if (inputToPresentNs > 0) m_inputToPresentMs = inputToPresentNs / 1e6;
+    bool isLowLatency = engine.presentSettings().latencyMode == VulkanEngineStructs::LatencyMode::Low;
+    title += QString(" | %1%2, %3 images | input %4 ms")
+            .arg(presentModeName(telemetry.presentMode))
+            .arg(isLowLatency ? " low latency" : "")
+            .arg(telemetry.swapchainImageCount)
+            .arg(m_inputToPresentMs, 0, 'f', 2);
+    this->setWindowTitle(title);
+}
+
 void DisplayWindow::handleInputEvent() {
     float horizontal =
             (m_keyStatusTable[Qt::Key::Key_A] ? -1.0f : 0.0f) +
@@ -150,9 +290,8 @@ void DisplayWindow::handleInputEvent() {
             (m_keyStatusTable[Qt::Key::Key_W] ? 1.0f : 0.0f) +
             (m_keyStatusTable[Qt::Key::Key_S] ? -1.0f : 0.0f);
 
-    if (qAbs(horizontal) + qAbs(vertical) + qAbs(frontBack) != 0.0f) {
-        engine.translateCamera(horizontal * m_cameraMoveSpeedScale,
-                               vertical * m_cameraMoveSpeedScale,
-                               frontBack * m_cameraMoveSpeedScale);
-    }
+    // The frames sample it themselves, so a held key moves the camera as late as any other input.
+    engine.setCameraMotion(horizontal * m_cameraMoveSpeedScale,
+                           vertical * m_cameraMoveSpeedScale,
+                           frontBack * m_cameraMoveSpeedScale);
 }
@@ -11,8 +11,11 @@
 #ifndef DISPLAY_WINDOW_H
 #define DISPLAY_WINDOW_H
 
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QWidget>
 
+#include "CameraPath.h"
 #include "VulkanEngine.h"
 
 class DisplayWindow : public QWidget {
@@ -20,9 +23,10 @@ class DisplayWindow : public QWidget {
 public:
     DisplayWindow();
 
-    void declareRenderResourceData();
+    virtual void declareRenderResourceData();
 
-    void initVulkanEngine();
+    // Surface fields of the info are filled from this window.
+    void initVulkanEngine(VulkanEngineStructs::CreateInfo info = {});
 
 protected:
     void paintEvent(QPaintEvent* event) override;
@@ -39,11 +43,42 @@ protected:
 
     void wheelEvent(QWheelEvent *event) override;
 
-private:
+protected:
     VulkanEngine engine = {};
 
+private:
+    // Hand the movement keys held to the engine; on every key press and release.
     void handleInputEvent();
 
+    // With the engine on its own render thread, paint events no longer drive frames; the overlay
+    // and camera path recording are refreshed from this timer on the GUI thread instead.
+    QTimer m_inputTimer = {};
+
+    void onInputTimer();
+
+    // Frame timings of the profiler in the title bar; F11 toggles profiling, F12 exports a trace.
+    void updateProfilerOverlay();
+
+    QElapsedTimer m_overlayTimer = {};
+
+    // Last non-zero input to present latency, since most frames carry no input.
+    double m_inputToPresentMs = 0.0;
+
+    // F7 cycles the present mode, F8 toggles the low latency mode.
+    void cyclePresentMode();
+
+    void toggleLatencyMode();
+
+    // F9 starts recording the camera every frame and saves the path when pressed again,
+    // for replay by FrameBench.
+    void toggleCameraPathRecording();
+
+    void recordCameraPathFrame();
+
+    bool m_isRecordingCameraPath = false;
+    CameraPath m_recordedCameraPath = {};
+    uint32_t m_recordedFrameIndex = 0;
+
     std::unordered_map<Qt::Key, bool> m_keyStatusTable = {
             { Qt::Key::Key_A, false }, { Qt::Key::Key_D, false },
             { Qt::Key::Key_Q, false }, { Qt::Key::Key_E, false },
@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragCorner;
+
+layout(location = 0) out vec4 color;
+
+// A round, soft-edged dot.
+void main() {
+    float coverage = 1.0f - smoothstep(0.5f, 1.0f, length(fragCorner));
+    if (coverage <= 0.0f) discard;
+    color = vec4(fragColor.rgb, fragColor.a * coverage);
+}
@@ -0,0 +1,67 @@
+#version 450
+
+// Sizes of the bindless tables, specialized by the engine.
+layout(constant_id = 0) const uint BINDLESS_BUFFER_CAPACITY = 1;
+
+struct Particle {
+    vec3 position;
+    float age;
+    vec3 velocity;
+    uint lifetimeAndEmitter; // Lifetime as a half in the low 16 bits, the emitter index in the high ones.
+};
+
+struct Emitter {
+    vec4 position; // w: spread.
+    vec4 velocity; // w: spread.
+    vec4 acceleration; // w: drag.
+    vec4 startColor;
+    vec4 endColor;
+    float minLifetime;
+    float maxLifetime;
+    float size;
+    uint firstEmitted;
+};
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 viewMat;
+    mat4 projMat;
+    uint materialBufferIndex;
+    uint instanceBufferIndex;
+} ubo;
+
+layout(set = 1, binding = 0) readonly buffer ParticleBuffer {
+    Particle particles[];
+} particleBuffers[BINDLESS_BUFFER_CAPACITY];
+
+layout(set = 1, binding = 0) readonly buffer EmitterBuffer {
+    Emitter emitters[];
+} emitterBuffers[BINDLESS_BUFFER_CAPACITY];
+
+layout(push_constant) uniform DrawParams {
+    uint particleBufferIndex;
+    uint emitterBufferIndex;
+} params;
+
+// Two triangles; culling is off, so their winding does not matter.
+const vec2 corners[6] = vec2[](
+        vec2(-1.0f, -1.0f), vec2(-1.0f, 1.0f), vec2(1.0f, 1.0f),
+        vec2(-1.0f, -1.0f), vec2(1.0f, 1.0f), vec2(1.0f, -1.0f));
+
+layout(location = 0) out vec4 colorOut;
+layout(location = 1) out vec2 cornerOut;
+
+// One instance per particle, facing the camera.
+void main() {
+    Particle particle = particleBuffers[params.particleBufferIndex].particles[gl_InstanceIndex];
+    Emitter emitter = emitterBuffers[params.emitterBufferIndex].emitters[particle.lifetimeAndEmitter >> 16];
+
+    vec2 corner = corners[gl_VertexIndex];
+    vec4 viewPosition = ubo.viewMat * vec4(particle.position, 1.0f);
+    viewPosition.xy += corner * emitter.size;
+    gl_Position = ubo.projMat * viewPosition;
+    gl_Position.y = -gl_Position.y; // Flip NDC-coord to matches with view-coord.
+
+    float lifetime = unpackHalf2x16(particle.lifetimeAndEmitter).x;
+    colorOut = mix(emitter.startColor, emitter.endColor, clamp(particle.age / lifetime, 0.0f, 1.0f));
+    cornerOut = corner;
+}
@@ -1,9 +1,163 @@
 #version 450
 
+// Sizes of the bindless tables, specialized by the engine.
+layout(constant_id = 0) const uint BINDLESS_BUFFER_CAPACITY = 1;
+layout(constant_id = 1) const uint BINDLESS_IMAGE_CAPACITY = 1;
+
+const uint MAX_SHADOW_CASCADE_COUNT = 4;
+
+struct Material {
+    vec4 baseColor;
+    uint baseColorTextureIndex;
+};
+
+struct PointLight {
+    vec4 positionRadius;
+    vec4 colorIntensity;
+};
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 viewMat;
+    mat4 projMat;
+    uint materialBufferIndex;
+    uint instanceBufferIndex;
+
+    vec4 lightDirection; // w: ambient term.
+    vec4 shadowSplitDepths;
+    vec4 shadowTexelDepths;
+    mat4 shadowMats[MAX_SHADOW_CASCADE_COUNT];
+    uvec4 shadowMapIndices;
+    uint shadowCascadeCount;
+    uint shadowMapResolution;
+
+    uint lightBufferIndex;
+    uint lightGridBufferIndex;
+    uint lightIndexBufferIndex;
+    uint lightCount;
+    uvec4 lightClusterCounts;
+    vec4 lightClusterParams; // xy: tile size; zw: log depth to slice.
+} ubo;
+
+layout(set = 1, binding = 0) readonly buffer MaterialBuffer {
+    Material materials[];
+} materialBuffers[BINDLESS_BUFFER_CAPACITY];
+
+layout(set = 1, binding = 0) readonly buffer LightBuffer {
+    uint indexCount;
+    uint droppedIndexCount;
+    PointLight lights[];
+} lightBuffers[BINDLESS_BUFFER_CAPACITY];
+
+layout(set = 1, binding = 0) readonly buffer LightGridBuffer {
+    uvec2 ranges[]; // Offset into the index list and count.
+} lightGridBuffers[BINDLESS_BUFFER_CAPACITY];
+
+layout(set = 1, binding = 0) readonly buffer LightIndexBuffer {
+    uint indices[];
+} lightIndexBuffers[BINDLESS_BUFFER_CAPACITY];
+
+layout(set = 1, binding = 1) uniform sampler2D textures[BINDLESS_IMAGE_CAPACITY];
+
+layout(push_constant) uniform PerDrawConstants {
+    mat4 modelMat;
+    uint materialIndex;
+    uint instanceIndex;
+} draw;
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 2) in vec3 fragWorldPos;
 
 layout(location = 0) out vec4 color;
 
+// 1 where lit. Bilinear 2x2 PCF: the four texels around the sample are gathered and compared at once.
+float sampleShadow(uint cascade, float cosTheta) {
+    vec4 shadowPos = ubo.shadowMats[cascade] * vec4(fragWorldPos, 1.0f);
+    vec2 uv = shadowPos.xy * vec2(0.5f, -0.5f) + 0.5f; // The vertex shader flips y.
+    if (any(lessThan(uv, vec2(0.0f))) || any(greaterThan(uv, vec2(1.0f))) || shadowPos.z > 1.0f) {
+        return 1.0f;
+    }
+
+    // Slope scaled, as a texel covers more depth the more the surface turns away from the light.
+    float tanTheta = sqrt(max(1.0f - cosTheta * cosTheta, 0.0f)) / max(cosTheta, 1e-3f);
+    float depth = shadowPos.z - ubo.shadowTexelDepths[cascade] * (1.0f + min(tanTheta, 4.0f));
+
+    float resolution = float(ubo.shadowMapResolution);
+    vec2 texelPos = uv * resolution - 0.5f;
+    vec2 weight = fract(texelPos);
+
+    // Looping over the cascades keeps the index dynamically uniform, as for the material textures.
+    vec4 occluders = vec4(1.0f);
+    for (uint i = 0; i < ubo.shadowCascadeCount; ++i) {
+        if (i == cascade) {
+            occluders = textureGather(textures[ubo.shadowMapIndices[i]], (floor(texelPos) + 1.0f) / resolution);
+        }
+    }
+    // Gathered in the order (0, 1), (1, 1), (1, 0), (0, 0).
+    vec4 lit = step(vec4(depth), occluders);
+    return mix(mix(lit.w, lit.z, weight.x), mix(lit.x, lit.y, weight.x), weight.y);
+}
+
+// Only the lights binned into the fragment's cluster by light_cull.comp, in world space.
+vec3 shadePointLights(vec3 viewPos, vec3 normal) {
+    uvec3 clusterCounts = ubo.lightClusterCounts.xyz;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / ubo.lightClusterParams.xy), clusterCounts.xy - 1);
+    float slice = floor(log(viewPos.z) * ubo.lightClusterParams.z - ubo.lightClusterParams.w);
+    uint z = uint(clamp(slice, 0.0f, float(clusterCounts.z - 1)));
+    uvec2 range = lightGridBuffers[ubo.lightGridBufferIndex].ranges[(z * clusterCounts.y + tile.y) * clusterCounts.x + tile.x];
+
+    vec3 radiance = vec3(0.0f);
+    for (uint i = 0; i < range.y; ++i) {
+        uint lightIndex = lightIndexBuffers[ubo.lightIndexBufferIndex].indices[range.x + i];
+        PointLight light = lightBuffers[ubo.lightBufferIndex].lights[lightIndex];
+
+        vec3 toLight = light.positionRadius.xyz - fragWorldPos;
+        float distanceSquared = dot(toLight, toLight);
+        float radius = light.positionRadius.w;
+        if (distanceSquared >= radius * radius) continue;
+
+        // Inverse square falloff windowed to reach 0 at the radius, where the culling stops.
+        float window = 1.0f - distanceSquared / (radius * radius);
+        float attenuation = window * window / max(distanceSquared, 1e-2f);
+        float cosTheta = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8f))), 0.0f);
+        radiance += light.colorIntensity.rgb * (light.colorIntensity.a * attenuation * cosTheta);
+    }
+    return radiance;
+}
+
 void main() {
-    color = vec4(fragColor, 1.0f);
-}
\ No newline at end of file
+    Material material = materialBuffers[ubo.materialBufferIndex].materials[draw.materialIndex];
+    // The material comes from push constants, so the texture index is dynamically uniform.
+    vec4 texel = texture(textures[material.baseColorTextureIndex], fragUV);
+    color = vec4(fragColor, 1.0f) * material.baseColor * texel;
+
+    // Unlit without shadow cascades and point lights.
+    if (ubo.shadowCascadeCount == 0 && ubo.lightCount == 0) return;
+
+    // Vertices carry no normals, so faces are shaded flat, always facing the camera.
+    vec3 viewPos = (ubo.viewMat * vec4(fragWorldPos, 1.0f)).xyz;
+    vec3 normal = normalize(cross(dFdx(viewPos), dFdy(viewPos)));
+    if (dot(normal, viewPos) > 0.0f) normal = -normal;
+
+    float ambient = ubo.lightDirection.w;
+    vec3 lighting = vec3(ambient);
+
+    if (ubo.shadowCascadeCount > 0) {
+        vec3 toLight = -normalize(mat3(ubo.viewMat) * ubo.lightDirection.xyz);
+        float cosTheta = dot(normal, toLight);
+
+        float shadow = 0.0f;
+        if (cosTheta > 0.0f) {
+            uint cascade = 0;
+            while (cascade + 1 < ubo.shadowCascadeCount && viewPos.z > ubo.shadowSplitDepths[cascade]) ++cascade;
+            shadow = viewPos.z > ubo.shadowSplitDepths[ubo.shadowCascadeCount - 1] ? 1.0f : sampleShadow(cascade, cosTheta);
+        }
+        lighting += (1.0f - ambient) * max(cosTheta, 0.0f) * shadow;
+    }
+
+    if (ubo.lightCount > 0) {
+        // The view matrix is a rotation and a translation, so its transpose takes the normal back.
+        lighting += shadePointLights(viewPos, normal * mat3(ubo.viewMat));
+    }
+    color.rgb *= lighting;
+}
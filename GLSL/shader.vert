@@ -1,19 +1,44 @@
 #version 450
 
+// Sizes of the bindless tables, specialized by the engine.
+layout(constant_id = 0) const uint BINDLESS_BUFFER_CAPACITY = 1;
+
 layout(location = 0) in vec3 posL;
 layout(location = 1) in vec3 colorIn;
+layout(location = 2) in vec2 uvIn;
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 modelMat;
+layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 viewMat;
     mat4 projMat;
+    uint materialBufferIndex;
+    uint instanceBufferIndex;
 } ubo;
 
+// World matrices of scene nodes; entry 0 is the identity.
+layout(set = 1, binding = 0) readonly buffer InstanceBuffer {
+    mat4 worldMats[];
+} instanceBuffers[BINDLESS_BUFFER_CAPACITY];
+
+layout(push_constant) uniform PerDrawConstants {
+    mat4 modelMat;
+    uint materialIndex;
+    uint instanceIndex;
+} draw;
+
+// The depth pre-pass and the color pass must produce bit-identical depth.
+invariant gl_Position;
+
 layout(location = 0) out vec3 colorOut;
+layout(location = 1) out vec2 uvOut;
+layout(location = 2) out vec3 worldPosOut; // For the shadow lookup.
 
 void main() {
-    gl_Position = ubo.projMat * ubo.viewMat * ubo.modelMat * vec4(posL, 1.0f);
+    mat4 worldMat = instanceBuffers[ubo.instanceBufferIndex].worldMats[draw.instanceIndex];
+    vec4 worldPos = worldMat * draw.modelMat * vec4(posL, 1.0f);
+    gl_Position = ubo.projMat * ubo.viewMat * worldPos;
     gl_Position.y = -gl_Position.y; // Flip NDC-coord to matches with view-coord.
 
     colorOut = colorIn;
-}
\ No newline at end of file
+    uvOut = uvIn;
+    worldPosOut = worldPos.xyz;
+}
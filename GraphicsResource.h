@@ -15,10 +15,12 @@
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <cstdint>
 
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 color;
+    glm::vec2 uv;
 
     static VkVertexInputBindingDescription generateBindingDescription() {
         VkVertexInputBindingDescription bindDesc = {};
@@ -30,8 +32,8 @@ struct Vertex {
         return bindDesc;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 2> generateAttributeDescriptions() {
-        std::array<VkVertexInputAttributeDescription, 2> attrDescs = {};
+    static std::array<VkVertexInputAttributeDescription, 3> generateAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> attrDescs = {};
 
         attrDescs[0].binding = 0;
         attrDescs[0].location = 0;
@@ -43,14 +45,134 @@ struct Vertex {
         attrDescs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
         attrDescs[1].offset = offsetof(Vertex, color);
 
+        attrDescs[2].binding = 0;
+        attrDescs[2].location = 2;
+        attrDescs[2].format = VK_FORMAT_R32G32_SFLOAT;
+        attrDescs[2].offset = offsetof(Vertex, uv);
+
         return attrDescs;
     }
 };
 
+// Vertex extended with the joints that move it, for skinned vertex buffers. Read as 32-bit words by
+// skinning.comp, which writes the skinned positions into a buffer of plain Vertex.
+struct SkinnedVertex {
+    glm::vec3 pos; // Bind pose.
+    glm::vec3 color;
+    glm::vec2 uv;
+
+    // Into the joint palette of the skin; weights sum to 1, unused joints have weight 0.
+    uint16_t joints[4];
+    glm::vec4 weights;
+};
+
+static_assert(sizeof(SkinnedVertex) == 14 * sizeof(uint32_t), "SkinnedVertex must be tightly packed.");
+
+// Per-frame data shared by all draws; written once per frame. Shadow passes get a copy of their own,
+// with the view and projection of their cascade.
 struct UniformBufferObject {
-    glm::mat4 modelMat;
+    constexpr static uint32_t MaxShadowCascadeCount = 4;
+
     glm::mat4 viewMat;
     glm::mat4 projMat;
+
+    // Slots in the bindless buffer table.
+    uint32_t materialBufferIndex;
+    uint32_t instanceBufferIndex;
+    uint32_t padding[2];
+
+    // Directional light, only applied with shadow cascades; shading stays unlit without them and point lights.
+    glm::vec4 lightDirection; // xyz: the way the light travels, normalized; w: ambient term.
+
+    glm::vec4 shadowSplitDepths; // Far view depth of every cascade.
+    glm::vec4 shadowTexelDepths; // Depth bias per cascade, a texel's worth of depth at 45 degrees.
+    glm::mat4 shadowMats[MaxShadowCascadeCount]; // Light view projection every cascade was rendered with.
+    glm::uvec4 shadowMapIndices; // Slots in the bindless image table.
+    uint32_t shadowCascadeCount;
+    uint32_t shadowMapResolution;
+    uint32_t padding1[2];
+
+    // Clustered point lights; slots in the bindless buffer table, see ClusteredLighting.
+    uint32_t lightBufferIndex;
+    uint32_t lightGridBufferIndex;
+    uint32_t lightIndexBufferIndex;
+    uint32_t lightCount; // 0 skips the point lights.
+    glm::uvec4 lightClusterCounts; // xyz: clusters across the screen and along the view depth.
+    // xy: tile size in pixels; zw: scale and bias taking the log of view depth to the slice.
+    glm::vec4 lightClusterParams;
+};
+
+// Indexed by PerDrawConstants::materialIndex; std430 layout.
+struct Material {
+    glm::vec4 baseColor;
+
+    // Slot in the bindless image table; multiplied with baseColor.
+    uint32_t baseColorTextureIndex;
+    uint32_t padding[3];
 };
 
+// Per-draw data delivered through push constants; must stay within the guaranteed 128 bytes.
+struct PerDrawConstants {
+    glm::mat4 modelMat;
+    uint32_t materialIndex;
+
+    // Into the instance buffer; the world matrix found there is applied on top of modelMat.
+    uint32_t instanceIndex;
+    uint32_t padding[2];
+};
+
+static_assert(sizeof(PerDrawConstants) <= 128, "Push constants exceed the guaranteed minimum size.");
+
+// Counters at the start of the occlusion culling object buffer, bumped by occlusion_cull.comp.
+struct CullStatistics {
+    uint32_t earlyDrawCount;
+    uint32_t lateDrawCount;
+    uint32_t occludedDrawCount;
+    uint32_t occludedTriangleCount;
+
+    // Meshlets rejected by the frustum or their normal cone, counted in phase 0 only.
+    uint32_t clusterCulledCount;
+    uint32_t clusterCulledTriangleCount;
+
+    uint32_t padding[2]; // The objects that follow are 16-byte aligned.
+};
+
+// Follows CullStatistics in the object buffer, one per recorded draw item; std430 layout.
+struct CullObject {
+    constexpr static uint32_t AlwaysVisible = 1; // No bounds, e.g. not attached to a scene node.
+    constexpr static uint32_t ConeCullable = 2; // Uniformly scaled without mirroring, so normal cones survive modelMat.
+
+    glm::vec4 center;  // World space; w unused.
+    glm::vec4 extents;
+    uint32_t indexCount;
+    uint32_t flags;
+
+    // Without meshlets the draw item is a single command covering all of its indices.
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    uint32_t firstCommand;
+    uint32_t padding[3];
+
+    // Model to world space, for the meshlet bounds.
+    glm::mat4 modelMat;
+};
+
+// Push constants of occlusion_cull.comp.
+struct OcclusionCullParams {
+    glm::mat4 viewProjMat; // What the pyramid is tested with; the frustum always comes from the frame's.
+    glm::vec4 cameraPosition; // World space, for normal cones; w unused.
+    uint32_t depthWidth;
+    uint32_t depthHeight;
+    uint32_t objectBufferIndex;
+    uint32_t commandBufferIndex;
+    uint32_t meshletBufferIndex;
+    uint32_t objectCount;
+    uint32_t commandCount; // Per phase.
+    uint32_t phase; // 0 tests every object, 1 re-tests the ones phase 0 rejected.
+    uint32_t pyramidLevelCount;
+    uint32_t padding[3];
+};
+
+static_assert(sizeof(OcclusionCullParams) <= 128, "Push constants exceed the guaranteed minimum size.");
+
 #endif // GRAPHICS_RESOURCES_H
\ No newline at end of file
@@ -0,0 +1,299 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "HiZPyramid.h"
+
+HiZPyramid::~HiZPyramid() {
+    destroy(); // In case someone forgets destroy the image and sampler.
+}
+
+void HiZPyramid::init(const HiZPyramidStructs::CreateInfo& info) {
+    m_info = info;
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+    // Only texelFetch() reads through it, so filtering never matters.
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(*m_device, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z sampler.");
+    }
+}
+
+bool HiZPyramid::isSupported(VkPhysicalDevice physicalDevice, VkFormat depthFormat) {
+    VkFormatProperties depthProperties = {};
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &depthProperties);
+
+    VkFormatProperties pyramidProperties = {};
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, Format, &pyramidProperties);
+
+    return (depthProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) &&
+           (pyramidProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) &&
+           (pyramidProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
+std::vector<DescriptorAllocator::LayoutBinding> HiZPyramid::buildSetBindings() {
+    return {
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT }
+    };
+}
+
+void HiZPyramid::resize(VkExtent2D depthExtent) {
+    destroyImage();
+
+    m_depthExtent = depthExtent;
+
+    // Halve and round up down to 1x1.
+    m_levelExtents.clear();
+    VkExtent2D extent = { (depthExtent.width + 1) / 2, (depthExtent.height + 1) / 2 };
+    for (;;) {
+        m_levelExtents.push_back({ std::max(extent.width, 1u), std::max(extent.height, 1u) });
+        if (extent.width <= 1 && extent.height <= 1) break;
+        extent = { (extent.width + 1) / 2, (extent.height + 1) / 2 };
+    }
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = Format;
+    imageInfo.extent = { m_levelExtents[0].width, m_levelExtents[0].height, 1 };
+    imageInfo.mipLevels = static_cast<uint32_t>(m_levelExtents.size());
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(*m_device, &imageInfo, nullptr, &m_image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z pyramid image.");
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(*m_device, m_image, &requirements);
+
+    VkMemoryAllocateInfo memoryAllocInfo = {};
+    memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocInfo.allocationSize = requirements.size;
+    memoryAllocInfo.memoryTypeIndex = findAdequateMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (vkAllocateMemory(*m_device, &memoryAllocInfo, nullptr, &m_memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate Hi-Z pyramid memory.");
+    }
+    vkBindImageMemory(*m_device, m_image, m_memory, 0);
+    m_memorySize = requirements.size;
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = Format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = imageInfo.mipLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(*m_device, &viewInfo, nullptr, &m_view) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Hi-Z pyramid image view.");
+    }
+
+    // Storage images are bound one level at a time.
+    m_levelViews.resize(imageInfo.mipLevels, VK_NULL_HANDLE);
+    for (uint32_t level = 0; level < imageInfo.mipLevels; ++level) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+
+        if (vkCreateImageView(*m_device, &viewInfo, nullptr, &m_levelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create Hi-Z pyramid level view.");
+        }
+    }
+
+    clear();
+}
+
+void HiZPyramid::recordBuild(VkCommandBuffer commandBuffer, size_t frameIndex, VkImageView depthView,
+                             VkPipeline pipeline, VkPipelineLayout pipelineLayout, VkDescriptorSetLayout setLayout) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+    for (uint32_t level = 0; level < m_levelExtents.size(); ++level) {
+        bool isFromDepth = level == 0;
+
+        VkDescriptorImageInfo sourceInfo = {};
+        sourceInfo.sampler = m_sampler;
+        sourceInfo.imageView = isFromDepth ? depthView : m_levelViews[level - 1];
+        sourceInfo.imageLayout = isFromDepth ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo targetInfo = {};
+        targetInfo.imageView = m_levelViews[level];
+        targetInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        auto set = m_info.descriptorAllocator->allocate(frameIndex, setLayout);
+
+        VkWriteDescriptorSet descWrites[2] = {};
+        descWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descWrites[0].dstSet = set;
+        descWrites[0].dstBinding = 0;
+        descWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descWrites[0].descriptorCount = 1;
+        descWrites[0].pImageInfo = &sourceInfo;
+
+        descWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descWrites[1].dstSet = set;
+        descWrites[1].dstBinding = 1;
+        descWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descWrites[1].descriptorCount = 1;
+        descWrites[1].pImageInfo = &targetInfo;
+
+        vkUpdateDescriptorSets(*m_device, 2, descWrites, 0, nullptr);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &set, 0, nullptr);
+
+        const auto& sourceExtent = isFromDepth ? m_depthExtent : m_levelExtents[level - 1];
+        const auto& targetExtent = m_levelExtents[level];
+
+        HiZPyramidStructs::BuildParams params = {};
+        params.sourceWidth = sourceExtent.width;
+        params.sourceHeight = sourceExtent.height;
+        params.targetWidth = targetExtent.width;
+        params.targetHeight = targetExtent.height;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+        vkCmdDispatch(commandBuffer, (targetExtent.width + GroupSize - 1) / GroupSize, (targetExtent.height + GroupSize - 1) / GroupSize, 1);
+
+        // The next level reads this one.
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
+
+void HiZPyramid::destroy() {
+    if (m_device == nullptr) return;
+
+    destroyImage();
+
+    // Destroy: init()
+    if (m_sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(*m_device, m_sampler, nullptr);
+        m_sampler = VK_NULL_HANDLE;
+    }
+}
+
+void HiZPyramid::destroyImage() {
+    for (auto& view : m_levelViews) {
+        vkDestroyImageView(*m_device, view, nullptr);
+    }
+    m_levelViews.clear();
+
+    if (m_view != VK_NULL_HANDLE) vkDestroyImageView(*m_device, m_view, nullptr);
+    if (m_image != VK_NULL_HANDLE) vkDestroyImage(*m_device, m_image, nullptr);
+    if (m_memory != VK_NULL_HANDLE) vkFreeMemory(*m_device, m_memory, nullptr);
+
+    m_view = VK_NULL_HANDLE;
+    m_image = VK_NULL_HANDLE;
+    m_memory = VK_NULL_HANDLE;
+    m_memorySize = 0;
+}
+
+void HiZPyramid::clear() {
+    VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+    cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufferAllocInfo.commandPool = m_info.commandPool;
+    cmdBufferAllocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmdBuffer = {};
+    vkAllocateCommandBuffers(*m_device, &cmdBufferAllocInfo, &cmdBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkClearColorValue farPlane = {};
+    farPlane.float32[0] = 1.0f;
+    vkCmdClearColorImage(cmdBuffer, m_image, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &barrier.subresourceRange);
+
+    // Culling reads it first, in the next frame.
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuffer;
+
+    vkQueueSubmit(m_info.queue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(m_info.queue);
+
+    vkFreeCommandBuffers(*m_device, m_info.commandPool, 1, &cmdBuffer);
+}
+
+uint32_t HiZPyramid::findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find an adequate memory type.");
+}
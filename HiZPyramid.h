@@ -0,0 +1,121 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef HI_Z_PYRAMID_H
+#define HI_Z_PYRAMID_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "DescriptorAllocator.h"
+
+namespace HiZPyramidStructs {
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // Used for the one-shot clear of a newly created pyramid.
+        VkQueue queue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+
+        // Per-level descriptor sets of recordBuild() come from the frame's transient pools.
+        DescriptorAllocator* descriptorAllocator = nullptr;
+    };
+
+    // Push constants of hiz_build.comp.
+    struct BuildParams {
+        uint32_t sourceWidth;
+        uint32_t sourceHeight;
+        uint32_t targetWidth;
+        uint32_t targetHeight;
+    };
+}
+
+// A conservative depth pyramid for occlusion culling. Level 0 has half the resolution of the depth
+// it is built from, and every texel keeps the farthest depth of the 2x2 texels below it. Sizes are
+// rounded up, so texel j of level L covers exactly the depth pixels [j, j + 1) * 2^(L + 1) and a box
+// whose nearest depth lies behind every texel under its screen rectangle is hidden.
+class HiZPyramid {
+public:
+    constexpr static VkFormat Format = VK_FORMAT_R32_SFLOAT;
+
+    // Must match local_size_x and local_size_y of hiz_build.comp.
+    constexpr static uint32_t GroupSize = 8;
+
+public:
+    HiZPyramid() = default;
+    ~HiZPyramid();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const HiZPyramidStructs::CreateInfo& info);
+
+    // Whether the device can build a pyramid from depth of the given format.
+    static bool isSupported(VkPhysicalDevice physicalDevice, VkFormat depthFormat);
+
+    // Set 0 of hiz_build.comp: the level below (or the depth) and the level written.
+    static std::vector<DescriptorAllocator::LayoutBinding> buildSetBindings();
+
+    // Recreate the pyramid for depth of the given extent. Every texel starts at the far plane,
+    // so nothing is hidden until the first recordBuild(). Nothing may be in flight.
+    void resize(VkExtent2D depthExtent);
+
+    // One dispatch per level with a barrier in between. The depth is expected in
+    // SHADER_READ_ONLY_OPTIMAL and the pyramid in GENERAL, where it is left.
+    void recordBuild(VkCommandBuffer commandBuffer, size_t frameIndex, VkImageView depthView,
+                     VkPipeline pipeline, VkPipelineLayout pipelineLayout, VkDescriptorSetLayout setLayout);
+
+    inline VkImage image() const { return m_image; }
+
+    // All levels, for texelFetch() with an explicit level.
+    inline VkImageView view() const { return m_view; }
+
+    // Nearest and clamped; only ever used with texelFetch().
+    inline VkSampler sampler() const { return m_sampler; }
+
+    inline VkExtent2D depthExtent() const { return m_depthExtent; }
+
+    inline uint32_t levelCount() const { return static_cast<uint32_t>(m_levelViews.size()); }
+
+    inline VkDeviceSize memorySize() const { return m_memorySize; }
+
+    void destroy();
+
+private:
+    void destroyImage();
+
+    // Transition to GENERAL and fill with 1.0, the far plane.
+    void clear();
+
+    uint32_t findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+    VkDevice* m_device = nullptr;
+
+    HiZPyramidStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    VkSampler m_sampler = VK_NULL_HANDLE;
+
+    VkExtent2D m_depthExtent = {};
+
+    std::vector<VkExtent2D> m_levelExtents = {};
+
+    VkImage m_image = VK_NULL_HANDLE;
+    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    VkDeviceSize m_memorySize = 0;
+
+    VkImageView m_view = VK_NULL_HANDLE;
+    std::vector<VkImageView> m_levelViews = {};
+};
+
+#endif // HI_Z_PYRAMID_H
@@ -0,0 +1,156 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "ImageMemoryPool.h"
+
+ImageMemoryPool::~ImageMemoryPool() {
+    destroy(); // In case someone forgets destroy allocated blocks.
+}
+
+ImageMemoryPool::Allocation ImageMemoryPool::allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex) {
+    Allocation allocation = {};
+    allocation.size = requirements.size;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+
+    for (uint32_t i = 0; i < m_blocks.size(); ++i) {
+        auto& block = m_blocks[i];
+        if (block.memory == VK_NULL_HANDLE || block.memoryTypeIndex != memoryTypeIndex) continue;
+
+        if (tryAllocateFromBlock(block, requirements, allocation.offset)) {
+            allocation.memory = block.memory;
+            allocation.blockIndex = i;
+            m_usedSize += allocation.size;
+            return allocation;
+        }
+    }
+
+    // Oversized images get a block of their own instead of failing.
+    auto blockIndex = createBlock(std::max(m_blockSize, requirements.size), memoryTypeIndex);
+    auto& block = m_blocks[blockIndex];
+    if (!tryAllocateFromBlock(block, requirements, allocation.offset)) {
+        throw std::runtime_error("Failed to sub-allocate image memory.");
+    }
+
+    allocation.memory = block.memory;
+    allocation.blockIndex = blockIndex;
+    m_usedSize += allocation.size;
+    return allocation;
+}
+
+void ImageMemoryPool::free(const Allocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) return;
+
+    auto& block = m_blocks[allocation.blockIndex];
+    auto& ranges = block.freeRanges;
+
+    auto itor = std::lower_bound(ranges.begin(), ranges.end(), allocation.offset, [](const Range& range, VkDeviceSize offset) {
+        return range.offset < offset;
+    });
+    itor = ranges.insert(itor, { allocation.offset, allocation.size });
+
+    // Merge with the following range, then with the preceding one.
+    auto next = itor + 1;
+    if (next != ranges.end() && itor->offset + itor->size == next->offset) {
+        itor->size += next->size;
+        ranges.erase(next);
+    }
+    if (itor != ranges.begin()) {
+        auto prev = itor - 1;
+        if (prev->offset + prev->size == itor->offset) {
+            prev->size += itor->size;
+            ranges.erase(itor);
+        }
+    }
+
+    m_usedSize -= allocation.size;
+
+    // Give completely empty blocks back to the device.
+    if (ranges.size() == 1 && ranges[0].size == block.size) {
+        vkFreeMemory(*m_device, block.memory, nullptr);
+        m_reservedSize -= block.size;
+        block = {};
+    }
+}
+
+size_t ImageMemoryPool::blockCount() const {
+    return std::count_if(m_blocks.begin(), m_blocks.end(), [](const Block& block) {
+        return block.memory != VK_NULL_HANDLE;
+    });
+}
+
+void ImageMemoryPool::destroy() {
+    for (auto& block : m_blocks) {
+        if (block.memory != VK_NULL_HANDLE) {
+            vkFreeMemory(*m_device, block.memory, nullptr);
+        }
+    }
+    m_blocks.clear();
+
+    m_usedSize = 0;
+    m_reservedSize = 0;
+}
+
+bool ImageMemoryPool::tryAllocateFromBlock(Block& block, const VkMemoryRequirements& requirements, VkDeviceSize& offset) {
+    auto& ranges = block.freeRanges;
+
+    // First fit; image allocations are few and long-lived, so fragmentation stays low.
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        auto range = ranges[i];
+        auto alignedOffset = (range.offset + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+        auto padding = alignedOffset - range.offset;
+        if (padding + requirements.size > range.size) continue;
+
+        offset = alignedOffset;
+
+        auto tailOffset = alignedOffset + requirements.size;
+        auto tailSize = range.offset + range.size - tailOffset;
+
+        ranges.erase(ranges.begin() + i);
+        if (tailSize > 0) {
+            ranges.insert(ranges.begin() + i, { tailOffset, tailSize });
+        }
+        if (padding > 0) {
+            ranges.insert(ranges.begin() + i, { range.offset, padding });
+        }
+        return true;
+    }
+    return false;
+}
+
+uint32_t ImageMemoryPool::createBlock(VkDeviceSize size, uint32_t memoryTypeIndex) {
+    VkMemoryAllocateInfo memoryAllocInfo = {};
+    memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocInfo.allocationSize = size;
+    memoryAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    Block block = {};
+    block.size = size;
+    block.memoryTypeIndex = memoryTypeIndex;
+    block.freeRanges.push_back({ 0, size });
+
+    if (vkAllocateMemory(*m_device, &memoryAllocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate image memory block.");
+    }
+    m_reservedSize += size;
+
+    // Reuse the slot of a released block first.
+    for (uint32_t i = 0; i < m_blocks.size(); ++i) {
+        if (m_blocks[i].memory == VK_NULL_HANDLE) {
+            m_blocks[i] = block;
+            return i;
+        }
+    }
+    m_blocks.push_back(block);
+    return static_cast<uint32_t>(m_blocks.size() - 1);
+}
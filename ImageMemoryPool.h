@@ -0,0 +1,91 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef IMAGE_MEMORY_POOL_H
+#define IMAGE_MEMORY_POOL_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace ImageMemoryPoolStructs {
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+
+        // Where the range came from; used to give it back.
+        uint32_t memoryTypeIndex = 0;
+        uint32_t blockIndex = 0;
+    };
+}
+
+// Sub-allocates optimal-tiling images from a few large device memory blocks per memory type,
+// which keeps the number of vkAllocateMemory calls far below maxMemoryAllocationCount.
+// Only images with optimal tiling may share a pool, so bufferImageGranularity never applies.
+class ImageMemoryPool {
+public:
+    using Allocation = ImageMemoryPoolStructs::Allocation;
+
+    constexpr static VkDeviceSize DefaultBlockSize = 64ull * 1024 * 1024;
+
+public:
+    ImageMemoryPool() = default;
+    ~ImageMemoryPool();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    inline void setBlockSize(VkDeviceSize size) { m_blockSize = size; }
+
+    Allocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex);
+
+    void free(const Allocation& allocation);
+
+    // Bytes handed out to images, and bytes reserved from the device.
+    inline VkDeviceSize usedSize() const { return m_usedSize; }
+    inline VkDeviceSize reservedSize() const { return m_reservedSize; }
+
+    size_t blockCount() const;
+
+    void destroy();
+
+private:
+    struct Range {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+    };
+
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeIndex = 0;
+
+        // Sorted by offset and never adjacent, since neighbours are merged on free.
+        std::vector<Range> freeRanges = {};
+    };
+
+    bool tryAllocateFromBlock(Block& block, const VkMemoryRequirements& requirements, VkDeviceSize& offset);
+
+    uint32_t createBlock(VkDeviceSize size, uint32_t memoryTypeIndex);
+
+private:
+    VkDevice* m_device = nullptr;
+
+    VkDeviceSize m_blockSize = DefaultBlockSize;
+
+    // Released blocks leave an empty entry behind so that block indices stay stable.
+    std::vector<Block> m_blocks = {};
+
+    VkDeviceSize m_usedSize = 0;
+    VkDeviceSize m_reservedSize = 0;
+};
+
+#endif // IMAGE_MEMORY_POOL_H
@@ -20,7 +20,10 @@ int main(int argc, char** argv) {
         QApplication a(argc, argv);
         DisplayWindow w;
         w.declareRenderResourceData();
-        w.initVulkanEngine();
+
+        VulkanEngineStructs::CreateInfo info = {};
+        info.enableRenderThread = true;
+        w.initVulkanEngine(info);
         w.show();
         return a.exec();
     }
@@ -0,0 +1,170 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "MeshletBuilder.h"
+
+// Cones whose normals reach further than this from the axis are so wide that they
+// would only reject the meshlet from a sliver of directions.
+constexpr static float MIN_CONE_SPREAD = 0.1f;
+
+std::vector<MeshletBuilder::Meshlet> MeshletBuilder::build(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices,
+                                                            const BuildParams& params) {
+    auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    auto vertexCount = static_cast<uint32_t>(positions.size());
+
+    // Triangles around each vertex, packed in one array.
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0);
+    for (uint32_t i = 0; i < 3 * triangleCount; ++i) {
+        ++triangleOffsets[indices[i] + 1];
+    }
+    for (uint32_t v = 0; v < vertexCount; ++v) {
+        triangleOffsets[v + 1] += triangleOffsets[v];
+    }
+    std::vector<uint32_t> vertexTriangles(3 * triangleCount);
+    std::vector<uint32_t> cursors(triangleOffsets.begin(), triangleOffsets.end() - 1);
+    for (uint32_t i = 0; i < 3 * triangleCount; ++i) {
+        vertexTriangles[cursors[indices[i]]++] = i / 3;
+    }
+
+    std::vector<bool> isEmitted(triangleCount, false);
+
+    // The meshlet that last referenced each vertex, so membership is a single compare.
+    std::vector<uint32_t> vertexOwners(vertexCount, UINT32_MAX);
+
+    std::vector<uint32_t> reordered = {};
+    reordered.reserve(indices.size());
+
+    std::vector<Meshlet> meshlets = {};
+    std::vector<uint32_t> candidates = {};
+    uint32_t nextSeed = 0;
+
+    while (true) {
+        // Seeds follow index order, which tends to follow the surface already.
+        while (nextSeed < triangleCount && isEmitted[nextSeed]) ++nextSeed;
+        if (nextSeed == triangleCount) break;
+
+        auto meshletIndex = static_cast<uint32_t>(meshlets.size());
+        Meshlet meshlet = {};
+        meshlet.firstIndex = static_cast<uint32_t>(reordered.size());
+
+        uint32_t meshletTriangleCount = 0;
+        candidates.clear();
+
+        auto triangle = nextSeed;
+        while (triangle != UINT32_MAX) {
+            isEmitted[triangle] = true;
+            for (uint32_t k = 0; k < 3; ++k) {
+                auto v = indices[3 * triangle + k];
+                reordered.push_back(v);
+                if (vertexOwners[v] == meshletIndex) continue;
+
+                vertexOwners[v] = meshletIndex;
+                ++meshlet.vertexCount;
+                for (auto t = triangleOffsets[v]; t < triangleOffsets[v + 1]; ++t) {
+                    if (!isEmitted[vertexTriangles[t]]) candidates.push_back(vertexTriangles[t]);
+                }
+            }
+            if (++meshletTriangleCount == params.maxTriangleCount) break;
+
+            // The neighbor adding the fewest vertices; ties go to the one found first, near the seed.
+            triangle = UINT32_MAX;
+            uint32_t bestNewVertexCount = UINT32_MAX;
+            size_t keptCount = 0;
+            for (auto candidate : candidates) {
+                if (isEmitted[candidate]) continue;
+                candidates[keptCount++] = candidate;
+
+                uint32_t newVertexCount = 0;
+                for (uint32_t k = 0; k < 3; ++k) {
+                    if (vertexOwners[indices[3 * candidate + k]] != meshletIndex) ++newVertexCount;
+                }
+                if (meshlet.vertexCount + newVertexCount > params.maxVertexCount) continue;
+                if (newVertexCount < bestNewVertexCount) {
+                    bestNewVertexCount = newVertexCount;
+                    triangle = candidate;
+                }
+            }
+            candidates.resize(keptCount);
+        }
+
+        meshlet.indexCount = 3 * meshletTriangleCount;
+        meshlets.push_back(meshlet);
+    }
+
+    reordered.insert(reordered.end(), indices.begin() + 3 * triangleCount, indices.end());
+    indices.swap(reordered);
+
+    for (auto& meshlet : meshlets) {
+        computeBounds(positions, indices, meshlet);
+    }
+    return meshlets;
+}
+
+bool MeshletBuilder::isBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition) {
+    if (meshlet.cone.w >= 1.0f) return false;
+
+    auto toCenter = glm::vec3(meshlet.sphere) - cameraPosition;
+    return glm::dot(toCenter, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(toCenter) + meshlet.sphere.w;
+}
+
+void MeshletBuilder::computeBounds(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, Meshlet& meshlet) {
+    auto first = indices.begin() + meshlet.firstIndex;
+    auto last = first + meshlet.indexCount;
+
+    // The center of the box is not the smallest sphere, but close and stable.
+    glm::vec3 minPosition = glm::vec3(FLT_MAX), maxPosition = glm::vec3(-FLT_MAX);
+    for (auto it = first; it != last; ++it) {
+        minPosition = glm::min(minPosition, positions[*it]);
+        maxPosition = glm::max(maxPosition, positions[*it]);
+    }
+    auto center = 0.5f * (minPosition + maxPosition);
+
+    float radius = 0.0f;
+    for (auto it = first; it != last; ++it) {
+        radius = std::max(radius, glm::length(positions[*it] - center));
+    }
+    meshlet.sphere = glm::vec4(center, radius);
+
+    // Front faces are clockwise on screen, which with the engine's left-handed view space
+    // makes cross(b - a, c - a) point towards the viewer.
+    auto faceNormal = [&](uint32_t i, glm::vec3& normal) {
+        const auto& a = positions[indices[i]];
+        normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+        float length = glm::length(normal);
+        if (length == 0.0f) return false;
+        normal /= length;
+        return true;
+    };
+
+    glm::vec3 normal = {};
+    glm::vec3 axis = glm::vec3(0.0f);
+    for (auto i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+        if (faceNormal(i, normal)) axis += normal;
+    }
+
+    meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    float axisLength = glm::length(axis);
+    if (axisLength < 1.0e-6f) return;
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (auto i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+        if (faceNormal(i, normal)) minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+    if (minDot <= MIN_CONE_SPREAD) return;
+
+    // The normals are within acos(minDot) of the axis, so they all face away when the view direction
+    // is within 90 degrees minus that, i.e. its cosine with the axis is above sin(acos(minDot)).
+    meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+}
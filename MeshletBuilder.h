@@ -0,0 +1,65 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace MeshletStructs {
+    // A cluster of adjacent triangles, drawn as a range of the reordered index buffer.
+    // std430 layout; uploaded as is and read by occlusion_cull.comp.
+    struct Meshlet {
+        glm::vec4 sphere; // Model space center and radius.
+
+        // Normal cone: axis and cutoff. Seen from p, every triangle faces away when
+        // dot(c - p, axis) >= cutoff * length(c - p) + radius for the sphere center c.
+        // A cutoff of 1 means the normals spread too far to ever pass.
+        glm::vec4 cone;
+
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t vertexCount; // Unique vertices referenced.
+        uint32_t padding;
+    };
+
+    struct BuildParams {
+        // The limits mesh shaders are commonly tuned for, so the clusters stay usable by them.
+        uint32_t maxVertexCount = 64;
+        uint32_t maxTriangleCount = 124;
+    };
+}
+
+// Splits an indexed triangle list into meshlets at load time. Each meshlet grows from a seed
+// triangle by adding the adjacent triangle that brings the fewest new vertices, which keeps it
+// compact, so its bounds are tight and its normals close enough for the cone to reject it
+// when seen from behind.
+class MeshletBuilder {
+public:
+    using Meshlet = MeshletStructs::Meshlet;
+    using BuildParams = MeshletStructs::BuildParams;
+
+public:
+    // Reorder indices so that every meshlet is a contiguous range; the set of triangles is unchanged.
+    // Trailing indices that do not form a triangle are kept at the end.
+    static std::vector<Meshlet> build(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices,
+                                      const BuildParams& params = {});
+
+    // Scalar reference of the cone test in occlusion_cull.comp; cameraPosition in model space.
+    static bool isBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+
+private:
+    static void computeBounds(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, Meshlet& meshlet);
+};
+
+#endif // MESHLET_BUILDER_H
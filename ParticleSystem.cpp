@@ -0,0 +1,292 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#include "ParticleSystem.h"
+
+ParticleSystem::~ParticleSystem() {
+    destroy(); // In case someone forgets destroy the buffers.
+}
+
+void ParticleSystem::init(const ParticleStructs::CreateInfo& info, const std::vector<Emitter>& emitters) {
+    m_info = info;
+    m_info.capacity = std::max(m_info.capacity, 1u);
+
+    if (emitters.size() > MaxEmitterCount) {
+        throw std::runtime_error("Failed to init particle system: too many emitters.");
+    }
+    m_emitters = emitters;
+    m_emissionRemainders.assign(m_emitters.size(), 0.0f);
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+    // Only ever touched by shaders and indirect commands.
+    for (auto& resource : m_particleResources) {
+        createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(ParticleStructs::Particle) * m_info.capacity,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, resource);
+    }
+    createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 sizeof(ParticleStructs::State), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_stateResource);
+
+    // Never empty, so there is always a buffer to bind.
+    size_t emitterCapacity = std::max(m_emitters.size(), static_cast<size_t>(1));
+
+    m_emitterResources.resize(m_info.frameCount);
+    m_emitterMappedData.resize(m_info.frameCount, nullptr);
+    m_readbackResources.resize(m_info.frameCount);
+    m_readbackMappedData.resize(m_info.frameCount, nullptr);
+    m_params.resize(m_info.frameCount);
+    for (size_t i = 0; i < m_info.frameCount; ++i) {
+        createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(ParticleStructs::GpuEmitter) * emitterCapacity,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_emitterResources[i]);
+        vkMapMemory(*m_device, m_emitterResources[i].memory, 0, VK_WHOLE_SIZE, 0, &m_emitterMappedData[i]);
+
+        createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t),
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_readbackResources[i]);
+        vkMapMemory(*m_device, m_readbackResources[i].memory, 0, VK_WHOLE_SIZE, 0, &m_readbackMappedData[i]);
+        *static_cast<uint32_t*>(m_readbackMappedData[i]) = 0;
+    }
+
+    auto& bindless = *m_info.bindlessDescriptors;
+    for (auto& resource : m_particleResources) {
+        resource.slot = bindless.registerBuffer(resource.buffer);
+    }
+    m_stateResource.slot = bindless.registerBuffer(m_stateResource.buffer);
+    for (auto& resource : m_emitterResources) {
+        resource.slot = bindless.registerBuffer(resource.buffer);
+    }
+
+    // Written by the simulation, then read by the billboards and their indirect draw.
+    AsyncComputeStructs::SharedBuffer sharedBuffer = {};
+    sharedBuffer.computeStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT;
+    sharedBuffer.computeAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT |
+                                 VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    sharedBuffer.graphicsStages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    sharedBuffer.graphicsAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    for (const auto& resource : { m_particleResources[0], m_particleResources[1], m_stateResource }) {
+        sharedBuffer.buffer = resource.buffer;
+        m_info.asyncCompute->addSharedBuffer(sharedBuffer);
+    }
+}
+
+void ParticleSystem::update(size_t frameIndex, float deltaTime) {
+    // The frame's fence has been waited, so the copy of its previous submission has landed.
+    m_aliveCount = *static_cast<const uint32_t*>(m_readbackMappedData[frameIndex]);
+
+    // Written as a whole, since the mapping may be write-combined.
+    auto* gpuEmitters = static_cast<ParticleStructs::GpuEmitter*>(m_emitterMappedData[frameIndex]);
+    uint32_t emittedCount = 0;
+    for (size_t i = 0; i < m_emitters.size(); ++i) {
+        const auto& emitter = m_emitters[i];
+
+        float exactCount = std::max(emitter.rate, 0.0f) * deltaTime + m_emissionRemainders[i];
+        auto count = static_cast<uint32_t>(std::min(exactCount, static_cast<float>(m_info.capacity)));
+        m_emissionRemainders[i] = std::min(exactCount - static_cast<float>(count), 1.0f);
+
+        ParticleStructs::GpuEmitter gpuEmitter = {};
+        gpuEmitter.position = glm::vec4(emitter.position, emitter.positionSpread);
+        gpuEmitter.velocity = glm::vec4(emitter.velocity, emitter.velocitySpread);
+        gpuEmitter.acceleration = glm::vec4(emitter.acceleration, emitter.drag);
+        gpuEmitter.startColor = emitter.startColor;
+        gpuEmitter.endColor = emitter.endColor;
+        gpuEmitter.minLifetime = emitter.minLifetime;
+        gpuEmitter.maxLifetime = std::max(emitter.maxLifetime, emitter.minLifetime);
+        gpuEmitter.size = emitter.size;
+        gpuEmitter.firstEmitted = emittedCount;
+        memcpy(&gpuEmitters[i], &gpuEmitter, sizeof(gpuEmitter));
+
+        // Whatever does not fit is dropped on the GPU anyway.
+        emittedCount = std::min(emittedCount + count, m_info.capacity);
+    }
+
+    auto& params = m_params[frameIndex];
+    params.deltaTime = deltaTime;
+    params.stateBufferIndex = m_stateResource.slot;
+    params.emitterBufferIndex = m_emitterResources[frameIndex].slot;
+    params.emitterCount = static_cast<uint32_t>(m_emitters.size());
+    params.emittedCount = emittedCount;
+    params.capacity = m_info.capacity;
+    params.seed = m_frameSerial++;
+}
+
+void ParticleSystem::recordSimulation(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipeline emitPipeline,
+                                      VkPipeline simulatePipeline, VkPipeline compactPipeline, VkPipelineLayout pipelineLayout) {
+    // On whatever queue the simulation runs on, so it owns the state from the start.
+    if (!m_isStateInitialized) {
+        ParticleStructs::State state = {};
+        for (auto& draw : state.draws) {
+            draw.vertexCount = VertexCount;
+        }
+        vkCmdUpdateBuffer(commandBuffer, m_stateResource.buffer, 0, sizeof(state), &state);
+        m_isStateInitialized = true;
+    }
+
+    auto& params = m_params[frameIndex];
+    params.sourceList = m_currList;
+    params.sourceBufferIndex = m_particleResources[m_currList].slot;
+    params.targetBufferIndex = m_particleResources[1 - m_currList].slot;
+
+    // Against the previous simulation, or the initial state.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+    // Also writes the dispatch of the other two passes; one group at least, so it always does.
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, emitPipeline);
+    vkCmdDispatch(commandBuffer, std::max((params.emittedCount + GroupSize - 1) / GroupSize, 1u), 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulatePipeline);
+    vkCmdDispatchIndirect(commandBuffer, m_stateResource.buffer, offsetof(ParticleStructs::State, dispatch));
+
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compactPipeline);
+    vkCmdDispatchIndirect(commandBuffer, m_stateResource.buffer, offsetof(ParticleStructs::State, dispatch));
+
+    m_currList = 1 - m_currList;
+
+    // The survivor count, for aliveCount() once the frame's fence is signaled.
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy region = {};
+    region.srcOffset = offsetof(ParticleStructs::State, draws) + sizeof(VkDrawIndirectCommand) * m_currList +
+                       offsetof(VkDrawIndirectCommand, instanceCount);
+    region.dstOffset = 0;
+    region.size = sizeof(uint32_t);
+    vkCmdCopyBuffer(commandBuffer, m_stateResource.buffer, m_readbackResources[frameIndex].buffer, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipelineLayout pipelineLayout) {
+    ParticleStructs::DrawParams params = {};
+    params.particleBufferIndex = m_particleResources[m_currList].slot;
+    params.emitterBufferIndex = m_emitterResources[frameIndex].slot;
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                       0, sizeof(params), &params);
+
+    vkCmdDrawIndirect(commandBuffer, m_stateResource.buffer,
+                      offsetof(ParticleStructs::State, draws) + sizeof(VkDrawIndirectCommand) * m_currList,
+                      1, sizeof(VkDrawIndirectCommand));
+}
+
+VkDeviceSize ParticleSystem::memorySize() const {
+    VkDeviceSize size = m_stateResource.size;
+    for (const auto& resource : m_particleResources) size += resource.size;
+    for (const auto& resource : m_emitterResources) size += resource.size;
+    for (const auto& resource : m_readbackResources) size += resource.size;
+    return size;
+}
+
+size_t ParticleSystem::allocationCount() const {
+    return isInited() ? 3 + m_emitterResources.size() + m_readbackResources.size() : 0;
+}
+
+void ParticleSystem::destroy() {
+    // The bindless table and async compute may be gone by the time the destructor runs.
+    if (m_device == nullptr || !isInited()) return;
+
+    for (auto& resource : m_particleResources) {
+        m_info.asyncCompute->removeSharedBuffer(resource.buffer);
+        destroyBuffer(resource);
+    }
+    m_info.asyncCompute->removeSharedBuffer(m_stateResource.buffer);
+    destroyBuffer(m_stateResource);
+
+    for (auto& resource : m_emitterResources) {
+        destroyBuffer(resource);
+    }
+    m_emitterResources.clear();
+    m_emitterMappedData.clear();
+
+    for (auto& resource : m_readbackResources) {
+        destroyBuffer(resource);
+    }
+    m_readbackResources.clear();
+    m_readbackMappedData.clear();
+
+    m_isStateInitialized = false;
+    m_currList = 0;
+    m_aliveCount = 0;
+}
+
+void ParticleSystem::createBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags properties, BufferResource& resource) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(*m_device, &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create particle buffer.");
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetBufferMemoryRequirements(*m_device, resource.buffer, &requirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = findAdequateMemoryType(requirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(*m_device, &allocInfo, nullptr, &resource.memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate particle buffer memory.");
+    }
+    vkBindBufferMemory(*m_device, resource.buffer, resource.memory, 0);
+
+    resource.size = requirements.size;
+}
+
+void ParticleSystem::destroyBuffer(BufferResource& resource) {
+    if (resource.buffer == VK_NULL_HANDLE) return;
+
+    if (resource.slot != BindlessDescriptors::InvalidSlot) {
+        m_info.bindlessDescriptors->unregisterBuffer(resource.slot);
+    }
+    // Freeing the memory unmaps it as well.
+    vkDestroyBuffer(*m_device, resource.buffer, nullptr);
+    vkFreeMemory(*m_device, resource.memory, nullptr);
+
+    resource = {};
+}
+
+uint32_t ParticleSystem::findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find an adequate memory type.");
+}
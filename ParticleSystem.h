@@ -0,0 +1,221 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "AsyncCompute.h"
+#include "BindlessDescriptors.h"
+
+namespace ParticleStructs {
+    struct Emitter {
+        glm::vec3 position = glm::vec3(0.0f);
+        float positionSpread = 0.0f; // Radius of the ball particles are born in.
+
+        glm::vec3 velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+        float velocitySpread = 0.5f; // Radius of the ball random offsets of the velocity are picked from.
+
+        // Applied to live particles as well, so changing them affects particles already emitted.
+        glm::vec3 acceleration = glm::vec3(0.0f, -1.0f, 0.0f);
+        float drag = 0.0f; // Fraction of the velocity lost per second.
+
+        // Interpolated over the lifetime; alpha blends the particle over the scene.
+        glm::vec4 startColor = glm::vec4(1.0f);
+        glm::vec4 endColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+
+        float minLifetime = 1.0f; // Seconds.
+        float maxLifetime = 2.0f;
+
+        float size = 0.02f; // Half extent of the billboard in world units.
+
+        float rate = 1000.0f; // Particles per second; 0 pauses emission.
+    };
+
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // The particle buffers are registered there, so shaders reach them by slot.
+        BindlessDescriptors* bindlessDescriptors = nullptr;
+
+        // Survivors of the frame are released to graphics through it; see AsyncCompute.
+        AsyncCompute* asyncCompute = nullptr;
+
+        // Emission stops while the pool is full.
+        uint32_t capacity = 1 << 20;
+
+        size_t frameCount = 1;
+    };
+
+    // std430 layout; read by all particle shaders.
+    struct Particle {
+        glm::vec3 position;
+        float age; // Seconds.
+        glm::vec3 velocity;
+        uint32_t lifetimeAndEmitter; // Lifetime as a half in the low 16 bits, the emitter index in the high ones.
+    };
+
+    // std430 layout; one per emitter in the frame's emitter buffer.
+    struct GpuEmitter {
+        glm::vec4 position; // w: positionSpread.
+        glm::vec4 velocity; // w: velocitySpread.
+        glm::vec4 acceleration; // w: drag.
+        glm::vec4 startColor;
+        glm::vec4 endColor;
+        float minLifetime;
+        float maxLifetime;
+        float size;
+        uint32_t firstEmitted; // Among the particles emitted this frame by all emitters.
+    };
+
+    // At the start of the state buffer, written only by the GPU. Each particle buffer has an indirect draw,
+    // whose instance count is the number of particles in it; the dispatch covers this frame's particles.
+    struct State {
+        VkDrawIndirectCommand draws[2];
+        VkDispatchIndirectCommand dispatch;
+        uint32_t simulatedCount; // Survivors of last frame plus the particles emitted this frame.
+    };
+
+    // Push constants of particle_emit.comp, particle_simulate.comp and particle_compact.comp.
+    struct SimulationParams {
+        float deltaTime;
+        uint32_t sourceBufferIndex; // Bindless slots.
+        uint32_t targetBufferIndex;
+        uint32_t stateBufferIndex;
+        uint32_t emitterBufferIndex;
+        uint32_t emitterCount;
+        uint32_t emittedCount; // By all emitters this frame, before clamping to what is free.
+        uint32_t capacity;
+        uint32_t sourceList; // Which draw of the state holds the particle count of the source buffer.
+        uint32_t seed;
+        uint32_t padding[2];
+    };
+
+    // Push constants of particle.vert.
+    struct DrawParams {
+        uint32_t particleBufferIndex;
+        uint32_t emitterBufferIndex;
+        uint32_t padding[2];
+    };
+}
+
+// Particles live entirely on the GPU. Every frame an emit pass appends the particles the emitters
+// spawn behind the survivors of the last frame, a simulate pass integrates them all, and a compact
+// pass moves the living ones into the other of two particle buffers, counting them into the instance
+// count of an indirect draw of billboards. The CPU only writes the emitters and the number of
+// particles each of them spawns, so its cost does not depend on how many particles there are.
+class ParticleSystem {
+public:
+    using Emitter = ParticleStructs::Emitter;
+
+    // Must match local_size_x of the particle compute shaders.
+    constexpr static uint32_t GroupSize = 64;
+
+    // Vertices of a billboard, two triangles generated in particle.vert.
+    constexpr static uint32_t VertexCount = 6;
+
+    // Emitter indices are kept in 16 bits of every particle.
+    constexpr static uint32_t MaxEmitterCount = 1 << 16;
+
+public:
+    ParticleSystem() = default;
+    ~ParticleSystem();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    // The number of emitters is fixed from then on.
+    void init(const ParticleStructs::CreateInfo& info, const std::vector<Emitter>& emitters);
+
+    inline bool isInited() const { return m_stateResource.buffer != VK_NULL_HANDLE; }
+
+    inline uint32_t capacity() const { return m_info.capacity; }
+
+    inline size_t emitterCount() const { return m_emitters.size(); }
+
+    inline const Emitter& emitter(uint32_t index) const { return m_emitters[index]; }
+
+    inline void setEmitter(uint32_t index, const Emitter& emitter) { m_emitters[index] = emitter; }
+
+    // After the frame's fence has been waited: read back what its previous submission left alive,
+    // and write the emitters with the particles they spawn over deltaTime.
+    void update(size_t frameIndex, float deltaTime);
+
+    // Of the frame's previous submission, so it lags by the frames in flight.
+    inline uint32_t aliveCount() const { return m_aliveCount; }
+
+    // The emit, simulate and compact passes, with the bindless table bound at set 1 of the layout.
+    void recordSimulation(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipeline emitPipeline,
+                          VkPipeline simulatePipeline, VkPipeline compactPipeline, VkPipelineLayout pipelineLayout);
+
+    // Billboards of what the last recordSimulation() left alive; the pipeline and sets are bound by the caller.
+    // DrawParams are pushed to the vertex and fragment stages, as the layout's range has to cover both.
+    void recordDraw(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipelineLayout pipelineLayout);
+
+    VkDeviceSize memorySize() const;
+
+    size_t allocationCount() const;
+
+    void destroy();
+
+private:
+    struct BufferResource {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        BindlessDescriptors::Slot slot = BindlessDescriptors::InvalidSlot;
+    };
+
+    void createBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags properties, BufferResource& resource);
+
+    void destroyBuffer(BufferResource& resource);
+
+    uint32_t findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+    VkDevice* m_device = nullptr;
+
+    ParticleStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    std::vector<Emitter> m_emitters = {};
+
+    // Fractions of a particle left over from previous frames, so low rates still emit.
+    std::vector<float> m_emissionRemainders = {};
+
+    BufferResource m_particleResources[2] = {};
+    BufferResource m_stateResource = {};
+
+    // Per frame in flight: the emitters, persistently mapped, and the particle count read back.
+    std::vector<BufferResource> m_emitterResources = {};
+    std::vector<void*> m_emitterMappedData = {};
+    std::vector<BufferResource> m_readbackResources = {};
+    std::vector<void*> m_readbackMappedData = {};
+
+    // Parameters of the frame's simulation, written by update().
+    std::vector<ParticleStructs::SimulationParams> m_params = {};
+
+    // Written by the first simulation, on the queue it runs on.
+    bool m_isStateInitialized = false;
+
+    // The particle buffer holding the survivors of the last simulation.
+    uint32_t m_currList = 0;
+
+    uint32_t m_aliveCount = 0;
+
+    uint32_t m_frameSerial = 0;
+};
+
+#endif // PARTICLE_SYSTEM_H
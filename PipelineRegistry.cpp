@@ -0,0 +1,306 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <exception>
+#include <stdexcept>
+
+#include "GraphicsResource.h"
+#include "PipelineRegistry.h"
+
+PipelineRegistry::~PipelineRegistry() {
+    destroyAllPipelines(); // In case someone forgets destroy created pipelines.
+    destroyPipelineCache();
+}
+
+PipelineRegistry::Handle PipelineRegistry::acquire(const Key& key) {
+    auto itor = m_handles.find(key);
+    if (itor != m_handles.end()) {
+        return itor->second;
+    }
+
+    auto handle = allocateHandle(createGraphicsPipeline(key), key);
+    m_handles.insert({ key, handle });
+
+    return handle;
+}
+
+PipelineRegistry::Handle PipelineRegistry::acquireCompute(const ComputeKey& key) {
+    auto itor = m_computeHandles.find(key);
+    if (itor != m_computeHandles.end()) {
+        return itor->second;
+    }
+
+    Key graphicsKey;
+    memset(&graphicsKey, 0, sizeof(graphicsKey));
+
+    auto handle = allocateHandle(createComputePipeline(key), graphicsKey);
+    m_computeHandles.insert({ key, handle });
+
+    return handle;
+}
+
+void PipelineRegistry::destroyAllPipelines() {
+    for (auto& pipeline : m_pipelines) {
+        vkDestroyPipeline(*m_device, pipeline, nullptr);
+    }
+    m_pipelines.clear();
+    m_keys.clear();
+    m_handles.clear();
+    m_computeHandles.clear();
+    m_freeHandles.clear();
+}
+
+void PipelineRegistry::destroyRenderPassPipelines() {
+    for (auto itor = m_handles.begin(); itor != m_handles.end();) {
+        if (itor->first.renderPass == VK_NULL_HANDLE) {
+            ++itor;
+            continue;
+        }
+        auto handle = itor->second;
+        vkDestroyPipeline(*m_device, m_pipelines[handle], nullptr);
+        m_pipelines[handle] = VK_NULL_HANDLE;
+        memset(&m_keys[handle], 0, sizeof(Key));
+        m_freeHandles.push_back(handle);
+
+        itor = m_handles.erase(itor);
+    }
+}
+
+PipelineRegistry::Handle PipelineRegistry::allocateHandle(VkPipeline pipeline, const Key& key) {
+    if (!m_freeHandles.empty()) {
+        auto handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_pipelines[handle] = pipeline;
+        m_keys[handle] = key;
+        return handle;
+    }
+    auto handle = static_cast<Handle>(m_pipelines.size());
+    m_pipelines.push_back(pipeline);
+    m_keys.push_back(key);
+    return handle;
+}
+
+void PipelineRegistry::destroyPipelineCache() {
+    if (m_pipelineCache == VK_NULL_HANDLE) return;
+
+    vkDestroyPipelineCache(*m_device, m_pipelineCache, nullptr);
+    m_pipelineCache = VK_NULL_HANDLE;
+}
+
+void PipelineRegistry::createPipelineCache() {
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+
+    if (vkCreatePipelineCache(*m_device, &cacheInfo, nullptr, &m_pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline cache.");
+    }
+}
+
+VkPipeline PipelineRegistry::createGraphicsPipeline(const Key& key) {
+    if (m_pipelineCache == VK_NULL_HANDLE) {
+        createPipelineCache();
+    }
+
+    // Make shader infos.
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStageInfos = {};
+    shaderStageInfos.push_back(m_shaderContainer->generateCreateInfo(key.vertexShader));
+    if (key.fragmentShader != VK_NULL_HANDLE) {
+        shaderStageInfos.push_back(m_shaderContainer->generateCreateInfo(key.fragmentShader));
+    }
+
+    std::vector<VkSpecializationMapEntry> specializationEntries = {};
+    auto specializationInfo = makeSpecializationInfo(specializationEntries);
+
+    if (!m_specializationConstants.empty()) {
+        for (auto& stageInfo : shaderStageInfos) {
+            stageInfo.pSpecializationInfo = &specializationInfo;
+        }
+    }
+
+    // Make input assembly info.
+    VkPipelineVertexInputStateCreateInfo vertexInputStateInfo = {};
+    vertexInputStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    auto vertexInputBindDesc = Vertex::generateBindingDescription();
+    auto vertexInputAttrDescs = Vertex::generateAttributeDescriptions();
+
+    if (key.vertexLayout == PipelineRegistryStructs::VertexLayout::Standard) {
+        vertexInputStateInfo.vertexBindingDescriptionCount = 1;
+        vertexInputStateInfo.pVertexBindingDescriptions = &vertexInputBindDesc;
+        vertexInputStateInfo.vertexAttributeDescriptionCount = vertexInputAttrDescs.size();
+        vertexInputStateInfo.pVertexAttributeDescriptions = vertexInputAttrDescs.data();
+    }
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateInfo ={};
+    inputAssemblyStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyStateInfo.topology = static_cast<VkPrimitiveTopology>(key.topology);
+    inputAssemblyStateInfo.primitiveRestartEnable = VK_FALSE;
+
+    // Make viewport and scissor info.
+    // Both are dynamic so that the pipeline survives swapchain extent changes.
+    VkPipelineViewportStateCreateInfo viewportStateInfo = {};
+    viewportStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateInfo.viewportCount = 1;
+    viewportStateInfo.pViewports = nullptr;
+    viewportStateInfo.scissorCount = 1;
+    viewportStateInfo.pScissors = nullptr;
+
+    // Make rasterization info.
+    VkPipelineRasterizationStateCreateInfo rasterizationStateInfo = {};
+    rasterizationStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationStateInfo.depthClampEnable = VK_FALSE;
+    rasterizationStateInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizationStateInfo.polygonMode = static_cast<VkPolygonMode>(key.polygonMode);
+    rasterizationStateInfo.lineWidth = 1.0f;
+    rasterizationStateInfo.cullMode = static_cast<VkCullModeFlags>(key.cullMode);
+    rasterizationStateInfo.frontFace = static_cast<VkFrontFace>(key.frontFace);
+    rasterizationStateInfo.depthBiasEnable = VK_FALSE;
+    rasterizationStateInfo.depthBiasConstantFactor = 0.0f;
+    rasterizationStateInfo.depthBiasClamp = 0.0f;
+    rasterizationStateInfo.depthBiasSlopeFactor = 0.0f;
+
+    // Make multisample info.
+    VkPipelineMultisampleStateCreateInfo multisampleStateInfo = {};
+    multisampleStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleStateInfo.sampleShadingEnable = VK_FALSE;
+    multisampleStateInfo.rasterizationSamples = static_cast<VkSampleCountFlagBits>(key.rasterizationSamples);
+    multisampleStateInfo.minSampleShading = 1.0f;
+    multisampleStateInfo.pSampleMask = nullptr;
+    multisampleStateInfo.alphaToCoverageEnable = VK_FALSE;
+    multisampleStateInfo.alphaToOneEnable = VK_FALSE;
+
+    // Make depth stencil info.
+    VkPipelineDepthStencilStateCreateInfo depthStencilStateInfo = {};
+    depthStencilStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilStateInfo.depthTestEnable = key.depthTestEnable ? VK_TRUE : VK_FALSE;
+    depthStencilStateInfo.depthWriteEnable = key.depthWriteEnable ? VK_TRUE : VK_FALSE;
+    depthStencilStateInfo.depthCompareOp = static_cast<VkCompareOp>(key.depthCompareOp);
+    depthStencilStateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilStateInfo.stencilTestEnable = VK_FALSE;
+    depthStencilStateInfo.minDepthBounds = 0.0f;
+    depthStencilStateInfo.maxDepthBounds = 1.0f;
+
+    // Make color blend info.
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = static_cast<VkColorComponentFlags>(key.colorWriteMask);
+    colorBlendAttachment.blendEnable = key.blendEnable ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = key.blendEnable ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstColorBlendFactor = key.blendEnable ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(key.colorAttachmentCount, colorBlendAttachment);
+
+    VkPipelineColorBlendStateCreateInfo colorBlendStateInfo = {};
+    colorBlendStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendStateInfo.logicOpEnable = VK_FALSE;
+    colorBlendStateInfo.logicOp = VK_LOGIC_OP_COPY;
+    colorBlendStateInfo.attachmentCount = colorBlendAttachments.size();
+    colorBlendStateInfo.pAttachments = colorBlendAttachments.data();
+    colorBlendStateInfo.blendConstants[0] = 0.0f;
+    colorBlendStateInfo.blendConstants[1] = 0.0f;
+    colorBlendStateInfo.blendConstants[2] = 0.0f;
+    colorBlendStateInfo.blendConstants[3] = 0.0f;
+
+    // Make dynamic info.
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo ={};
+    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo.dynamicStateCount = 2;
+    dynamicStateInfo.pDynamicStates = dynamicStates;
+
+    // Create pipeline.
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = shaderStageInfos.size();
+    pipelineInfo.pStages = shaderStageInfos.data();
+    pipelineInfo.pVertexInputState = &vertexInputStateInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyStateInfo;
+    pipelineInfo.pViewportState = &viewportStateInfo;
+    pipelineInfo.pRasterizationState = &rasterizationStateInfo;
+    pipelineInfo.pMultisampleState = &multisampleStateInfo;
+    pipelineInfo.pDepthStencilState = &depthStencilStateInfo;
+    pipelineInfo.pColorBlendState = &colorBlendStateInfo;
+    pipelineInfo.pDynamicState = &dynamicStateInfo;
+    pipelineInfo.layout = key.layout;
+    pipelineInfo.renderPass = key.renderPass;
+    pipelineInfo.subpass = key.subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+#ifdef VK_KHR_dynamic_rendering
+    // Without a render pass the attachment formats are all the pipeline needs to know.
+    std::vector<VkFormat> colorFormats(key.colorAttachmentCount, static_cast<VkFormat>(key.colorFormat));
+
+    VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.colorAttachmentCount = colorFormats.size();
+    renderingInfo.pColorAttachmentFormats = colorFormats.data();
+    renderingInfo.depthAttachmentFormat = static_cast<VkFormat>(key.depthFormat);
+
+    if (key.renderPass == VK_NULL_HANDLE) {
+        pipelineInfo.pNext = &renderingInfo;
+    }
+#endif
+
+    VkPipeline pipeline = {};
+    if (vkCreateGraphicsPipelines(*m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create graphics pipelines.");
+    }
+
+    return pipeline;
+}
+
+VkPipeline PipelineRegistry::createComputePipeline(const ComputeKey& key) {
+    if (m_pipelineCache == VK_NULL_HANDLE) {
+        createPipelineCache();
+    }
+
+    std::vector<VkSpecializationMapEntry> specializationEntries = {};
+    auto specializationInfo = makeSpecializationInfo(specializationEntries);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = m_shaderContainer->generateCreateInfo(key.computeShader);
+    if (!m_specializationConstants.empty()) {
+        pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+    }
+    pipelineInfo.layout = key.layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline = {};
+    if (vkCreateComputePipelines(*m_device, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute pipelines.");
+    }
+
+    return pipeline;
+}
+
+VkSpecializationInfo PipelineRegistry::makeSpecializationInfo(std::vector<VkSpecializationMapEntry>& entries) const {
+    entries.resize(m_specializationConstants.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].constantID = i;
+        entries[i].offset = i * sizeof(uint32_t);
+        entries[i].size = sizeof(uint32_t);
+    }
+
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = entries.size();
+    specializationInfo.pMapEntries = entries.data();
+    specializationInfo.dataSize = m_specializationConstants.size() * sizeof(uint32_t);
+    specializationInfo.pData = m_specializationConstants.data();
+    return specializationInfo;
+}
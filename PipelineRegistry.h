@@ -0,0 +1,207 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderContainer.h"
+
+namespace PipelineRegistryStructs {
+    enum class VertexLayout : uint8_t {
+        None = 0,
+        Standard = 1 // struct Vertex
+    };
+
+    // Compact description of all the state baked into a graphics pipeline.
+    // The layout is padding-free so that the raw bytes can be hashed and compared directly.
+    struct GraphicsPipelineKey {
+        VkShaderModule vertexShader;
+        VkShaderModule fragmentShader; // VK_NULL_HANDLE for depth-only pipelines.
+        VkPipelineLayout layout;
+        VkRenderPass renderPass; // VK_NULL_HANDLE for dynamic rendering, which only needs the formats below.
+        uint32_t subpass;
+
+        uint32_t colorFormat; // VkFormat of every color attachment; only used with dynamic rendering.
+        uint32_t depthFormat; // VkFormat; only used with dynamic rendering.
+
+        VertexLayout vertexLayout;
+        uint8_t topology; // VkPrimitiveTopology
+        uint8_t polygonMode; // VkPolygonMode
+        uint8_t cullMode; // VkCullModeFlags
+        uint8_t frontFace; // VkFrontFace
+        uint8_t rasterizationSamples; // VkSampleCountFlagBits
+        uint8_t depthTestEnable;
+        uint8_t depthWriteEnable;
+        uint8_t depthCompareOp; // VkCompareOp
+        uint8_t blendEnable;
+        uint8_t colorWriteMask; // VkColorComponentFlags
+        uint8_t colorAttachmentCount;
+
+        // Default state matches the original hard-coded main pipeline.
+        static GraphicsPipelineKey makeDefault() {
+            GraphicsPipelineKey key;
+            memset(&key, 0, sizeof(key));
+
+            key.vertexLayout = VertexLayout::Standard;
+            key.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            key.polygonMode = VK_POLYGON_MODE_FILL;
+            key.cullMode = VK_CULL_MODE_BACK_BIT;
+            key.frontFace = VK_FRONT_FACE_CLOCKWISE;
+            key.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+            key.depthCompareOp = VK_COMPARE_OP_LESS;
+            key.colorWriteMask =
+                    VK_COLOR_COMPONENT_R_BIT |
+                    VK_COLOR_COMPONENT_G_BIT |
+                    VK_COLOR_COMPONENT_B_BIT |
+                    VK_COLOR_COMPONENT_A_BIT;
+            key.colorAttachmentCount = 1;
+
+            return key;
+        }
+    };
+
+    static_assert(std::has_unique_object_representations_v<GraphicsPipelineKey>,
+                  "GraphicsPipelineKey must not contain padding bytes.");
+
+    struct GraphicsPipelineKeyHasher {
+        size_t operator()(const GraphicsPipelineKey& key) const {
+            // FNV-1a over the raw key bytes.
+            auto bytes = reinterpret_cast<const unsigned char*>(&key);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(key); ++i) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct GraphicsPipelineKeyEqual {
+        bool operator()(const GraphicsPipelineKey& lhs, const GraphicsPipelineKey& rhs) const {
+            return memcmp(&lhs, &rhs, sizeof(GraphicsPipelineKey)) == 0;
+        }
+    };
+
+    // A compute pipeline is fully described by its shader and layout.
+    struct ComputePipelineKey {
+        VkShaderModule computeShader;
+        VkPipelineLayout layout;
+    };
+
+    static_assert(std::has_unique_object_representations_v<ComputePipelineKey>,
+                  "ComputePipelineKey must not contain padding bytes.");
+
+    struct ComputePipelineKeyHasher {
+        size_t operator()(const ComputePipelineKey& key) const {
+            auto bytes = reinterpret_cast<const unsigned char*>(&key);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(key); ++i) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct ComputePipelineKeyEqual {
+        bool operator()(const ComputePipelineKey& lhs, const ComputePipelineKey& rhs) const {
+            return memcmp(&lhs, &rhs, sizeof(ComputePipelineKey)) == 0;
+        }
+    };
+}
+
+class PipelineRegistry {
+public:
+    using Key = PipelineRegistryStructs::GraphicsPipelineKey;
+    using ComputeKey = PipelineRegistryStructs::ComputePipelineKey;
+
+    // Dense index into the registry; resolving it is a plain array access, which is
+    // what the per-draw path should use instead of hashing keys or strings.
+    using Handle = uint32_t;
+    constexpr static Handle InvalidHandle = UINT32_MAX;
+
+public:
+    PipelineRegistry() = default;
+    ~PipelineRegistry();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+    inline void setShaderContainer(ShaderContainer* container) { m_shaderContainer = container; }
+
+    // Applied to every shader stage as constant_id 0, 1, ...; stages ignore ids they do not declare.
+    inline void setSpecializationConstants(const std::vector<uint32_t>& values) { m_specializationConstants = values; }
+
+    // Return the cached pipeline matching the key, creating it on first request only.
+    Handle acquire(const Key& key);
+
+    // Compute pipelines share the handle space and the pipeline cache with graphics ones.
+    Handle acquireCompute(const ComputeKey& key);
+
+    inline VkPipeline pipeline(Handle handle) const { return m_pipelines[handle]; }
+
+    // Zeroed for compute pipelines.
+    inline const Key& key(Handle handle) const { return m_keys[handle]; }
+
+    inline size_t pipelineCount() const { return m_pipelines.size() - m_freeHandles.size(); }
+
+    // Pipelines must be rebuilt when the render passes or shader modules they refer to are destroyed.
+    void destroyAllPipelines();
+
+    // Only the graphics pipelines made for a render pass, e.g. when the render passes are rebuilt for a new
+    // swapchain; their handles are invalid from then on, and the other pipelines keep theirs.
+    void destroyRenderPassPipelines();
+
+    void destroyPipelineCache();
+
+private:
+    VkPipeline createGraphicsPipeline(const Key& key);
+
+    VkPipeline createComputePipeline(const ComputeKey& key);
+
+    // Applied to every stage of a pipeline; the entries point into m_specializationConstants.
+    VkSpecializationInfo makeSpecializationInfo(std::vector<VkSpecializationMapEntry>& entries) const;
+
+    void createPipelineCache();
+
+private:
+    VkDevice* m_device = nullptr;
+
+    ShaderContainer* m_shaderContainer = nullptr;
+
+    std::vector<uint32_t> m_specializationConstants = {};
+
+    // Kept alive across destroyAllPipelines() so that recreated pipelines are cheap to build.
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+    std::unordered_map<Key, Handle,
+                       PipelineRegistryStructs::GraphicsPipelineKeyHasher,
+                       PipelineRegistryStructs::GraphicsPipelineKeyEqual> m_handles = {};
+
+    std::unordered_map<ComputeKey, Handle,
+                       PipelineRegistryStructs::ComputePipelineKeyHasher,
+                       PipelineRegistryStructs::ComputePipelineKeyEqual> m_computeHandles = {};
+
+    std::vector<VkPipeline> m_pipelines = {};
+    std::vector<Key> m_keys = {};
+
+    // Of destroyed pipelines, taken again by the next acquires.
+    std::vector<Handle> m_freeHandles = {};
+
+    Handle allocateHandle(VkPipeline pipeline, const Key& key);
+};
+
+#endif // PIPELINE_REGISTRY_H
@@ -0,0 +1,275 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+#include "Profiler.h"
+
+// Chrome trace thread id of the GPU timeline; CPU threads hash to smaller ids.
+constexpr static uint32_t GPU_TRACE_THREAD_ID = UINT32_MAX;
+
+ProfilerEventRing::ProfilerEventRing(size_t capacity) {
+    m_capacity = std::max<size_t>(capacity, 1);
+    m_slots = std::make_unique<Slot[]>(m_capacity);
+}
+
+void ProfilerEventRing::push(const Event& event) {
+    uint64_t index = m_head.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = m_slots[index % m_capacity];
+
+    // Mark the slot busy before touching the fields, so a concurrent snapshot never mixes two events.
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.beginNs.store(event.beginNs, std::memory_order_relaxed);
+    slot.endNs.store(event.endNs, std::memory_order_relaxed);
+    slot.threadId.store(event.threadId, std::memory_order_relaxed);
+    slot.isGpu.store(event.isGpu, std::memory_order_relaxed);
+    slot.gpuFrameIndex.store(event.gpuFrameIndex, std::memory_order_relaxed);
+
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+std::vector<ProfilerEventRing::Event> ProfilerEventRing::snapshot() const {
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    uint64_t first = head > m_capacity ? head - m_capacity : 0;
+
+    std::vector<Event> events = {};
+    events.reserve(head - first);
+
+    for (uint64_t index = first; index < head; ++index) {
+        const auto& slot = m_slots[index % m_capacity];
+
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != index + 1) continue; // Being written, or already overwritten by a newer event.
+
+        Event event = {};
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.beginNs = slot.beginNs.load(std::memory_order_relaxed);
+        event.endNs = slot.endNs.load(std::memory_order_relaxed);
+        event.threadId = slot.threadId.load(std::memory_order_relaxed);
+        event.isGpu = slot.isGpu.load(std::memory_order_relaxed);
+        event.gpuFrameIndex = slot.gpuFrameIndex.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+        events.push_back(event);
+    }
+    return events;
+}
+
+Profiler::Profiler() {
+    m_epoch = std::chrono::steady_clock::now();
+    m_events = std::make_unique<ProfilerEventRing>(m_info.eventCapacity);
+}
+
+Profiler::~Profiler() {
+    destroy(); // In case someone forgets destroy query pools.
+}
+
+void Profiler::init(const ProfilerStructs::CreateInfo& info) {
+    m_info = info;
+
+    if (m_events->capacity() != m_info.eventCapacity) {
+        m_events = std::make_unique<ProfilerEventRing>(m_info.eventCapacity);
+    }
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(m_info.physicalDevice, &properties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_info.physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_info.physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = m_info.queueFamilyIndex < queueFamilyCount ?
+            queueFamilies[m_info.queueFamilyIndex].timestampValidBits : 0;
+
+    // Zero valid bits means the queue does not support timestamps at all; CPU timing still works.
+    m_isGpuTimingSupported = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+    if (!m_isGpuTimingSupported) return;
+
+    m_timestampPeriodNs = properties.limits.timestampPeriod;
+    m_timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * m_info.maxGpuScopesPerFrame;
+
+    m_gpuFrameSlots.resize(m_info.frameSlotCount);
+    for (auto& slot : m_gpuFrameSlots) {
+        if (vkCreateQueryPool(*m_device, &poolInfo, nullptr, &slot.queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timestamp query pool");
+        }
+        slot.scopes.reserve(m_info.maxGpuScopesPerFrame);
+    }
+}
+
+const char* Profiler::internName(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_internedNamesMutex);
+    // Node-based, so the pointer stays valid across rehashes.
+    return m_internedNames.insert(name).first->c_str();
+}
+
+void Profiler::recordCpuEvent(const char* name, uint64_t beginNs, uint64_t endNs) {
+    if (!isEnabled()) return;
+
+    Event event = {};
+    event.name = name;
+    event.beginNs = beginNs;
+    event.endNs = endNs;
+    event.threadId = currentThreadId();
+    m_events->push(event);
+}
+
+void Profiler::recordCpuFrame(uint64_t beginNs, uint64_t endNs) {
+    m_cpuFrameNs.store(endNs - beginNs, std::memory_order_relaxed);
+    recordCpuEvent("frame", beginNs, endNs);
+}
+
+void Profiler::beginGpuFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    m_currGpuFrameSlot = nullptr;
+    if (!m_isGpuTimingSupported || frameSlot >= m_gpuFrameSlots.size()) return;
+
+    auto& slot = m_gpuFrameSlots[frameSlot];
+    collectGpuFrame(slot);
+
+    slot.scopes.clear();
+    slot.openScopes.clear();
+    slot.queryCount = 0;
+    slot.frameIndex = m_gpuFrameCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    slot.anchorNs = nowNs();
+
+    vkCmdResetQueryPool(commandBuffer, slot.queryPool, 0, 2 * m_info.maxGpuScopesPerFrame);
+    m_currGpuFrameSlot = &slot;
+}
+
+void Profiler::beginGpuScope(VkCommandBuffer commandBuffer, const char* name) {
+    auto slot = m_currGpuFrameSlot;
+    if (slot == nullptr || !isEnabled() || slot->queryCount + 2 > 2 * m_info.maxGpuScopesPerFrame) {
+        return;
+    }
+
+    GpuScope scope = {};
+    scope.name = name;
+    scope.beginQuery = slot->queryCount++;
+    scope.endQuery = slot->queryCount++;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot->queryPool, scope.beginQuery);
+
+    slot->openScopes.push_back(slot->scopes.size());
+    slot->scopes.push_back(scope);
+}
+
+void Profiler::endGpuScope(VkCommandBuffer commandBuffer) {
+    auto slot = m_currGpuFrameSlot;
+    if (slot == nullptr || slot->openScopes.empty()) return;
+
+    const auto& scope = slot->scopes[slot->openScopes.back()];
+    slot->openScopes.pop_back();
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot->queryPool, scope.endQuery);
+}
+
+void Profiler::collectGpuFrame(GpuFrameSlot& slot) {
+    if (slot.queryCount == 0) return;
+
+    std::vector<uint64_t> timestamps(slot.queryCount);
+    VkResult result = vkGetQueryPoolResults(*m_device, slot.queryPool, 0, slot.queryCount,
+                                            timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    // VK_NOT_READY, also when a scope was left open; the frame is skipped rather than stalling.
+    if (result != VK_SUCCESS) return;
+
+    uint64_t originTicks = timestamps[slot.scopes.front().beginQuery] & m_timestampMask;
+    auto toNs = [&](uint32_t query) {
+        uint64_t ticks = (timestamps[query] - originTicks) & m_timestampMask; // Survives a wraparound.
+        return slot.anchorNs + static_cast<uint64_t>(static_cast<double>(ticks) * m_timestampPeriodNs);
+    };
+
+    for (size_t i = 0; i < slot.scopes.size(); ++i) {
+        const auto& scope = slot.scopes[i];
+
+        Event event = {};
+        event.name = scope.name;
+        event.beginNs = toNs(scope.beginQuery);
+        event.endNs = std::max(event.beginNs, toNs(scope.endQuery));
+        event.threadId = GPU_TRACE_THREAD_ID;
+        event.isGpu = true;
+        event.gpuFrameIndex = slot.frameIndex;
+        m_events->push(event);
+
+        if (i == 0) m_gpuFrameNs.store(event.endNs - event.beginNs, std::memory_order_relaxed);
+    }
+}
+
+Profiler::FrameSummary Profiler::frameSummary() const {
+    FrameSummary summary = {};
+    summary.cpuFrameMs = m_cpuFrameNs.load(std::memory_order_relaxed) / 1e6;
+    summary.gpuFrameMs = m_gpuFrameNs.load(std::memory_order_relaxed) / 1e6;
+    return summary;
+}
+
+static void writeJsonString(FILE* file, const char* str) {
+    fputc('"', file);
+    for (const char* c = str != nullptr ? str : ""; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+        else if (static_cast<unsigned char>(*c) < 0x20) fprintf(file, "\\u%04x", static_cast<unsigned char>(*c));
+        else fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+void Profiler::exportChromeTrace(const std::string& filename) const {
+    FILE* file = fopen(filename.c_str(), "w");
+    if (file == nullptr) {
+        throw std::runtime_error("Failed to open trace file " + filename);
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}",
+            GPU_TRACE_THREAD_ID);
+
+    // Complete events, timestamps and durations in microseconds.
+    for (const auto& event : snapshot()) {
+        fprintf(file, ",\n{\"name\":");
+        writeJsonString(file, event.name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                event.isGpu ? "gpu" : "cpu", event.beginNs / 1e3, (event.endNs - event.beginNs) / 1e3, event.threadId);
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        throw std::runtime_error("Failed to write trace file " + filename);
+    }
+}
+
+void Profiler::destroy() {
+    // Destroy: init()
+    for (auto& slot : m_gpuFrameSlots) {
+        vkDestroyQueryPool(*m_device, slot.queryPool, nullptr);
+    }
+    m_gpuFrameSlots.clear();
+    m_currGpuFrameSlot = nullptr;
+    m_isGpuTimingSupported = false;
+}
+
+uint32_t Profiler::currentThreadId() {
+    // Small and stable per thread, never colliding with the GPU timeline.
+    return static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id()) % 0x7fffffff);
+}
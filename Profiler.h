@@ -0,0 +1,223 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace ProfilerStructs {
+    struct Event {
+        const char* name = nullptr; // String literal or interned by the profiler; never freed before it.
+        uint64_t beginNs = 0; // On the profiler clock; GPU events are mapped onto it.
+        uint64_t endNs = 0;
+        uint32_t threadId = 0;
+        bool isGpu = false;
+        uint64_t gpuFrameIndex = 0; // GPU events: which frame recorded them, counting from 1.
+    };
+
+    struct FrameSummary {
+        double cpuFrameMs = 0.0;
+        double gpuFrameMs = 0.0; // 0 when timestamps are not supported.
+    };
+
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // The queue family the profiled command buffers are submitted to.
+        uint32_t queueFamilyIndex = 0;
+
+        // One query pool per frame in flight, read back when the frame slot is reused.
+        uint32_t frameSlotCount = 2;
+
+        uint32_t maxGpuScopesPerFrame = 64;
+
+        // Older events are overwritten once the ring is full.
+        size_t eventCapacity = 1 << 16;
+    };
+}
+
+// Fixed-size ring of events that any thread can push to without locking.
+// Each slot carries a sequence number, so readers skip slots that are being overwritten.
+class ProfilerEventRing {
+public:
+    using Event = ProfilerStructs::Event;
+
+public:
+    explicit ProfilerEventRing(size_t capacity);
+
+    void push(const Event& event);
+
+    // Oldest first.
+    std::vector<Event> snapshot() const;
+
+    inline size_t capacity() const { return m_capacity; }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence = { 0 }; // Index + 1 of the event in the slot, 0 while written.
+        std::atomic<const char*> name = { nullptr };
+        std::atomic<uint64_t> beginNs = { 0 };
+        std::atomic<uint64_t> endNs = { 0 };
+        std::atomic<uint32_t> threadId = { 0 };
+        std::atomic<bool> isGpu = { false };
+        std::atomic<uint64_t> gpuFrameIndex = { 0 };
+    };
+
+    std::unique_ptr<Slot[]> m_slots = nullptr;
+
+    size_t m_capacity = 0;
+
+    std::atomic<uint64_t> m_head = { 0 };
+};
+
+// CPU scopes are timed with a steady clock; GPU scopes with vkCmdWriteTimestamp into one query pool
+// per frame in flight. Both end up in the same event ring, exportable as Chrome trace JSON
+// (chrome://tracing or https://ui.perfetto.dev).
+class Profiler {
+public:
+    using Event = ProfilerStructs::Event;
+    using FrameSummary = ProfilerStructs::FrameSummary;
+
+public:
+    Profiler();
+    ~Profiler();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const ProfilerStructs::CreateInfo& info);
+
+    inline bool isEnabled() const { return m_isEnabled.load(std::memory_order_relaxed); }
+    inline void setEnabled(bool value) { m_isEnabled.store(value, std::memory_order_relaxed); }
+
+    inline bool isGpuTimingSupported() const { return m_isGpuTimingSupported; }
+
+    // Nanoseconds since the profiler was created.
+    inline uint64_t nowNs() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+    }
+
+    // Return a pointer that stays valid for the lifetime of the profiler; for names that are not literals.
+    const char* internName(const std::string& name);
+
+    // CPU.
+
+    void recordCpuEvent(const char* name, uint64_t beginNs, uint64_t endNs);
+
+    // Record the whole frame and update the frame summary.
+    void recordCpuFrame(uint64_t beginNs, uint64_t endNs);
+
+    // GPU; the frame slot's previous submission must have completed (i.e. its fence waited).
+
+    // Collect the results of the slot's previous frame and reset its queries.
+    void beginGpuFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+
+    // GPU frames begun so far, which is also the index of the last one. Their events arrive the frames
+    // in flight later, in the order the frames were begun; unlike their times, the indices never go back.
+    inline uint64_t gpuFrameCount() const { return m_gpuFrameCount.load(std::memory_order_relaxed); }
+
+    // Scopes nest; the first scope of a frame is taken as the GPU frame time.
+    void beginGpuScope(VkCommandBuffer commandBuffer, const char* name);
+
+    void endGpuScope(VkCommandBuffer commandBuffer);
+
+    // Results.
+
+    FrameSummary frameSummary() const;
+
+    inline std::vector<Event> snapshot() const { return m_events->snapshot(); }
+
+    void exportChromeTrace(const std::string& filename) const;
+
+    void destroy();
+
+private:
+    VkDevice* m_device = nullptr;
+
+    ProfilerStructs::CreateInfo m_info = {};
+
+    std::chrono::steady_clock::time_point m_epoch = {};
+
+    std::atomic<bool> m_isEnabled = { true };
+
+    std::unique_ptr<ProfilerEventRing> m_events = nullptr;
+
+    std::mutex m_internedNamesMutex = {};
+    std::unordered_set<std::string> m_internedNames = {};
+
+    std::atomic<uint64_t> m_cpuFrameNs = { 0 };
+    std::atomic<uint64_t> m_gpuFrameNs = { 0 };
+
+    std::atomic<uint64_t> m_gpuFrameCount = { 0 };
+
+    bool m_isGpuTimingSupported = false;
+
+    double m_timestampPeriodNs = 1.0;
+
+    uint64_t m_timestampMask = UINT64_MAX;
+
+    struct GpuScope {
+        const char* name = nullptr;
+        uint32_t beginQuery = 0;
+        uint32_t endQuery = 0;
+    };
+
+    struct GpuFrameSlot {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<GpuScope> scopes = {};
+        std::vector<uint32_t> openScopes = {}; // Indices into scopes.
+        uint32_t queryCount = 0;
+
+        uint64_t frameIndex = 0;
+
+        // CPU time when recording started. Without calibrated timestamps the GPU timeline can not be
+        // correlated exactly, so GPU events are placed relative to it.
+        uint64_t anchorNs = 0;
+    };
+
+    std::vector<GpuFrameSlot> m_gpuFrameSlots = {};
+
+    GpuFrameSlot* m_currGpuFrameSlot = nullptr;
+
+    void collectGpuFrame(GpuFrameSlot& slot);
+
+    static uint32_t currentThreadId();
+};
+
+// Time the enclosing block on the CPU.
+class ProfileScope {
+public:
+    ProfileScope(Profiler& profiler, const char* name) : m_profiler(profiler), m_name(name) {
+        m_beginNs = m_profiler.nowNs();
+    }
+
+    ~ProfileScope() {
+        m_profiler.recordCpuEvent(m_name, m_beginNs, m_profiler.nowNs());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler& m_profiler;
+    const char* m_name = nullptr;
+    uint64_t m_beginNs = 0;
+};
+
+#endif // PROFILER_H
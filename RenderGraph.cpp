@@ -0,0 +1,908 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "RenderGraph.h"
+
+namespace RenderGraphStructs {
+    AccessInfo describeAccess(Access access, PassType passType) {
+        VkPipelineStageFlags shaderStages = passType == PassType::Compute ?
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT :
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+        switch (access) {
+            case Access::ColorAttachmentWrite:
+            case Access::ColorResolveWrite:
+                return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true };
+            case Access::DepthAttachmentWrite:
+                return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true };
+            case Access::DepthAttachmentRead:
+                return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                         VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false };
+            case Access::SampledRead:
+                return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false };
+            case Access::StorageRead:
+                return { shaderStages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false };
+            case Access::StorageWrite:
+                return { shaderStages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, true };
+            case Access::TransferSrc:
+                return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false };
+            case Access::TransferDst:
+                return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true };
+            case Access::IndirectRead:
+                return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false };
+            case Access::VertexRead:
+                return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+                         VK_IMAGE_LAYOUT_UNDEFINED, false };
+        }
+        return {};
+    }
+
+    static VkImageUsageFlags convertAccessToUsage(Access access) {
+        switch (access) {
+            case Access::ColorAttachmentWrite:
+            case Access::ColorResolveWrite: return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+            case Access::DepthAttachmentWrite:
+            case Access::DepthAttachmentRead: return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            case Access::SampledRead: return VK_IMAGE_USAGE_SAMPLED_BIT;
+            case Access::StorageRead:
+            case Access::StorageWrite: return VK_IMAGE_USAGE_STORAGE_BIT;
+            case Access::TransferSrc: return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            case Access::TransferDst: return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            default: return 0;
+        }
+    }
+}
+
+RenderGraph::~RenderGraph() {
+    destroy(); // In case someone forgets destroy compiled resources.
+}
+
+void RenderGraph::init(const RenderGraphStructs::CreateInfo& info) {
+    m_info = info;
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+#ifdef VK_KHR_dynamic_rendering
+    if (m_info.enableDynamicRendering) {
+        m_cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(*m_device, "vkCmdBeginRenderingKHR");
+        m_cmdEndRendering = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(*m_device, "vkCmdEndRenderingKHR");
+        m_info.enableDynamicRendering = m_cmdBeginRendering != nullptr && m_cmdEndRendering != nullptr;
+    }
+#else
+    m_info.enableDynamicRendering = false;
+#endif
+}
+
+RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const ImageDesc& desc) {
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = true;
+    resource.isImported = false;
+    resource.desc = desc;
+
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, const ImageDesc& desc,
+                                                     VkImageLayout initialLayout, VkPipelineStageFlags initialStages,
+                                                     VkImageLayout finalLayout, VkAccessFlags initialAccess) {
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = true;
+    resource.isImported = true;
+    resource.desc = desc;
+    resource.initialLayout = initialLayout;
+    resource.initialStages = initialStages;
+    resource.initialAccess = initialAccess;
+    resource.finalLayout = finalLayout;
+
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::importBuffer(const std::string& name) {
+    Resource resource = {};
+    resource.name = name;
+    resource.isImage = false;
+    resource.isImported = true;
+
+    m_resources.push_back(resource);
+    return static_cast<ResourceHandle>(m_resources.size() - 1);
+}
+
+void RenderGraph::bindImportedImage(ResourceHandle resource, VkImage image, VkImageView view) {
+    m_resources[resource].image = image;
+    m_resources[resource].view = view;
+}
+
+void RenderGraph::bindImportedBuffer(ResourceHandle resource, VkBuffer buffer) {
+    m_resources[resource].buffer = buffer;
+}
+
+RenderGraph::PassHandle RenderGraph::addPass(const std::string& name, PassType type) {
+    Pass pass = {};
+    pass.name = name;
+    pass.type = type;
+
+    m_passes.push_back(pass);
+    return static_cast<PassHandle>(m_passes.size() - 1);
+}
+
+void RenderGraph::readImage(PassHandle pass, ResourceHandle resource, Access access) {
+    m_passes[pass].reads.push_back({ resource, access, LoadOp::Load, {} });
+}
+
+void RenderGraph::writeImage(PassHandle pass, ResourceHandle resource, Access access, LoadOp loadOp, VkClearValue clearValue) {
+    m_passes[pass].writes.push_back({ resource, access, loadOp, clearValue });
+}
+
+void RenderGraph::resolveImage(PassHandle pass, ResourceHandle source, ResourceHandle target) {
+    m_passes[pass].writes.push_back({ target, Access::ColorResolveWrite, LoadOp::DontCare, {}, source });
+}
+
+void RenderGraph::readBuffer(PassHandle pass, ResourceHandle resource, Access access) {
+    m_passes[pass].reads.push_back({ resource, access, LoadOp::Load, {} });
+}
+
+void RenderGraph::writeBuffer(PassHandle pass, ResourceHandle resource, Access access) {
+    m_passes[pass].writes.push_back({ resource, access, LoadOp::Load, {} });
+}
+
+void RenderGraph::setExecute(PassHandle pass, const ExecuteFunc& func) {
+    m_passes[pass].execute = func;
+}
+
+void RenderGraph::setCondition(PassHandle pass, const ConditionFunc& func) {
+    m_passes[pass].condition = func;
+}
+
+void RenderGraph::setPassScopeCallbacks(const PassScopeFunc& begin, const PassScopeFunc& end) {
+    m_passScopeBegin = begin;
+    m_passScopeEnd = end;
+}
+
+void RenderGraph::compile(VkExtent2D backbufferExtent) {
+    destroyCompiledResources();
+
+    m_backbufferExtent = backbufferExtent;
+
+    cullPasses();
+
+    computeLifetimes();
+
+    createTransientImages();
+
+    aliasTransientMemory();
+
+    createRenderPasses();
+
+    computeBarriers();
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+    std::vector<VkImageMemoryBarrier> imageBarriers = {};
+    std::vector<VkBufferMemoryBarrier> bufferBarriers = {};
+
+    for (auto passHandle : m_executionOrder) {
+        auto& pass = m_passes[passHandle];
+
+        if (m_passScopeBegin) m_passScopeBegin(commandBuffer, passHandle);
+
+        // Imported resources are only known now, so patch them into the precomputed barriers.
+        if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty()) {
+            imageBarriers.clear();
+            for (const auto& barrierGroup : pass.imageBarriers) {
+                imageBarriers.push_back(barrierGroup.second);
+                imageBarriers.back().image = m_resources[barrierGroup.first].image;
+            }
+
+            bufferBarriers.clear();
+            for (const auto& barrierGroup : pass.bufferBarriers) {
+                bufferBarriers.push_back(barrierGroup.second);
+                bufferBarriers.back().buffer = m_resources[barrierGroup.first].buffer;
+            }
+
+            vkCmdPipelineBarrier(commandBuffer, pass.srcStages, pass.dstStages, 0, 0, nullptr,
+                                 bufferBarriers.size(), bufferBarriers.data(),
+                                 imageBarriers.size(), imageBarriers.data());
+        }
+
+        if (pass.condition && !pass.condition()) {
+            // Skipped this time; the barriers above keep layouts and hazards as compiled.
+        }
+        else if (pass.type == PassType::Graphics && m_info.enableDynamicRendering) {
+            beginDynamicRendering(commandBuffer, pass);
+            if (pass.execute) pass.execute(commandBuffer);
+#ifdef VK_KHR_dynamic_rendering
+            m_cmdEndRendering(commandBuffer);
+#endif
+        }
+        else if (pass.type == PassType::Graphics) {
+            VkRenderPassBeginInfo passBeginInfo = {};
+            passBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            passBeginInfo.renderPass = pass.renderPass;
+            passBeginInfo.framebuffer = acquireFramebuffer(pass);
+            passBeginInfo.renderArea.offset = { 0, 0 };
+            passBeginInfo.renderArea.extent = pass.extent;
+            passBeginInfo.clearValueCount = pass.clearValues.size();
+            passBeginInfo.pClearValues = pass.clearValues.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            if (pass.execute) pass.execute(commandBuffer);
+            vkCmdEndRenderPass(commandBuffer);
+        }
+        else {
+            if (pass.execute) pass.execute(commandBuffer);
+        }
+
+        if (m_passScopeEnd) m_passScopeEnd(commandBuffer, passHandle);
+    }
+
+    if (!m_finalBarriers.empty()) {
+        imageBarriers.clear();
+        for (const auto& barrierGroup : m_finalBarriers) {
+            imageBarriers.push_back(barrierGroup.second);
+            imageBarriers.back().image = m_resources[barrierGroup.first].image;
+        }
+
+        vkCmdPipelineBarrier(commandBuffer, m_finalSrcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                             0, nullptr, imageBarriers.size(), imageBarriers.data());
+    }
+}
+
+VkRenderPass RenderGraph::renderPass(PassHandle pass) const {
+    return m_passes[pass].renderPass;
+}
+
+VkImageView RenderGraph::imageView(ResourceHandle resource) const {
+    return m_resources[resource].view;
+}
+
+void RenderGraph::destroyCompiledResources() {
+    for (auto& framebufferGroup : m_framebuffers) {
+        vkDestroyFramebuffer(*m_device, framebufferGroup.second, nullptr);
+    }
+    m_framebuffers.clear();
+
+    for (auto& pass : m_passes) {
+        if (pass.renderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(*m_device, pass.renderPass, nullptr);
+        }
+        pass.renderPass = VK_NULL_HANDLE;
+        pass.isCulled = false;
+        pass.srcStages = 0;
+        pass.dstStages = 0;
+        pass.imageBarriers.clear();
+        pass.bufferBarriers.clear();
+        pass.attachments.clear();
+        pass.attachmentDescs.clear();
+        pass.clearValues.clear();
+        pass.colorRefs.clear();
+        pass.resolveRefs.clear();
+        pass.depthRef = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+    }
+
+    for (auto& resource : m_resources) {
+        if (!resource.isImported) {
+            if (resource.view != VK_NULL_HANDLE) vkDestroyImageView(*m_device, resource.view, nullptr);
+            if (resource.image != VK_NULL_HANDLE) vkDestroyImage(*m_device, resource.image, nullptr);
+            resource.view = VK_NULL_HANDLE;
+            resource.image = VK_NULL_HANDLE;
+        }
+        resource.usage = 0;
+        resource.firstPass = UINT32_MAX;
+        resource.lastPass = 0;
+        resource.lastAccess = {};
+        resource.aliasPredecessor = InvalidHandle;
+    }
+
+    for (auto& bucket : m_memoryBuckets) {
+        vkFreeMemory(*m_device, bucket.memory, nullptr);
+    }
+    m_memoryBuckets.clear();
+
+    m_executionOrder.clear();
+    m_finalBarriers.clear();
+    m_finalSrcStages = 0;
+
+    m_transientMemorySize = 0;
+    m_unaliasedTransientMemorySize = 0;
+    m_barrierCount = 0;
+}
+
+void RenderGraph::destroy() {
+    if (m_device == nullptr) return;
+
+    destroyCompiledResources();
+
+    m_passes.clear();
+    m_resources.clear();
+}
+
+void RenderGraph::cullPasses() {
+    // Reference counting from the imported resources backwards: a pass survives when
+    // something it writes is imported or read by a surviving pass.
+    std::vector<uint32_t> passRefCounts(m_passes.size(), 0);
+    std::vector<uint32_t> resourceRefCounts(m_resources.size(), 0);
+    std::vector<std::vector<PassHandle>> producers(m_resources.size());
+
+    for (PassHandle i = 0; i < m_passes.size(); ++i) {
+        passRefCounts[i] = m_passes[i].writes.size();
+        for (const auto& read : m_passes[i].reads) {
+            ++resourceRefCounts[read.resource];
+        }
+        for (const auto& write : m_passes[i].writes) {
+            producers[write.resource].push_back(i);
+        }
+    }
+
+    std::vector<ResourceHandle> unreferenced = {};
+    for (ResourceHandle i = 0; i < m_resources.size(); ++i) {
+        if (m_resources[i].isImported) {
+            ++resourceRefCounts[i];
+        }
+        if (resourceRefCounts[i] == 0) {
+            unreferenced.push_back(i);
+        }
+    }
+
+    for (PassHandle i = 0; i < m_passes.size(); ++i) {
+        m_passes[i].isCulled = passRefCounts[i] == 0;
+    }
+
+    while (!unreferenced.empty()) {
+        auto resource = unreferenced.back();
+        unreferenced.pop_back();
+
+        for (auto producer : producers[resource]) {
+            if (m_passes[producer].isCulled || --passRefCounts[producer] > 0) continue;
+
+            m_passes[producer].isCulled = true;
+            for (const auto& read : m_passes[producer].reads) {
+                if (--resourceRefCounts[read.resource] == 0) {
+                    unreferenced.push_back(read.resource);
+                }
+            }
+        }
+    }
+
+    for (PassHandle i = 0; i < m_passes.size(); ++i) {
+        if (!m_passes[i].isCulled) {
+            m_executionOrder.push_back(i);
+        }
+    }
+}
+
+void RenderGraph::computeLifetimes() {
+    for (uint32_t order = 0; order < m_executionOrder.size(); ++order) {
+        const auto& pass = m_passes[m_executionOrder[order]];
+
+        auto visit = [&](const ResourceAccess& item) {
+            auto& resource = m_resources[item.resource];
+            resource.firstPass = std::min(resource.firstPass, order);
+            resource.lastPass = order;
+            resource.lastAccess = RenderGraphStructs::describeAccess(item.access, pass.type);
+            resource.usage |= RenderGraphStructs::convertAccessToUsage(item.access);
+        };
+        std::for_each(pass.reads.begin(), pass.reads.end(), visit);
+        std::for_each(pass.writes.begin(), pass.writes.end(), visit);
+    }
+
+    for (auto& resource : m_resources) {
+        resource.extent = resource.desc.extent.width == 0 ? m_backbufferExtent : resource.desc.extent;
+    }
+}
+
+void RenderGraph::createTransientImages() {
+    const VkImageUsageFlags attachmentUsages =
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+    for (auto& resource : m_resources) {
+        if (resource.isImported || !resource.isImage || resource.firstPass == UINT32_MAX) continue;
+
+        // Images only ever used as attachments never need real backing memory on tilers.
+        auto usage = resource.usage;
+        if ((usage & ~attachmentUsages) == 0) {
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        resource.usage = usage;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = resource.desc.format;
+        imageInfo.extent = { resource.extent.width, resource.extent.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = resource.desc.samples;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(*m_device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create render graph image " + resource.name + ".");
+        }
+    }
+}
+
+void RenderGraph::aliasTransientMemory() {
+    struct Candidate {
+        ResourceHandle handle;
+        VkMemoryRequirements requirements;
+    };
+
+    std::vector<Candidate> candidates = {};
+    for (ResourceHandle i = 0; i < m_resources.size(); ++i) {
+        if (m_resources[i].image == VK_NULL_HANDLE || m_resources[i].isImported) continue;
+
+        Candidate candidate = { i, {} };
+        vkGetImageMemoryRequirements(*m_device, m_resources[i].image, &candidate.requirements);
+        candidates.push_back(candidate);
+
+        m_unaliasedTransientMemorySize += candidate.requirements.size;
+    }
+
+    // Largest first, so that smaller images fill in behind them.
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+        return lhs.requirements.size > rhs.requirements.size;
+    });
+
+    for (const auto& candidate : candidates) {
+        const auto& resource = m_resources[candidate.handle];
+
+        MemoryBucket* target = nullptr;
+        for (auto& bucket : m_memoryBuckets) {
+            if ((bucket.memoryTypeBits & candidate.requirements.memoryTypeBits) == 0) continue;
+
+            bool isOverlapped = std::any_of(bucket.resources.begin(), bucket.resources.end(), [&](ResourceHandle other) {
+                const auto& placed = m_resources[other];
+                return resource.firstPass <= placed.lastPass && placed.firstPass <= resource.lastPass;
+            });
+            if (!isOverlapped) {
+                target = &bucket;
+                break;
+            }
+        }
+        if (target == nullptr) {
+            m_memoryBuckets.emplace_back();
+            target = &m_memoryBuckets.back();
+        }
+
+        target->size = std::max(target->size, candidate.requirements.size);
+        target->alignment = std::max(target->alignment, candidate.requirements.alignment);
+        target->memoryTypeBits &= candidate.requirements.memoryTypeBits;
+        target->isLazilyAllocatable &= (resource.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+        target->resources.push_back(candidate.handle);
+    }
+
+    for (auto& bucket : m_memoryBuckets) {
+        bool found = false;
+        uint32_t memoryTypeIndex = 0;
+        if (bucket.isLazilyAllocatable) {
+            memoryTypeIndex = findMemoryType(bucket.memoryTypeBits,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, found);
+        }
+        if (!found) {
+            memoryTypeIndex = findMemoryType(bucket.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, found);
+        }
+        if (!found) {
+            throw std::runtime_error("Failed to find an adequate memory type for render graph images.");
+        }
+
+        VkMemoryAllocateInfo memoryAllocInfo = {};
+        memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memoryAllocInfo.allocationSize = bucket.size;
+        memoryAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+        if (vkAllocateMemory(*m_device, &memoryAllocInfo, nullptr, &bucket.memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate render graph memory.");
+        }
+        m_transientMemorySize += bucket.size;
+
+        // Every image of a bucket starts at offset 0; their lifetimes never overlap.
+        for (auto handle : bucket.resources) {
+            vkBindImageMemory(*m_device, m_resources[handle].image, bucket.memory, 0);
+        }
+
+        // The first user of the memory in a frame follows the last user of the previous frame.
+        std::sort(bucket.resources.begin(), bucket.resources.end(), [&](ResourceHandle lhs, ResourceHandle rhs) {
+            return m_resources[lhs].firstPass < m_resources[rhs].firstPass;
+        });
+        for (size_t i = 0; i < bucket.resources.size(); ++i) {
+            auto predecessor = i == 0 ? bucket.resources.back() : bucket.resources[i - 1];
+            m_resources[bucket.resources[i]].aliasPredecessor = predecessor;
+        }
+    }
+
+    // Views can only be created once memory is bound.
+    for (const auto& candidate : candidates) {
+        auto& resource = m_resources[candidate.handle];
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = resource.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = resource.desc.format;
+        viewInfo.subresourceRange.aspectMask = isDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(*m_device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create render graph image view " + resource.name + ".");
+        }
+    }
+}
+
+void RenderGraph::createRenderPasses() {
+    for (uint32_t order = 0; order < m_executionOrder.size(); ++order) {
+        auto& pass = m_passes[m_executionOrder[order]];
+        if (pass.type != PassType::Graphics) continue;
+
+        std::vector<ResourceAccess> colorAccesses = {};
+        std::vector<ResourceAccess> depthAccesses = {};
+        std::vector<ResourceAccess> resolveAccesses = {};
+        for (const auto& write : pass.writes) {
+            if (write.access == Access::ColorAttachmentWrite) colorAccesses.push_back(write);
+            if (write.access == Access::DepthAttachmentWrite) depthAccesses.push_back(write);
+            if (write.access == Access::ColorResolveWrite) resolveAccesses.push_back(write);
+        }
+        for (const auto& read : pass.reads) {
+            if (read.access == Access::DepthAttachmentRead) depthAccesses.push_back(read);
+        }
+        if (depthAccesses.size() > 1) {
+            throw std::runtime_error("Render graph pass " + pass.name + " binds more than one depth attachment.");
+        }
+
+        auto& attachmentDescs = pass.attachmentDescs;
+        auto& colorRefs = pass.colorRefs;
+        auto& depthRef = pass.depthRef;
+
+        auto addAttachment = [&](const ResourceAccess& item) {
+            const auto& resource = m_resources[item.resource];
+            auto info = RenderGraphStructs::describeAccess(item.access, pass.type);
+
+            // Keep the contents only when somebody looks at them afterwards.
+            bool isReadLater = resource.isImported || resource.lastPass > order;
+
+            // Layout transitions are done by the graph barriers, never by the render pass.
+            VkAttachmentDescription desc = {};
+            desc.format = resource.desc.format;
+            desc.samples = resource.desc.samples;
+            desc.loadOp = item.loadOp == LoadOp::Clear ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+                          item.loadOp == LoadOp::Load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            desc.storeOp = isReadLater ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            desc.initialLayout = info.layout;
+            desc.finalLayout = info.layout;
+
+            VkAttachmentReference ref = {};
+            ref.attachment = attachmentDescs.size();
+            ref.layout = info.layout;
+
+            attachmentDescs.push_back(desc);
+            pass.attachments.push_back(item.resource);
+            pass.clearValues.push_back(item.clearValue);
+
+            return ref;
+        };
+
+        for (const auto& item : colorAccesses) {
+            colorRefs.push_back(addAttachment(item));
+        }
+        if (!depthAccesses.empty()) {
+            depthRef = addAttachment(depthAccesses[0]);
+        }
+
+        // Resolve references are parallel to the color references.
+        auto& resolveRefs = pass.resolveRefs;
+        if (!resolveAccesses.empty()) {
+            resolveRefs.resize(colorRefs.size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+        }
+        for (const auto& item : resolveAccesses) {
+            auto source = std::find_if(colorAccesses.begin(), colorAccesses.end(), [&](const ResourceAccess& color) {
+                return color.resource == item.resolveSource;
+            });
+            if (source == colorAccesses.end()) {
+                throw std::runtime_error("Render graph pass " + pass.name + " resolves an image it does not render to.");
+            }
+            resolveRefs[source - colorAccesses.begin()] = addAttachment(item);
+        }
+
+        if (pass.attachments.empty()) {
+            throw std::runtime_error("Render graph pass " + pass.name + " has no attachments.");
+        }
+        pass.extent = m_resources[pass.attachments[0]].extent;
+
+        if (m_info.enableDynamicRendering) continue;
+
+        VkSubpassDescription subpassDesc = {};
+        subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpassDesc.colorAttachmentCount = colorRefs.size();
+        subpassDesc.pColorAttachments = colorRefs.data();
+        subpassDesc.pResolveAttachments = resolveRefs.empty() ? nullptr : resolveRefs.data();
+        subpassDesc.pDepthStencilAttachment = depthRef.attachment == VK_ATTACHMENT_UNUSED ? nullptr : &depthRef;
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = attachmentDescs.size();
+        renderPassInfo.pAttachments = attachmentDescs.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpassDesc;
+        renderPassInfo.dependencyCount = 0; // Covered by the barriers recorded before the pass.
+        renderPassInfo.pDependencies = nullptr;
+
+        if (vkCreateRenderPass(*m_device, &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create render pass for render graph pass " + pass.name + ".");
+        }
+    }
+}
+
+void RenderGraph::computeBarriers() {
+    // What the next access of each resource has to wait for.
+    struct State {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;
+        VkPipelineStageFlags visibleStages = 0; // Stages already synchronized with the last write.
+    };
+
+    std::vector<State> states(m_resources.size());
+    for (ResourceHandle i = 0; i < m_resources.size(); ++i) {
+        const auto& resource = m_resources[i];
+        auto& state = states[i];
+
+        if (resource.isImported && resource.isImage) {
+            state.layout = resource.initialLayout;
+            state.writeStages = resource.initialStages;
+            state.writeAccess = resource.initialAccess;
+            continue;
+        }
+
+        // Transient images and imported buffers wait for the last use of the memory in the previous frame.
+        auto previous = resource.aliasPredecessor != InvalidHandle ? resource.aliasPredecessor : i;
+        const auto& lastAccess = m_resources[previous].lastAccess;
+        if (lastAccess.isWrite) {
+            state.writeStages = lastAccess.stages;
+            state.writeAccess = lastAccess.access;
+        }
+        else {
+            state.readStages = lastAccess.stages;
+        }
+    }
+
+    for (auto passHandle : m_executionOrder) {
+        auto& pass = m_passes[passHandle];
+
+        auto visit = [&](const ResourceAccess& item) {
+            const auto& resource = m_resources[item.resource];
+            auto& state = states[item.resource];
+            auto info = RenderGraphStructs::describeAccess(item.access, pass.type);
+
+            bool isLayoutChanged = resource.isImage && info.layout != state.layout;
+
+            VkPipelineStageFlags srcStages = 0;
+            bool isHazard = false;
+            if (info.isWrite) {
+                // WAW and WAR.
+                srcStages = state.writeStages | state.readStages;
+                isHazard = srcStages != 0 || isLayoutChanged;
+            }
+            else {
+                // RAW, unless an earlier barrier already made the write visible to these stages.
+                srcStages = state.writeStages | (isLayoutChanged ? state.readStages : 0);
+                isHazard = (state.writeStages != 0 && (info.stages & ~state.visibleStages) != 0) || isLayoutChanged;
+            }
+            if (!isHazard) {
+                state.readStages |= info.isWrite ? 0 : info.stages;
+                return;
+            }
+
+            pass.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            pass.dstStages |= info.stages;
+
+            if (resource.isImage) {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = state.writeAccess;
+                barrier.dstAccessMask = info.access;
+                barrier.oldLayout = state.layout; // UNDEFINED on first use discards the previous contents.
+                barrier.newLayout = info.layout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.subresourceRange.aspectMask = isDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+                barrier.subresourceRange.baseMipLevel = 0;
+                barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+                barrier.subresourceRange.baseArrayLayer = 0;
+                barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+                pass.imageBarriers.push_back({ item.resource, barrier });
+            }
+            else {
+                VkBufferMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = state.writeAccess;
+                barrier.dstAccessMask = info.access;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                pass.bufferBarriers.push_back({ item.resource, barrier });
+            }
+            ++m_barrierCount;
+
+            if (info.isWrite) {
+                state.writeStages = info.stages;
+                state.writeAccess = info.access;
+                state.readStages = 0;
+                state.visibleStages = 0;
+            }
+            else {
+                // A layout transition counts as a write that only these stages have waited for.
+                if (isLayoutChanged) {
+                    state.writeStages = info.stages;
+                    state.writeAccess = 0;
+                    state.visibleStages = 0;
+                }
+                state.readStages |= info.stages;
+                state.visibleStages |= info.stages;
+            }
+            if (resource.isImage) {
+                state.layout = info.layout;
+            }
+        };
+        std::for_each(pass.reads.begin(), pass.reads.end(), visit);
+        std::for_each(pass.writes.begin(), pass.writes.end(), visit);
+    }
+
+    // Hand imported images back in the layout their owner expects, e.g. PRESENT_SRC_KHR.
+    for (ResourceHandle i = 0; i < m_resources.size(); ++i) {
+        const auto& resource = m_resources[i];
+        const auto& state = states[i];
+        if (!resource.isImported || !resource.isImage || resource.firstPass == UINT32_MAX) continue;
+        if (resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == state.layout) continue;
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = state.writeAccess;
+        barrier.dstAccessMask = 0; // Presentation and semaphores make the contents visible.
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = resource.finalLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = isDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+        m_finalBarriers.push_back({ i, barrier });
+        m_finalSrcStages |= state.writeStages | state.readStages;
+        ++m_barrierCount;
+    }
+    if (m_finalSrcStages == 0) {
+        m_finalSrcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+}
+
+VkFramebuffer RenderGraph::acquireFramebuffer(const Pass& pass) {
+    std::vector<VkImageView> views(pass.attachments.size());
+    for (size_t i = 0; i < pass.attachments.size(); ++i) {
+        views[i] = m_resources[pass.attachments[i]].view;
+    }
+
+    auto key = std::make_pair(static_cast<PassHandle>(&pass - m_passes.data()), views);
+    auto itor = m_framebuffers.find(key);
+    if (itor != m_framebuffers.end()) {
+        return itor->second;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = pass.renderPass;
+    framebufferInfo.attachmentCount = views.size();
+    framebufferInfo.pAttachments = views.data();
+    framebufferInfo.width = pass.extent.width;
+    framebufferInfo.height = pass.extent.height;
+    framebufferInfo.layers = 1;
+
+    VkFramebuffer framebuffer = {};
+    if (vkCreateFramebuffer(*m_device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create framebuffers.");
+    }
+
+    m_framebuffers.insert({ key, framebuffer });
+    return framebuffer;
+}
+
+void RenderGraph::beginDynamicRendering(VkCommandBuffer commandBuffer, const Pass& pass) {
+#ifdef VK_KHR_dynamic_rendering
+    auto makeAttachmentInfo = [&](const VkAttachmentReference& ref) {
+        const auto& desc = pass.attachmentDescs[ref.attachment];
+
+        VkRenderingAttachmentInfoKHR attachmentInfo = {};
+        attachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        attachmentInfo.imageView = m_resources[pass.attachments[ref.attachment]].view;
+        attachmentInfo.imageLayout = ref.layout;
+        attachmentInfo.resolveMode = VK_RESOLVE_MODE_NONE;
+        attachmentInfo.loadOp = desc.loadOp;
+        attachmentInfo.storeOp = desc.storeOp;
+        attachmentInfo.clearValue = pass.clearValues[ref.attachment];
+        return attachmentInfo;
+    };
+
+    std::vector<VkRenderingAttachmentInfoKHR> colorInfos = {};
+    for (size_t i = 0; i < pass.colorRefs.size(); ++i) {
+        auto attachmentInfo = makeAttachmentInfo(pass.colorRefs[i]);
+        if (i < pass.resolveRefs.size() && pass.resolveRefs[i].attachment != VK_ATTACHMENT_UNUSED) {
+            attachmentInfo.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+            attachmentInfo.resolveImageView = m_resources[pass.attachments[pass.resolveRefs[i].attachment]].view;
+            attachmentInfo.resolveImageLayout = pass.resolveRefs[i].layout;
+        }
+        colorInfos.push_back(attachmentInfo);
+    }
+
+    VkRenderingAttachmentInfoKHR depthInfo = {};
+    bool hasDepth = pass.depthRef.attachment != VK_ATTACHMENT_UNUSED;
+    if (hasDepth) {
+        depthInfo = makeAttachmentInfo(pass.depthRef);
+    }
+
+    VkRenderingInfoKHR renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea.offset = { 0, 0 };
+    renderingInfo.renderArea.extent = pass.extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = colorInfos.size();
+    renderingInfo.pColorAttachments = colorInfos.data();
+    renderingInfo.pDepthAttachment = hasDepth ? &depthInfo : nullptr;
+
+    m_cmdBeginRendering(commandBuffer, &renderingInfo);
+#else
+    // Never reached, since init() turns dynamic rendering off without the extension.
+    ((void)(commandBuffer));
+    ((void)(pass));
+#endif
+}
+
+uint32_t RenderGraph::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, bool& found) const {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            found = true;
+            return i;
+        }
+    }
+    found = false;
+    return 0;
+}
+
+bool RenderGraph::isDepthFormat(VkFormat format) {
+    return format == VK_FORMAT_D16_UNORM ||
+           format == VK_FORMAT_D32_SFLOAT ||
+           format == VK_FORMAT_D16_UNORM_S8_UINT ||
+           format == VK_FORMAT_D24_UNORM_S8_UINT ||
+           format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
@@ -0,0 +1,323 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace RenderGraphStructs {
+    enum class PassType : uint8_t {
+        Graphics = 0, // Wrapped in a render pass made of its attachment accesses.
+        Compute = 1,
+        Transfer = 2
+    };
+
+    // How a pass touches a resource; decides pipeline stages, access masks and image layouts.
+    enum class Access : uint8_t {
+        ColorAttachmentWrite = 0,
+        DepthAttachmentWrite = 1,
+        DepthAttachmentRead = 2, // Bound read-only for depth testing.
+        SampledRead = 3,
+        StorageRead = 4,
+        StorageWrite = 5,
+        TransferSrc = 6,
+        TransferDst = 7,
+        IndirectRead = 8,
+        VertexRead = 9,
+        ColorResolveWrite = 10 // Target of a multisample resolve at the end of a graphics pass.
+    };
+
+    enum class LoadOp : uint8_t {
+        Load = 0,
+        Clear = 1,
+        DontCare = 2
+    };
+
+    struct ImageDesc {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+
+        // Zero means the extent passed to compile(), i.e. the backbuffer extent.
+        VkExtent2D extent = { 0, 0 };
+
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    };
+
+    struct AccessInfo {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access = 0;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        bool isWrite = false;
+    };
+
+    AccessInfo describeAccess(Access access, PassType passType);
+
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // Record graphics passes with vkCmdBeginRenderingKHR against image views instead of
+        // render pass and framebuffer objects. The device must have VK_KHR_dynamic_rendering enabled;
+        // ignored when the Vulkan headers predate the extension.
+        bool enableDynamicRendering = false;
+    };
+}
+
+// Passes declare the resources they read and write; compile() derives everything else:
+//   - passes whose results never reach an imported resource are culled;
+//   - one batched vkCmdPipelineBarrier per pass covers exactly the hazards and layout transitions;
+//   - graphics passes get a render pass whose store ops drop attachments nobody reads later;
+//   - transient images whose lifetimes do not overlap share the same device memory.
+// The graph structure is declared once; compile() is repeated whenever the backbuffer changes.
+class RenderGraph {
+public:
+    using PassType = RenderGraphStructs::PassType;
+    using Access = RenderGraphStructs::Access;
+    using LoadOp = RenderGraphStructs::LoadOp;
+    using ImageDesc = RenderGraphStructs::ImageDesc;
+
+    using ResourceHandle = uint32_t;
+    using PassHandle = uint32_t;
+    constexpr static uint32_t InvalidHandle = UINT32_MAX;
+
+    using ExecuteFunc = std::function<void(VkCommandBuffer)>;
+    using ConditionFunc = std::function<bool()>;
+    using PassScopeFunc = std::function<void(VkCommandBuffer, PassHandle)>;
+
+public:
+    RenderGraph() = default;
+    ~RenderGraph();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const RenderGraphStructs::CreateInfo& info);
+
+    // Resources.
+
+    // Owned by the graph and only valid during execution; contents never survive a frame.
+    ResourceHandle createImage(const std::string& name, const ImageDesc& desc);
+
+    // Owned outside the graph and bound before every execute(), e.g. the swapchain image.
+    // The image is expected in initialLayout after initialStages and is left in finalLayout.
+    // initialAccess names writes made before the graph runs, e.g. by the previous frame,
+    // which the first use has to make visible.
+    ResourceHandle importImage(const std::string& name, const ImageDesc& desc,
+                               VkImageLayout initialLayout, VkPipelineStageFlags initialStages,
+                               VkImageLayout finalLayout, VkAccessFlags initialAccess = 0);
+
+    ResourceHandle importBuffer(const std::string& name);
+
+    void bindImportedImage(ResourceHandle resource, VkImage image, VkImageView view);
+
+    void bindImportedBuffer(ResourceHandle resource, VkBuffer buffer);
+
+    // Passes.
+
+    PassHandle addPass(const std::string& name, PassType type);
+
+    void readImage(PassHandle pass, ResourceHandle resource, Access access);
+
+    // The load op and clear value only apply to attachment writes.
+    void writeImage(PassHandle pass, ResourceHandle resource, Access access,
+                    LoadOp loadOp = LoadOp::DontCare, VkClearValue clearValue = {});
+
+    // Resolve a multisampled color attachment written by the same pass into a single-sampled image,
+    // inside the render pass, so the multisampled contents never have to leave tile memory.
+    void resolveImage(PassHandle pass, ResourceHandle source, ResourceHandle target);
+
+    void readBuffer(PassHandle pass, ResourceHandle resource, Access access);
+
+    void writeBuffer(PassHandle pass, ResourceHandle resource, Access access);
+
+    void setExecute(PassHandle pass, const ExecuteFunc& func);
+
+    // Asked at every execute(); when false the pass records its barriers but neither its render pass
+    // nor its execute function, so what it wrote last time is left as it was. Barriers stay those
+    // computed at compile(), which hold either way as long as no layout is UNDEFINED on first use.
+    void setCondition(PassHandle pass, const ConditionFunc& func);
+
+    // Called around every live pass, barriers included, e.g. to write GPU timestamps.
+    void setPassScopeCallbacks(const PassScopeFunc& begin, const PassScopeFunc& end);
+
+    // Pass handles are indices below passCount().
+    inline size_t passCount() const { return m_passes.size(); }
+    inline const std::string& passName(PassHandle pass) const { return m_passes[pass].name; }
+
+    // Compilation and execution.
+
+    void compile(VkExtent2D backbufferExtent);
+
+    // Record all live passes; imported resources must be bound.
+    void execute(VkCommandBuffer commandBuffer);
+
+    // Only valid for live graphics passes after compile(); VK_NULL_HANDLE with dynamic rendering.
+    VkRenderPass renderPass(PassHandle pass) const;
+
+    inline bool isDynamicRenderingEnabled() const { return m_info.enableDynamicRendering; }
+
+    inline bool isPassCulled(PassHandle pass) const { return m_passes[pass].isCulled; }
+
+    VkImageView imageView(ResourceHandle resource) const;
+
+    // Memory actually bound to transient images, and what it would be without aliasing.
+    inline VkDeviceSize transientMemorySize() const { return m_transientMemorySize; }
+    inline VkDeviceSize unaliasedTransientMemorySize() const { return m_unaliasedTransientMemorySize; }
+
+    inline size_t transientAllocationCount() const { return m_memoryBuckets.size(); }
+
+    inline size_t barrierCount() const { return m_barrierCount; }
+
+    // Release everything compile() created; declarations are kept.
+    void destroyCompiledResources();
+
+    void destroy();
+
+private:
+    struct ResourceAccess {
+        ResourceHandle resource = InvalidHandle;
+        Access access = Access::SampledRead;
+        LoadOp loadOp = LoadOp::Load;
+        VkClearValue clearValue = {};
+
+        // Only used by resolve writes.
+        ResourceHandle resolveSource = InvalidHandle;
+    };
+
+    struct Pass {
+        std::string name = {};
+        PassType type = PassType::Graphics;
+
+        std::vector<ResourceAccess> reads = {};
+        std::vector<ResourceAccess> writes = {};
+
+        ExecuteFunc execute = {};
+        ConditionFunc condition = {};
+
+        // Compiled data.
+        bool isCulled = false;
+
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        std::vector<std::pair<ResourceHandle, VkImageMemoryBarrier>> imageBarriers = {};
+        std::vector<std::pair<ResourceHandle, VkBufferMemoryBarrier>> bufferBarriers = {};
+
+        // Attachment descriptions and references are kept for dynamic rendering,
+        // where they are turned into rendering infos at execution instead of a render pass.
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        std::vector<ResourceHandle> attachments = {};
+        std::vector<VkAttachmentDescription> attachmentDescs = {};
+        std::vector<VkClearValue> clearValues = {};
+        std::vector<VkAttachmentReference> colorRefs = {};
+        std::vector<VkAttachmentReference> resolveRefs = {}; // Parallel to colorRefs; may be empty.
+        VkAttachmentReference depthRef = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+        VkExtent2D extent = {};
+    };
+
+    struct Resource {
+        std::string name = {};
+        bool isImage = true;
+        bool isImported = false;
+        ImageDesc desc = {};
+
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags initialStages = 0;
+        VkAccessFlags initialAccess = 0;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+
+        // Compiled data.
+        VkImageUsageFlags usage = 0;
+        VkExtent2D extent = {};
+        uint32_t firstPass = UINT32_MAX; // Index in execution order of live passes.
+        uint32_t lastPass = 0;
+        RenderGraphStructs::AccessInfo lastAccess = {};
+
+        // The transient image previously placed in the same memory, whose last use the first
+        // use of this one must wait for (possibly in the previous frame).
+        ResourceHandle aliasPredecessor = InvalidHandle;
+    };
+
+    struct MemoryBucket {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memoryTypeBits = UINT32_MAX;
+        bool isLazilyAllocatable = true;
+        std::vector<ResourceHandle> resources = {};
+    };
+
+    void cullPasses();
+
+    void computeLifetimes();
+
+    void createTransientImages();
+
+    void aliasTransientMemory();
+
+    void createRenderPasses();
+
+    void computeBarriers();
+
+    VkFramebuffer acquireFramebuffer(const Pass& pass);
+
+    void beginDynamicRendering(VkCommandBuffer commandBuffer, const Pass& pass);
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, bool& found) const;
+
+    static bool isDepthFormat(VkFormat format);
+
+private:
+    VkDevice* m_device = nullptr;
+
+    RenderGraphStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    std::vector<Pass> m_passes = {};
+
+    std::vector<Resource> m_resources = {};
+
+    // Live passes in execution order, which is declaration order.
+    std::vector<PassHandle> m_executionOrder = {};
+
+    PassScopeFunc m_passScopeBegin = {};
+    PassScopeFunc m_passScopeEnd = {};
+
+    VkExtent2D m_backbufferExtent = {};
+
+    std::vector<MemoryBucket> m_memoryBuckets = {};
+
+    // Imported views change every frame (e.g. swapchain images), so framebuffers are cached by view.
+    std::map<std::pair<PassHandle, std::vector<VkImageView>>, VkFramebuffer> m_framebuffers = {};
+
+    std::vector<std::pair<ResourceHandle, VkImageMemoryBarrier>> m_finalBarriers = {};
+    VkPipelineStageFlags m_finalSrcStages = 0;
+
+    VkDeviceSize m_transientMemorySize = 0;
+    VkDeviceSize m_unaliasedTransientMemorySize = 0;
+
+    size_t m_barrierCount = 0;
+
+#ifdef VK_KHR_dynamic_rendering
+    PFN_vkCmdBeginRenderingKHR m_cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR m_cmdEndRendering = nullptr;
+#endif
+};
+
+#endif // RENDER_GRAPH_H
@@ -0,0 +1,188 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <numeric>
+#include <stdexcept>
+
+#include "Scene.h"
+
+// Composing every local matrix in SIMD batches beats picking out the dirty ones past this fraction.
+constexpr static size_t BATCH_COMPOSE_DIVISOR = 4;
+
+void Scene::reserve(size_t count) {
+    for (auto component : { &m_localTransforms.positionX, &m_localTransforms.positionY, &m_localTransforms.positionZ,
+                            &m_localTransforms.rotationX, &m_localTransforms.rotationY, &m_localTransforms.rotationZ,
+                            &m_localTransforms.rotationW, &m_localTransforms.scaleX, &m_localTransforms.scaleY,
+                            &m_localTransforms.scaleZ }) {
+        component->reserve(count);
+    }
+    m_localMatrices.reserve(count);
+    m_worldMatrices.reserve(count);
+    m_localBounds.reserve(count);
+    m_worldBounds.reserve(count);
+    m_parentIndices.reserve(count);
+    m_depths.reserve(count);
+    m_isLocalDirty.reserve(count);
+    m_isWorldDirty.reserve(count);
+    m_nodeOfIndex.reserve(count);
+    m_indexOfNode.reserve(count);
+}
+
+Scene::NodeId Scene::createNode(NodeId parent, const Bounds& localBounds) {
+    if (parent != InvalidNode && parent >= m_indexOfNode.size()) {
+        throw std::runtime_error("Scene node parent does not exist");
+    }
+
+    auto node = static_cast<NodeId>(m_indexOfNode.size());
+    auto index = static_cast<uint32_t>(m_nodeOfIndex.size());
+
+    uint32_t parentIndex = parent == InvalidNode ? InvalidIndex : m_indexOfNode[parent];
+    uint32_t depth = parent == InvalidNode ? 0 : m_depths[parentIndex] + 1;
+
+    if (!m_depths.empty() && depth < m_depths.back()) {
+        m_isOrderDirty = true;
+    }
+
+    m_localTransforms.resize(index + 1);
+    m_localMatrices.push_back(glm::mat4(1.0f));
+    m_worldMatrices.push_back(glm::mat4(1.0f));
+    m_localBounds.push_back(localBounds);
+    m_worldBounds.push_back(localBounds);
+    m_parentIndices.push_back(parentIndex);
+    m_depths.push_back(depth);
+    m_isLocalDirty.push_back(0);
+    m_isWorldDirty.push_back(0);
+    m_nodeOfIndex.push_back(node);
+    m_indexOfNode.push_back(index);
+
+    markLocalDirty(index);
+    ++m_structureVersion;
+
+    return node;
+}
+
+void Scene::setLocalTransform(NodeId node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    auto index = m_indexOfNode[node];
+    m_localTransforms.set(index, position, rotation, scale);
+    markLocalDirty(index);
+}
+
+void Scene::setLocalBounds(NodeId node, const Bounds& bounds) {
+    auto index = m_indexOfNode[node];
+    m_localBounds[index] = bounds;
+    markLocalDirty(index);
+}
+
+void Scene::markLocalDirty(uint32_t index) {
+    if (m_isLocalDirty[index]) return;
+    m_isLocalDirty[index] = 1;
+    ++m_localDirtyCount;
+}
+
+void Scene::sortByDepth() {
+    size_t count = m_nodeOfIndex.size();
+
+    // Stable, so siblings keep their creation order and parents stay ahead of children.
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_depths[a] < m_depths[b]; });
+
+    std::vector<uint32_t> newIndexOf(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        newIndexOf[order[i]] = i;
+    }
+
+    auto permute = [&](auto& values) {
+        std::remove_reference_t<decltype(values)> sorted(count);
+        for (size_t i = 0; i < count; ++i) {
+            sorted[i] = values[order[i]];
+        }
+        values.swap(sorted);
+    };
+
+    for (auto component : { &m_localTransforms.positionX, &m_localTransforms.positionY, &m_localTransforms.positionZ,
+                            &m_localTransforms.rotationX, &m_localTransforms.rotationY, &m_localTransforms.rotationZ,
+                            &m_localTransforms.rotationW, &m_localTransforms.scaleX, &m_localTransforms.scaleY,
+                            &m_localTransforms.scaleZ }) {
+        permute(*component);
+    }
+    permute(m_localMatrices);
+    permute(m_worldMatrices);
+    permute(m_localBounds);
+    permute(m_worldBounds);
+    permute(m_parentIndices);
+    permute(m_depths);
+    permute(m_isLocalDirty);
+    permute(m_isWorldDirty);
+    permute(m_nodeOfIndex);
+
+    for (auto& parentIndex : m_parentIndices) {
+        if (parentIndex != InvalidIndex) parentIndex = newIndexOf[parentIndex];
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        m_indexOfNode[m_nodeOfIndex[i]] = i;
+    }
+
+    m_isOrderDirty = false;
+}
+
+// Arvo's method: the extents of a transformed box are the absolute matrix applied to the extents.
+static SceneStructs::Bounds transformBounds(const glm::mat4& matrix, const SceneStructs::Bounds& bounds) {
+    SceneStructs::Bounds result = {};
+    result.center = glm::vec3(matrix * glm::vec4(bounds.center, 1.0f));
+    for (int r = 0; r < 3; ++r) {
+        result.extents[r] = std::abs(matrix[0][r]) * bounds.extents.x +
+                            std::abs(matrix[1][r]) * bounds.extents.y +
+                            std::abs(matrix[2][r]) * bounds.extents.z;
+    }
+    return result;
+}
+
+void Scene::update() {
+    if (m_isOrderDirty) {
+        sortByDepth();
+    }
+
+    size_t count = m_nodeOfIndex.size();
+    bool isBatchComposed = m_localDirtyCount * BATCH_COMPOSE_DIVISOR >= count;
+    if (isBatchComposed) {
+        TransformMath::composeMatrices(m_localTransforms, m_localMatrices.data());
+    }
+
+    // Parents come first, so their world dirty flags are final by the time children read them.
+    m_updatedNodeCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t parentIndex = m_parentIndices[i];
+        bool isParentDirty = parentIndex != InvalidIndex && m_isWorldDirty[parentIndex];
+
+        m_isWorldDirty[i] = m_isLocalDirty[i] || isParentDirty;
+        if (!m_isWorldDirty[i]) continue;
+
+        if (m_isLocalDirty[i] && !isBatchComposed) {
+            TransformMath::composeMatrices(m_localTransforms, i, 1, &m_localMatrices[i]);
+        }
+        m_isLocalDirty[i] = 0;
+
+        if (parentIndex == InvalidIndex) {
+            m_worldMatrices[i] = m_localMatrices[i];
+        }
+        else {
+            TransformMath::multiplyMatrices(&m_worldMatrices[parentIndex], &m_localMatrices[i], &m_worldMatrices[i], 1);
+        }
+        m_worldBounds[i] = transformBounds(m_worldMatrices[i], m_localBounds[i]);
+
+        ++m_updatedNodeCount;
+    }
+
+    m_localDirtyCount = 0;
+}
@@ -0,0 +1,107 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include "TransformMath.h"
+
+namespace SceneStructs {
+    using NodeId = uint32_t;
+
+    constexpr static NodeId InvalidNode = UINT32_MAX;
+
+    // Axis aligned.
+    struct Bounds {
+        glm::vec3 center = {};
+        glm::vec3 extents = {}; // Half size.
+    };
+}
+
+// A transform hierarchy kept as flat arrays sorted by depth, so that every parent comes before
+// its children and world transforms propagate in a single linear pass. Only nodes whose local
+// transform changed, or whose parent's world transform changed, are recomputed by update().
+//
+// Node ids are stable; the array index of a node (nodeIndex()) may change whenever nodes are
+// created, which bumps structureVersion().
+class Scene {
+public:
+    using NodeId = SceneStructs::NodeId;
+    using Bounds = SceneStructs::Bounds;
+
+    constexpr static NodeId InvalidNode = SceneStructs::InvalidNode;
+    constexpr static uint32_t InvalidIndex = UINT32_MAX;
+
+public:
+    void reserve(size_t count);
+
+    // The parent must have been created before; InvalidNode makes a root.
+    NodeId createNode(NodeId parent = InvalidNode, const Bounds& localBounds = {});
+
+    void setLocalTransform(NodeId node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.0f));
+
+    void setLocalBounds(NodeId node, const Bounds& bounds);
+
+    // Restore depth order if needed and bring world matrices and bounds up to date.
+    void update();
+
+    inline size_t nodeCount() const { return m_nodeOfIndex.size(); }
+
+    inline uint32_t nodeIndex(NodeId node) const { return m_indexOfNode[node]; }
+
+    inline uint64_t structureVersion() const { return m_structureVersion; }
+
+    // Indexed by nodeIndex() and valid after update(); contiguous so that they can be copied
+    // to GPU buffers as they are.
+
+    inline const std::vector<glm::mat4>& worldMatrices() const { return m_worldMatrices; }
+
+    inline const std::vector<Bounds>& worldBounds() const { return m_worldBounds; }
+
+    inline const std::vector<uint32_t>& parentIndices() const { return m_parentIndices; }
+
+    // Nodes recomputed by the last update().
+    inline size_t updatedNodeCount() const { return m_updatedNodeCount; }
+
+private:
+    // Per node, in depth order.
+    TransformMath::TransformSoA m_localTransforms = {};
+    std::vector<glm::mat4> m_localMatrices = {};
+    std::vector<glm::mat4> m_worldMatrices = {};
+    std::vector<Bounds> m_localBounds = {};
+    std::vector<Bounds> m_worldBounds = {};
+    std::vector<uint32_t> m_parentIndices = {};
+    std::vector<uint32_t> m_depths = {};
+    std::vector<uint8_t> m_isLocalDirty = {};
+    std::vector<uint8_t> m_isWorldDirty = {};
+    std::vector<NodeId> m_nodeOfIndex = {};
+
+    // Per node id.
+    std::vector<uint32_t> m_indexOfNode = {};
+
+    size_t m_localDirtyCount = 0;
+    size_t m_updatedNodeCount = 0;
+
+    // Set when a node is created shallower than the last one.
+    bool m_isOrderDirty = false;
+    uint64_t m_structureVersion = 0;
+
+    void sortByDepth();
+
+    void markLocalDirty(uint32_t index);
+};
+
+#endif // SCENE_H
@@ -64,6 +64,23 @@ VkPipelineShaderStageCreateInfo ShaderContainer::generateCreateInfo(const std::s
     return info;
 }
 
+VkPipelineShaderStageCreateInfo ShaderContainer::generateCreateInfo(VkShaderModule module) {
+    for (const auto& shader : m_shaders) {
+        if (shader.second.module == module) {
+            return generateCreateInfo(shader.first);
+        }
+    }
+    throw std::runtime_error("Failed to find shader with given module.");
+}
+
+VkShaderModule ShaderContainer::shaderModule(const std::string& name) {
+    auto itor = m_shaders.find(name);
+    if (itor == m_shaders.end()) {
+        throw std::runtime_error("Failed to find shader " + name + ".");
+    }
+    return itor->second.module;
+}
+
 std::vector<VkPipelineShaderStageCreateInfo> ShaderContainer::generateAllCreateInfos() {
     std::vector<VkPipelineShaderStageCreateInfo> infos(m_shaders.size());
 
@@ -127,6 +144,9 @@ void ShaderContainer::convertStageType(ShaderContainer::StageType type, VkShader
         case Fragment:
             target = VK_SHADER_STAGE_FRAGMENT_BIT;
             break;
+        case Compute:
+            target = VK_SHADER_STAGE_COMPUTE_BIT;
+            break;
         default:
             throw std::runtime_error("Unknown shader stage type.");
     }
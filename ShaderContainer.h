@@ -30,6 +30,7 @@ public:
     constexpr static StageType Undefined = 0;
     constexpr static StageType Vertex = 1;
     constexpr static StageType Fragment = 2;
+    constexpr static StageType Compute = 3;
 
 public:
     ShaderContainer() = default;
@@ -48,6 +49,10 @@ public:
 
     VkPipelineShaderStageCreateInfo generateCreateInfo(const std::string& name);
 
+    VkPipelineShaderStageCreateInfo generateCreateInfo(VkShaderModule module);
+
+    VkShaderModule shaderModule(const std::string& name);
+
     std::vector<VkPipelineShaderStageCreateInfo> generateAllCreateInfos();
 
     void destroyAllShaderModules();
@@ -0,0 +1,327 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+#include "GraphicsResource.h"
+#include "ShadowCascades.h"
+
+ShadowCascades::~ShadowCascades() {
+    destroy(); // In case someone forgets destroy the shadow maps.
+}
+
+void ShadowCascades::init(const ShadowCascadesStructs::CreateInfo& info) {
+    assert(info.cascadeCount > 0 && info.cascadeCount <= UniformBufferObject::MaxShadowCascadeCount);
+
+    m_info = info;
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+    m_format = selectFormat(m_info.physicalDevice);
+
+    // Only gathered, which never filters.
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(*m_device, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create shadow map sampler.");
+    }
+
+    m_cascades.resize(m_info.cascadeCount);
+    for (uint32_t i = 0; i < m_info.cascadeCount; ++i) {
+        auto& cascade = m_cascades[i];
+        cascade.isCached = i >= m_info.firstCachedCascade;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = m_format;
+        imageInfo.extent = { m_info.resolution, m_info.resolution, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(*m_device, &imageInfo, nullptr, &cascade.image) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create shadow map image.");
+        }
+
+        VkMemoryRequirements requirements = {};
+        vkGetImageMemoryRequirements(*m_device, cascade.image, &requirements);
+
+        VkMemoryAllocateInfo memoryAllocInfo = {};
+        memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memoryAllocInfo.allocationSize = requirements.size;
+        memoryAllocInfo.memoryTypeIndex = findAdequateMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (vkAllocateMemory(*m_device, &memoryAllocInfo, nullptr, &cascade.memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate shadow map memory.");
+        }
+        vkBindImageMemory(*m_device, cascade.image, cascade.memory, 0);
+        m_memorySize += requirements.size;
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = cascade.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = m_format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(*m_device, &viewInfo, nullptr, &cascade.view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create shadow map image view.");
+        }
+    }
+
+    clear();
+
+    // Sampled in SHADER_READ_ONLY_OPTIMAL, where the maps are left between frames.
+    for (auto& cascade : m_cascades) {
+        cascade.slot = m_info.bindlessDescriptors->registerImage(cascade.view, m_sampler);
+    }
+}
+
+VkFormat ShadowCascades::selectFormat(VkPhysicalDevice physicalDevice) {
+    // D16_UNORM is always supported for both.
+    const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    for (auto format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }) {
+        VkFormatProperties properties = {};
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        if ((properties.optimalTilingFeatures & features) == features) {
+            return format;
+        }
+    }
+    throw std::runtime_error("Failed to find a supported shadow map format.");
+}
+
+void ShadowCascades::update(const Camera& camera, const glm::vec3& lightDirection,
+                            const std::vector<Bounds>& changedBounds, bool isEverythingChanged) {
+    auto direction = glm::normalize(lightDirection);
+    bool isLightChanged = direction != m_lightDirection;
+    if (isLightChanged) {
+        // Rotation only, so every cascade is a plain box in it.
+        m_lightDirection = direction;
+        auto up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        m_lightViewMat = glm::lookAtLH(glm::vec3(0.0f), direction, up);
+    }
+
+    float nearZ = camera.nearZ();
+    float farZ = m_info.shadowDistance > 0.0f ? std::min(m_info.shadowDistance, camera.farZ()) : camera.farZ();
+
+    // The slices are symmetric around the view axis, as are their bounding spheres, whose radii thus
+    // do not change as the camera moves or turns.
+    float tanHalfFovY = std::tan(glm::radians(camera.verticalFov()) * 0.5f);
+    float tanHalfFovX = tanHalfFovY * camera.aspectRatio();
+    float cornerScale = std::sqrt(tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY);
+
+    uint32_t cachedUpdateBudget = m_info.maxCachedUpdatesPerFrame;
+    m_renderedCascadeCount = 0;
+
+    for (uint32_t i = 0; i < m_cascades.size(); ++i) {
+        auto& cascade = m_cascades[i];
+
+        // Practical split scheme: logarithmic splits keep the texel density even with depth,
+        // uniform ones keep near cascades from getting too thin.
+        float t = static_cast<float>(i + 1) / static_cast<float>(m_cascades.size());
+        float logarithmicSplit = nearZ * std::pow(farZ / nearZ, t);
+        float uniformSplit = nearZ + (farZ - nearZ) * t;
+        cascade.nearZ = i == 0 ? nearZ : m_cascades[i - 1].farZ;
+        cascade.farZ = uniformSplit + (logarithmicSplit - uniformSplit) * m_info.splitLambda;
+
+        float centerZ = 0.5f * (cascade.nearZ + cascade.farZ);
+        float halfDepth = 0.5f * (cascade.farZ - cascade.nearZ);
+        float nearRadius = cascade.nearZ * cornerScale;
+        float farRadius = cascade.farZ * cornerScale;
+        float radius = std::sqrt(halfDepth * halfDepth + std::max(nearRadius * nearRadius, farRadius * farRadius));
+
+        auto center = camera.eye() + camera.lookAt() * centerZ;
+        auto lightCenter = glm::vec3(m_lightViewMat * glm::vec4(center, 1.0f));
+
+        if (!cascade.isCached) {
+            fit(cascade, lightCenter, radius);
+            cascade.isRenderNeeded = true;
+            ++m_renderedCascadeCount;
+            continue;
+        }
+
+        // How far the slice reaches from the center of what the shadow map holds.
+        auto offset = glm::abs(lightCenter - cascade.center) + radius;
+        float reach = std::max(std::max(offset.x, offset.y), offset.z);
+
+        // Wrong unless rendered now.
+        bool isStale = !cascade.isValid || isLightChanged || radius != cascade.radius || reach > cascade.extent;
+
+        // Right for now, but casters changed or the camera is halfway through the margin.
+        bool isDue = isEverythingChanged || reach > cascade.extent - 0.5f * m_info.cacheMargin * radius;
+        for (size_t j = 0; !isDue && j < changedBounds.size(); ++j) {
+            isDue = isOverlapped(cascade, changedBounds[j]);
+        }
+
+        cascade.isRenderNeeded = isStale || (isDue && cachedUpdateBudget > 0);
+        if (!cascade.isRenderNeeded) continue;
+
+        if (!isStale) --cachedUpdateBudget;
+        fit(cascade, lightCenter, radius);
+        ++m_renderedCascadeCount;
+    }
+}
+
+float ShadowCascades::texelDepth(uint32_t cascade) const {
+    const auto& item = m_cascades[cascade];
+    float texelSize = 2.0f * item.extent / static_cast<float>(m_info.resolution);
+    return texelSize / (2.0f * item.extent + m_info.casterDistance);
+}
+
+void ShadowCascades::destroy() {
+    if (m_device == nullptr) return;
+
+    // Destroy: init()
+    for (auto& cascade : m_cascades) {
+        if (cascade.slot != BindlessDescriptors::InvalidSlot) {
+            m_info.bindlessDescriptors->unregisterImage(cascade.slot);
+        }
+        if (cascade.view != VK_NULL_HANDLE) vkDestroyImageView(*m_device, cascade.view, nullptr);
+        if (cascade.image != VK_NULL_HANDLE) vkDestroyImage(*m_device, cascade.image, nullptr);
+        if (cascade.memory != VK_NULL_HANDLE) vkFreeMemory(*m_device, cascade.memory, nullptr);
+    }
+    m_cascades.clear();
+    m_memorySize = 0;
+
+    if (m_sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(*m_device, m_sampler, nullptr);
+        m_sampler = VK_NULL_HANDLE;
+    }
+}
+
+void ShadowCascades::fit(Cascade& cascade, const glm::vec3& center, float radius) const {
+    // Cached cascades get room for the camera to move; all get half a texel for the snapping.
+    float resolution = static_cast<float>(m_info.resolution);
+    float extent = radius * (cascade.isCached ? 1.0f + m_info.cacheMargin : 1.0f) * resolution / (resolution - 1.0f);
+
+    // Whole texels only, so what the map holds never moves by a fraction of a texel.
+    float texelSize = 2.0f * extent / resolution;
+    cascade.center = glm::vec3(glm::floor(glm::vec2(center) / texelSize + 0.5f) * texelSize, center.z);
+    cascade.radius = radius;
+    cascade.extent = extent;
+
+    const auto& c = cascade.center;
+    cascade.projMat = glm::orthoLH_ZO(c.x - extent, c.x + extent, c.y - extent, c.y + extent,
+                                      c.z - extent - m_info.casterDistance, c.z + extent);
+    cascade.isValid = true;
+}
+
+bool ShadowCascades::isOverlapped(const Cascade& cascade, const Bounds& bounds) const {
+    // Bounds of the rotated box in light space.
+    auto rotation = glm::mat3(m_lightViewMat);
+    auto center = rotation * bounds.center;
+    glm::vec3 extents = {};
+    for (int axis = 0; axis < 3; ++axis) {
+        extents += glm::abs(rotation[axis]) * bounds.extents[axis];
+    }
+
+    auto boxMin = cascade.center - glm::vec3(cascade.extent, cascade.extent, cascade.extent + m_info.casterDistance);
+    auto boxMax = cascade.center + glm::vec3(cascade.extent);
+    return glm::all(glm::lessThanEqual(center - extents, boxMax)) &&
+           glm::all(glm::greaterThanEqual(center + extents, boxMin));
+}
+
+void ShadowCascades::clear() {
+    VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+    cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufferAllocInfo.commandPool = m_info.commandPool;
+    cmdBufferAllocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmdBuffer = {};
+    vkAllocateCommandBuffers(*m_device, &cmdBufferAllocInfo, &cmdBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+
+    std::vector<VkImageMemoryBarrier> barriers(m_cascades.size());
+    for (size_t i = 0; i < m_cascades.size(); ++i) {
+        auto& barrier = barriers[i];
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = m_cascades[i].image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+    }
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+
+    VkClearDepthStencilValue farPlane = { 1.0f, 0 };
+    for (size_t i = 0; i < m_cascades.size(); ++i) {
+        vkCmdClearDepthStencilImage(cmdBuffer, m_cascades[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    &farPlane, 1, &barriers[i].subresourceRange);
+    }
+
+    // Where the render graph expects them at the start of every frame.
+    for (auto& barrier : barriers) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, barriers.size(), barriers.data());
+
+    vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuffer;
+
+    vkQueueSubmit(m_info.queue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(m_info.queue);
+
+    vkFreeCommandBuffers(*m_device, m_info.commandPool, 1, &cmdBuffer);
+}
+
+uint32_t ShadowCascades::findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find an adequate memory type.");
+}
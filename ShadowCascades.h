@@ -0,0 +1,181 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "BindlessDescriptors.h"
+#include "Camera.h"
+#include "Scene.h"
+
+namespace ShadowCascadesStructs {
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // Used for the one-shot clear of the new shadow maps.
+        VkQueue queue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+
+        // Every shadow map is registered there, so the shading reaches it by slot.
+        BindlessDescriptors* bindlessDescriptors = nullptr;
+
+        uint32_t cascadeCount = 4; // Up to UniformBufferObject::MaxShadowCascadeCount.
+
+        uint32_t resolution = 2048; // Width and height of every shadow map.
+
+        // Shadows end there; 0 means the far plane of the camera.
+        float shadowDistance = 0.0f;
+
+        // Blend between uniform (0) and logarithmic (1) split depths.
+        float splitLambda = 0.75f;
+
+        // Casters this far beyond a cascade towards the light still cast into it.
+        float casterDistance = 100.0f;
+
+        // Cascades from this one on are cached; the nearer ones are rendered every frame.
+        // The cascade count disables caching.
+        uint32_t firstCachedCascade = 2;
+
+        // Cached cascades cover this much more than their part of the frustum needs, as a fraction
+        // of its radius, so the camera can move for a while before they have to be rendered again.
+        float cacheMargin = 0.25f;
+
+        // Cached cascades rendered in one frame only because their casters changed or the camera nears
+        // their edge; the others keep what they have until a later frame. Cascades that would show
+        // wrong shadows otherwise, e.g. after the light turned, are rendered regardless.
+        uint32_t maxCachedUpdatesPerFrame = 1;
+    };
+}
+
+// Shadow maps of a directional light over cascades of the camera frustum. Every cascade is the bounding
+// sphere of its slice of the frustum seen along the light, snapped to shadow map texels, so it does not
+// shimmer as the camera turns or moves. Distant cascades, covering more than they need, are kept
+// across frames and only rendered again when the light turns, casters inside them change, or the camera
+// is about to leave what they cover, which bounds how many cascades a frame renders.
+class ShadowCascades {
+public:
+    using Bounds = SceneStructs::Bounds;
+
+public:
+    ShadowCascades() = default;
+    ~ShadowCascades();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const ShadowCascadesStructs::CreateInfo& info);
+
+    inline bool isInited() const { return !m_cascades.empty(); }
+
+    // A depth format the device can render to and sample.
+    static VkFormat selectFormat(VkPhysicalDevice physicalDevice);
+
+    inline VkFormat format() const { return m_format; }
+
+    inline uint32_t resolution() const { return m_info.resolution; }
+
+    inline uint32_t cascadeCount() const { return static_cast<uint32_t>(m_cascades.size()); }
+
+    // Left in SHADER_READ_ONLY_OPTIMAL between frames.
+    inline VkImage image(uint32_t cascade) const { return m_cascades[cascade].image; }
+    inline VkImageView view(uint32_t cascade) const { return m_cascades[cascade].view; }
+    inline BindlessDescriptors::Slot slot(uint32_t cascade) const { return m_cascades[cascade].slot; }
+
+    // Fit the cascades to the camera for a light travelling along lightDirection and decide which ones are
+    // rendered this frame. changedBounds are world bounds of casters that moved or changed since the last
+    // update, before and after; isEverythingChanged stands for changes that can not be bounded.
+    void update(const Camera& camera, const glm::vec3& lightDirection,
+                const std::vector<Bounds>& changedBounds, bool isEverythingChanged);
+
+    inline bool isRenderNeeded(uint32_t cascade) const { return m_cascades[cascade].isRenderNeeded; }
+
+    // Of this frame's update().
+    inline uint32_t renderedCascadeCount() const { return m_renderedCascadeCount; }
+
+    // The light view shared by all cascades, and the projection each was last rendered with,
+    // i.e. what its shadow map holds.
+    inline const glm::mat4& viewMat() const { return m_lightViewMat; }
+    inline const glm::mat4& projMat(uint32_t cascade) const { return m_cascades[cascade].projMat; }
+
+    // Far view depth of the cascade.
+    inline float splitDepth(uint32_t cascade) const { return m_cascades[cascade].farZ; }
+
+    // Depth covered by a texel in the cascade's shadow map, for biasing.
+    float texelDepth(uint32_t cascade) const;
+
+    inline VkDeviceSize memorySize() const { return m_memorySize; }
+
+    inline size_t allocationCount() const { return m_cascades.size(); }
+
+    void destroy();
+
+private:
+    struct Cascade {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        BindlessDescriptors::Slot slot = BindlessDescriptors::InvalidSlot;
+
+        // View depths of the slice of the frustum.
+        float nearZ = 0.0f;
+        float farZ = 0.0f;
+
+        // What the shadow map holds: a box around center in light space, extent in x, y and towards
+        // the camera, plus the caster distance towards the light.
+        bool isValid = false;
+        glm::vec3 center = {};
+        float radius = 0.0f; // Of the slice it was fitted to.
+        float extent = 0.0f;
+        glm::mat4 projMat = glm::mat4(1.0f);
+
+        bool isCached = false;
+        bool isRenderNeeded = false;
+    };
+
+    // Fit the cascade to a slice of the given radius around center, both in light space.
+    void fit(Cascade& cascade, const glm::vec3& center, float radius) const;
+
+    // Whether world bounds reach into the box the cascade holds.
+    bool isOverlapped(const Cascade& cascade, const Bounds& bounds) const;
+
+    // Transition every shadow map to SHADER_READ_ONLY_OPTIMAL, filled with the far plane.
+    void clear();
+
+    uint32_t findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+    VkDevice* m_device = nullptr;
+
+    ShadowCascadesStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+
+    // Nearest and clamped; the shading gathers and compares itself.
+    VkSampler m_sampler = VK_NULL_HANDLE;
+
+    std::vector<Cascade> m_cascades = {};
+
+    VkDeviceSize m_memorySize = 0;
+
+    // Light space shared by all cascades; only rotates with the light.
+    glm::vec3 m_lightDirection = glm::vec3(0.0f);
+    glm::mat4 m_lightViewMat = glm::mat4(1.0f);
+
+    uint32_t m_renderedCascadeCount = 0;
+};
+
+#endif // SHADOW_CASCADES_H
@@ -0,0 +1,105 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef SIMD_LANE_H
+#define SIMD_LANE_H
+
+// Four floats and the handful of operations the batched math needs: SSE2 on x86, NEON on ARM,
+// and plain arrays elsewhere so that callers need no second code path.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_LANE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_LANE_NEON
+#include <arm_neon.h>
+#endif
+
+#include <cmath>
+
+namespace SimdLane {
+#if defined(SIMD_LANE_SSE2)
+    using Lane = __m128;
+    using Mask = __m128;
+
+    inline const char* instructionSet() { return "SSE2"; }
+
+    inline Lane load(const float* p) { return _mm_loadu_ps(p); }
+    inline void store(float* p, Lane v) { _mm_storeu_ps(p, v); }
+    inline Lane splat(float value) { return _mm_set1_ps(value); }
+    inline Lane add(Lane a, Lane b) { return _mm_add_ps(a, b); }
+    inline Lane sub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+    inline Lane mul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+    inline Lane abs(Lane a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+    inline Mask lessThan(Lane a, Lane b) { return _mm_cmplt_ps(a, b); }
+    inline Mask maskOr(Mask a, Mask b) { return _mm_or_ps(a, b); }
+    // Bit i is set when lane i of the mask is.
+    inline int maskBits(Mask m) { return _mm_movemask_ps(m); }
+
+    inline void transpose(Lane& a, Lane& b, Lane& c, Lane& d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+#elif defined(SIMD_LANE_NEON)
+    using Lane = float32x4_t;
+    using Mask = uint32x4_t;
+
+    inline const char* instructionSet() { return "NEON"; }
+
+    inline Lane load(const float* p) { return vld1q_f32(p); }
+    inline void store(float* p, Lane v) { vst1q_f32(p, v); }
+    inline Lane splat(float value) { return vdupq_n_f32(value); }
+    inline Lane add(Lane a, Lane b) { return vaddq_f32(a, b); }
+    inline Lane sub(Lane a, Lane b) { return vsubq_f32(a, b); }
+    inline Lane mul(Lane a, Lane b) { return vmulq_f32(a, b); }
+    inline Lane abs(Lane a) { return vabsq_f32(a); }
+
+    inline Mask lessThan(Lane a, Lane b) { return vcltq_f32(a, b); }
+    inline Mask maskOr(Mask a, Mask b) { return vorrq_u32(a, b); }
+    inline int maskBits(Mask m) {
+        const int32x4_t shifts = { 0, 1, 2, 3 };
+        return static_cast<int>(vaddvq_u32(vshlq_u32(vshrq_n_u32(m, 31), shifts)));
+    }
+
+    inline void transpose(Lane& a, Lane& b, Lane& c, Lane& d) {
+        auto ab = vtrnq_f32(a, b); // a0 b0 a2 b2 | a1 b1 a3 b3
+        auto cd = vtrnq_f32(c, d); // c0 d0 c2 d2 | c1 d1 c3 d3
+        a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+        b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+        c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+        d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+    }
+#else
+    struct Lane { float v[4]; };
+    struct Mask { bool v[4]; };
+
+    inline const char* instructionSet() { return "scalar"; }
+
+    inline Lane load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+    inline void store(float* p, Lane a) { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+    inline Lane splat(float value) { return { { value, value, value, value } }; }
+    inline Lane add(Lane a, Lane b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+    inline Lane sub(Lane a, Lane b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+    inline Lane mul(Lane a, Lane b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+    inline Lane abs(Lane a) { for (int i = 0; i < 4; ++i) a.v[i] = std::abs(a.v[i]); return a; }
+
+    inline Mask lessThan(Lane a, Lane b) { Mask m = {}; for (int i = 0; i < 4; ++i) m.v[i] = a.v[i] < b.v[i]; return m; }
+    inline Mask maskOr(Mask a, Mask b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] || b.v[i]; return a; }
+    inline int maskBits(Mask m) { return (m.v[0] ? 1 : 0) | (m.v[1] ? 2 : 0) | (m.v[2] ? 4 : 0) | (m.v[3] ? 8 : 0); }
+
+    inline void transpose(Lane& a, Lane& b, Lane& c, Lane& d) {
+        Lane rows[4] = { a, b, c, d };
+        a = { { rows[0].v[0], rows[1].v[0], rows[2].v[0], rows[3].v[0] } };
+        b = { { rows[0].v[1], rows[1].v[1], rows[2].v[1], rows[3].v[1] } };
+        c = { { rows[0].v[2], rows[1].v[2], rows[2].v[2], rows[3].v[2] } };
+        d = { { rows[0].v[3], rows[1].v[3], rows[2].v[3], rows[3].v[3] } };
+    }
+#endif
+}
+
+#endif // SIMD_LANE_H
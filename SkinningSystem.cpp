@@ -0,0 +1,319 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#include "SkinningSystem.h"
+
+SkinningSystem::~SkinningSystem() {
+    destroy(); // In case someone forgets destroy the buffers.
+}
+
+SkinningSystem::Handle SkinningSystem::addMesh(const std::vector<SkinnedVertex>& vertices, uint32_t jointCount,
+                                               const std::vector<std::vector<glm::vec3>>& morphTargets) {
+    Mesh mesh = {};
+    mesh.firstVertex = static_cast<uint32_t>(m_sourceVertices.size());
+    mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+    mesh.firstJoint = static_cast<uint32_t>(m_jointMats.size());
+    mesh.jointCount = jointCount;
+    mesh.firstMorphDelta = static_cast<uint32_t>(m_morphDeltas.size());
+    mesh.firstMorphWeight = static_cast<uint32_t>(m_morphWeights.size());
+    mesh.morphTargetCount = static_cast<uint32_t>(morphTargets.size());
+
+    m_sourceVertices.insert(m_sourceVertices.end(), vertices.begin(), vertices.end());
+    m_jointMats.resize(m_jointMats.size() + jointCount, glm::mat4(1.0f));
+    m_morphWeights.resize(m_morphWeights.size() + morphTargets.size(), 0.0f);
+    for (const auto& morphTarget : morphTargets) {
+        if (morphTarget.size() != vertices.size()) {
+            throw std::runtime_error("Failed to add skinned mesh: a morph target does not match the vertices.");
+        }
+        for (const auto& delta : morphTarget) {
+            m_morphDeltas.push_back(glm::vec4(delta, 0.0f));
+        }
+    }
+
+    m_meshes.push_back(mesh);
+    return static_cast<Handle>(m_meshes.size() - 1);
+}
+
+void SkinningSystem::init(const SkinningStructs::CreateInfo& info) {
+    m_info = info;
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+    // Never empty, so there is always a buffer to bind.
+    auto sizeOf = [](size_t elementSize, size_t count) {
+        return static_cast<VkDeviceSize>(elementSize * std::max(count, static_cast<size_t>(1)));
+    };
+
+    createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 sizeOf(sizeof(SkinnedVertex), m_sourceVertices.size()), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_sourceResource);
+    createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 sizeOf(sizeof(glm::vec4), m_morphDeltas.size()), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_morphResource);
+    createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 sizeOf(sizeof(Vertex), m_sourceVertices.size()), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_targetResource);
+
+    m_paletteResources.resize(m_info.frameCount);
+    m_paletteMappedData.resize(m_info.frameCount, nullptr);
+    m_morphWeightResources.resize(m_info.frameCount);
+    m_morphWeightMappedData.resize(m_info.frameCount, nullptr);
+    for (size_t i = 0; i < m_info.frameCount; ++i) {
+        createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeOf(sizeof(glm::mat4), m_jointMats.size()),
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_paletteResources[i]);
+        vkMapMemory(*m_device, m_paletteResources[i].memory, 0, VK_WHOLE_SIZE, 0, &m_paletteMappedData[i]);
+
+        createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeOf(sizeof(float), m_morphWeights.size()),
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_morphWeightResources[i]);
+        vkMapMemory(*m_device, m_morphWeightResources[i].memory, 0, VK_WHOLE_SIZE, 0, &m_morphWeightMappedData[i]);
+    }
+
+    upload();
+
+    auto& bindless = *m_info.bindlessDescriptors;
+    for (auto* resource : { &m_sourceResource, &m_morphResource, &m_targetResource }) {
+        resource->slot = bindless.registerBuffer(resource->buffer);
+    }
+    for (size_t i = 0; i < m_info.frameCount; ++i) {
+        m_paletteResources[i].slot = bindless.registerBuffer(m_paletteResources[i].buffer);
+        m_morphWeightResources[i].slot = bindless.registerBuffer(m_morphWeightResources[i].buffer);
+    }
+
+    // Only the poses are needed from now on.
+    m_sourceVertices = {};
+    m_morphDeltas = {};
+}
+
+void SkinningSystem::setJointMatrices(Handle mesh, const std::vector<glm::mat4>& jointMats) {
+    auto& target = m_meshes[mesh];
+    auto count = std::min(static_cast<uint32_t>(jointMats.size()), target.jointCount);
+    std::copy(jointMats.begin(), jointMats.begin() + count, m_jointMats.begin() + target.firstJoint);
+    ++target.poseVersion;
+}
+
+void SkinningSystem::setMorphWeights(Handle mesh, const std::vector<float>& weights) {
+    auto& target = m_meshes[mesh];
+    auto count = std::min(static_cast<uint32_t>(weights.size()), target.morphTargetCount);
+    std::copy(weights.begin(), weights.begin() + count, m_morphWeights.begin() + target.firstMorphWeight);
+    ++target.poseVersion;
+}
+
+void SkinningSystem::update(size_t frameIndex) {
+    // All of them, since the frame's copy may be several poses behind; this is small next to the vertices.
+    if (!m_jointMats.empty()) {
+        memcpy(m_paletteMappedData[frameIndex], m_jointMats.data(), sizeof(glm::mat4) * m_jointMats.size());
+    }
+    if (!m_morphWeights.empty()) {
+        memcpy(m_morphWeightMappedData[frameIndex], m_morphWeights.data(), sizeof(float) * m_morphWeights.size());
+    }
+}
+
+VkDeviceSize SkinningSystem::poseSize() const {
+    return sizeof(glm::mat4) * m_jointMats.size() + sizeof(float) * m_morphWeights.size();
+}
+
+void SkinningSystem::recordSkinning(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipeline pipeline, VkPipelineLayout pipelineLayout) {
+    m_skinnedVertexCount = 0;
+
+    bool isPipelineBound = false;
+    for (auto& mesh : m_meshes) {
+        // The skinned vertices persist across frames, so an unchanged pose is already in place.
+        if (mesh.recordedPoseVersion == mesh.poseVersion || mesh.vertexCount == 0) continue;
+        mesh.recordedPoseVersion = mesh.poseVersion;
+
+        if (!isPipelineBound) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            isPipelineBound = true;
+        }
+
+        SkinningStructs::Params params = {};
+        params.sourceBufferIndex = m_sourceResource.slot;
+        params.targetBufferIndex = m_targetResource.slot;
+        params.paletteBufferIndex = m_paletteResources[frameIndex].slot;
+        params.morphBufferIndex = m_morphResource.slot;
+        params.morphWeightBufferIndex = m_morphWeightResources[frameIndex].slot;
+        params.firstSourceVertex = mesh.firstVertex;
+        params.firstTargetVertex = mesh.firstVertex;
+        params.vertexCount = mesh.vertexCount;
+        params.firstJoint = mesh.firstJoint;
+        params.jointCount = mesh.jointCount;
+        params.firstMorphDelta = mesh.firstMorphDelta;
+        params.firstMorphWeight = mesh.firstMorphWeight;
+        params.morphTargetCount = mesh.morphTargetCount;
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+        vkCmdDispatch(commandBuffer, (mesh.vertexCount + GroupSize - 1) / GroupSize, 1, 1);
+        m_skinnedVertexCount += mesh.vertexCount;
+    }
+}
+
+VkDeviceSize SkinningSystem::memorySize() const {
+    VkDeviceSize size = m_sourceResource.size + m_morphResource.size + m_targetResource.size;
+    for (const auto& resource : m_paletteResources) size += resource.size;
+    for (const auto& resource : m_morphWeightResources) size += resource.size;
+    return size;
+}
+
+size_t SkinningSystem::allocationCount() const {
+    return isInited() ? 3 + m_paletteResources.size() + m_morphWeightResources.size() : 0;
+}
+
+void SkinningSystem::destroy() {
+    // The bindless table may be gone by the time the destructor runs.
+    if (m_device == nullptr || !isInited()) return;
+
+    destroyBuffer(m_sourceResource);
+    destroyBuffer(m_morphResource);
+    destroyBuffer(m_targetResource);
+
+    for (auto& resource : m_paletteResources) {
+        destroyBuffer(resource);
+    }
+    m_paletteResources.clear();
+    m_paletteMappedData.clear();
+
+    for (auto& resource : m_morphWeightResources) {
+        destroyBuffer(resource);
+    }
+    m_morphWeightResources.clear();
+    m_morphWeightMappedData.clear();
+}
+
+void SkinningSystem::createBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags properties, BufferResource& resource) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(*m_device, &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create skinning buffer.");
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetBufferMemoryRequirements(*m_device, resource.buffer, &requirements);
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = findAdequateMemoryType(requirements.memoryTypeBits, properties);
+
+    if (vkAllocateMemory(*m_device, &allocInfo, nullptr, &resource.memory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate skinning buffer memory.");
+    }
+    vkBindBufferMemory(*m_device, resource.buffer, resource.memory, 0);
+
+    resource.size = requirements.size;
+}
+
+void SkinningSystem::destroyBuffer(BufferResource& resource) {
+    if (resource.buffer == VK_NULL_HANDLE) return;
+
+    if (resource.slot != BindlessDescriptors::InvalidSlot) {
+        m_info.bindlessDescriptors->unregisterBuffer(resource.slot);
+    }
+    // Freeing the memory unmaps it as well.
+    vkDestroyBuffer(*m_device, resource.buffer, nullptr);
+    vkFreeMemory(*m_device, resource.memory, nullptr);
+
+    resource = {};
+}
+
+void SkinningSystem::upload() {
+    // The skinned vertices start as the bind poses, so meshes never posed need no dispatch at all.
+    std::vector<Vertex> targetVertices(m_sourceVertices.size());
+    for (size_t i = 0; i < m_sourceVertices.size(); ++i) {
+        const auto& source = m_sourceVertices[i];
+        targetVertices[i] = { source.pos, source.color, source.uv };
+    }
+
+    VkDeviceSize sourceSize = sizeof(SkinnedVertex) * m_sourceVertices.size();
+    VkDeviceSize morphSize = sizeof(glm::vec4) * m_morphDeltas.size();
+    VkDeviceSize targetSize = sizeof(Vertex) * targetVertices.size();
+    if (sourceSize + morphSize + targetSize == 0) return;
+
+    BufferResource staging = {};
+    createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, sourceSize + morphSize + targetSize,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging);
+
+    void* data = nullptr;
+    vkMapMemory(*m_device, staging.memory, 0, VK_WHOLE_SIZE, 0, &data);
+    auto* bytes = static_cast<uint8_t*>(data);
+    memcpy(bytes, m_sourceVertices.data(), sourceSize);
+    memcpy(bytes + sourceSize, m_morphDeltas.data(), morphSize);
+    memcpy(bytes + sourceSize + morphSize, targetVertices.data(), targetSize);
+    vkUnmapMemory(*m_device, staging.memory);
+
+    VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+    cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufferAllocInfo.commandPool = m_info.commandPool;
+    cmdBufferAllocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmdBuffer = {};
+    vkAllocateCommandBuffers(*m_device, &cmdBufferAllocInfo, &cmdBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+
+    VkBufferCopy region = {};
+    if (sourceSize != 0) {
+        region.srcOffset = 0;
+        region.size = sourceSize;
+        vkCmdCopyBuffer(cmdBuffer, staging.buffer, m_sourceResource.buffer, 1, &region);
+    }
+    if (morphSize != 0) {
+        region.srcOffset = sourceSize;
+        region.size = morphSize;
+        vkCmdCopyBuffer(cmdBuffer, staging.buffer, m_morphResource.buffer, 1, &region);
+    }
+    if (targetSize != 0) {
+        region.srcOffset = sourceSize + morphSize;
+        region.size = targetSize;
+        vkCmdCopyBuffer(cmdBuffer, staging.buffer, m_targetResource.buffer, 1, &region);
+    }
+
+    // Read by the first skinning pass, or as vertices if that never comes.
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuffer;
+
+    vkQueueSubmit(m_info.queue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(m_info.queue);
+
+    vkFreeCommandBuffers(*m_device, m_info.commandPool, 1, &cmdBuffer);
+
+    destroyBuffer(staging);
+}
+
+uint32_t SkinningSystem::findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find an adequate memory type.");
+}
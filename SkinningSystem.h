@@ -0,0 +1,186 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef SKINNING_SYSTEM_H
+#define SKINNING_SYSTEM_H
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "BindlessDescriptors.h"
+#include "GraphicsResource.h"
+
+namespace SkinningStructs {
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // Used for the one-shot upload of the bind poses.
+        VkQueue queue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+
+        // All buffers read or written by skinning.comp are registered there.
+        BindlessDescriptors* bindlessDescriptors = nullptr;
+
+        size_t frameCount = 1;
+    };
+
+    // Push constants of skinning.comp, one dispatch per mesh.
+    struct Params {
+        uint32_t sourceBufferIndex; // Bindless slots.
+        uint32_t targetBufferIndex;
+        uint32_t paletteBufferIndex;
+        uint32_t morphBufferIndex;
+        uint32_t morphWeightBufferIndex;
+
+        uint32_t firstSourceVertex; // Into the bind poses.
+        uint32_t firstTargetVertex; // Into the skinned vertices.
+        uint32_t vertexCount;
+
+        uint32_t firstJoint; // Into the palette.
+        uint32_t jointCount; // 0 leaves the morphed positions as they are.
+
+        uint32_t firstMorphDelta; // Into the morph deltas, target by target.
+        uint32_t firstMorphWeight;
+        uint32_t morphTargetCount;
+
+        uint32_t padding[3];
+    };
+}
+
+// Skinned and morphed meshes, posed on the GPU once per frame. A compute pre-pass reads the bind pose
+// of every mesh whose pose changed, applies its weighted morph targets and then its joints, and writes
+// the positions into one vertex buffer of plain Vertex. Every graphics pass then draws from that buffer
+// like from any other, so the work is not repeated per pass and the pipelines need not know about it.
+class SkinningSystem {
+public:
+    using Handle = uint32_t;
+
+    constexpr static Handle InvalidHandle = UINT32_MAX;
+
+    // Must match local_size_x of skinning.comp.
+    constexpr static uint32_t GroupSize = 64;
+
+public:
+    SkinningSystem() = default;
+    ~SkinningSystem();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    // Before init. Every morph target holds a position delta per vertex. The joint palette starts
+    // as identities and the morph weights as 0, so the mesh starts in its bind pose.
+    Handle addMesh(const std::vector<SkinnedVertex>& vertices, uint32_t jointCount,
+                   const std::vector<std::vector<glm::vec3>>& morphTargets = {});
+
+    void init(const SkinningStructs::CreateInfo& info);
+
+    inline bool isInited() const { return m_targetResource.buffer != VK_NULL_HANDLE; }
+
+    inline size_t meshCount() const { return m_meshes.size(); }
+
+    // Joint matrices take bind pose to posed model space, i.e. the joint transform times its inverse bind matrix.
+    // Up to the joint count of the mesh are taken, in order.
+    void setJointMatrices(Handle mesh, const std::vector<glm::mat4>& jointMats);
+
+    // One weight per morph target, in order.
+    void setMorphWeights(Handle mesh, const std::vector<float>& weights);
+
+    // Whether the pose changed since the mesh was last recorded, i.e. the next recordSkinning() moves it.
+    inline bool isPoseChanged(Handle mesh) const { return m_meshes[mesh].poseVersion != m_meshes[mesh].recordedPoseVersion; }
+
+    // The skinned vertices of all meshes; bound as a vertex buffer at the offset of each mesh.
+    inline VkBuffer vertexBuffer() const { return m_targetResource.buffer; }
+
+    inline VkDeviceSize vertexOffset(Handle mesh) const { return sizeof(Vertex) * m_meshes[mesh].firstVertex; }
+
+    // After the frame's fence has been waited: write the poses into the frame's palette and weights.
+    void update(size_t frameIndex);
+
+    // Bytes update() writes every frame.
+    VkDeviceSize poseSize() const;
+
+    // One dispatch per mesh whose pose changed since it was last recorded, with the bindless table bound
+    // at set 1 of the layout. The skinned vertices are written in the compute stage; synchronizing their
+    // reads at vertex input is up to the caller.
+    void recordSkinning(VkCommandBuffer commandBuffer, size_t frameIndex, VkPipeline pipeline, VkPipelineLayout pipelineLayout);
+
+    // Of the last recordSkinning().
+    inline uint32_t skinnedVertexCount() const { return m_skinnedVertexCount; }
+
+    VkDeviceSize memorySize() const;
+
+    size_t allocationCount() const;
+
+    void destroy();
+
+private:
+    struct Mesh {
+        uint32_t firstVertex = 0;
+        uint32_t vertexCount = 0;
+        uint32_t firstJoint = 0;
+        uint32_t jointCount = 0;
+        uint32_t firstMorphDelta = 0;
+        uint32_t firstMorphWeight = 0;
+        uint32_t morphTargetCount = 0;
+
+        // Bumped by every pose change; the skinned vertices are those of recordedPoseVersion.
+        uint64_t poseVersion = 0;
+        uint64_t recordedPoseVersion = 0;
+    };
+
+    struct BufferResource {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        BindlessDescriptors::Slot slot = BindlessDescriptors::InvalidSlot;
+    };
+
+    void createBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VkMemoryPropertyFlags properties, BufferResource& resource);
+
+    void destroyBuffer(BufferResource& resource);
+
+    // Copy the bind poses and morph deltas through a staging buffer and wait for it.
+    void upload();
+
+    uint32_t findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+    VkDevice* m_device = nullptr;
+
+    SkinningStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    std::vector<Mesh> m_meshes = {};
+
+    // Of all meshes, in order; the declared data is dropped once uploaded.
+    std::vector<SkinnedVertex> m_sourceVertices = {};
+    std::vector<glm::vec4> m_morphDeltas = {}; // w unused.
+
+    // Poses of all meshes, copied into the frame's buffers by update().
+    std::vector<glm::mat4> m_jointMats = {};
+    std::vector<float> m_morphWeights = {};
+
+    BufferResource m_sourceResource = {};
+    BufferResource m_morphResource = {};
+    BufferResource m_targetResource = {};
+
+    // Per frame in flight, persistently mapped.
+    std::vector<BufferResource> m_paletteResources = {};
+    std::vector<void*> m_paletteMappedData = {};
+    std::vector<BufferResource> m_morphWeightResources = {};
+    std::vector<void*> m_morphWeightMappedData = {};
+
+    uint32_t m_skinnedVertexCount = 0;
+};
+
+#endif // SKINNING_SYSTEM_H
@@ -0,0 +1,85 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef SNAPSHOT_EXCHANGE_H
+#define SNAPSHOT_EXCHANGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Hand the latest value of a small struct from one writer thread to any number of readers
+// without locking. The writer fills the slot readers are not pointed at and then flips it;
+// a reader only retries when the writer laps it twice during a single copy.
+template<typename T>
+class SnapshotExchange {
+    static_assert(std::is_trivially_copyable<T>::value, "Snapshots are copied word by word");
+
+public:
+    SnapshotExchange() { publish(T{}); }
+
+    // Single writer.
+    void publish(const T& value) {
+        uint64_t words[WordCount] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        uint32_t index = (m_frontIndex.load(std::memory_order_relaxed) + 1) % 2;
+        auto& slot = m_slots[index];
+
+        // Odd while written.
+        uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+        slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WordCount; ++i) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        slot.sequence.store(sequence + 2, std::memory_order_release);
+        m_frontIndex.store(index, std::memory_order_release);
+    }
+
+    // Any thread.
+    T read() const {
+        uint64_t words[WordCount] = {};
+        for (;;) {
+            const auto& slot = m_slots[m_frontIndex.load(std::memory_order_acquire)];
+
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence % 2 != 0) continue;
+
+            for (size_t i = 0; i < WordCount; ++i) {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == sequence) break;
+        }
+
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    constexpr static size_t WordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    struct Slot {
+        std::atomic<uint64_t> sequence = { 0 };
+        std::atomic<uint64_t> words[WordCount] = {};
+    };
+
+    Slot m_slots[2] = {};
+
+    std::atomic<uint32_t> m_frontIndex = { 0 };
+};
+
+#endif // SNAPSHOT_EXCHANGE_H
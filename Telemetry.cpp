@@ -0,0 +1,171 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <exception>
+#include <stdexcept>
+
+#include "Telemetry.h"
+
+// Results come back in bit order, which is the field order of TelemetryStructs::PipelineStatistics.
+constexpr static VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+Telemetry::~Telemetry() {
+    destroy(); // In case someone forgets destroy query pools.
+}
+
+void Telemetry::init(const TelemetryStructs::CreateInfo& info) {
+    m_info = info;
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(m_info.physicalDevice, &properties);
+    m_maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    m_isPipelineStatisticsSupported = m_info.enablePipelineStatistics;
+    if (!m_isPipelineStatisticsSupported) return;
+
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    poolInfo.queryCount = 1;
+    poolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+    m_frameSlots.resize(m_info.frameSlotCount);
+    for (auto& slot : m_frameSlots) {
+        if (vkCreateQueryPool(*m_device, &poolInfo, nullptr, &slot.queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline statistics query pool");
+        }
+    }
+}
+
+void Telemetry::trackAllocation(VkDeviceSize size) {
+    m_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    m_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void Telemetry::trackFree(VkDeviceSize size) {
+    m_allocationCount.fetch_sub(1, std::memory_order_relaxed);
+    m_allocatedBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void Telemetry::trackUpload(VkDeviceSize size) {
+    m_totalUploadedBytes.fetch_add(size, std::memory_order_relaxed);
+    m_frameUploadedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void Telemetry::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    m_currFrameSlot = nullptr;
+    if (!m_isPipelineStatisticsSupported || frameSlot >= m_frameSlots.size()) return;
+
+    auto& slot = m_frameSlots[frameSlot];
+
+    if (slot.isQueryWritten) {
+        TelemetryStructs::PipelineStatistics statistics = {};
+        VkResult result = vkGetQueryPoolResults(*m_device, slot.queryPool, 0, 1,
+                                                sizeof(statistics), &statistics, sizeof(statistics),
+                                                VK_QUERY_RESULT_64_BIT);
+        // VK_NOT_READY keeps the previous statistics rather than stalling.
+        if (result == VK_SUCCESS) {
+            std::lock_guard<std::mutex> lock(m_publishedMutex);
+            m_publishedPipelineStatistics = statistics;
+        }
+    }
+
+    vkCmdResetQueryPool(commandBuffer, slot.queryPool, 0, 1);
+    slot.isQueryWritten = false;
+
+    m_currFrameSlot = &slot;
+}
+
+void Telemetry::beginPipelineStatistics(VkCommandBuffer commandBuffer) {
+    if (m_currFrameSlot == nullptr) return;
+    vkCmdBeginQuery(commandBuffer, m_currFrameSlot->queryPool, 0, 0);
+}
+
+void Telemetry::endPipelineStatistics(VkCommandBuffer commandBuffer) {
+    if (m_currFrameSlot == nullptr) return;
+    vkCmdEndQuery(commandBuffer, m_currFrameSlot->queryPool, 0);
+    m_currFrameSlot->isQueryWritten = true;
+}
+
+void Telemetry::endFrame(const FrameResources& resources) {
+    m_frameCounters.uploadedBytes = m_frameUploadedBytes.exchange(0, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(m_publishedMutex);
+        m_publishedFrameCounters = m_frameCounters;
+        m_publishedFrameResources = resources;
+        ++m_publishedFrameNumber;
+    }
+    m_frameCounters = {};
+}
+
+Telemetry::Snapshot Telemetry::snapshot() const {
+    Snapshot snapshot = {};
+
+    {
+        std::lock_guard<std::mutex> lock(m_publishedMutex);
+        snapshot.frameNumber = m_publishedFrameNumber;
+        snapshot.frame = m_publishedFrameCounters;
+        snapshot.pipelineStatistics = m_publishedPipelineStatistics;
+
+        snapshot.allocationCount = m_publishedFrameResources.allocationCount;
+        snapshot.allocatedBytes = m_publishedFrameResources.allocatedBytes;
+        snapshot.presentMode = m_publishedFrameResources.presentMode;
+        snapshot.swapchainImageCount = m_publishedFrameResources.swapchainImageCount;
+    }
+    snapshot.isPipelineStatisticsSupported = m_isPipelineStatisticsSupported;
+
+    snapshot.allocationCount += m_allocationCount.load(std::memory_order_relaxed);
+    snapshot.maxAllocationCount = m_maxAllocationCount;
+    snapshot.allocatedBytes += m_allocatedBytes.load(std::memory_order_relaxed);
+    snapshot.totalUploadedBytes = m_totalUploadedBytes.load(std::memory_order_relaxed);
+
+    snapshot.heaps.resize(m_memoryProperties.memoryHeapCount);
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i) {
+        snapshot.heaps[i].size = m_memoryProperties.memoryHeaps[i].size;
+        snapshot.heaps[i].isDeviceLocal = m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    }
+
+    // The budget moves with the whole system, so it is queried fresh instead of cached.
+    snapshot.isMemoryBudgetSupported = m_info.enableMemoryBudget;
+    if (m_info.enableMemoryBudget) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties2.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(m_info.physicalDevice, &memoryProperties2);
+
+        for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i) {
+            snapshot.heaps[i].usage = budgetProperties.heapUsage[i];
+            snapshot.heaps[i].budget = budgetProperties.heapBudget[i];
+        }
+    }
+
+    return snapshot;
+}
+
+void Telemetry::destroy() {
+    // Destroy: init()
+    for (auto& slot : m_frameSlots) {
+        vkDestroyQueryPool(*m_device, slot.queryPool, nullptr);
+    }
+    m_frameSlots.clear();
+    m_currFrameSlot = nullptr;
+    m_isPipelineStatisticsSupported = false;
+}
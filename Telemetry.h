@@ -0,0 +1,219 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace TelemetryStructs {
+    struct HeapUsage {
+        VkDeviceSize size = 0;
+        bool isDeviceLocal = false;
+
+        // From VK_EXT_memory_budget; usage and budget are 0 when it is not supported.
+        // Usage covers the whole process, not only the engine.
+        VkDeviceSize usage = 0;
+        VkDeviceSize budget = 0;
+    };
+
+    struct PipelineStatistics {
+        uint64_t inputAssemblyVertices = 0;
+        uint64_t inputAssemblyPrimitives = 0;
+        uint64_t vertexShaderInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentShaderInvocations = 0;
+    };
+
+    // Command counts of one recorded frame.
+    struct FrameCounters {
+        uint32_t drawCount = 0;
+        uint32_t culledDrawCount = 0; // Draw items skipped by frustum culling.
+
+        // Skipped by GPU occlusion culling; read back from the GPU, so they lag by the frames in flight.
+        uint32_t occludedDrawCount = 0;
+        uint64_t occludedTriangleCount = 0;
+
+        // Meshlets skipped on the GPU by the frustum or their normal cone; lag the same way.
+        uint32_t clusterCulledCount = 0;
+        uint64_t clusterCulledTriangleCount = 0;
+
+        // Alive after the particle simulation; read back, so it lags the same way.
+        uint32_t particleCount = 0;
+
+        // Posed by the skinning pre-pass; meshes whose pose did not change are skipped.
+        uint32_t skinnedVertexCount = 0;
+
+        // Shadow cascades rendered; cached ones are skipped while their shadow maps hold.
+        uint32_t shadowCascadeRenderCount = 0;
+
+        // Point lights binned by clustered lighting, and the indices into them the clusters took and dropped
+        // for lack of space; the indices are read back, so they lag by the frames in flight.
+        uint32_t pointLightCount = 0;
+        uint32_t lightIndexCount = 0;
+        uint32_t droppedLightIndexCount = 0;
+
+        uint32_t pipelineBindCount = 0;
+        uint32_t vertexBufferBindCount = 0;
+        uint32_t indexBufferBindCount = 0;
+        uint32_t descriptorSetBindCount = 0;
+        VkDeviceSize uploadedBytes = 0; // Host to device copies made for the frame.
+
+        // From the latest camera input applied to the frame until it was handed to present; 0 without input.
+        uint64_t inputToPresentNs = 0;
+    };
+
+    // What the engine holds outside trackAllocation() and how it presents. Gathered by the recording thread,
+    // which is the one rebuilding all of it, and published with the frame counters.
+    struct FrameResources {
+        // Textures, transient attachments and the like, which allocate in blocks of their own.
+        uint32_t allocationCount = 0;
+        VkDeviceSize allocatedBytes = 0;
+
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        uint32_t swapchainImageCount = 0;
+    };
+
+    struct Snapshot {
+        // Number of frames published so far; the counters belong to the last one.
+        uint64_t frameNumber = 0;
+
+        bool isMemoryBudgetSupported = false;
+        std::vector<HeapUsage> heaps = {};
+
+        // Live device memory allocations made by the engine, against maxMemoryAllocationCount.
+        uint32_t allocationCount = 0;
+        uint32_t maxAllocationCount = 0;
+        VkDeviceSize allocatedBytes = 0;
+
+        FrameCounters frame = {};
+
+        // Of the swapchain the last frame was presented to; the present mode may have fallen back
+        // from the requested one.
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        uint32_t swapchainImageCount = 0;
+
+        // Since init, including uploads made outside frames such as vertex and texture data.
+        VkDeviceSize totalUploadedBytes = 0;
+
+        // Read back one frame in flight later than the counters; all 0 when not supported.
+        bool isPipelineStatisticsSupported = false;
+        PipelineStatistics pipelineStatistics = {};
+    };
+
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // VK_EXT_memory_budget is enabled on the device.
+        bool enableMemoryBudget = false;
+
+        // The pipelineStatisticsQuery feature is enabled on the device.
+        bool enablePipelineStatistics = false;
+
+        // One query per frame in flight, read back when the frame slot is reused.
+        uint32_t frameSlotCount = 2;
+    };
+}
+
+// Where the memory goes and how much work each frame does. Counters are bumped by the recording
+// thread and published at endFrame(); snapshot() may be called from any thread.
+class Telemetry {
+public:
+    using Snapshot = TelemetryStructs::Snapshot;
+    using FrameCounters = TelemetryStructs::FrameCounters;
+    using FrameResources = TelemetryStructs::FrameResources;
+
+public:
+    Telemetry() = default;
+    ~Telemetry();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const TelemetryStructs::CreateInfo& info);
+
+    inline bool isPipelineStatisticsSupported() const { return m_isPipelineStatisticsSupported; }
+
+    // Allocations and uploads; callable from any thread.
+
+    void trackAllocation(VkDeviceSize size);
+
+    // For allocations released before the device is destroyed.
+    void trackFree(VkDeviceSize size);
+
+    void trackUpload(VkDeviceSize size);
+
+    // Frames; from the recording thread.
+
+    // Counters of the frame being recorded; bump them directly next to the commands.
+    inline FrameCounters& frameCounters() { return m_frameCounters; }
+
+    // Collect the statistics of the slot's previous frame and reset its query.
+    // The frame slot's previous submission must have completed.
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+
+    // Around everything the frame draws, outside of render passes.
+    void beginPipelineStatistics(VkCommandBuffer commandBuffer);
+
+    void endPipelineStatistics(VkCommandBuffer commandBuffer);
+
+    // Publish the frame counters along with the resources as of this frame, and start over.
+    void endFrame(const FrameResources& resources);
+
+    // Results.
+
+    // Heap usage is queried on every call.
+    Snapshot snapshot() const;
+
+    void destroy();
+
+private:
+    VkDevice* m_device = nullptr;
+
+    TelemetryStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    uint32_t m_maxAllocationCount = 0;
+
+    std::atomic<uint32_t> m_allocationCount = { 0 };
+    std::atomic<VkDeviceSize> m_allocatedBytes = { 0 };
+
+    std::atomic<VkDeviceSize> m_totalUploadedBytes = { 0 };
+
+    // Uploads are tracked from any thread, so they are kept apart from the other frame counters.
+    std::atomic<VkDeviceSize> m_frameUploadedBytes = { 0 };
+
+    FrameCounters m_frameCounters = {};
+
+    bool m_isPipelineStatisticsSupported = false;
+
+    struct FrameSlot {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        bool isQueryWritten = false;
+    };
+
+    std::vector<FrameSlot> m_frameSlots = {};
+
+    FrameSlot* m_currFrameSlot = nullptr;
+
+    // Published results.
+    mutable std::mutex m_publishedMutex = {};
+    uint64_t m_publishedFrameNumber = 0;
+    FrameCounters m_publishedFrameCounters = {};
+    FrameResources m_publishedFrameResources = {};
+    TelemetryStructs::PipelineStatistics m_publishedPipelineStatistics = {};
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,218 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+
+#include "TextureFormats.h"
+
+namespace TextureFormats {
+    FormatInfo queryFormatInfo(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+                return { 1, 1, 4, false };
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                return { 4, 4, 8, true };
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+            case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+                return { 4, 4, 16, true };
+            case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+            case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+                return { 8, 8, 16, true };
+            default:
+                return {};
+        }
+    }
+
+    VkDeviceSize mipLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+        auto info = queryFormatInfo(format);
+        VkDeviceSize blocksX = (width + info.blockWidth - 1) / info.blockWidth;
+        VkDeviceSize blocksY = (height + info.blockHeight - 1) / info.blockHeight;
+        return blocksX * blocksY * info.bytesPerBlock;
+    }
+
+    VkDeviceSize mipChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount) {
+        VkDeviceSize size = 0;
+        for (uint32_t i = 0; i < levelCount; ++i) {
+            size += mipLevelSize(format, std::max(width >> i, 1u), std::max(height >> i, 1u));
+        }
+        return size;
+    }
+
+    uint32_t fullMipLevelCount(uint32_t width, uint32_t height) {
+        uint32_t levelCount = 1;
+        for (uint32_t size = std::max(width, height); size > 1; size >>= 1) {
+            ++levelCount;
+        }
+        return levelCount;
+    }
+
+    static float decodeSrgb(unsigned char value) {
+        float c = value / 255.0f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static unsigned char encodeSrgb(float linear) {
+        float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+        return static_cast<unsigned char>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    void generateMipChainRGBA8(ImageData& image) {
+        auto levelCount = fullMipLevelCount(image.width, image.height);
+
+        bool isSrgb = image.format == VK_FORMAT_R8G8B8A8_SRGB || image.format == VK_FORMAT_B8G8R8A8_SRGB;
+        std::array<float, 256> linearTable = {};
+        for (uint32_t i = 0; i < 256; ++i) {
+            linearTable[i] = decodeSrgb(static_cast<unsigned char>(i));
+        }
+
+        image.levelOffsets.resize(1);
+        image.levelSizes.resize(1);
+        image.bytes.resize(mipChainSize(image.format, image.width, image.height, levelCount));
+
+        for (uint32_t level = 1; level < levelCount; ++level) {
+            uint32_t srcWidth = std::max(image.width >> (level - 1), 1u);
+            uint32_t srcHeight = std::max(image.height >> (level - 1), 1u);
+            uint32_t dstWidth = std::max(image.width >> level, 1u);
+            uint32_t dstHeight = std::max(image.height >> level, 1u);
+
+            auto srcOffset = image.levelOffsets[level - 1];
+            auto dstOffset = srcOffset + image.levelSizes[level - 1];
+            image.levelOffsets.push_back(dstOffset);
+            image.levelSizes.push_back(VkDeviceSize(dstWidth) * dstHeight * 4);
+
+            const unsigned char* src = image.bytes.data() + srcOffset;
+            unsigned char* dst = image.bytes.data() + dstOffset;
+
+            for (uint32_t y = 0; y < dstHeight; ++y) {
+                uint32_t y0 = std::min(2 * y, srcHeight - 1), y1 = std::min(2 * y + 1, srcHeight - 1);
+                for (uint32_t x = 0; x < dstWidth; ++x) {
+                    uint32_t x0 = std::min(2 * x, srcWidth - 1), x1 = std::min(2 * x + 1, srcWidth - 1);
+                    for (uint32_t c = 0; c < 4; ++c) {
+                        if (isSrgb && c < 3) {
+                            float sum = linearTable[src[(y0 * srcWidth + x0) * 4 + c]] + linearTable[src[(y0 * srcWidth + x1) * 4 + c]] +
+                                        linearTable[src[(y1 * srcWidth + x0) * 4 + c]] + linearTable[src[(y1 * srcWidth + x1) * 4 + c]];
+                            dst[(y * dstWidth + x) * 4 + c] = encodeSrgb(0.25f * sum);
+                            continue;
+                        }
+                        uint32_t sum = src[(y0 * srcWidth + x0) * 4 + c] + src[(y0 * srcWidth + x1) * 4 + c] +
+                                       src[(y1 * srcWidth + x0) * 4 + c] + src[(y1 * srcWidth + x1) * 4 + c];
+                        dst[(y * dstWidth + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+
+    static VkFormat convertGlInternalFormat(uint32_t glInternalFormat) {
+        switch (glInternalFormat) {
+            case 0x8058: return VK_FORMAT_R8G8B8A8_UNORM; // GL_RGBA8
+            case 0x8C43: return VK_FORMAT_R8G8B8A8_SRGB; // GL_SRGB8_ALPHA8
+            case 0x83F0: return VK_FORMAT_BC1_RGB_UNORM_BLOCK; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+            case 0x83F1: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK; // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+            case 0x8C4D: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK; // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+            case 0x83F3: return VK_FORMAT_BC3_UNORM_BLOCK; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+            case 0x8C4F: return VK_FORMAT_BC3_SRGB_BLOCK; // GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+            case 0x8E8C: return VK_FORMAT_BC7_UNORM_BLOCK; // GL_COMPRESSED_RGBA_BPTC_UNORM
+            case 0x8E8D: return VK_FORMAT_BC7_SRGB_BLOCK; // GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+            case 0x93B0: return VK_FORMAT_ASTC_4x4_UNORM_BLOCK; // GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+            case 0x93D0: return VK_FORMAT_ASTC_4x4_SRGB_BLOCK; // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR
+            case 0x93B7: return VK_FORMAT_ASTC_8x8_UNORM_BLOCK; // GL_COMPRESSED_RGBA_ASTC_8x8_KHR
+            case 0x93D7: return VK_FORMAT_ASTC_8x8_SRGB_BLOCK; // GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    struct KtxHeader {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType, glTypeSize, glFormat, glInternalFormat, glBaseInternalFormat;
+        uint32_t pixelWidth, pixelHeight, pixelDepth;
+        uint32_t numberOfArrayElements, numberOfFaces, numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    static KtxHeader readKtxHeader(std::ifstream& fin, const std::string& filename) {
+        if (!fin.is_open()) {
+            throw std::runtime_error("Failed to open KTX file " + filename + ".");
+        }
+
+        const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+        KtxHeader header = {};
+        fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!fin || memcmp(header.identifier, identifier, sizeof(identifier)) != 0) {
+            throw std::runtime_error("Invalid KTX file " + filename + ".");
+        }
+        // Only little endian 2D textures are supported, which covers what common encoders produce.
+        if (header.endianness != 0x04030201 || header.pixelDepth > 1 ||
+            header.numberOfArrayElements > 1 || header.numberOfFaces != 1) {
+            throw std::runtime_error("Unsupported KTX layout in " + filename + ".");
+        }
+
+        return header;
+    }
+
+    VkFormat queryKtxFormat(const std::string& filename) {
+        std::ifstream fin(filename, std::ios::binary);
+        return convertGlInternalFormat(readKtxHeader(fin, filename).glInternalFormat);
+    }
+
+    ImageData loadKtx(const std::string& filename) {
+        std::ifstream fin(filename, std::ios::binary);
+        auto header = readKtxHeader(fin, filename);
+
+        ImageData image = {};
+        image.format = convertGlInternalFormat(header.glInternalFormat);
+        image.width = header.pixelWidth;
+        image.height = header.pixelHeight;
+        if (image.format == VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("Unsupported KTX format in " + filename + ".");
+        }
+
+        fin.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+        uint32_t levelCount = std::max(header.numberOfMipmapLevels, 1u);
+        for (uint32_t level = 0; level < levelCount; ++level) {
+            uint32_t imageSize = 0;
+            fin.read(reinterpret_cast<char*>(&imageSize), sizeof(imageSize));
+
+            auto expectedSize = mipLevelSize(image.format, std::max(image.width >> level, 1u), std::max(image.height >> level, 1u));
+            if (!fin || imageSize != expectedSize) {
+                throw std::runtime_error("Corrupted KTX level in " + filename + ".");
+            }
+
+            image.levelOffsets.push_back(image.bytes.size());
+            image.levelSizes.push_back(imageSize);
+            image.bytes.resize(image.bytes.size() + imageSize);
+            fin.read(reinterpret_cast<char*>(image.bytes.data() + image.levelOffsets.back()), imageSize);
+
+            // Each level is padded to 4 bytes.
+            fin.seekg((4 - imageSize % 4) % 4, std::ios::cur);
+        }
+
+        return image;
+    }
+}
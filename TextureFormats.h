@@ -0,0 +1,60 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef TEXTURE_FORMATS_H
+#define TEXTURE_FORMATS_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TextureFormats {
+    struct FormatInfo {
+        uint32_t blockWidth = 1;
+        uint32_t blockHeight = 1;
+        uint32_t bytesPerBlock = 0; // 0 means the format is not supported by the texture subsystem.
+        bool isCompressed = false;
+    };
+
+    FormatInfo queryFormatInfo(VkFormat format);
+
+    VkDeviceSize mipLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+    VkDeviceSize mipChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount);
+
+    uint32_t fullMipLevelCount(uint32_t width, uint32_t height);
+
+    // Tightly packed pixel data of all mip levels, level 0 first.
+    struct ImageData {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<VkDeviceSize> levelOffsets = {};
+        std::vector<VkDeviceSize> levelSizes = {};
+        std::vector<unsigned char> bytes = {};
+
+        inline uint32_t levelCount() const { return static_cast<uint32_t>(levelSizes.size()); }
+    };
+
+    // Append the remaining levels of a RGBA8 image whose level 0 is already filled, with a 2x2 box filter.
+    // This is the offline path used when the device can not blit the format. sRGB color is averaged in
+    // linear space, as a blit would, so the smaller levels do not darken; alpha is always linear.
+    void generateMipChainRGBA8(ImageData& image);
+
+    // Only read the header; used to pick a candidate file the device can sample before loading it.
+    VkFormat queryKtxFormat(const std::string& filename);
+
+    // Load a KTX (version 1) container of a 2D texture, typically holding offline compressed BC/ASTC levels.
+    ImageData loadKtx(const std::string& filename);
+}
+
+#endif // TEXTURE_FORMATS_H
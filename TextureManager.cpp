@@ -0,0 +1,418 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <QDebug>
+#include <QImage>
+
+#include "TextureManager.h"
+
+TextureManager::~TextureManager() {
+    destroy(); // In case someone forgets destroy created images and samplers.
+}
+
+void TextureManager::init(const TextureManagerStructs::CreateInfo& info) {
+    m_info = info;
+
+    vkGetPhysicalDeviceMemoryProperties(m_info.physicalDevice, &m_memoryProperties);
+
+    m_memoryPool.setDevice(m_device);
+}
+
+TextureManager::Handle TextureManager::createTexture(const std::vector<std::string>& candidateFilenames) {
+    // A candidate that is missing, unreadable or not sampleable falls through to the next one.
+    for (const auto& filename : candidateFilenames) {
+        auto isKtx = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".ktx") == 0;
+
+        // Offline encoded containers already hold their whole mip chain.
+        if (isKtx) {
+            TextureFormats::ImageData imageData = {};
+            try {
+                if (!isFormatSampleable(TextureFormats::queryKtxFormat(filename))) continue;
+                imageData = TextureFormats::loadKtx(filename);
+            }
+            catch (const std::runtime_error& e) {
+                qDebug() << e.what();
+                continue;
+            }
+            return createTexture(imageData, filename);
+        }
+
+        QImage image(QString::fromStdString(filename));
+        if (image.isNull()) {
+            qDebug() << "Failed to load image" << filename.c_str();
+            continue;
+        }
+        image = image.convertToFormat(QImage::Format_RGBA8888);
+
+        TextureFormats::ImageData imageData = {};
+        imageData.format = VK_FORMAT_R8G8B8A8_SRGB;
+        imageData.width = image.width();
+        imageData.height = image.height();
+        imageData.levelOffsets = { 0 };
+        imageData.levelSizes = { VkDeviceSize(imageData.width) * imageData.height * 4 };
+        imageData.bytes.resize(imageData.levelSizes[0]);
+
+        // Scan lines of a QImage are 4-byte aligned, which RGBA8 rows already are.
+        for (uint32_t y = 0; y < imageData.height; ++y) {
+            memcpy(imageData.bytes.data() + y * imageData.width * 4, image.constScanLine(y), imageData.width * 4);
+        }
+
+        return createTexture(imageData, filename);
+    }
+
+    throw std::runtime_error("Failed to load a texture: no candidate could be read in a format supported by the device.");
+}
+
+TextureManager::Handle TextureManager::createTexture(const TextureFormats::ImageData& imageData, const std::string& debugName) {
+    if (!isFormatSampleable(imageData.format)) {
+        throw std::runtime_error("Texture format of " + debugName + " is not supported by the device.");
+    }
+
+    Texture texture = {};
+    texture.format = imageData.format;
+    texture.width = imageData.width;
+    texture.height = imageData.height;
+    texture.name = debugName;
+
+    auto formatInfo = TextureFormats::queryFormatInfo(imageData.format);
+    auto fullLevelCount = TextureFormats::fullMipLevelCount(imageData.width, imageData.height);
+
+    // Compressed data can not be filtered on the fly, so it is used with whatever levels it carries.
+    if (formatInfo.isCompressed || imageData.levelCount() == fullLevelCount) {
+        texture.levelCount = imageData.levelCount();
+        createImage(texture);
+        createImageView(texture);
+        uploadImageData(texture, imageData, false);
+    }
+    else if (isFormatBlittable(imageData.format)) {
+        texture.levelCount = fullLevelCount;
+        createImage(texture);
+        createImageView(texture);
+        uploadImageData(texture, imageData, true);
+    }
+    else {
+        // Offline path; every supported uncompressed format has 4 bytes per texel, filtered per channel.
+        auto mippedData = imageData;
+        TextureFormats::generateMipChainRGBA8(mippedData);
+
+        texture.levelCount = mippedData.levelCount();
+        createImage(texture);
+        createImageView(texture);
+        uploadImageData(texture, mippedData, false);
+    }
+
+    m_textures.push_back(texture);
+    return static_cast<Handle>(m_textures.size() - 1);
+}
+
+TextureManager::Handle TextureManager::createSolidTexture(uint32_t rgba, const std::string& debugName) {
+    TextureFormats::ImageData imageData = {};
+    imageData.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageData.width = 1;
+    imageData.height = 1;
+    imageData.levelOffsets = { 0 };
+    imageData.levelSizes = { 4 };
+    imageData.bytes = {
+            static_cast<unsigned char>(rgba >> 24), static_cast<unsigned char>(rgba >> 16),
+            static_cast<unsigned char>(rgba >> 8), static_cast<unsigned char>(rgba)
+    };
+
+    return createTexture(imageData, debugName);
+}
+
+VkSampler TextureManager::acquireSampler(const SamplerKey& key) {
+    auto itor = m_samplers.find(key);
+    if (itor != m_samplers.end()) {
+        return itor->second;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = static_cast<VkFilter>(key.magFilter);
+    samplerInfo.minFilter = static_cast<VkFilter>(key.minFilter);
+    samplerInfo.mipmapMode = static_cast<VkSamplerMipmapMode>(key.mipmapMode);
+    samplerInfo.addressModeU = static_cast<VkSamplerAddressMode>(key.addressModeU);
+    samplerInfo.addressModeV = static_cast<VkSamplerAddressMode>(key.addressModeV);
+    samplerInfo.addressModeW = static_cast<VkSamplerAddressMode>(key.addressModeW);
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.anisotropyEnable = (key.anisotropyEnable && m_info.samplerAnisotropy) ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = samplerInfo.anisotropyEnable ? std::min(16.0f, m_info.maxSamplerAnisotropy) : 1.0f;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+
+    VkSampler sampler = {};
+    if (vkCreateSampler(*m_device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create sampler.");
+    }
+
+    m_samplers.insert({ key, sampler });
+    return sampler;
+}
+
+bool TextureManager::isFormatSampleable(VkFormat format) const {
+    auto formatInfo = TextureFormats::queryFormatInfo(format);
+    if (formatInfo.bytesPerBlock == 0) return false;
+
+    // Block compressed formats additionally need their feature enabled on the device.
+    if (formatInfo.isCompressed) {
+        bool isASTC = format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK;
+        if (isASTC ? !m_info.textureCompressionASTC : !m_info.textureCompressionBC) return false;
+    }
+
+    VkFormatProperties properties = {};
+    vkGetPhysicalDeviceFormatProperties(m_info.physicalDevice, format, &properties);
+
+    return properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+}
+
+void TextureManager::destroy() {
+    for (auto& samplerGroup : m_samplers) {
+        vkDestroySampler(*m_device, samplerGroup.second, nullptr);
+    }
+    m_samplers.clear();
+
+    for (auto& texture : m_textures) {
+        vkDestroyImageView(*m_device, texture.view, nullptr);
+        vkDestroyImage(*m_device, texture.image, nullptr);
+        m_memoryPool.free(texture.allocation);
+    }
+    m_textures.clear();
+
+    m_memoryPool.destroy();
+}
+
+bool TextureManager::isFormatBlittable(VkFormat format) const {
+    VkFormatProperties properties = {};
+    vkGetPhysicalDeviceFormatProperties(m_info.physicalDevice, format, &properties);
+
+    VkFormatFeatureFlags required =
+            VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+            VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+void TextureManager::createImage(Texture& texture) {
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = texture.format;
+    imageInfo.extent = { texture.width, texture.height, 1 };
+    imageInfo.mipLevels = texture.levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    // Levels generated on the device are read back as blit sources.
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(*m_device, &imageInfo, nullptr, &texture.image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture image.");
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(*m_device, texture.image, &requirements);
+
+    auto memoryTypeIndex = findAdequateMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    texture.allocation = m_memoryPool.allocate(requirements, memoryTypeIndex);
+
+    vkBindImageMemory(*m_device, texture.image, texture.allocation.memory, texture.allocation.offset);
+}
+
+void TextureManager::createImageView(Texture& texture) {
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = texture.image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = texture.format;
+    viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = texture.levelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(*m_device, &viewInfo, nullptr, &texture.view) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture image view.");
+    }
+}
+
+void TextureManager::uploadImageData(Texture& texture, const TextureFormats::ImageData& imageData, bool generateMipsOnDevice) {
+    // Create staging buffer.
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = imageData.bytes.size();
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer stagingBuffer = {};
+    if (vkCreateBuffer(*m_device, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create texture staging buffer.");
+    }
+
+    VkMemoryRequirements requirements = {};
+    vkGetBufferMemoryRequirements(*m_device, stagingBuffer, &requirements);
+
+    VkMemoryAllocateInfo memoryAllocInfo = {};
+    memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memoryAllocInfo.allocationSize = requirements.size;
+    memoryAllocInfo.memoryTypeIndex = findAdequateMemoryType(requirements.memoryTypeBits,
+                                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    VkDeviceMemory stagingMemory = {};
+    if (vkAllocateMemory(*m_device, &memoryAllocInfo, nullptr, &stagingMemory) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate texture staging memory.");
+    }
+    vkBindBufferMemory(*m_device, stagingBuffer, stagingMemory, 0);
+
+    void* data;
+    vkMapMemory(*m_device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(data, imageData.bytes.data(), imageData.bytes.size());
+    vkUnmapMemory(*m_device, stagingMemory);
+    m_uploadedBytes += imageData.bytes.size();
+
+    // Record upload commands.
+    VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+    cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufferAllocInfo.commandPool = m_info.commandPool;
+    cmdBufferAllocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmdBuffer = {};
+    vkAllocateCommandBuffers(*m_device, &cmdBufferAllocInfo, &cmdBuffer);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture.image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    // All levels: UNDEFINED -> TRANSFER_DST.
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = texture.levelCount;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // Copy every level the data carries.
+    std::vector<VkBufferImageCopy> copyRegions(imageData.levelCount());
+    for (uint32_t level = 0; level < imageData.levelCount(); ++level) {
+        auto& region = copyRegions[level];
+        region.bufferOffset = imageData.levelOffsets[level];
+        region.bufferRowLength = 0; // Tightly packed.
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+    }
+
+    vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           copyRegions.size(), copyRegions.data());
+
+    uint32_t firstFinalLevel = 0;
+    if (generateMipsOnDevice) {
+        // Each level is downsampled from the previous one, which is turned into a blit source first.
+        for (uint32_t level = 1; level < texture.levelCount; ++level) {
+            barrier.subresourceRange.baseMipLevel = level - 1;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+            vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+            blit.srcOffsets[1] = { int32_t(std::max(texture.width >> (level - 1), 1u)),
+                                   int32_t(std::max(texture.height >> (level - 1), 1u)), 1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+            blit.dstOffsets[1] = { int32_t(std::max(texture.width >> level, 1u)),
+                                   int32_t(std::max(texture.height >> level, 1u)), 1 };
+
+            vkCmdBlitImage(cmdBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+            vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+        firstFinalLevel = texture.levelCount - 1;
+    }
+
+    // Remaining levels: TRANSFER_DST -> SHADER_READ_ONLY.
+    barrier.subresourceRange.baseMipLevel = firstFinalLevel;
+    barrier.subresourceRange.levelCount = texture.levelCount - firstFinalLevel;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkEndCommandBuffer(cmdBuffer);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuffer;
+
+    vkQueueSubmit(m_info.queue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(m_info.queue);
+
+    vkFreeCommandBuffers(*m_device, m_info.commandPool, 1, &cmdBuffer);
+
+    vkDestroyBuffer(*m_device, stagingBuffer, nullptr);
+    vkFreeMemory(*m_device, stagingMemory, nullptr);
+}
+
+uint32_t TextureManager::findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i) {
+        if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    throw std::runtime_error("Failed to find an adequate memory type.");
+}
@@ -0,0 +1,175 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "ImageMemoryPool.h"
+#include "TextureFormats.h"
+
+namespace TextureManagerStructs {
+    struct CreateInfo {
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+
+        // Used for one-shot upload submissions.
+        VkQueue queue = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+
+        // Device features actually enabled on the logical device.
+        bool textureCompressionBC = false;
+        bool textureCompressionASTC = false;
+        bool samplerAnisotropy = false;
+        float maxSamplerAnisotropy = 1.0f;
+    };
+
+    struct Texture {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        ImageMemoryPool::Allocation allocation = {};
+
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t levelCount = 0;
+
+        std::string name = {};
+    };
+
+    // Padding-free so that the raw bytes can be hashed and compared directly.
+    struct SamplerKey {
+        uint8_t magFilter; // VkFilter
+        uint8_t minFilter; // VkFilter
+        uint8_t mipmapMode; // VkSamplerMipmapMode
+        uint8_t addressModeU; // VkSamplerAddressMode
+        uint8_t addressModeV;
+        uint8_t addressModeW;
+        uint8_t anisotropyEnable;
+        uint8_t padding;
+
+        // Trilinear, repeating, anisotropic when the device allows it.
+        static SamplerKey makeDefault() {
+            SamplerKey key;
+            memset(&key, 0, sizeof(key));
+
+            key.magFilter = VK_FILTER_LINEAR;
+            key.minFilter = VK_FILTER_LINEAR;
+            key.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+            key.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            key.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            key.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            key.anisotropyEnable = 1;
+
+            return key;
+        }
+    };
+
+    static_assert(std::has_unique_object_representations_v<SamplerKey>,
+                  "SamplerKey must not contain padding bytes.");
+
+    struct SamplerKeyHasher {
+        size_t operator()(const SamplerKey& key) const {
+            uint64_t value = 0;
+            memcpy(&value, &key, sizeof(key));
+            return std::hash<uint64_t>()(value);
+        }
+    };
+
+    struct SamplerKeyEqual {
+        bool operator()(const SamplerKey& lhs, const SamplerKey& rhs) const {
+            return memcmp(&lhs, &rhs, sizeof(SamplerKey)) == 0;
+        }
+    };
+}
+
+// Owns sampled images, their pooled memory and the samplers used to read them.
+// Images are uploaded once; mip chains come from the file (KTX), from vkCmdBlitImage,
+// or from a CPU box filter when the format can not be blitted with linear filtering.
+class TextureManager {
+public:
+    using Texture = TextureManagerStructs::Texture;
+    using SamplerKey = TextureManagerStructs::SamplerKey;
+
+    using Handle = uint32_t;
+    constexpr static Handle InvalidHandle = UINT32_MAX;
+
+public:
+    TextureManager() = default;
+    ~TextureManager();
+
+    inline void setDevice(VkDevice* device) { m_device = device; }
+
+    void init(const TextureManagerStructs::CreateInfo& info);
+
+    // The first candidate that can be read and whose format the device can sample is used, so callers may list
+    // e.g. a BC7 and an ASTC encoding of the same image followed by an uncompressed source; missing ones are skipped.
+    // Throws only when no candidate is left.
+    Handle createTexture(const std::vector<std::string>& candidateFilenames);
+
+    Handle createTexture(const TextureFormats::ImageData& imageData, const std::string& debugName);
+
+    // 1x1 texture of the given RGBA8 color.
+    Handle createSolidTexture(uint32_t rgba, const std::string& debugName);
+
+    inline const Texture& texture(Handle handle) const { return m_textures[handle]; }
+
+    inline size_t textureCount() const { return m_textures.size(); }
+
+    // Samplers are owned by the cache and live until destroy().
+    VkSampler acquireSampler(const SamplerKey& key);
+
+    bool isFormatSampleable(VkFormat format) const;
+
+    inline const ImageMemoryPool& memoryPool() const { return m_memoryPool; }
+
+    // Bytes copied through staging buffers so far.
+    inline VkDeviceSize uploadedBytes() const { return m_uploadedBytes; }
+
+    void destroy();
+
+private:
+    bool isFormatBlittable(VkFormat format) const;
+
+    void createImage(Texture& texture);
+
+    void createImageView(Texture& texture);
+
+    // Record and submit the whole upload; waits until the queue is idle.
+    void uploadImageData(Texture& texture, const TextureFormats::ImageData& imageData, bool generateMipsOnDevice);
+
+    uint32_t findAdequateMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+    VkDevice* m_device = nullptr;
+
+    TextureManagerStructs::CreateInfo m_info = {};
+
+    VkPhysicalDeviceMemoryProperties m_memoryProperties = {};
+
+    ImageMemoryPool m_memoryPool = {};
+
+    std::vector<Texture> m_textures = {};
+
+    VkDeviceSize m_uploadedBytes = 0;
+
+    std::unordered_map<SamplerKey, VkSampler,
+                       TextureManagerStructs::SamplerKeyHasher,
+                       TextureManagerStructs::SamplerKeyEqual> m_samplers = {};
+};
+
+#endif // TEXTURE_MANAGER_H
@@ -0,0 +1,123 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SimdLane.h"
+#include "TransformMath.h"
+
+void TransformMath::TransformSoA::resize(size_t count) {
+    for (auto component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ }) {
+        component->resize(count, 0.0f);
+    }
+    for (auto component : { &rotationW, &scaleX, &scaleY, &scaleZ }) {
+        component->resize(count, 1.0f);
+    }
+}
+
+void TransformMath::TransformSoA::set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    positionX[index] = position.x;
+    positionY[index] = position.y;
+    positionZ[index] = position.z;
+    rotationX[index] = rotation.x;
+    rotationY[index] = rotation.y;
+    rotationZ[index] = rotation.z;
+    rotationW[index] = rotation.w;
+    scaleX[index] = scale.x;
+    scaleY[index] = scale.y;
+    scaleZ[index] = scale.z;
+}
+
+namespace {
+    using namespace SimdLane;
+
+    glm::mat4 composeMatrix(const TransformMath::TransformSoA& transforms, size_t i) {
+        glm::quat rotation = glm::quat(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i]);
+        glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]));
+        matrix = matrix * glm::mat4_cast(rotation);
+        return glm::scale(matrix, glm::vec3(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]));
+    }
+}
+
+const char* TransformMath::instructionSet() {
+    return SimdLane::instructionSet();
+}
+
+void TransformMath::composeMatrices(const TransformSoA& transforms, glm::mat4* matrices) {
+    composeMatrices(transforms, 0, transforms.size(), matrices);
+}
+
+void TransformMath::composeMatrices(const TransformSoA& transforms, size_t first, size_t count, glm::mat4* matrices) {
+    size_t end = first + count;
+    size_t i = first;
+
+    const Lane one = splat(1.0f), two = splat(2.0f), zero = splat(0.0f);
+
+    for (; i + 4 <= end; i += 4) {
+        Lane qx = load(&transforms.rotationX[i]), qy = load(&transforms.rotationY[i]);
+        Lane qz = load(&transforms.rotationZ[i]), qw = load(&transforms.rotationW[i]);
+
+        Lane xx = mul(qx, qx), yy = mul(qy, qy), zz = mul(qz, qz);
+        Lane xy = mul(qx, qy), xz = mul(qx, qz), yz = mul(qy, qz);
+        Lane wx = mul(qw, qx), wy = mul(qw, qy), wz = mul(qw, qz);
+
+        // Same layout as glm::mat3_cast: columns scaled by the matching scale component.
+        Lane sx = load(&transforms.scaleX[i]), sy = load(&transforms.scaleY[i]), sz = load(&transforms.scaleZ[i]);
+        Lane columns[4][4] = {
+                { mul(sub(one, mul(two, add(yy, zz))), sx), mul(mul(two, add(xy, wz)), sx), mul(mul(two, sub(xz, wy)), sx), zero },
+                { mul(mul(two, sub(xy, wz)), sy), mul(sub(one, mul(two, add(xx, zz))), sy), mul(mul(two, add(yz, wx)), sy), zero },
+                { mul(mul(two, add(xz, wy)), sz), mul(mul(two, sub(yz, wx)), sz), mul(sub(one, mul(two, add(xx, yy))), sz), zero },
+                { load(&transforms.positionX[i]), load(&transforms.positionY[i]), load(&transforms.positionZ[i]), one }
+        };
+
+        // Each column holds one row component of four objects; transposing gives one column of each object.
+        for (int c = 0; c < 4; ++c) {
+            auto& column = columns[c];
+            transpose(column[0], column[1], column[2], column[3]);
+            for (int k = 0; k < 4; ++k) {
+                store(&matrices[i - first + k][c][0], column[k]);
+            }
+        }
+    }
+
+    for (; i < end; ++i) {
+        matrices[i - first] = composeMatrix(transforms, i);
+    }
+}
+
+void TransformMath::composeMatricesScalar(const TransformSoA& transforms, glm::mat4* matrices) {
+    for (size_t i = 0; i < transforms.size(); ++i) {
+        matrices[i] = composeMatrix(transforms, i);
+    }
+}
+
+void TransformMath::multiplyMatrices(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* results, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        Lane a0 = load(&lhs[i][0][0]), a1 = load(&lhs[i][1][0]), a2 = load(&lhs[i][2][0]), a3 = load(&lhs[i][3][0]);
+        const float* b = &rhs[i][0][0];
+
+        // Column j of the result is the columns of lhs weighted by column j of rhs.
+        Lane columns[4];
+        for (int j = 0; j < 4; ++j) {
+            columns[j] = add(add(mul(a0, splat(b[4 * j + 0])), mul(a1, splat(b[4 * j + 1]))),
+                             add(mul(a2, splat(b[4 * j + 2])), mul(a3, splat(b[4 * j + 3]))));
+        }
+        // Stored last, since the result may alias an input.
+        for (int j = 0; j < 4; ++j) {
+            store(&results[i][j][0], columns[j]);
+        }
+    }
+}
+
+void TransformMath::multiplyMatricesScalar(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* results, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        results[i] = lhs[i] * rhs[i];
+    }
+}
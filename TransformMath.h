@@ -0,0 +1,56 @@
+/*
+** Render Station @ https://github.com/yiyaowen/render-station
+**
+** Create fantastic animation and game.
+**
+** yiyaowen (c) 2021 All Rights Reserved.
+**
+** Developed with Qt5 and Vulkan on macOS.
+*/
+
+#ifndef TRANSFORM_MATH_H
+#define TRANSFORM_MATH_H
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Batched transform math for many objects at once. Inputs are kept as structure of arrays
+// so that four objects fill one SIMD register per component (see SimdLane.h); the remainder
+// of a batch goes through the scalar path.
+namespace TransformMath {
+    // Translation, rotation and scale of each object, one array per component.
+    struct TransformSoA {
+        std::vector<float> positionX = {}, positionY = {}, positionZ = {};
+        std::vector<float> rotationX = {}, rotationY = {}, rotationZ = {}, rotationW = {}; // Unit quaternions.
+        std::vector<float> scaleX = {}, scaleY = {}, scaleZ = {};
+
+        inline size_t size() const { return positionX.size(); }
+
+        // New entries are identity transforms.
+        void resize(size_t count);
+
+        void set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    };
+
+    // "SSE2", "NEON" or "scalar".
+    const char* instructionSet();
+
+    // matrices[i] = T * R * S of transforms[i]; matrices must hold transforms.size() entries.
+    void composeMatrices(const TransformSoA& transforms, glm::mat4* matrices);
+
+    // matrices[k] = T * R * S of transforms[first + k] for k < count.
+    void composeMatrices(const TransformSoA& transforms, size_t first, size_t count, glm::mat4* matrices);
+
+    // Reference path with glm::translate, glm::mat4_cast and glm::scale.
+    void composeMatricesScalar(const TransformSoA& transforms, glm::mat4* matrices);
+
+    // results[i] = lhs[i] * rhs[i]; results may alias either input.
+    void multiplyMatrices(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* results, size_t count);
+
+    void multiplyMatricesScalar(const glm::mat4* lhs, const glm::mat4* rhs, glm::mat4* results, size_t count);
+}
+
+#endif // TRANSFORM_MATH_H
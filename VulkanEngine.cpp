@@ -11,9 +11,13 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <set>
+#include <unordered_set>
 
 #include <QApplication>
 #include <QDesktopWidget>
@@ -40,6 +44,9 @@ void VulkanEngine::init(const VulkanEngineStructs::CreateInfo& info) {
 
     m_originInfo = info;
 
+    m_presentSettings = info.present;
+    m_presentSettingsExchange.publish(info.present);
+
     // Init surface info.
     m_surfaceInfo = info.surface;
 
@@ -53,9 +60,16 @@ void VulkanEngine::init(const VulkanEngineStructs::CreateInfo& info) {
 
     // Init vulkan core.
     initCore();
+
+    if (info.enableRenderThread) {
+        startRenderThread();
+    }
 }
 
 VulkanEngine::~VulkanEngine() {
+    // The render thread must not touch anything destroyCore() releases; a failure has had its chance to be reported.
+    joinRenderThread();
+
     destroyCore();
 }
 
@@ -64,14 +78,58 @@ void VulkanEngine::renderFrame() {
     mRenderFrame();
 }
 
-void VulkanEngine::resize(uint32_t width, uint32_t height) {
-    m_surfaceInfo.screenCoordWidth = width;
-    m_surfaceInfo.screenCoordHeight = height;
+void VulkanEngine::setPresentSettings(const VulkanEngineStructs::PresentSettings& settings) {
+    m_presentSettingsExchange.publish(settings);
+    m_isPresentSettingsPending.store(true, std::memory_order_release);
+}
+
+void VulkanEngine::startRenderThread() {
+    if (m_renderThread.joinable()) return;
+
+    m_shouldRenderThreadRun.store(true, std::memory_order_release);
+    m_renderThread = std::thread(&VulkanEngine::renderThreadLoop, this);
+}
+
+void VulkanEngine::stopRenderThread() {
+    joinRenderThread();
+
+    if (m_renderThreadException) {
+        auto exception = m_renderThreadException;
+        m_renderThreadException = nullptr;
+        m_hasRenderThreadFailed.store(false, std::memory_order_relaxed);
+        std::rethrow_exception(exception);
+    }
+}
+
+void VulkanEngine::joinRenderThread() {
+    if (!m_renderThread.joinable()) return;
+
+    m_shouldRenderThreadRun.store(false, std::memory_order_release);
+    m_renderThread.join();
+}
 
-    m_surfaceInfo.pixelWidth = m_surfaceInfo.DPR * width;
-    m_surfaceInfo.pixelHeight = m_surfaceInfo.DPR * height;
+void VulkanEngine::renderThreadLoop() {
+    try {
+        while (m_shouldRenderThreadRun.load(std::memory_order_acquire)) {
+            renderFrame();
 
-    recreateSwapchain();
+            // Nothing to wait on when rendering is paused or the window is minimized.
+            if (!m_renderEnable || m_surfaceInfo.pixelWidth == 0 || m_surfaceInfo.pixelHeight == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    }
+    catch (...) {
+        // The thread stays joinable, so the GUI thread does not start rendering on its own.
+        m_renderThreadException = std::current_exception();
+        m_hasRenderThreadFailed.store(true, std::memory_order_release);
+    }
+}
+
+void VulkanEngine::resize(uint32_t width, uint32_t height) {
+    m_pendingWidth.store(width, std::memory_order_relaxed);
+    m_pendingHeight.store(height, std::memory_order_relaxed);
+    m_isResizePending.store(true, std::memory_order_release);
 }
 
 void VulkanEngine::initCore() {
@@ -85,30 +143,59 @@ void VulkanEngine::initCore() {
 
     createLogicalDevice();
 
+    // Before anything allocates, so all engine allocations are counted.
+    createTelemetry();
+
     createSwapchain();
 
     createImageViews();
 
-    createRenderPasses();
+    m_depthFormat = selectDepthFormat();
+
+    m_sampleCount = selectSampleCount();
 
-    createFramebuffers();
+    buildRenderGraph();
+
+    // The bindless table lives as long as the device and is shared by all pipelines.
+    createBindlessDescriptors();
+
+    createDescriptorAllocator();
 
     // Decide target desc set layout before creating pipelines.
     createDescriptorSetLayout();
 
+    // Shader modules and pipeline layouts do not depend on the swapchain, so they live as long as the device.
+    createGraphicsPipelineLayout();
+
     createGraphicsPipelines();
 
+    createComputePipelines();
+
     createCommandPool();
 
-    // Must prepare all resource data before creating command buffers.
+    createProfiler();
+
+    // Must prepare all resource data before recording command buffers.
     createAllDeclaredVertexBuffers();
+    createSkinningSystem();
+    buildAllDeclaredMeshlets(); // Reorders indices, so before they are uploaded.
     createAllDeclaredIndexBuffers();
+    createMeshletBuffer();
+    resolveDrawItems();
     createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
+    createAllDeclaredTextures(); // Materials refer to bindless slots of textures.
+    createMaterialBuffer();
+    createInstanceBuffers();
+    createOcclusionCulling(); // The pyramid is cleared with a one-shot submission.
+    createShadowCascades(); // So are the shadow maps.
+    createClusteredLighting();
 
     createCommandBuffers();
 
+    createAsyncCompute();
+
+    createParticleSystem(); // Shares its buffers through async compute.
+
     createFencesAndSemaphores();
 }
 
@@ -138,6 +225,15 @@ void VulkanEngine::destroyCore() {
     // Destroy: createCommandPool()
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 
+    // Destroy: createParticleSystem()
+    m_particleSystem.destroy();
+
+    // Destroy: createSkinningSystem()
+    m_skinningSystem.destroy();
+
+    // Destroy: createAsyncCompute()
+    m_asyncCompute.destroy();
+
     // Cleanup created buffers.
     // Note that command buffers may depend on this data, so it should be destroyed after command pool.
     for (auto& vertexBufferGroup : m_vertexBuffers) {
@@ -163,37 +259,77 @@ void VulkanEngine::destroyCore() {
     }
 
     for (auto& uniformBuffer : m_uniformBuffer.resources) {
+        vkUnmapMemory(m_device, uniformBuffer.memory);
         vkDestroyBuffer(m_device, uniformBuffer.buffer, nullptr);
         vkFreeMemory(m_device, uniformBuffer.memory, nullptr);
     }
 
-    // Destroy: createDescriptorPool()
-    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
-
-    // Destroy: createGraphicsPipelines()
-    for (auto& pipelineLayout : m_pipelineLayouts) {
-        vkDestroyPipelineLayout(m_device, pipelineLayout.second, nullptr);
+    // Destroy: createInstanceBuffers()
+    for (size_t i = 0; i < m_instanceBuffer.resources.size(); ++i) {
+        destroyInstanceBuffer(i);
     }
 
-    for (auto& graphicsPipeline : m_graphicsPipelines) {
-        vkDestroyPipeline(m_device, graphicsPipeline.second, nullptr);
+    // Destroy: createOcclusionCulling()
+    for (size_t i = 0; i < m_occlusionBuffers.objectCapacities.size(); ++i) {
+        destroyOcclusionBuffers(i);
+    }
+    for (auto& statisticsResource : m_occlusionBuffers.statisticsResources) {
+        vkUnmapMemory(m_device, statisticsResource.memory);
+        vkDestroyBuffer(m_device, statisticsResource.buffer, nullptr);
+        vkFreeMemory(m_device, statisticsResource.memory, nullptr);
+        m_telemetry.trackFree(statisticsResource.requirements.size);
     }
+    m_occlusionBuffers.statisticsResources.clear();
+    m_occlusionBuffers.statisticsMappedData.clear();
+    m_hiZPyramid.destroy();
+
+    // Destroy: createShadowCascades()
+    m_shadowCascades.destroy();
+
+    // Destroy: createClusteredLighting()
+    m_clusteredLighting.destroy();
 
-    // Destroy: createDescriptorSetLayout()
-    for (auto& descSetLayout : m_descSetLayouts) {
-        vkDestroyDescriptorSetLayout(m_device, descSetLayout.second, nullptr);
+    // Destroy: createMaterialBuffer()
+    vkDestroyBuffer(m_device, m_materialBuffer.resource.buffer, nullptr);
+    vkFreeMemory(m_device, m_materialBuffer.resource.memory, nullptr);
+
+    // Destroy: createMeshletBuffer()
+    if (m_meshletBuffer.resource.buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, m_meshletBuffer.resource.buffer, nullptr);
+        vkFreeMemory(m_device, m_meshletBuffer.resource.memory, nullptr);
     }
 
-    // Destroy: createFramebuffers()
-    for (auto& framebuffer : m_swapchainFramebuffers) {
-        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+    // Destroy: createAllDeclaredTextures()
+    m_textureManager.destroy();
+
+    // Destroy: createGraphicsPipelineLayout(), createComputePipelines()
+    for (auto& pipelineLayout : m_pipelineLayouts) {
+        vkDestroyPipelineLayout(m_device, pipelineLayout.second, nullptr);
     }
 
-    // Destroy: createRenderPasses()
-    for (auto& renderPass : m_renderPasses) {
-        vkDestroyRenderPass(m_device, renderPass.second, nullptr);
+    m_pipelineRegistry.destroyAllPipelines();
+    m_pipelineRegistry.destroyPipelineCache();
+
+    // Destroy: createDescriptorAllocator(), createDescriptorSetLayout()
+    m_descriptorAllocator.destroy();
+
+    // Destroy: createBindlessDescriptors()
+    m_bindlessDescriptors.destroy();
+
+    if (m_bindlessFallbackBuffer.buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(m_device, m_bindlessFallbackBuffer.buffer, nullptr);
+        vkFreeMemory(m_device, m_bindlessFallbackBuffer.memory, nullptr);
     }
 
+    // Destroy: buildRenderGraph()
+    m_renderGraph.destroy();
+
+    // Destroy: createProfiler()
+    m_profiler.destroy();
+
+    // Destroy: createTelemetry()
+    m_telemetry.destroy();
+
     // Destroy: createImageViews()
     for (auto& imageView : m_swapchainImageViews) {
         vkDestroyImageView(m_device, imageView, nullptr);
@@ -224,43 +360,149 @@ void VulkanEngine::mRenderFrame() {
 
     // Frame start
 
-    vkWaitForFences(m_device, 1, &m_fences["frame_in_flight"][m_currFrameIndex], VK_TRUE, UINT64_MAX);
+    // Only CPU side copies are touched, so even frames with nothing to render to drain them.
+    applyPendingUpdates();
+
+    if (!prepareSwapchain()) return;
+
+    uint64_t frameBeginNs = m_profiler.nowNs();
+
+    bool isLowLatency = m_presentSettings.latencyMode == VulkanEngineStructs::LatencyMode::Low;
+    if (!isLowLatency) {
+        applyCameraInput();
+    }
+
+    {
+        ProfileScope scope(m_profiler, "wait_frame_fence");
+        vkWaitForFences(m_device, 1, &m_fences["frame_in_flight"][m_currFrameIndex], VK_TRUE, UINT64_MAX);
+    }
+    if (isLowLatency) {
+        // The previous frame too, so that input is not queued behind more than one frame.
+        ProfileScope scope(m_profiler, "wait_prev_frame_fence");
+        size_t prevFrameIndex = (m_currFrameIndex + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT;
+        vkWaitForFences(m_device, 1, &m_fences["frame_in_flight"][prevFrameIndex], VK_TRUE, UINT64_MAX);
+    }
 
     uint32_t  imageIndex;
-    vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_semaphores["image_available"][m_currFrameIndex], VK_NULL_HANDLE, &imageIndex);
+    VkResult acquireResult;
+    {
+        ProfileScope scope(m_profiler, "acquire");
+        acquireResult = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_semaphores["image_available"][m_currFrameIndex], VK_NULL_HANDLE, &imageIndex);
+    }
+    // Nothing was acquired and the semaphore is left unsignaled, so the frame is dropped as a whole;
+    // the fence is still signaled since it is only reset right before submission.
+    if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+        m_isSwapchainOutdated = true;
+        return;
+    }
+    // A suboptimal image can still be presented; recreate after this frame.
+    if (acquireResult == VK_SUBOPTIMAL_KHR) {
+        m_isSwapchainOutdated = true;
+    }
+    else if (acquireResult != VK_SUCCESS) {
+        throw std::runtime_error("Failed to acquire swapchain image.");
+    }
     m_currSwapchainImageIndex = imageIndex;
 
     if (m_fenceRefs["image_in_flight"][imageIndex] != VK_NULL_HANDLE) {
+        ProfileScope scope(m_profiler, "wait_image_fence");
         vkWaitForFences(m_device, 1, &m_fenceRefs["image_in_flight"][imageIndex], VK_TRUE, UINT64_MAX);
     }
     m_fenceRefs["image_in_flight"][imageIndex] = m_fences["frame_in_flight"][m_currFrameIndex];
 
+    // The frame's previous submission has retired, so all of its transient descriptor sets can go at once.
+    m_descriptorAllocator.resetFrame(m_currFrameIndex);
+
     // Update uniform buffers
 
-    updateUniformBuffers();
+    if (isLowLatency) {
+        applyCameraInput();
+    }
+    {
+        ProfileScope scope(m_profiler, "update_uniforms");
+        updateUniformBuffers();
+    }
+    if (m_skinningSystem.isInited()) {
+        ProfileScope scope(m_profiler, "update_skins");
+        m_skinningSystem.update(m_currFrameIndex);
+        m_telemetry.trackUpload(m_skinningSystem.poseSize());
+    }
+    {
+        ProfileScope scope(m_profiler, "cull");
+        cullDrawItems();
+        updateOcclusionBuffers();
+    }
+    if (m_shadowCascades.isInited()) {
+        ProfileScope scope(m_profiler, "update_shadows");
+        updateShadowCascades();
+    }
+    if (m_clusteredLighting.isInited()) {
+        ProfileScope scope(m_profiler, "update_lights");
+        m_clusteredLighting.update(m_currFrameIndex);
+        m_telemetry.trackUpload(m_clusteredLighting.uploadSize());
+
+        auto& counters = m_telemetry.frameCounters();
+        counters.pointLightCount = static_cast<uint32_t>(m_clusteredLighting.lightCount());
+        counters.lightIndexCount = m_clusteredLighting.lightIndexCount();
+        counters.droppedLightIndexCount = m_clusteredLighting.droppedLightIndexCount();
+    }
+    if (m_particleSystem.isInited()) {
+        ProfileScope scope(m_profiler, "update_particles");
+        // Frame to frame on the render thread, so a stall does not make particles jump too far.
+        uint64_t nowNs = m_profiler.nowNs();
+        float deltaTime = m_particleUpdateNs != 0 ? static_cast<float>(nowNs - m_particleUpdateNs) * 1e-9f : 0.0f;
+        m_particleUpdateNs = nowNs;
+
+        m_particleSystem.update(m_currFrameIndex, std::min(deltaTime, 0.1f));
+        m_telemetry.frameCounters().particleCount = m_particleSystem.aliveCount();
+    }
+
+    // Shared by the async compute tasks and the graphics work of the frame.
+    m_frameBindlessSet = m_bindlessDescriptors.prepareFrame(m_currFrameIndex);
+
+    // Async compute goes first, so it can run while the graphics work is recorded and submitted.
+    VkSemaphore computeFinished;
+    {
+        ProfileScope scope(m_profiler, "async_compute");
+        computeFinished = m_asyncCompute.submit(m_currFrameIndex);
+    }
+
+    // Record
+
+    auto& commandBuffer = m_commandBuffers[m_currFrameIndex];
+    {
+        ProfileScope scope(m_profiler, "record");
+        recordCommandBuffer(commandBuffer, imageIndex);
+    }
 
     // Render
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { m_semaphores["image_available"][m_currFrameIndex] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
+    // Only the stages consuming async compute results wait for them.
+    VkSemaphore waitSemaphores[] = { m_semaphores["image_available"][m_currFrameIndex], computeFinished };
+    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, m_asyncCompute.graphicsWaitStages() };
+    submitInfo.waitSemaphoreCount = computeFinished != VK_NULL_HANDLE ? 2 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &commandBuffer;
 
-    VkSemaphore signalSemaphores[] = { m_semaphores["render_finish"][m_currFrameIndex] };
-    submitInfo.signalSemaphoreCount = 1;
+    // Render finish comes first, since it is the one presenting waits for.
+    VkSemaphore graphicsReleased = m_asyncCompute.graphicsReleaseSemaphore();
+    VkSemaphore signalSemaphores[] = { m_semaphores["render_finish"][m_currFrameIndex], graphicsReleased };
+    submitInfo.signalSemaphoreCount = graphicsReleased != VK_NULL_HANDLE ? 2 : 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     vkResetFences(m_device, 1, &m_fences["frame_in_flight"][m_currFrameIndex]);
 
-    if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_fences["frame_in_flight"][m_currFrameIndex]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to submit queue.");
+    {
+        ProfileScope scope(m_profiler, "submit");
+        if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_fences["frame_in_flight"][m_currFrameIndex]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit queue.");
+        }
     }
 
     // Preset
@@ -277,95 +519,123 @@ void VulkanEngine::mRenderFrame() {
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
 
-    vkQueuePresentKHR(m_presentQueue, &presentInfo);
-
-    m_currFrameIndex = (m_currFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
-}
-
-void VulkanEngine::recreateSwapchain() {
-    m_renderEnable = false;
+    VkResult presentResult;
+    {
+        ProfileScope scope(m_profiler, "present");
+        presentResult = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    }
+    if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+        m_isSwapchainOutdated = true;
+    }
+    else if (presentResult != VK_SUCCESS) {
+        throw std::runtime_error("Failed to present swapchain image.");
+    }
 
-    // Wait util all works done.
-    vkDeviceWaitIdle(m_device);
+    // Up to the present call; when the image reaches the screen is up to the present mode.
+    if (m_sampledInputTimestampNs != 0) {
+        m_telemetry.frameCounters().inputToPresentNs = m_profiler.nowNs() - m_sampledInputTimestampNs;
+        m_sampledInputTimestampNs = 0;
+    }
+    m_telemetry.endFrame(gatherFrameResources());
 
-    // Destroy old swapchain.
-    destroyOldSwapchain();
+    m_profiler.recordCpuFrame(frameBeginNs, m_profiler.nowNs());
 
-    // Create new swapchain.
-    createSwapchain();
+    VulkanEngineStructs::CameraState cameraState = {};
+    cameraState.eye = m_camera->eye();
+    cameraState.yaw = m_cameraYaw;
+    cameraState.pitch = m_cameraPitch;
+    m_cameraStateExchange.publish(cameraState);
 
-    createImageViews();
+    m_currFrameIndex = (m_currFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+}
 
-    createRenderPasses();
+bool VulkanEngine::prepareSwapchain() {
+    if (m_isResizePending.exchange(false, std::memory_order_acquire)) {
+        uint32_t width = m_pendingWidth.load(std::memory_order_relaxed);
+        uint32_t height = m_pendingHeight.load(std::memory_order_relaxed);
 
-    createFramebuffers();
+        m_surfaceInfo.screenCoordWidth = width;
+        m_surfaceInfo.screenCoordHeight = height;
 
-    // Decide target desc set layout before creating pipelines.
-    createDescriptorSetLayout();
+        m_surfaceInfo.pixelWidth = m_surfaceInfo.DPR * width;
+        m_surfaceInfo.pixelHeight = m_surfaceInfo.DPR * height;
 
-    createGraphicsPipelines();
+        m_isSwapchainOutdated = true;
+    }
 
-    createUniformBuffers();
+    if (m_isPresentSettingsPending.exchange(false, std::memory_order_acquire)) {
+        auto settings = m_presentSettingsExchange.read();
+        if (settings.presentMode != m_presentSettings.presentMode || settings.imageCount != m_presentSettings.imageCount) {
+            m_isSwapchainOutdated = true;
+        }
+        m_presentSettings = settings;
+    }
 
-    createDescriptorPool();
+    // A zero-sized swapchain can not be created; keep it outdated until the window is restored.
+    if (m_surfaceInfo.pixelWidth == 0 || m_surfaceInfo.pixelHeight == 0) return false;
 
-    createDescriptorSets();
+    if (m_isSwapchainOutdated) {
+        recreateSwapchain();
+        m_isSwapchainOutdated = false;
+    }
+    return true;
+}
 
-    // Note that command pool is not recreated here for the sake of efficiency.
-    // Consequently, all command buffers should be freed in destroySwapchain.
+void VulkanEngine::recreateSwapchain() {
+    // Runs inside the frame on whichever thread renders, so no frame can start meanwhile; m_renderEnable
+    // belongs to its owner and is left alone.
 
-    createCommandBuffers();
+    // Wait util all works done.
+    vkDeviceWaitIdle(m_device);
 
-    m_renderEnable = true;
-}
+    // Destroy everything that depends on the old swapchain; the swapchain itself is retired below.
+    destroyOldSwapchain();
 
-void VulkanEngine::destroyOldSwapchain() {
-    // Destroy: shader modules created.
-    m_shaderContainer.destroyAllShaderModules();
+    // The extent limits follow the window, so the capabilities queried at startup are stale.
+    auto& details = m_physicalDeviceInfo.swapchainDetails;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &details.capabilities);
 
-    // Free: vkAllocateCommandBuffers()
-    vkFreeCommandBuffers(m_device, m_commandPool, m_commandBuffers.size(), m_commandBuffers.data());
+    // Create new swapchain.
+    auto oldSwapchain = m_swapchain;
+    createSwapchain(oldSwapchain);
+    vkDestroySwapchainKHR(m_device, oldSwapchain, nullptr);
 
-    // Destroy: createUniformBuffers(), createDescriptorPool()
-    vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+    createImageViews();
 
-    for (auto& uniformBuffer : m_uniformBuffer.resources) {
-        vkDestroyBuffer(m_device, uniformBuffer.buffer, nullptr);
-        vkFreeMemory(m_device, uniformBuffer.memory, nullptr);
-    }
+    // The image count may differ, and nothing is in flight after the wait.
+    m_fenceRefs["image_in_flight"].assign(m_swapchainImages.size(), VK_NULL_HANDLE);
 
+    m_renderGraph.compile(m_swapchainExtent2D);
 
-    // Destroy: createGraphicsPipelines()
-    for (auto& pipelineLayout : m_pipelineLayouts) {
-        vkDestroyPipelineLayout(m_device, pipelineLayout.second, nullptr);
+    // The pyramid follows the depth it is built from, and starts over without occlusion.
+    if (m_isOcclusionCullingEnabled) {
+        m_hiZPyramid.resize(m_swapchainExtent2D);
     }
 
-    for (auto& graphicsPipeline : m_graphicsPipelines) {
-        vkDestroyPipeline(m_device, graphicsPipeline.second, nullptr);
+    // Graphics pipelines refer to the render passes of the graph, so they follow it, unless dynamic
+    // rendering is used and they only know the attachment formats. Compute pipelines, shader modules
+    // and layouts never refer to a render pass and are kept.
+    if (!m_isDynamicRenderingEnabled) {
+        createGraphicsPipelines();
     }
 
-    // Destroy: createDescSetLayout()
-    for (auto& descSetLayout : m_descSetLayouts) {
-        vkDestroyDescriptorSetLayout(m_device, descSetLayout.second, nullptr);
-    }
+    // Note that command buffers, uniform buffers and descriptors are per frame in flight,
+    // so they do not depend on the swapchain and are not recreated here.
+}
 
-    // Destroy: createFramebuffers()
-    for (auto& framebuffer : m_swapchainFramebuffers) {
-        vkDestroyFramebuffer(m_device, framebuffer, nullptr);
+void VulkanEngine::destroyOldSwapchain() {
+    if (!m_isDynamicRenderingEnabled) {
+        // Destroy: createGraphicsPipelines(), only the pipelines made for the render passes about to go.
+        m_pipelineRegistry.destroyRenderPassPipelines();
     }
 
-    // Destroy: createRenderPasses()
-    for (auto& renderPass : m_renderPasses) {
-        vkDestroyRenderPass(m_device, renderPass.second, nullptr);
-    }
+    // Destroy: m_renderGraph.compile()
+    m_renderGraph.destroyCompiledResources();
 
     // Destroy: createImageViews()
     for (auto& imageView : m_swapchainImageViews) {
         vkDestroyImageView(m_device, imageView, nullptr);
     }
-
-    // Destroy: createSwapchain()
-    vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
 }
 
 void VulkanEngine::createInstance() {
@@ -471,6 +741,18 @@ void VulkanEngine::createLogicalDevice() {
     const auto& indices = m_physicalDeviceInfo.queueFamilyIndices;
     std::set<uint32_t> uniqueQueueFamilyIndices = { indices.graphics.value(), indices.present.value() };
 
+    // Dedicated families never support graphics; the set takes care of one shared with present.
+    m_computeQueueFamilyIndex = indices.graphics.value();
+    if (m_originInfo.enableAsyncCompute && indices.compute.has_value()) {
+        m_computeQueueFamilyIndex = indices.compute.value();
+        uniqueQueueFamilyIndices.insert(m_computeQueueFamilyIndex);
+    }
+    m_transferQueueFamilyIndex = indices.graphics.value();
+    if (indices.transfer.has_value()) {
+        m_transferQueueFamilyIndex = indices.transfer.value();
+        uniqueQueueFamilyIndices.insert(m_transferQueueFamilyIndex);
+    }
+
     std::vector<VkDeviceQueueCreateInfo> queueInfos = {};
 
     float queuePriority = 1.0f; // Simply give all queues the same priority.
@@ -485,7 +767,19 @@ void VulkanEngine::createLogicalDevice() {
         queueInfos.push_back(queueInfo);
     }
 
+    const auto& supportedFeatures = m_physicalDeviceInfo.features;
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    // Shaders index the bindless table with dynamically uniform indices.
+    deviceFeatures.shaderStorageBufferArrayDynamicIndexing = supportedFeatures.shaderStorageBufferArrayDynamicIndexing;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+    // Texture formats are picked at load time by what is enabled here.
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+    deviceFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+    deviceFeatures.pipelineStatisticsQuery = m_originInfo.enablePipelineStatistics && supportedFeatures.pipelineStatisticsQuery;
+    // Meshlet commands of a draw item go out in one indirect draw when possible.
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
 
     VkDeviceCreateInfo deviceInfo = {};
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -493,12 +787,55 @@ void VulkanEngine::createLogicalDevice() {
     deviceInfo.pQueueCreateInfos = queueInfos.data();
     deviceInfo.pEnabledFeatures = &deviceFeatures;
 
+    void* featureChain = nullptr;
+
+    // Only enable the descriptor indexing features the bindless table relies on.
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    if (m_physicalDeviceInfo.descriptorIndexingSupported) {
+        indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.pNext = featureChain;
+        featureChain = &indexingFeatures;
+    }
+
+    m_isDynamicRenderingEnabled = m_originInfo.preferDynamicRendering && m_physicalDeviceInfo.dynamicRenderingSupported;
+
+#ifdef VK_KHR_dynamic_rendering
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    if (m_isDynamicRenderingEnabled) {
+        dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+        dynamicRenderingFeatures.pNext = featureChain;
+        featureChain = &dynamicRenderingFeatures;
+    }
+#endif
+
+    deviceInfo.pNext = featureChain;
+
     // If the [VK_KHR_portability_subset] extension is included in pProperties of vkEnumerateDeviceExtensionProperties,
     // ppEnabledExtensions must include "VK_KHR_portability_subset". (Debugged with Molten Vulkan SDK on macOS)
     auto requiredExtensions = deviceMinimumRequiredExtensions;
     if (isPropertyInSupportedProperties("VK_KHR_portability_subset", m_physicalDeviceInfo.supportedExtensions)) {
         requiredExtensions.push_back("VK_KHR_portability_subset");
     }
+    if (m_physicalDeviceInfo.descriptorIndexingSupported) {
+        requiredExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+    if (m_physicalDeviceInfo.memoryBudgetSupported) {
+        requiredExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+#ifdef VK_KHR_dynamic_rendering
+    if (m_isDynamicRenderingEnabled) {
+        requiredExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+        if (m_physicalDeviceInfo.properties.apiVersion < VK_API_VERSION_1_2) {
+            requiredExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+            requiredExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+        }
+    }
+#endif
     deviceInfo.enabledExtensionCount = requiredExtensions.size();
     deviceInfo.ppEnabledExtensionNames = requiredExtensions.data();
 
@@ -515,16 +852,21 @@ void VulkanEngine::createLogicalDevice() {
         throw std::runtime_error("Failed to create logical device.");
     }
 
-    // Bind device with shader container by the way.
+    // Bind device with shader container and pipeline registry by the way.
     m_shaderContainer.setDevice(&m_device);
 
+    m_pipelineRegistry.setDevice(&m_device);
+    m_pipelineRegistry.setShaderContainer(&m_shaderContainer);
+
     // Store required queues in created device by the way.
     // Get first queue in each queue family by default.
     vkGetDeviceQueue(m_device, indices.graphics.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, indices.present.value(), 0, &m_presentQueue);
+    vkGetDeviceQueue(m_device, m_computeQueueFamilyIndex, 0, &m_computeQueue);
+    vkGetDeviceQueue(m_device, m_transferQueueFamilyIndex, 0, &m_transferQueue);
 }
 
-void VulkanEngine::createSwapchain() {
+void VulkanEngine::createSwapchain(VkSwapchainKHR oldSwapchain) {
     const auto& details = m_physicalDeviceInfo.swapchainDetails;
 
     VkSurfaceFormatKHR surfaceFormat = selectSwapchainSurfaceFormat(details.formats);
@@ -533,7 +875,9 @@ void VulkanEngine::createSwapchain() {
 
     VkExtent2D extent2D = selectSwapchainExtent2D(details.capabilities);
 
-    uint32_t  imageCount = details.capabilities.minImageCount + 1;
+    // One more than the minimum by default, so that acquire does not wait on the presentation engine.
+    uint32_t  imageCount = m_presentSettings.imageCount > 0 ? m_presentSettings.imageCount : details.capabilities.minImageCount + 1;
+    imageCount = std::max(imageCount, details.capabilities.minImageCount);
     // Note maxImageCount == 0 means there is no maximum.
     if (details.capabilities.maxImageCount > 0 && imageCount > details.capabilities.maxImageCount) {
         imageCount = details.capabilities.maxImageCount;
@@ -574,7 +918,7 @@ void VulkanEngine::createSwapchain() {
     swapchainInfo.presentMode = presentMode;
     swapchainInfo.clipped = VK_TRUE;
 
-    swapchainInfo.oldSwapchain = VK_NULL_HANDLE;
+    swapchainInfo.oldSwapchain = oldSwapchain;
 
     if (vkCreateSwapchainKHR(m_device, &swapchainInfo, nullptr, &m_swapchain) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create swapchain.");
@@ -590,6 +934,8 @@ void VulkanEngine::createSwapchain() {
     m_swapchainImageFormat = surfaceFormat.format;
 
     m_swapchainExtent2D = extent2D;
+
+    m_presentMode = presentMode;
 }
 
 void VulkanEngine::createImageViews() {
@@ -619,214 +965,572 @@ void VulkanEngine::createImageViews() {
     }
 }
 
-void VulkanEngine::createRenderPasses() {
-    VkAttachmentDescription colorAttachment = {};
-    colorAttachment.format = m_swapchainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT; // Disable anti-alias;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentRef = {};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpassDesc = {};
-    subpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpassDesc.colorAttachmentCount = 1;
-    subpassDesc.pColorAttachments = &colorAttachmentRef;
-
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0; // There is only one subpass in this application, so 0 points to itself.
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    VkRenderPassCreateInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpassDesc;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-    if (vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPasses["main"]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create render passes.");
-    }
-}
-
-void VulkanEngine::createFramebuffers() {
-    m_swapchainFramebuffers.resize(m_swapchainImageViews.size());
-
-    for (size_t i = 0; i < m_swapchainImageViews.size(); ++i) {
-        VkImageView attachments[] = { m_swapchainImageViews[i] };
-
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = m_renderPasses["main"];
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = m_swapchainExtent2D.width;
-        framebufferInfo.height = m_swapchainExtent2D.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(m_device, &framebufferInfo, nullptr, &m_swapchainFramebuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create framebuffers.");
+VkFormat VulkanEngine::selectDepthFormat() {
+    // Prefer formats without stencil; all of them are widely supported as optimal tiling attachments.
+    std::vector<VkFormat> candidateFormats = {
+            VK_FORMAT_D32_SFLOAT,
+            VK_FORMAT_D32_SFLOAT_S8_UINT,
+            VK_FORMAT_D24_UNORM_S8_UINT
+    };
+
+    for (auto format : candidateFormats) {
+        VkFormatProperties properties = {};
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return format;
         }
     }
+    throw std::runtime_error("Failed to find a supported depth format.");
 }
 
-void VulkanEngine::createGraphicsPipelines() {
-    static bool shaderFirstLoaded = true;
-    // Make shader infos.
-    if (shaderFirstLoaded) {
-        shaderFirstLoaded = false;
-        m_shaderContainer.addGlslShader("vert", "../GLSL/shader.vert", "../GLSL/SPIR-V/vert.spv","main", ShaderContainer::Vertex);
-        m_shaderContainer.addGlslShader("frag", "../GLSL/shader.frag", "../GLSL/SPIR-V/frag.spv", "main", ShaderContainer::Fragment);
+VkSampleCountFlagBits VulkanEngine::selectSampleCount() {
+    // Color and depth are multisampled together, so both limits apply.
+    const auto& limits = m_physicalDeviceInfo.properties.limits;
+    VkSampleCountFlags supportedCounts = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+
+    auto sampleCount = m_originInfo.sampleCount;
+    while (sampleCount > VK_SAMPLE_COUNT_1_BIT && !(supportedCounts & sampleCount)) {
+        sampleCount = static_cast<VkSampleCountFlagBits>(sampleCount >> 1);
     }
-    else {
-        m_shaderContainer.addCompiledShader("vert", "../GLSL/SPIR-V/vert.spv", "main", ShaderContainer::Vertex);
-        m_shaderContainer.addCompiledShader("frag", "../GLSL/SPIR-V/frag.spv", "main", ShaderContainer::Fragment);
+    return sampleCount;
+}
+
+void VulkanEngine::buildRenderGraph() {
+    m_renderGraph.setDevice(&m_device);
+
+    RenderGraphStructs::CreateInfo graphInfo = {};
+    graphInfo.physicalDevice = m_physicalDevice;
+    graphInfo.enableDynamicRendering = m_isDynamicRenderingEnabled;
+    m_renderGraph.init(graphInfo);
+
+    // The swapchain image is available once the acquire semaphore is waited at color output,
+    // and has to be handed over for presentation at the end of the frame.
+    RenderGraph::ImageDesc backbufferDesc = {};
+    backbufferDesc.format = m_swapchainImageFormat;
+    m_backbuffer = m_renderGraph.importImage("backbuffer", backbufferDesc,
+                                             VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                             VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+    // Depth never outlives a frame, so a single transient image serves all frames in flight;
+    // the graph makes each frame wait for the depth accesses of the previous one.
+    RenderGraph::ImageDesc depthDesc = {};
+    depthDesc.format = m_depthFormat;
+    depthDesc.samples = m_sampleCount;
+    auto depth = m_renderGraph.createImage("depth", depthDesc);
+
+    // With MSAA the samples only live in a transient (lazily allocated if possible) attachment
+    // and are resolved into the swapchain image at the end of the main pass.
+    auto colorTarget = m_backbuffer;
+    if (m_sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+        RenderGraph::ImageDesc colorDesc = {};
+        colorDesc.format = m_swapchainImageFormat;
+        colorDesc.samples = m_sampleCount;
+        colorTarget = m_renderGraph.createImage("color_msaa", colorDesc);
+    }
+
+    VkClearValue colorClearValue = {};
+    colorClearValue.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+    VkClearValue depthClearValue = {};
+    depthClearValue.depthStencil = { 1.0f, 0 };
+
+    // The pyramid is built from sampled depth, which rules out multisampled depth.
+    m_isOcclusionCullingEnabled = m_originInfo.enableOcclusionCulling && m_sampleCount == VK_SAMPLE_COUNT_1_BIT &&
+                                  HiZPyramid::isSupported(m_physicalDevice, m_depthFormat);
+
+    // Meshlets are culled by the same passes, so they come and go with them.
+    m_isMeshletCullingEnabled = m_originInfo.enableMeshletCulling && m_isOcclusionCullingEnabled;
+
+    // Occlusion culling splits depth rendering in two: draw items visible in the previous frame's pyramid
+    // lay down depth first, the pyramid is rebuilt from it, and the remaining ones are tested again
+    // against that. The pyramid persists across frames and is left as built for the next one.
+    auto addCullPass = [this](const std::string& name, uint32_t phase) {
+        auto pass = m_renderGraph.addPass(name, RenderGraph::PassType::Compute);
+        m_renderGraph.readImage(pass, m_hiZPyramidResource, RenderGraph::Access::StorageRead);
+        m_renderGraph.writeBuffer(pass, m_cullObjectsResource, RenderGraph::Access::StorageWrite);
+        m_renderGraph.writeBuffer(pass, m_drawCommandsResource, RenderGraph::Access::StorageWrite);
+        m_renderGraph.setExecute(pass, [this, phase](VkCommandBuffer commandBuffer) {
+            recordOcclusionCull(commandBuffer, phase);
+        });
+    };
+    auto addHiZBuildPass = [this, depth]() {
+        auto pass = m_renderGraph.addPass("hiz_build", RenderGraph::PassType::Compute);
+        m_renderGraph.readImage(pass, depth, RenderGraph::Access::SampledRead);
+        m_renderGraph.writeImage(pass, m_hiZPyramidResource, RenderGraph::Access::StorageWrite);
+        m_renderGraph.setExecute(pass, [this, depth](VkCommandBuffer commandBuffer) {
+            recordHiZBuild(commandBuffer, depth);
+        });
+    };
+
+    // Skinned vertices are posed once, ahead of every pass drawing them. The buffer persists across
+    // frames, so the graph also makes the pre-pass wait for the draws of the previous frame.
+    m_isSkinningEnabled = m_skinningSystem.meshCount() > 0;
+    auto readSkinnedVertices = [this](RenderGraph::PassHandle pass) {
+        if (m_isSkinningEnabled) {
+            m_renderGraph.readBuffer(pass, m_skinnedVerticesResource, RenderGraph::Access::VertexRead);
+        }
+    };
+
+    if (m_isSkinningEnabled) {
+        m_skinnedVerticesResource = m_renderGraph.importBuffer("skinned_vertices");
+
+        auto pass = m_renderGraph.addPass("skinning", RenderGraph::PassType::Compute);
+        m_renderGraph.writeBuffer(pass, m_skinnedVerticesResource, RenderGraph::Access::StorageWrite);
+        m_renderGraph.setExecute(pass, [this](VkCommandBuffer commandBuffer) {
+            recordSkinning(commandBuffer);
+        });
+    }
+
+    // Shadow maps persist across frames: a cascade whose pass is skipped keeps what it rendered last,
+    // and the main passes sample whichever is there.
+    m_isShadowEnabled = m_originInfo.shadowCascadeCount > 0;
+    if (m_isShadowEnabled) {
+        RenderGraph::ImageDesc shadowDesc = {};
+        shadowDesc.format = ShadowCascades::selectFormat(m_physicalDevice);
+        shadowDesc.extent = { m_originInfo.shadowMapResolution, m_originInfo.shadowMapResolution };
+
+        auto cascadeCount = std::min(m_originInfo.shadowCascadeCount, UniformBufferObject::MaxShadowCascadeCount);
+        for (uint32_t i = 0; i < cascadeCount; ++i) {
+            auto name = "shadow_cascade_" + std::to_string(i);
+            auto resource = m_renderGraph.importImage(name, shadowDesc,
+                                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+            auto pass = m_renderGraph.addPass(name, RenderGraph::PassType::Graphics);
+            m_renderGraph.writeImage(pass, resource, RenderGraph::Access::DepthAttachmentWrite,
+                                     RenderGraph::LoadOp::Clear, depthClearValue);
+            readSkinnedVertices(pass);
+            m_renderGraph.setExecute(pass, [this, i](VkCommandBuffer commandBuffer) {
+                recordShadowCascade(commandBuffer, i);
+            });
+            m_renderGraph.setCondition(pass, [this, i]() {
+                return m_shadowCascades.isRenderNeeded(i);
+            });
+
+            m_shadowCascadePasses.push_back(pass);
+            m_shadowCascadeResources.push_back(resource);
+        }
+    }
+    auto readShadowMaps = [this](RenderGraph::PassHandle pass) {
+        for (auto resource : m_shadowCascadeResources) {
+            m_renderGraph.readImage(pass, resource, RenderGraph::Access::SampledRead);
+        }
+    };
+
+    // Lights are binned once per frame for the camera of the frame. The grid and index list persist
+    // across frames, so the graph also makes the culling wait for the shading of the previous frame.
+    m_isClusteredLightingEnabled = m_originInfo.enableClusteredLighting && m_clusteredLighting.lightCount() > 0;
+    if (m_isClusteredLightingEnabled) {
+        m_lightGridResource = m_renderGraph.importBuffer("light_grid");
+        m_lightIndexResource = m_renderGraph.importBuffer("light_indices");
+
+        auto pass = m_renderGraph.addPass("light_cull", RenderGraph::PassType::Compute);
+        m_renderGraph.writeBuffer(pass, m_lightGridResource, RenderGraph::Access::StorageWrite);
+        m_renderGraph.writeBuffer(pass, m_lightIndexResource, RenderGraph::Access::StorageWrite);
+        m_renderGraph.setExecute(pass, [this](VkCommandBuffer commandBuffer) {
+            recordLightCull(commandBuffer);
+        });
+    }
+    auto readLightClusters = [this](RenderGraph::PassHandle pass) {
+        if (m_isClusteredLightingEnabled) {
+            m_renderGraph.readBuffer(pass, m_lightGridResource, RenderGraph::Access::StorageRead);
+            m_renderGraph.readBuffer(pass, m_lightIndexResource, RenderGraph::Access::StorageRead);
+        }
+    };
+
+    if (m_isOcclusionCullingEnabled) {
+        RenderGraph::ImageDesc pyramidDesc = {};
+        pyramidDesc.format = HiZPyramid::Format;
+        m_hiZPyramidResource = m_renderGraph.importImage("hiz_pyramid", pyramidDesc,
+                                                         VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                         VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT);
+        m_cullObjectsResource = m_renderGraph.importBuffer("cull_objects");
+        m_drawCommandsResource = m_renderGraph.importBuffer("draw_commands");
+
+        addCullPass("cull_early", 0);
     }
 
-    auto shaderStageInfos = m_shaderContainer.generateAllCreateInfos();
+    auto firstPhase = m_isOcclusionCullingEnabled ? DrawPhase::OcclusionEarly : DrawPhase::All;
 
-    // Make input assembly info.
-    auto vertexInputBindDesc = Vertex::generateBindingDescription();
-    auto vertexInputAttrDescs = Vertex::generateAttributeDescriptions();
+    if (m_originInfo.enableDepthPrepass) {
+        m_depthPrepassPass = m_renderGraph.addPass("depth_prepass", RenderGraph::PassType::Graphics);
+        m_renderGraph.writeImage(m_depthPrepassPass, depth, RenderGraph::Access::DepthAttachmentWrite,
+                                 RenderGraph::LoadOp::Clear, depthClearValue);
+        if (m_isOcclusionCullingEnabled) {
+            m_renderGraph.readBuffer(m_depthPrepassPass, m_drawCommandsResource, RenderGraph::Access::IndirectRead);
+        }
+        readSkinnedVertices(m_depthPrepassPass);
+        m_renderGraph.setExecute(m_depthPrepassPass, [this, firstPhase](VkCommandBuffer commandBuffer) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineRegistry.pipeline(m_depthPrepassPipeline));
+            ++m_telemetry.frameCounters().pipelineBindCount;
+            recordDrawItems(commandBuffer, m_pipelineLayouts["main"], firstPhase);
+        });
+
+        if (m_isOcclusionCullingEnabled) {
+            addHiZBuildPass();
+            addCullPass("cull_late", 1);
+
+            // Render pass compatible with the first one, so it shares the pipeline.
+            auto latePass = m_renderGraph.addPass("depth_prepass_late", RenderGraph::PassType::Graphics);
+            m_renderGraph.writeImage(latePass, depth, RenderGraph::Access::DepthAttachmentWrite, RenderGraph::LoadOp::Load);
+            m_renderGraph.readBuffer(latePass, m_drawCommandsResource, RenderGraph::Access::IndirectRead);
+            readSkinnedVertices(latePass);
+            m_renderGraph.setExecute(latePass, [this](VkCommandBuffer commandBuffer) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineRegistry.pipeline(m_depthPrepassPipeline));
+                ++m_telemetry.frameCounters().pipelineBindCount;
+                recordDrawItems(commandBuffer, m_pipelineLayouts["main"], DrawPhase::OcclusionLate);
+            });
+        }
+    }
 
-    VkPipelineVertexInputStateCreateInfo vertexInputStateInfo = {};
-    vertexInputStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputStateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputStateInfo.pVertexBindingDescriptions = &vertexInputBindDesc;
-    vertexInputStateInfo.vertexAttributeDescriptionCount = vertexInputAttrDescs.size();
-    vertexInputStateInfo.pVertexAttributeDescriptions = vertexInputAttrDescs.data();
+    // Particles blend over everything else, so with them the resolve moves to their pass.
+    m_isParticleSystemEnabled = m_originInfo.maxParticleCount > 0 && !m_particleEmitters.empty();
 
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateInfo ={};
-    inputAssemblyStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyStateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssemblyStateInfo.primitiveRestartEnable = VK_FALSE;
+    m_mainPass = m_renderGraph.addPass("main", RenderGraph::PassType::Graphics);
+    m_renderGraph.writeImage(m_mainPass, colorTarget, RenderGraph::Access::ColorAttachmentWrite,
+                             RenderGraph::LoadOp::Clear, colorClearValue);
+    if (colorTarget != m_backbuffer && !m_isParticleSystemEnabled) {
+        m_renderGraph.resolveImage(m_mainPass, colorTarget, m_backbuffer);
+    }
+    if (m_originInfo.enableDepthPrepass) {
+        m_renderGraph.readImage(m_mainPass, depth, RenderGraph::Access::DepthAttachmentRead);
+    }
+    else {
+        m_renderGraph.writeImage(m_mainPass, depth, RenderGraph::Access::DepthAttachmentWrite,
+                                 RenderGraph::LoadOp::Clear, depthClearValue);
+    }
+    if (m_isOcclusionCullingEnabled) {
+        m_renderGraph.readBuffer(m_mainPass, m_drawCommandsResource, RenderGraph::Access::IndirectRead);
+    }
+    readSkinnedVertices(m_mainPass);
+    readShadowMaps(m_mainPass);
+    readLightClusters(m_mainPass);
+    m_renderGraph.setExecute(m_mainPass, [this, firstPhase](VkCommandBuffer commandBuffer) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineRegistry.pipeline(m_mainPipeline));
+        ++m_telemetry.frameCounters().pipelineBindCount;
+        recordDrawItems(commandBuffer, m_pipelineLayouts["main"], firstPhase);
+        // Depth of both phases is already complete; shade everything that made it through either.
+        if (m_isOcclusionCullingEnabled && m_originInfo.enableDepthPrepass) {
+            recordDrawItems(commandBuffer, m_pipelineLayouts["main"], DrawPhase::OcclusionLate);
+        }
+    });
 
-    // Make viewport and scissor info.
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(m_swapchainExtent2D.width);
-    viewport.height = static_cast<float>(m_swapchainExtent2D.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+    if (m_isOcclusionCullingEnabled && !m_originInfo.enableDepthPrepass) {
+        addHiZBuildPass();
+        addCullPass("cull_late", 1);
+
+        // Single-sampled, so there is nothing to resolve; render pass compatible with the main one.
+        auto latePass = m_renderGraph.addPass("main_late", RenderGraph::PassType::Graphics);
+        m_renderGraph.writeImage(latePass, colorTarget, RenderGraph::Access::ColorAttachmentWrite, RenderGraph::LoadOp::Load);
+        m_renderGraph.writeImage(latePass, depth, RenderGraph::Access::DepthAttachmentWrite, RenderGraph::LoadOp::Load);
+        m_renderGraph.readBuffer(latePass, m_drawCommandsResource, RenderGraph::Access::IndirectRead);
+        readSkinnedVertices(latePass);
+        readShadowMaps(latePass);
+        readLightClusters(latePass);
+        m_renderGraph.setExecute(latePass, [this](VkCommandBuffer commandBuffer) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineRegistry.pipeline(m_mainPipeline));
+            ++m_telemetry.frameCounters().pipelineBindCount;
+            recordDrawItems(commandBuffer, m_pipelineLayouts["main"], DrawPhase::OcclusionLate);
+        });
+    }
+
+    // Depth tested but not written; the particle and state buffers come from async compute,
+    // which the frame's submission waits for, so the graph does not track them.
+    if (m_isParticleSystemEnabled) {
+        m_particlePass = m_renderGraph.addPass("particles", RenderGraph::PassType::Graphics);
+        m_renderGraph.writeImage(m_particlePass, colorTarget, RenderGraph::Access::ColorAttachmentWrite, RenderGraph::LoadOp::Load);
+        if (colorTarget != m_backbuffer) {
+            m_renderGraph.resolveImage(m_particlePass, colorTarget, m_backbuffer);
+        }
+        m_renderGraph.readImage(m_particlePass, depth, RenderGraph::Access::DepthAttachmentRead);
+        m_renderGraph.setExecute(m_particlePass, [this](VkCommandBuffer commandBuffer) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineRegistry.pipeline(m_particlePipeline));
+            ++m_telemetry.frameCounters().pipelineBindCount;
+            m_particleSystem.recordDraw(commandBuffer, m_currFrameIndex, m_pipelineLayouts["main"]);
+        });
+    }
+
+    // One GPU scope per live pass, named after it.
+    m_passScopeNames.clear();
+    for (RenderGraph::PassHandle pass = 0; pass < m_renderGraph.passCount(); ++pass) {
+        m_passScopeNames.push_back(m_profiler.internName(m_renderGraph.passName(pass)));
+    }
+    m_renderGraph.setPassScopeCallbacks(
+            [this](VkCommandBuffer commandBuffer, RenderGraph::PassHandle pass) {
+                m_profiler.beginGpuScope(commandBuffer, m_passScopeNames[pass]);
+            },
+            [this](VkCommandBuffer commandBuffer, RenderGraph::PassHandle pass) {
+                FUNC_PARAM_UNUSED(pass);
+                m_profiler.endGpuScope(commandBuffer);
+            });
+
+    m_renderGraph.compile(m_swapchainExtent2D);
+}
 
-    VkRect2D scissor = {};
-    scissor.offset = { 0, 0 };
-    scissor.extent = m_swapchainExtent2D;
-
-    VkPipelineViewportStateCreateInfo viewportStateInfo = {};
-    viewportStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateInfo.viewportCount = 1;
-    viewportStateInfo.pViewports = &viewport;
-    viewportStateInfo.scissorCount = 1;
-    viewportStateInfo.pScissors = &scissor;
-
-    // Make rasterization info.
-    VkPipelineRasterizationStateCreateInfo rasterizationStateInfo = {};
-    rasterizationStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizationStateInfo.depthClampEnable = VK_FALSE;
-    rasterizationStateInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterizationStateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizationStateInfo.lineWidth = 1.0f;
-    rasterizationStateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizationStateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterizationStateInfo.depthBiasEnable = VK_FALSE;
-    rasterizationStateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationStateInfo.depthBiasClamp = 0.0f;
-    rasterizationStateInfo.depthBiasSlopeFactor = 0.0f;
-
-    // Make multisample info.
-    VkPipelineMultisampleStateCreateInfo multisampleStateInfo = {};
-    multisampleStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleStateInfo.sampleShadingEnable = VK_FALSE;
-    multisampleStateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleStateInfo.minSampleShading = 1.0f;
-    multisampleStateInfo.pSampleMask = nullptr;
-    multisampleStateInfo.alphaToCoverageEnable = VK_FALSE;
-    multisampleStateInfo.alphaToOneEnable = VK_FALSE;
-
-    // Make color blend info.
-    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-    colorBlendAttachment.colorWriteMask =
-            VK_COLOR_COMPONENT_R_BIT |
-            VK_COLOR_COMPONENT_G_BIT |
-            VK_COLOR_COMPONENT_B_BIT |
-            VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-    VkPipelineColorBlendStateCreateInfo colorBlendStateInfo = {};
-    colorBlendStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendStateInfo.logicOpEnable = VK_FALSE;
-    colorBlendStateInfo.logicOp = VK_LOGIC_OP_COPY;
-    colorBlendStateInfo.attachmentCount = 1;
-    colorBlendStateInfo.pAttachments = &colorBlendAttachment;
-    colorBlendStateInfo.blendConstants[0] = 0.0f;
-    colorBlendStateInfo.blendConstants[1] = 0.0f;
-    colorBlendStateInfo.blendConstants[2] = 0.0f;
-    colorBlendStateInfo.blendConstants[3] = 0.0f;
-
-    // Make dynamic info.
-    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_LINE_WIDTH };
-
-    VkPipelineDynamicStateCreateInfo dynamicStateInfo ={};
-    dynamicStateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-//    dynamicStateInfo.dynamicStateCount = 2;
-//    dynamicStateInfo.pDynamicStates = dynamicStates;
-    dynamicStateInfo.dynamicStateCount = 0;
-    dynamicStateInfo.pDynamicStates = nullptr;
+void VulkanEngine::createGraphicsPipelineLayout() {
+    // Make shader infos.
+    m_shaderContainer.addGlslShader("vert", "../GLSL/shader.vert", "../GLSL/SPIR-V/vert.spv","main", ShaderContainer::Vertex);
+    m_shaderContainer.addGlslShader("frag", "../GLSL/shader.frag", "../GLSL/SPIR-V/frag.spv", "main", ShaderContainer::Fragment);
+    if (m_isParticleSystemEnabled) {
+        m_shaderContainer.addGlslShader("particle_vert", "../GLSL/particle.vert", "../GLSL/SPIR-V/particle_vert.spv", "main", ShaderContainer::Vertex);
+        m_shaderContainer.addGlslShader("particle_frag", "../GLSL/particle.frag", "../GLSL/SPIR-V/particle_frag.spv", "main", ShaderContainer::Fragment);
+    }
 
     // Create pipeline layout.
+    // Set 0: per-frame data; set 1: bindless resource table.
+    VkDescriptorSetLayout setLayouts[] = { m_frameSetLayout, m_bindlessDescriptors.layout() };
+
     VkPipelineLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    layoutInfo.setLayoutCount = 1;
-    layoutInfo.pSetLayouts = &m_descSetLayouts["main"];
-    layoutInfo.pushConstantRangeCount = 0;
-    layoutInfo.pPushConstantRanges = nullptr;
+    layoutInfo.setLayoutCount = 2;
+    layoutInfo.pSetLayouts = setLayouts;
+
+    // Per-draw data goes through push constants, so issuing draws never touches descriptors or buffers.
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PerDrawConstants);
+
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
 
     if (vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_pipelineLayouts["main"]) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create pipeline layout.");
     }
+}
+
+void VulkanEngine::createGraphicsPipelines() {
+    // Describe pipeline state; the registry creates each distinct state at most once.
+    auto key = PipelineRegistry::Key::makeDefault();
+
+    key.vertexShader = m_shaderContainer.shaderModule("vert");
+    key.fragmentShader = m_shaderContainer.shaderModule("frag");
+    key.layout = m_pipelineLayouts["main"];
+    key.renderPass = m_renderGraph.renderPass(m_mainPass);
+    key.subpass = 0;
+    if (m_renderGraph.isDynamicRenderingEnabled()) {
+        key.colorFormat = m_swapchainImageFormat;
+        key.depthFormat = m_depthFormat;
+    }
+    key.depthTestEnable = VK_TRUE;
+    key.depthWriteEnable = VK_TRUE;
+    key.depthCompareOp = VK_COMPARE_OP_LESS;
+    key.rasterizationSamples = m_sampleCount;
+
+    if (m_originInfo.enableDepthPrepass) {
+        // Same vertex shader (gl_Position is invariant) so that EQUAL passes exactly for the visible surface.
+        auto prepassKey = key;
+        prepassKey.fragmentShader = VK_NULL_HANDLE;
+        prepassKey.renderPass = m_renderGraph.renderPass(m_depthPrepassPass);
+        prepassKey.colorAttachmentCount = 0;
+        m_depthPrepassPipeline = m_pipelineRegistry.acquire(prepassKey);
+
+        key.depthWriteEnable = VK_FALSE;
+        key.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    }
+
+    m_mainPipeline = m_pipelineRegistry.acquire(key);
+
+    if (m_isShadowEnabled) {
+        // Depth only like the pre-pass, single-sampled into the shadow map format; all cascade passes
+        // are compatible. The bias is left to the shading, as the key has no depth bias state.
+        auto shadowKey = PipelineRegistry::Key::makeDefault();
+        shadowKey.vertexShader = m_shaderContainer.shaderModule("vert");
+        shadowKey.layout = m_pipelineLayouts["main"];
+        shadowKey.renderPass = m_renderGraph.renderPass(m_shadowCascadePasses.front());
+        shadowKey.subpass = 0;
+        if (m_renderGraph.isDynamicRenderingEnabled()) {
+            shadowKey.depthFormat = ShadowCascades::selectFormat(m_physicalDevice);
+        }
+        shadowKey.colorAttachmentCount = 0;
+        shadowKey.depthTestEnable = VK_TRUE;
+        shadowKey.depthWriteEnable = VK_TRUE;
+        shadowKey.depthCompareOp = VK_COMPARE_OP_LESS;
+        m_shadowPipeline = m_pipelineRegistry.acquire(shadowKey);
+    }
+
+    if (m_isParticleSystemEnabled) {
+        // Shares the main layout, so the frame's sets stay bound. Billboards face the camera
+        // and are alpha blended, so they are not culled and leave depth as it is.
+        auto particleKey = PipelineRegistry::Key::makeDefault();
+        particleKey.vertexShader = m_shaderContainer.shaderModule("particle_vert");
+        particleKey.fragmentShader = m_shaderContainer.shaderModule("particle_frag");
+        particleKey.layout = m_pipelineLayouts["main"];
+        particleKey.renderPass = m_renderGraph.renderPass(m_particlePass);
+        particleKey.subpass = 0;
+        if (m_renderGraph.isDynamicRenderingEnabled()) {
+            particleKey.colorFormat = m_swapchainImageFormat;
+            particleKey.depthFormat = m_depthFormat;
+        }
+        particleKey.vertexLayout = PipelineRegistryStructs::VertexLayout::None;
+        particleKey.cullMode = VK_CULL_MODE_NONE;
+        particleKey.depthTestEnable = VK_TRUE;
+        particleKey.depthWriteEnable = VK_FALSE;
+        particleKey.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+        particleKey.blendEnable = VK_TRUE;
+        particleKey.rasterizationSamples = m_sampleCount;
+        m_particlePipeline = m_pipelineRegistry.acquire(particleKey);
+    }
+}
+
+void VulkanEngine::createComputePipelines() {
+    if (!m_isOcclusionCullingEnabled && !m_isParticleSystemEnabled && !m_isSkinningEnabled && !m_isClusteredLightingEnabled) return;
+
+    // Make shader infos.
+    if (m_isOcclusionCullingEnabled) {
+        m_shaderContainer.addGlslShader("hiz_build", "../GLSL/hiz_build.comp", "../GLSL/SPIR-V/hiz_build.spv", "main", ShaderContainer::Compute);
+        m_shaderContainer.addGlslShader("occlusion_cull", "../GLSL/occlusion_cull.comp", "../GLSL/SPIR-V/occlusion_cull.spv", "main", ShaderContainer::Compute);
+    }
+    if (m_isParticleSystemEnabled) {
+        m_shaderContainer.addGlslShader("particle_emit", "../GLSL/particle_emit.comp", "../GLSL/SPIR-V/particle_emit.spv", "main", ShaderContainer::Compute);
+        m_shaderContainer.addGlslShader("particle_simulate", "../GLSL/particle_simulate.comp", "../GLSL/SPIR-V/particle_simulate.spv", "main", ShaderContainer::Compute);
+        m_shaderContainer.addGlslShader("particle_compact", "../GLSL/particle_compact.comp", "../GLSL/SPIR-V/particle_compact.spv", "main", ShaderContainer::Compute);
+    }
+    if (m_isSkinningEnabled) {
+        m_shaderContainer.addGlslShader("skinning", "../GLSL/skinning.comp", "../GLSL/SPIR-V/skinning.spv", "main", ShaderContainer::Compute);
+    }
+    if (m_isClusteredLightingEnabled) {
+        m_shaderContainer.addGlslShader("light_cull", "../GLSL/light_cull.comp", "../GLSL/SPIR-V/light_cull.spv", "main", ShaderContainer::Compute);
+    }
+
+    if (m_isParticleSystemEnabled) {
+        // Set 1: bindless resource table, holding the particle, state and emitter buffers.
+        // Set 0 is left unused, so the table sits where the graphics pipelines have it.
+        VkDescriptorSetLayout particleSetLayouts[] = { m_frameSetLayout, m_bindlessDescriptors.layout() };
+
+        VkPushConstantRange particlePushConstantRange = {};
+        particlePushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        particlePushConstantRange.offset = 0;
+        particlePushConstantRange.size = sizeof(ParticleStructs::SimulationParams);
+
+        VkPipelineLayoutCreateInfo particleLayoutInfo = {};
+        particleLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        particleLayoutInfo.setLayoutCount = 2;
+        particleLayoutInfo.pSetLayouts = particleSetLayouts;
+        particleLayoutInfo.pushConstantRangeCount = 1;
+        particleLayoutInfo.pPushConstantRanges = &particlePushConstantRange;
+
+        if (vkCreatePipelineLayout(m_device, &particleLayoutInfo, nullptr, &m_pipelineLayouts["particle_simulation"]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout.");
+        }
+
+        PipelineRegistry::ComputeKey particleKey = {};
+        particleKey.layout = m_pipelineLayouts["particle_simulation"];
+        particleKey.computeShader = m_shaderContainer.shaderModule("particle_emit");
+        m_particleEmitPipeline = m_pipelineRegistry.acquireCompute(particleKey);
+        particleKey.computeShader = m_shaderContainer.shaderModule("particle_simulate");
+        m_particleSimulatePipeline = m_pipelineRegistry.acquireCompute(particleKey);
+        particleKey.computeShader = m_shaderContainer.shaderModule("particle_compact");
+        m_particleCompactPipeline = m_pipelineRegistry.acquireCompute(particleKey);
+    }
+
+    if (m_isSkinningEnabled) {
+        // Set 1: bindless resource table, holding the bind poses, morph targets, poses and skinned vertices.
+        VkDescriptorSetLayout skinningSetLayouts[] = { m_frameSetLayout, m_bindlessDescriptors.layout() };
+
+        VkPushConstantRange skinningPushConstantRange = {};
+        skinningPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        skinningPushConstantRange.offset = 0;
+        skinningPushConstantRange.size = sizeof(SkinningStructs::Params);
+
+        VkPipelineLayoutCreateInfo skinningLayoutInfo = {};
+        skinningLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        skinningLayoutInfo.setLayoutCount = 2;
+        skinningLayoutInfo.pSetLayouts = skinningSetLayouts;
+        skinningLayoutInfo.pushConstantRangeCount = 1;
+        skinningLayoutInfo.pPushConstantRanges = &skinningPushConstantRange;
+
+        if (vkCreatePipelineLayout(m_device, &skinningLayoutInfo, nullptr, &m_pipelineLayouts["skinning"]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout.");
+        }
+
+        PipelineRegistry::ComputeKey skinningKey = {};
+        skinningKey.computeShader = m_shaderContainer.shaderModule("skinning");
+        skinningKey.layout = m_pipelineLayouts["skinning"];
+        m_skinningPipeline = m_pipelineRegistry.acquireCompute(skinningKey);
+    }
+
+    if (m_isClusteredLightingEnabled) {
+        // Set 1: bindless resource table, holding the lights, the light grid and the index list.
+        VkDescriptorSetLayout lightCullSetLayouts[] = { m_frameSetLayout, m_bindlessDescriptors.layout() };
+
+        VkPushConstantRange lightCullPushConstantRange = {};
+        lightCullPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        lightCullPushConstantRange.offset = 0;
+        lightCullPushConstantRange.size = sizeof(ClusteredLightingStructs::Params);
+
+        VkPipelineLayoutCreateInfo lightCullLayoutInfo = {};
+        lightCullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        lightCullLayoutInfo.setLayoutCount = 2;
+        lightCullLayoutInfo.pSetLayouts = lightCullSetLayouts;
+        lightCullLayoutInfo.pushConstantRangeCount = 1;
+        lightCullLayoutInfo.pPushConstantRanges = &lightCullPushConstantRange;
+
+        if (vkCreatePipelineLayout(m_device, &lightCullLayoutInfo, nullptr, &m_pipelineLayouts["light_cull"]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout.");
+        }
+
+        PipelineRegistry::ComputeKey lightCullKey = {};
+        lightCullKey.computeShader = m_shaderContainer.shaderModule("light_cull");
+        lightCullKey.layout = m_pipelineLayouts["light_cull"];
+        m_lightCullPipeline = m_pipelineRegistry.acquireCompute(lightCullKey);
+    }
+
+    if (!m_isOcclusionCullingEnabled) return;
+
+    // Cached by the allocator, so asking again after a swapchain recreation returns the same layouts.
+    m_hiZBuildSetLayout = m_descriptorAllocator.acquireLayout(HiZPyramid::buildSetBindings());
+    m_occlusionCullSetLayout = m_descriptorAllocator.acquireLayout({
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+            { 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT }
+    });
+
+    // Set 0: source and target level.
+    VkPushConstantRange buildPushConstantRange = {};
+    buildPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    buildPushConstantRange.offset = 0;
+    buildPushConstantRange.size = sizeof(HiZPyramidStructs::BuildParams);
+
+    VkPipelineLayoutCreateInfo buildLayoutInfo = {};
+    buildLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    buildLayoutInfo.setLayoutCount = 1;
+    buildLayoutInfo.pSetLayouts = &m_hiZBuildSetLayout;
+    buildLayoutInfo.pushConstantRangeCount = 1;
+    buildLayoutInfo.pPushConstantRanges = &buildPushConstantRange;
+
+    if (vkCreatePipelineLayout(m_device, &buildLayoutInfo, nullptr, &m_pipelineLayouts["hiz_build"]) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout.");
+    }
 
-    // Create pipeline.
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = shaderStageInfos.size();
-    pipelineInfo.pStages = shaderStageInfos.data();
-    pipelineInfo.pVertexInputState = &vertexInputStateInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssemblyStateInfo;
-    pipelineInfo.pViewportState = &viewportStateInfo;
-    pipelineInfo.pRasterizationState = &rasterizationStateInfo;
-    pipelineInfo.pMultisampleState = &multisampleStateInfo;
-    pipelineInfo.pDepthStencilState = nullptr;
-    pipelineInfo.pColorBlendState = &colorBlendStateInfo;
-    pipelineInfo.pDynamicState = &dynamicStateInfo;
-    pipelineInfo.layout = m_pipelineLayouts["main"];
-    pipelineInfo.renderPass = m_renderPasses["main"];
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1;
+    // Set 0: the pyramid and the frame's uniform buffer; set 1: bindless resource table,
+    // holding the object, meshlet and command buffers.
+    VkDescriptorSetLayout cullSetLayouts[] = { m_occlusionCullSetLayout, m_bindlessDescriptors.layout() };
 
-    if (vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipelines["main"]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create graphics pipelines.");
+    VkPushConstantRange cullPushConstantRange = {};
+    cullPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullPushConstantRange.offset = 0;
+    cullPushConstantRange.size = sizeof(OcclusionCullParams);
+
+    VkPipelineLayoutCreateInfo cullLayoutInfo = {};
+    cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    cullLayoutInfo.setLayoutCount = 2;
+    cullLayoutInfo.pSetLayouts = cullSetLayouts;
+    cullLayoutInfo.pushConstantRangeCount = 1;
+    cullLayoutInfo.pPushConstantRanges = &cullPushConstantRange;
+
+    if (vkCreatePipelineLayout(m_device, &cullLayoutInfo, nullptr, &m_pipelineLayouts["occlusion_cull"]) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create pipeline layout.");
     }
+
+    PipelineRegistry::ComputeKey buildKey = {};
+    buildKey.computeShader = m_shaderContainer.shaderModule("hiz_build");
+    buildKey.layout = m_pipelineLayouts["hiz_build"];
+    m_hiZBuildPipeline = m_pipelineRegistry.acquireCompute(buildKey);
+
+    PipelineRegistry::ComputeKey cullKey = {};
+    cullKey.computeShader = m_shaderContainer.shaderModule("occlusion_cull");
+    cullKey.layout = m_pipelineLayouts["occlusion_cull"];
+    m_occlusionCullPipeline = m_pipelineRegistry.acquireCompute(cullKey);
 }
 
 void VulkanEngine::createCommandPool() {
@@ -835,15 +1539,66 @@ void VulkanEngine::createCommandPool() {
     VkCommandPoolCreateInfo cmdPoolInfo = {};
     cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     cmdPoolInfo.queueFamilyIndex = indices.graphics.value();
-    cmdPoolInfo.flags = 0;
+    // Command buffers are re-recorded every frame.
+    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     if (vkCreateCommandPool(m_device, &cmdPoolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create command pool.");
     }
 }
 
+void VulkanEngine::createProfiler() {
+    m_profiler.setDevice(&m_device);
+
+    ProfilerStructs::CreateInfo profilerInfo = {};
+    profilerInfo.physicalDevice = m_physicalDevice;
+    profilerInfo.queueFamilyIndex = m_physicalDeviceInfo.queueFamilyIndices.graphics.value();
+    profilerInfo.frameSlotCount = MAX_FRAMES_IN_FLIGHT;
+    m_profiler.init(profilerInfo);
+
+    m_profiler.setEnabled(m_originInfo.enableProfiling);
+}
+
+void VulkanEngine::createTelemetry() {
+    m_telemetry.setDevice(&m_device);
+
+    TelemetryStructs::CreateInfo telemetryInfo = {};
+    telemetryInfo.physicalDevice = m_physicalDevice;
+    telemetryInfo.enableMemoryBudget = m_physicalDeviceInfo.memoryBudgetSupported;
+    telemetryInfo.enablePipelineStatistics =
+            m_originInfo.enablePipelineStatistics && m_physicalDeviceInfo.features.pipelineStatisticsQuery;
+    telemetryInfo.frameSlotCount = MAX_FRAMES_IN_FLIGHT;
+    m_telemetry.init(telemetryInfo);
+}
+
+TelemetryStructs::FrameResources VulkanEngine::gatherFrameResources() const {
+    TelemetryStructs::FrameResources resources = {};
+
+    const auto& texturePool = m_textureManager.memoryPool();
+    resources.allocationCount += texturePool.blockCount() + m_renderGraph.transientAllocationCount();
+    resources.allocatedBytes += texturePool.reservedSize() + m_renderGraph.transientMemorySize();
+
+    if (m_hiZPyramid.memorySize() != 0) {
+        ++resources.allocationCount;
+        resources.allocatedBytes += m_hiZPyramid.memorySize();
+    }
+
+    resources.allocationCount += static_cast<uint32_t>(m_particleSystem.allocationCount() + m_skinningSystem.allocationCount());
+    resources.allocatedBytes += m_particleSystem.memorySize() + m_skinningSystem.memorySize();
+
+    resources.allocationCount += static_cast<uint32_t>(m_shadowCascades.allocationCount());
+    resources.allocatedBytes += m_shadowCascades.memorySize();
+
+    resources.allocationCount += static_cast<uint32_t>(m_clusteredLighting.allocationCount());
+    resources.allocatedBytes += m_clusteredLighting.memorySize();
+
+    resources.presentMode = m_presentMode;
+    resources.swapchainImageCount = static_cast<uint32_t>(m_swapchainImages.size());
+    return resources;
+}
+
 void VulkanEngine::createCommandBuffers() {
-    m_commandBuffers.resize(m_swapchainFramebuffers.size());
+    m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
     VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
     cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -854,59 +1609,183 @@ void VulkanEngine::createCommandBuffers() {
     if (vkAllocateCommandBuffers(m_device, &cmdBufferAllocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate command buffers.");
     }
+}
 
-    for (size_t i = 0; i < m_commandBuffers.size(); ++i) {
-        VkCommandBufferBeginInfo bufferBeginInfo = {};
-        bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        bufferBeginInfo.flags = 0;
-        bufferBeginInfo.pInheritanceInfo = nullptr;
-
-        if (vkBeginCommandBuffer(m_commandBuffers[i], &bufferBeginInfo) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to begin command buffer.");
-        }
+void VulkanEngine::createAsyncCompute() {
+    m_asyncCompute.setDevice(&m_device);
 
-        VkRenderPassBeginInfo passBeginInfo = {};
-        passBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        passBeginInfo.renderPass = m_renderPasses["main"];
-        passBeginInfo.framebuffer = m_swapchainFramebuffers[i];
-        passBeginInfo.renderArea.offset = { 0, 0 };
-        passBeginInfo.renderArea.extent = m_swapchainExtent2D;
+    AsyncComputeStructs::CreateInfo asyncComputeInfo = {};
+    asyncComputeInfo.queue = m_computeQueue;
+    asyncComputeInfo.queueFamilyIndex = m_computeQueueFamilyIndex;
+    asyncComputeInfo.graphicsQueueFamilyIndex = m_physicalDeviceInfo.queueFamilyIndices.graphics.value();
+    asyncComputeInfo.frameCount = MAX_FRAMES_IN_FLIGHT;
 
-        VkClearValue clearColor = { { { 0.0f, 0.0f, 0.0f, 1.0f } } };
-        passBeginInfo.clearValueCount = 1;
-        passBeginInfo.pClearValues = &clearColor;
+    m_asyncCompute.init(asyncComputeInfo);
+}
 
-        vkCmdBeginRenderPass(m_commandBuffers[i], &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+void VulkanEngine::createParticleSystem() {
+    if (!m_isParticleSystemEnabled) return;
+
+    m_particleSystem.setDevice(&m_device);
+
+    ParticleStructs::CreateInfo particleInfo = {};
+    particleInfo.physicalDevice = m_physicalDevice;
+    particleInfo.bindlessDescriptors = &m_bindlessDescriptors;
+    particleInfo.asyncCompute = &m_asyncCompute;
+    particleInfo.capacity = m_originInfo.maxParticleCount;
+    particleInfo.frameCount = MAX_FRAMES_IN_FLIGHT;
+    m_particleSystem.init(particleInfo, m_particleEmitters);
+
+    // The billboards are the first to read the results, in the last pass of the graph.
+    m_asyncCompute.addTask([this](VkCommandBuffer commandBuffer, size_t frameIndex) {
+        auto pipelineLayout = m_pipelineLayouts["particle_simulation"];
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &m_frameBindlessSet, 0, nullptr);
+        m_particleSystem.recordSimulation(commandBuffer, frameIndex, m_pipelineRegistry.pipeline(m_particleEmitPipeline),
+                                          m_pipelineRegistry.pipeline(m_particleSimulatePipeline),
+                                          m_pipelineRegistry.pipeline(m_particleCompactPipeline), pipelineLayout);
+    }, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+}
 
-        vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelines["main"]);
+void VulkanEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    VkCommandBufferBeginInfo bufferBeginInfo = {};
+    bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    bufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    bufferBeginInfo.pInheritanceInfo = nullptr;
 
-        // Bind vertex data.
-        auto& vertexBuffer = m_vertexBuffers[m_currBindVertexBufferLabel];
-        VkBuffer vertexBuffers[] = { vertexBuffer.isServerResourceEnabled ?
-                                      vertexBuffer.serverResource.buffer :
-                                      vertexBuffer.clientResource.buffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(m_commandBuffers[i], 0, 1, vertexBuffers, offsets);
+    if (vkBeginCommandBuffer(commandBuffer, &bufferBeginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin command buffer.");
+    }
 
-        // Bind index data.
-        auto& indexBuffer = m_indexBuffers[m_currBindIndexBufferLabel];
-        vkCmdBindIndexBuffer(m_commandBuffers[i], indexBuffer.serverResource.buffer, 0, VK_INDEX_TYPE_UINT32);
+    m_renderGraph.bindImportedImage(m_backbuffer, m_swapchainImages[imageIndex], m_swapchainImageViews[imageIndex]);
 
-        // Bind descriptor sets.
-        vkCmdBindDescriptorSets(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayouts["main"], 0, 1, &m_descriptorSets[i], 0, nullptr);
+    if (m_isSkinningEnabled) {
+        m_renderGraph.bindImportedBuffer(m_skinnedVerticesResource, m_skinningSystem.vertexBuffer());
+    }
 
-        vkCmdDrawIndexed(m_commandBuffers[i], indexBuffer.data.size(), 1, 0, 0, 0);
+    if (m_isOcclusionCullingEnabled) {
+        m_renderGraph.bindImportedImage(m_hiZPyramidResource, m_hiZPyramid.image(), m_hiZPyramid.view());
+        m_renderGraph.bindImportedBuffer(m_cullObjectsResource, m_occlusionBuffers.objectResources[m_currFrameIndex].buffer);
+        m_renderGraph.bindImportedBuffer(m_drawCommandsResource, m_occlusionBuffers.commandResources[m_currFrameIndex].buffer);
+    }
 
-        vkCmdEndRenderPass(m_commandBuffers[i]);
+    for (uint32_t i = 0; i < m_shadowCascadeResources.size(); ++i) {
+        m_renderGraph.bindImportedImage(m_shadowCascadeResources[i], m_shadowCascades.image(i), m_shadowCascades.view(i));
+    }
 
-        if (vkEndCommandBuffer(m_commandBuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to record command buffer.");
-        }
+    if (m_isClusteredLightingEnabled) {
+        m_renderGraph.bindImportedBuffer(m_lightGridResource, m_clusteredLighting.gridBuffer());
+        m_renderGraph.bindImportedBuffer(m_lightIndexResource, m_clusteredLighting.indexBuffer());
     }
-}
 
-void VulkanEngine::createFencesAndSemaphores() {
-    m_fences["frame_in_flight"].resize(MAX_FRAMES_IN_FLIGHT);
+    auto pipelineLayout = m_pipelineLayouts["main"];
+
+    setViewport(commandBuffer, m_swapchainExtent2D);
+
+    // Bind per-frame and bindless descriptor sets once; they stay bound across all passes of the graph.
+    m_frameDescriptorSet = allocateFrameDescriptorSet();
+    VkDescriptorSet descriptorSets[] = { m_frameDescriptorSet, m_frameBindlessSet };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+    ++m_telemetry.frameCounters().descriptorSetBindCount;
+
+    // The frame's fence has been waited, so the queries written last time in this slot are ready.
+    m_profiler.beginGpuFrame(commandBuffer, m_currFrameIndex);
+    m_profiler.beginGpuScope(commandBuffer, "gpu_frame");
+
+    m_telemetry.beginFrame(commandBuffer, m_currFrameIndex);
+    m_telemetry.beginPipelineStatistics(commandBuffer);
+
+    // Buffers written by the async compute tasks of this frame; a no-op on a single queue family.
+    m_asyncCompute.recordGraphicsAcquire(commandBuffer);
+
+    m_renderGraph.execute(commandBuffer);
+
+    m_asyncCompute.recordGraphicsRelease(commandBuffer);
+
+    m_telemetry.endPipelineStatistics(commandBuffer);
+
+    m_profiler.endGpuScope(commandBuffer);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record command buffer.");
+    }
+}
+
+void VulkanEngine::recordDrawItems(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, DrawPhase phase,
+                                   const std::vector<uint32_t>* drawItemIds) {
+    const auto& ids = drawItemIds != nullptr ? *drawItemIds : m_visibleDrawItems;
+
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize boundVertexBufferOffset = 0;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+
+    // With occlusion culling every draw item is issued in both phases, one command per meshlet,
+    // and the commands written by the cull passes decide with an instance count of 0 or 1
+    // in which one each of them is drawn.
+    VkBuffer drawCommands = VK_NULL_HANDLE;
+    size_t firstCommand = phase == DrawPhase::OcclusionLate ? m_occlusionBuffers.commandCount : 0;
+    if (phase != DrawPhase::All) {
+        drawCommands = m_occlusionBuffers.commandResources[m_currFrameIndex].buffer;
+    }
+
+    // Without multiDrawIndirect the commands of a draw item are issued one by one.
+    uint32_t maxDrawCount = m_physicalDeviceInfo.features.multiDrawIndirect ?
+                            m_physicalDeviceInfo.properties.limits.maxDrawIndirectCount : 1;
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const auto& drawItem = m_drawItems[ids[i]];
+
+        // Bind vertex data.
+        if (drawItem.vertexBuffer != boundVertexBuffer || drawItem.vertexBufferOffset != boundVertexBufferOffset) {
+            VkDeviceSize offsets[] = { drawItem.vertexBufferOffset };
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &drawItem.vertexBuffer, offsets);
+            boundVertexBuffer = drawItem.vertexBuffer;
+            boundVertexBufferOffset = drawItem.vertexBufferOffset;
+            ++m_telemetry.frameCounters().vertexBufferBindCount;
+        }
+
+        // Bind index data.
+        if (drawItem.indexBuffer != boundIndexBuffer) {
+            vkCmdBindIndexBuffer(commandBuffer, drawItem.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            boundIndexBuffer = drawItem.indexBuffer;
+            ++m_telemetry.frameCounters().indexBufferBindCount;
+        }
+
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                           0, sizeof(PerDrawConstants), &drawItem.constants);
+
+        if (phase == DrawPhase::All) {
+            vkCmdDrawIndexed(commandBuffer, drawItem.indexCount, 1, 0, 0, 0);
+        }
+        else {
+            auto commandCount = std::max(drawItem.meshletCount, 1u);
+            for (uint32_t command = 0; command < commandCount; command += maxDrawCount) {
+                vkCmdDrawIndexedIndirect(commandBuffer, drawCommands, (firstCommand + command) * sizeof(VkDrawIndexedIndirectCommand),
+                                         std::min(commandCount - command, maxDrawCount), sizeof(VkDrawIndexedIndirectCommand));
+            }
+            firstCommand += commandCount;
+        }
+    }
+    m_telemetry.frameCounters().drawCount += ids.size();
+}
+
+void VulkanEngine::setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void VulkanEngine::createFencesAndSemaphores() {
+    m_fences["frame_in_flight"].resize(MAX_FRAMES_IN_FLIGHT);
     m_fenceRefs["image_in_flight"].resize(m_swapchainImages.size(), VK_NULL_HANDLE);
 
     m_semaphores["image_available"].resize(MAX_FRAMES_IN_FLIGHT);
@@ -1004,6 +1883,59 @@ VulkanEngineStructs::PhysicalDeviceInfo VulkanEngine::queryPhysicalDeviceInfo(Vk
 
     vkGetPhysicalDeviceMemoryProperties(device, &info.memoryProperties);
 
+    vkGetPhysicalDeviceProperties(device, &info.properties);
+
+    vkGetPhysicalDeviceFeatures(device, &info.features);
+
+    // Descriptor indexing features and limits are only reachable through the 2 variants.
+    if (isPropertyInSupportedProperties(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, info.supportedExtensions)) {
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+
+        info.descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &info.descriptorIndexingProperties;
+        vkGetPhysicalDeviceProperties2(device, &properties2);
+        info.descriptorIndexingProperties.pNext = nullptr;
+
+        info.descriptorIndexingSupported =
+                indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind &&
+                indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                indexingFeatures.descriptorBindingUpdateUnusedWhilePending &&
+                indexingFeatures.descriptorBindingPartiallyBound;
+    }
+
+    // Budgets are queried through vkGetPhysicalDeviceMemoryProperties2, core since the instance is 1.2.
+    info.memoryBudgetSupported = isPropertyInSupportedProperties(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, info.supportedExtensions);
+
+#ifdef VK_KHR_dynamic_rendering
+    // The extension depends on VK_KHR_depth_stencil_resolve, which is only core from Vulkan 1.2.
+    bool isDepthStencilResolveAvailable =
+            info.properties.apiVersion >= VK_API_VERSION_1_2 ||
+            isPropertiesAllInSupportedProperties({ VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+                                                   VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME }, info.supportedExtensions);
+
+    if (isDepthStencilResolveAvailable &&
+        isPropertyInSupportedProperties(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, info.supportedExtensions)) {
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &dynamicRenderingFeatures;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+
+        info.dynamicRenderingSupported = dynamicRenderingFeatures.dynamicRendering;
+    }
+#endif
+
     return info;
 }
 
@@ -1049,6 +1981,19 @@ VulkanEngineStructs::QueueFamilyIndices VulkanEngine::queryDeviceQueueFamilyIndi
         if (indices.isFullySupported()) break;
     }
 
+    // The first family of each kind; graphics families can do both, so they are never dedicated.
+    for (size_t i = 0; i < queueFamilies.size(); ++i) {
+        auto flags = queueFamilies[i].queueFlags;
+        if (flags & VK_QUEUE_GRAPHICS_BIT) continue;
+
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !indices.compute.has_value()) {
+            indices.compute = i;
+        }
+        else if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT) && !indices.transfer.has_value()) {
+            indices.transfer = i;
+        }
+    }
+
     return indices;
 }
 
@@ -1112,12 +2057,19 @@ VkSurfaceFormatKHR VulkanEngine::selectSwapchainSurfaceFormat(const std::vector<
 }
 
 VkPresentModeKHR VulkanEngine::selectSwapchainPresentMode(const std::vector<VkPresentModeKHR>& candidateModes) {
-    for (const auto& mode : candidateModes) {
-        if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return mode;
-        }
+    auto isSupported = [&](VkPresentModeKHR mode) {
+        return std::find(candidateModes.begin(), candidateModes.end(), mode) != candidateModes.end();
+    };
+
+    auto requestedMode = m_presentSettings.presentMode;
+    if (isSupported(requestedMode)) {
+        return requestedMode;
+    }
+    // Mailbox still skips waiting for vblank where immediate mode is not available.
+    if (requestedMode == VK_PRESENT_MODE_IMMEDIATE_KHR && isSupported(VK_PRESENT_MODE_MAILBOX_KHR)) {
+        return VK_PRESENT_MODE_MAILBOX_KHR;
     }
-    // If there is no candidate support mailbox mode then simply return fifo mode.
+    // Otherwise simply return fifo mode.
     // Note that all GPUs support Vulkan will support fifo mode.
     return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -1152,10 +2104,157 @@ void VulkanEngine::declareVertices(const std::string& bufferLabel, bool enableSe
     m_vertexBuffers.insert({ bufferLabel, { enableServerBuffer, vertices } });
 }
 
+uint32_t VulkanEngine::declareSkinnedVertices(const std::string& bufferLabel, const std::vector<SkinnedVertex>& vertices,
+                                              uint32_t jointCount, const std::vector<std::vector<glm::vec3>>& morphTargets) {
+    // Skinned vertices are uploaded once at init.
+    assert(!m_skinningSystem.isInited());
+    assert(m_vertexBuffers.find(bufferLabel) == m_vertexBuffers.end());
+
+    auto skinId = m_skinningSystem.addMesh(vertices, jointCount, morphTargets);
+    m_skinnedVertexBuffers.insert({ bufferLabel, skinId });
+    return skinId;
+}
+
+void VulkanEngine::setSkinJointMatrices(uint32_t skinId, const std::vector<glm::mat4>& jointMats) {
+    assert(skinId < m_skinningSystem.meshCount());
+    m_skinningSystem.setJointMatrices(skinId, jointMats);
+}
+
+void VulkanEngine::setSkinMorphWeights(uint32_t skinId, const std::vector<float>& weights) {
+    assert(skinId < m_skinningSystem.meshCount());
+    m_skinningSystem.setMorphWeights(skinId, weights);
+}
+
+uint32_t VulkanEngine::declarePointLight(const ClusteredLightingStructs::PointLight& light) {
+    // The light buffers are sized at init.
+    assert(!m_clusteredLighting.isInited());
+    return m_clusteredLighting.addLight(light);
+}
+
+void VulkanEngine::setPointLight(uint32_t lightId, const ClusteredLightingStructs::PointLight& light) {
+    // The light count is fixed at init, so it is safe to check from here.
+    assert(lightId < m_clusteredLighting.lightCount());
+
+    std::lock_guard<std::mutex> lock(m_pendingUpdateMutex);
+    m_pendingLightUpdates.push_back({ lightId, light });
+}
+
+void VulkanEngine::createSkinningSystem() {
+    if (!m_isSkinningEnabled) return;
+
+    m_skinningSystem.setDevice(&m_device);
+
+    SkinningStructs::CreateInfo skinningInfo = {};
+    skinningInfo.physicalDevice = m_physicalDevice;
+    skinningInfo.queue = m_graphicsQueue;
+    skinningInfo.commandPool = m_commandPool;
+    skinningInfo.bindlessDescriptors = &m_bindlessDescriptors;
+    skinningInfo.frameCount = MAX_FRAMES_IN_FLIGHT;
+    m_skinningSystem.init(skinningInfo);
+}
+
+void VulkanEngine::recordSkinning(VkCommandBuffer commandBuffer) {
+    auto pipelineLayout = m_pipelineLayouts["skinning"];
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &m_frameBindlessSet, 0, nullptr);
+    ++m_telemetry.frameCounters().descriptorSetBindCount;
+
+    m_skinningSystem.recordSkinning(commandBuffer, m_currFrameIndex, m_pipelineRegistry.pipeline(m_skinningPipeline), pipelineLayout);
+
+    auto& counters = m_telemetry.frameCounters();
+    counters.skinnedVertexCount = m_skinningSystem.skinnedVertexCount();
+    if (counters.skinnedVertexCount != 0) ++counters.pipelineBindCount;
+}
+
 void VulkanEngine::declareIndices(const std::string& bufferLabel, const std::vector<uint32_t>& indices) {
     m_indexBuffers.insert({ bufferLabel, (IndexBuffer){ indices } });
 }
 
+uint32_t VulkanEngine::declareDrawItem(const std::string& vertexBufferLabel, const std::string& indexBufferLabel,
+                                       const glm::mat4& modelMat, uint32_t materialIndex) {
+    DrawItem drawItem = {};
+    drawItem.vertexBufferLabel = vertexBufferLabel;
+    drawItem.indexBufferLabel = indexBufferLabel;
+    drawItem.constants.modelMat = modelMat;
+    drawItem.constants.materialIndex = materialIndex;
+
+    m_drawItems.push_back(drawItem);
+    m_isEveryCasterChanged = true;
+
+    // Draw items declared after init can be resolved immediately.
+    if (m_isInited && m_device != VK_NULL_HANDLE) {
+        resolveDrawItem(m_drawItems.back());
+    }
+
+    return static_cast<uint32_t>(m_drawItems.size() - 1);
+}
+
+void VulkanEngine::setDrawItemTransform(uint32_t drawItemId, const glm::mat4& modelMat) {
+    m_drawItems[drawItemId].constants.modelMat = modelMat;
+    m_isEveryCasterChanged = true;
+}
+
+void VulkanEngine::setDrawItemTransforms(uint32_t firstDrawItemId, const TransformMath::TransformSoA& transforms) {
+    if (firstDrawItemId + transforms.size() > m_drawItems.size()) {
+        throw std::runtime_error("Draw item transforms out of range");
+    }
+
+    m_composedModelMats.resize(transforms.size());
+    TransformMath::composeMatrices(transforms, m_composedModelMats.data());
+
+    for (size_t i = 0; i < transforms.size(); ++i) {
+        m_drawItems[firstDrawItemId + i].constants.modelMat = m_composedModelMats[i];
+    }
+    m_isEveryCasterChanged = true;
+}
+
+void VulkanEngine::setDrawItemMaterial(uint32_t drawItemId, uint32_t materialIndex) {
+    m_drawItems[drawItemId].constants.materialIndex = materialIndex;
+}
+
+void VulkanEngine::setScene(Scene* scene) {
+    m_scene = scene;
+    m_resolvedSceneVersion = UINT64_MAX;
+    m_isEveryCasterChanged = true;
+}
+
+void VulkanEngine::setDrawItemNode(uint32_t drawItemId, Scene::NodeId node) {
+    m_drawItems[drawItemId].sceneNode = node;
+    m_resolvedSceneVersion = UINT64_MAX;
+    m_isEveryCasterChanged = true;
+}
+
+void VulkanEngine::resolveDrawItem(DrawItem& drawItem) {
+    auto skin = m_skinnedVertexBuffers.find(drawItem.vertexBufferLabel);
+    if (skin != m_skinnedVertexBuffers.end()) {
+        drawItem.vertexBuffer = m_skinningSystem.vertexBuffer();
+        drawItem.vertexBufferOffset = m_skinningSystem.vertexOffset(skin->second);
+    }
+    else {
+        auto& vertexBuffer = m_vertexBuffers[drawItem.vertexBufferLabel];
+        drawItem.vertexBuffer = vertexBuffer.isServerResourceEnabled ?
+                                vertexBuffer.serverResource.buffer :
+                                vertexBuffer.clientResource.buffer;
+        drawItem.vertexBufferOffset = 0;
+    }
+
+    auto& indexBuffer = m_indexBuffers[drawItem.indexBufferLabel];
+    drawItem.indexBuffer = indexBuffer.serverResource.buffer;
+    drawItem.indexCount = indexBuffer.data.size();
+    drawItem.firstMeshlet = indexBuffer.firstMeshlet;
+    drawItem.meshletCount = static_cast<uint32_t>(indexBuffer.meshlets.size());
+}
+
+void VulkanEngine::resolveDrawItems() {
+    // Keep the original single-mesh behaviour when no draw item is declared explicitly.
+    if (m_drawItems.empty() && !m_currBindVertexBufferLabel.empty() && !m_currBindIndexBufferLabel.empty()) {
+        declareDrawItem(m_currBindVertexBufferLabel, m_currBindIndexBufferLabel);
+    }
+
+    for (auto& drawItem : m_drawItems) {
+        resolveDrawItem(drawItem);
+    }
+}
+
 void VulkanEngine::createCoherentVertexBuffer(const std::string& label, size_t vertexCount) {
     // Only can create vertex buffer when it has been declared.
     assert(m_vertexBuffers.find(label) != m_vertexBuffers.end());
@@ -1210,6 +2309,7 @@ void VulkanEngine::createAllDeclaredVertexBuffers() {
             vkMapMemory(m_device, clientBuffer.memory, 0, VK_WHOLE_SIZE, 0, &data);
             memcpy(data, hostVertices.data(), sizeof(Vertex) * hostVertices.size());
             vkUnmapMemory(m_device, clientBuffer.memory);
+            m_telemetry.trackUpload(sizeof(Vertex) * hostVertices.size());
 
             copyBufferData(clientBuffer.buffer, serverBuffer.buffer, clientBuffer.requirements.size);
         }
@@ -1221,6 +2321,7 @@ void VulkanEngine::createAllDeclaredVertexBuffers() {
             vkMapMemory(m_device, clientBuffer.memory, 0, VK_WHOLE_SIZE, 0, &data);
             memcpy(data, hostVertices.data(), sizeof(Vertex) * hostVertices.size());
             vkUnmapMemory(m_device, clientBuffer.memory);
+            m_telemetry.trackUpload(sizeof(Vertex) * hostVertices.size());
         }
     }
 }
@@ -1250,6 +2351,7 @@ VkMemoryRequirements VulkanEngine::createExclusiveBuffer(VkBufferUsageFlags usag
     }
 
     vkBindBufferMemory(m_device, buffer, memory, 0);
+    m_telemetry.trackAllocation(requirements.size);
 
     return requirements;
 }
@@ -1319,125 +2421,974 @@ void VulkanEngine::createAllDeclaredIndexBuffers() {
         void* data;
         vkMapMemory(m_device, clientBuffer.memory, 0, VK_WHOLE_SIZE, 0, &data);
         memcpy(data, hostIndices.data(), sizeof(uint32_t) * hostIndices.size());
+        m_telemetry.trackUpload(sizeof(uint32_t) * hostIndices.size());
         vkUnmapMemory(m_device, clientBuffer.memory);
 
         copyBufferData(clientBuffer.buffer, serverBuffer.buffer, clientBuffer.requirements.size);
     }
 }
 
-void VulkanEngine::createDescriptorSetLayout() {
-    VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
+void VulkanEngine::buildAllDeclaredMeshlets() {
+    if (!m_isMeshletCullingEnabled) return;
+
+    // Index buffers know nothing of positions; take them from the first draw item using each one,
+    // or from the bound buffers that make the implicit draw item.
+    std::unordered_map<std::string, std::string> vertexBufferLabels = {};
+    for (const auto& drawItem : m_drawItems) {
+        vertexBufferLabels.insert({ drawItem.indexBufferLabel, drawItem.vertexBufferLabel });
+    }
+
+    if (!m_currBindIndexBufferLabel.empty() && !m_currBindVertexBufferLabel.empty()) {
+        vertexBufferLabels.insert({ m_currBindIndexBufferLabel, m_currBindVertexBufferLabel });
+    }
+
+    // Skinned vertices move, so bounds of their bind pose would cull what is visible.
+    std::unordered_set<std::string> skinnedIndexBufferLabels = {};
+    for (const auto& drawItem : m_drawItems) {
+        if (m_skinnedVertexBuffers.count(drawItem.vertexBufferLabel) != 0) {
+            skinnedIndexBufferLabels.insert(drawItem.indexBufferLabel);
+        }
+    }
+    if (m_skinnedVertexBuffers.count(m_currBindVertexBufferLabel) != 0) {
+        skinnedIndexBufferLabels.insert(m_currBindIndexBufferLabel);
+    }
+
+    std::vector<glm::vec3> positions = {};
+    uint32_t meshletCount = 0;
+    for (auto& indexBufferGroup : m_indexBuffers) {
+        auto vertexBufferLabel = vertexBufferLabels.find(indexBufferGroup.first);
+        if (vertexBufferLabel == vertexBufferLabels.end()) continue;
+        if (skinnedIndexBufferLabels.count(indexBufferGroup.first) != 0) continue;
+
+        const auto& vertices = m_vertexBuffers[vertexBufferLabel->second].data;
+        positions.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            positions[i] = vertices[i].pos;
+        }
+
+        auto& indexBuffer = indexBufferGroup.second;
+        indexBuffer.meshlets = MeshletBuilder::build(positions, indexBuffer.data);
+        indexBuffer.firstMeshlet = meshletCount;
+        meshletCount += static_cast<uint32_t>(indexBuffer.meshlets.size());
+    }
+}
+
+void VulkanEngine::createMeshletBuffer() {
+    std::vector<MeshletStructs::Meshlet> meshlets = {};
+    for (const auto& indexBufferGroup : m_indexBuffers) {
+        const auto& indexBuffer = indexBufferGroup.second;
+        if (indexBuffer.meshlets.empty()) continue;
+
+        meshlets.resize(std::max(meshlets.size(), indexBuffer.firstMeshlet + indexBuffer.meshlets.size()));
+        std::copy(indexBuffer.meshlets.begin(), indexBuffer.meshlets.end(), meshlets.begin() + indexBuffer.firstMeshlet);
+    }
+    if (meshlets.empty()) return;
+
+    auto& resource = m_meshletBuffer.resource;
+
+    resource.requirements = createExclusiveBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(MeshletStructs::Meshlet) * meshlets.size(),
+                                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                  resource.buffer, resource.memory);
+
+    void* data;
+    vkMapMemory(m_device, resource.memory, 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(data, meshlets.data(), sizeof(MeshletStructs::Meshlet) * meshlets.size());
+    vkUnmapMemory(m_device, resource.memory);
+    m_telemetry.trackUpload(sizeof(MeshletStructs::Meshlet) * meshlets.size());
+
+    m_meshletBuffer.slot = m_bindlessDescriptors.registerBuffer(resource.buffer);
+}
+
+uint32_t VulkanEngine::declareTexture(const std::vector<std::string>& candidateFilenames) {
+    // Textures are uploaded once at init.
+    assert(m_textures[DefaultTexture].handle == TextureManager::InvalidHandle);
+
+    TextureBinding binding = {};
+    binding.candidateFilenames = candidateFilenames;
+
+    m_textures.push_back(binding);
+    return static_cast<uint32_t>(m_textures.size() - 1);
+}
+
+uint32_t VulkanEngine::declareMaterial(const glm::vec4& baseColor, uint32_t textureId) {
+    // Materials are uploaded once at init.
+    assert(m_materialBuffer.resource.buffer == VK_NULL_HANDLE);
+    assert(textureId < m_textures.size());
+
+    m_materialBuffer.data.push_back(Material{ baseColor, textureId });
+    return static_cast<uint32_t>(m_materialBuffer.data.size() - 1);
+}
+
+uint32_t VulkanEngine::declareParticleEmitter(const ParticleStructs::Emitter& emitter) {
+    // The emitter buffers are sized at init.
+    assert(!m_particleSystem.isInited());
+
+    m_particleEmitters.push_back(emitter);
+    return static_cast<uint32_t>(m_particleEmitters.size() - 1);
+}
+
+void VulkanEngine::setParticleEmitter(uint32_t emitterId, const ParticleStructs::Emitter& emitter) {
+    // Emitters are all declared before init, so the count does not change under the render thread.
+    assert(emitterId < m_particleEmitters.size());
+
+    std::lock_guard<std::mutex> lock(m_pendingUpdateMutex);
+    m_pendingEmitterUpdates.push_back({ emitterId, emitter });
+}
+
+void VulkanEngine::applyPendingUpdates() {
+    std::lock_guard<std::mutex> lock(m_pendingUpdateMutex);
+
+    for (const auto& update : m_pendingEmitterUpdates) {
+        m_particleEmitters[update.first] = update.second;
+        if (m_particleSystem.isInited()) {
+            m_particleSystem.setEmitter(update.first, update.second);
+        }
+    }
+    m_pendingEmitterUpdates.clear();
+
+    for (const auto& update : m_pendingLightUpdates) {
+        m_clusteredLighting.setLight(update.first, update.second);
+    }
+    m_pendingLightUpdates.clear();
+}
 
-    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+void VulkanEngine::createBindlessDescriptors() {
+    const auto& info = m_physicalDeviceInfo;
 
-    if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descSetLayouts["main"]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create descriptor set layouts.");
+    BindlessDescriptorsStructs::CreateInfo bindlessInfo = {};
+    bindlessInfo.framesInFlight = MAX_FRAMES_IN_FLIGHT;
+
+    if (info.descriptorIndexingSupported) {
+        const auto& limits = info.descriptorIndexingProperties;
+        bindlessInfo.updateAfterBind = true;
+        bindlessInfo.bufferCapacity = std::min({ 4096u,
+                                                 limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                                                 limits.maxDescriptorSetUpdateAfterBindStorageBuffers });
+        bindlessInfo.imageCapacity = std::min({ 4096u,
+                                                limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                                limits.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                                limits.maxDescriptorSetUpdateAfterBindSampledImages,
+                                                limits.maxDescriptorSetUpdateAfterBindSamplers });
+    }
+    else {
+        // Every slot of an ordinary set must be valid, so keep the fallback table small.
+        const auto& limits = info.properties.limits;
+        bindlessInfo.updateAfterBind = false;
+        bindlessInfo.bufferCapacity = std::min({ 64u,
+                                                 limits.maxPerStageDescriptorStorageBuffers,
+                                                 limits.maxDescriptorSetStorageBuffers });
+        bindlessInfo.imageCapacity = std::min({ 16u,
+                                                limits.maxPerStageDescriptorSampledImages,
+                                                limits.maxPerStageDescriptorSamplers,
+                                                limits.maxDescriptorSetSampledImages,
+                                                limits.maxDescriptorSetSamplers });
+
+        m_bindlessFallbackBuffer.requirements = createExclusiveBuffer(
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 256, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                m_bindlessFallbackBuffer.buffer, m_bindlessFallbackBuffer.memory);
+        bindlessInfo.fallbackBuffer = m_bindlessFallbackBuffer.buffer;
+    }
+
+    m_bindlessDescriptors.setDevice(&m_device);
+    m_bindlessDescriptors.init(bindlessInfo);
+
+    // Shaders size the bindless arrays with specialization constants 0 and 1.
+    m_pipelineRegistry.setSpecializationConstants({ m_bindlessDescriptors.bufferCapacity(),
+                                                    m_bindlessDescriptors.imageCapacity() });
+}
+
+void VulkanEngine::createAllDeclaredTextures() {
+    const auto& features = m_physicalDeviceInfo.features;
+
+    TextureManagerStructs::CreateInfo textureInfo = {};
+    textureInfo.physicalDevice = m_physicalDevice;
+    textureInfo.queue = m_graphicsQueue;
+    textureInfo.commandPool = m_commandPool;
+    textureInfo.textureCompressionBC = features.textureCompressionBC;
+    textureInfo.textureCompressionASTC = features.textureCompressionASTC_LDR;
+    textureInfo.samplerAnisotropy = features.samplerAnisotropy;
+    textureInfo.maxSamplerAnisotropy = m_physicalDeviceInfo.properties.limits.maxSamplerAnisotropy;
+
+    m_textureManager.setDevice(&m_device);
+    m_textureManager.init(textureInfo);
+
+    auto sampler = m_textureManager.acquireSampler(TextureManager::SamplerKey::makeDefault());
+
+    // The white texture doubles as the content of unused slots in fallback mode.
+    auto& defaultTexture = m_textures[DefaultTexture];
+    defaultTexture.handle = m_textureManager.createSolidTexture(0xFFFFFFFF, "white");
+    m_bindlessDescriptors.setFallbackImage(m_textureManager.texture(defaultTexture.handle).view, sampler);
+
+    for (auto& binding : m_textures) {
+        if (binding.handle == TextureManager::InvalidHandle) {
+            binding.handle = m_textureManager.createTexture(binding.candidateFilenames);
+        }
+        binding.slot = m_bindlessDescriptors.registerImage(m_textureManager.texture(binding.handle).view, sampler);
+    }
+    m_telemetry.trackUpload(m_textureManager.uploadedBytes());
+}
+
+void VulkanEngine::createMaterialBuffer() {
+    // Resolve texture ids to bindless slots.
+    auto materials = m_materialBuffer.data;
+    for (auto& material : materials) {
+        material.baseColorTextureIndex = m_textures[material.baseColorTextureIndex].slot;
+    }
+
+    auto& resource = m_materialBuffer.resource;
+
+    resource.requirements = createExclusiveBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(Material) * materials.size(),
+                                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                  resource.buffer, resource.memory);
+
+    void* data;
+    vkMapMemory(m_device, resource.memory, 0, VK_WHOLE_SIZE, 0, &data);
+    memcpy(data, materials.data(), sizeof(Material) * materials.size());
+    vkUnmapMemory(m_device, resource.memory);
+    m_telemetry.trackUpload(sizeof(Material) * materials.size());
+
+    m_materialBuffer.slot = m_bindlessDescriptors.registerBuffer(resource.buffer);
+}
+
+void VulkanEngine::createInstanceBuffers() {
+    m_instanceBuffer.resources.resize(MAX_FRAMES_IN_FLIGHT);
+    m_instanceBuffer.mappedData.resize(MAX_FRAMES_IN_FLIGHT, nullptr);
+    m_instanceBuffer.capacities.resize(MAX_FRAMES_IN_FLIGHT, 0);
+    m_instanceBuffer.slots.resize(MAX_FRAMES_IN_FLIGHT, BindlessDescriptors::InvalidSlot);
+
+    size_t matrixCount = 1 + (m_scene != nullptr ? m_scene->nodeCount() : 0);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        reserveInstanceBuffer(i, matrixCount);
+    }
+}
+
+void VulkanEngine::reserveInstanceBuffer(size_t frameIndex, size_t matrixCount) {
+    if (m_instanceBuffer.capacities[frameIndex] >= matrixCount) return;
+
+    // Only called once the frame's previous submission has retired, so the old buffer is free to go.
+    destroyInstanceBuffer(frameIndex);
+
+    // Grow geometrically so that a growing scene does not reallocate every frame.
+    size_t capacity = std::max(matrixCount, 2 * m_instanceBuffer.capacities[frameIndex]);
+
+    auto& resource = m_instanceBuffer.resources[frameIndex];
+    resource.requirements = createExclusiveBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(glm::mat4) * capacity,
+                                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                  resource.buffer, resource.memory);
+    vkMapMemory(m_device, resource.memory, 0, VK_WHOLE_SIZE, 0, &m_instanceBuffer.mappedData[frameIndex]);
+
+    glm::mat4 identity = glm::mat4(1.0f);
+    memcpy(m_instanceBuffer.mappedData[frameIndex], &identity, sizeof(identity));
+
+    m_instanceBuffer.capacities[frameIndex] = capacity;
+    m_instanceBuffer.slots[frameIndex] = m_bindlessDescriptors.registerBuffer(resource.buffer);
+}
+
+void VulkanEngine::destroyInstanceBuffer(size_t frameIndex) {
+    auto& resource = m_instanceBuffer.resources[frameIndex];
+    if (resource.buffer == VK_NULL_HANDLE) return;
+
+    m_bindlessDescriptors.unregisterBuffer(m_instanceBuffer.slots[frameIndex]);
+    vkUnmapMemory(m_device, resource.memory);
+    vkDestroyBuffer(m_device, resource.buffer, nullptr);
+    vkFreeMemory(m_device, resource.memory, nullptr);
+    m_telemetry.trackFree(resource.requirements.size);
+
+    resource = {};
+    m_instanceBuffer.mappedData[frameIndex] = nullptr;
+    m_instanceBuffer.capacities[frameIndex] = 0;
+    m_instanceBuffer.slots[frameIndex] = BindlessDescriptors::InvalidSlot;
+}
+
+void VulkanEngine::updateInstanceBuffer() {
+    if (m_scene == nullptr) {
+        for (auto& drawItem : m_drawItems) {
+            drawItem.constants.instanceIndex = 0;
+        }
+        return;
+    }
+
+    m_scene->update();
+
+    // Node indices move when the structure changes.
+    if (m_scene->structureVersion() != m_resolvedSceneVersion) {
+        for (auto& drawItem : m_drawItems) {
+            drawItem.constants.instanceIndex = drawItem.sceneNode == Scene::InvalidNode ? 0 : 1 + m_scene->nodeIndex(drawItem.sceneNode);
+        }
+        m_resolvedSceneVersion = m_scene->structureVersion();
+        ++m_drawItemNodeSerial;
+    }
+
+    const auto& worldMatrices = m_scene->worldMatrices();
+    reserveInstanceBuffer(m_currFrameIndex, 1 + worldMatrices.size());
+
+    // Already laid out as the shader reads them; each frame in flight has its own copy.
+    auto* data = static_cast<glm::mat4*>(m_instanceBuffer.mappedData[m_currFrameIndex]);
+    memcpy(data + 1, worldMatrices.data(), sizeof(glm::mat4) * worldMatrices.size());
+    m_telemetry.trackUpload(sizeof(glm::mat4) * worldMatrices.size());
+}
+
+void VulkanEngine::cullDrawItems() {
+    m_visibleDrawItems.clear();
+
+    if (!m_originInfo.enableFrustumCulling || m_scene == nullptr) {
+        for (uint32_t i = 0; i < m_drawItems.size(); ++i) {
+            m_visibleDrawItems.push_back(i);
+        }
+        // Scene nodes are not tracked without the hierarchy.
+        if (m_scene != nullptr) m_isEveryCasterChanged = true;
+        return;
+    }
+
+    const auto& worldBounds = m_scene->worldBounds();
+
+    // Rebuild when draw items were added or moved to other nodes, otherwise refit what moved.
+    if (m_cullingBvhSerial != m_drawItemNodeSerial || m_cullingBvhDrawItemCount != m_drawItems.size()) {
+        m_cullableDrawItems.clear();
+        m_uncullableDrawItems.clear();
+        m_cullableBounds.clear();
+        for (uint32_t i = 0; i < m_drawItems.size(); ++i) {
+            auto node = m_drawItems[i].sceneNode;
+            if (node == Scene::InvalidNode) {
+                m_uncullableDrawItems.push_back(i);
+            }
+            else {
+                m_cullableDrawItems.push_back(i);
+                m_cullableBounds.push_back(worldBounds[m_scene->nodeIndex(node)]);
+            }
+        }
+        m_cullingBvh.build(m_cullableBounds);
+        m_isEveryCasterChanged = true;
+
+        m_cullingBvhSerial = m_drawItemNodeSerial;
+        m_cullingBvhDrawItemCount = m_drawItems.size();
+    }
+    else {
+        m_movedCullables.clear();
+        for (uint32_t i = 0; i < m_cullableDrawItems.size(); ++i) {
+            const auto& bounds = worldBounds[m_scene->nodeIndex(m_drawItems[m_cullableDrawItems[i]].sceneNode)];
+            auto& cachedBounds = m_cullableBounds[i];
+            if (bounds.center != cachedBounds.center || bounds.extents != cachedBounds.extents) {
+                if (m_isShadowEnabled) {
+                    m_changedCasterBounds.push_back(cachedBounds);
+                    m_changedCasterBounds.push_back(bounds);
+                }
+                cachedBounds = bounds;
+                m_movedCullables.push_back(i);
+            }
+        }
+        m_cullingBvh.refit(m_cullableBounds, m_movedCullables);
+    }
+
+    const auto& ubo = m_uniformBuffer.data;
+    auto frustum = CullingBvh::extractFrustum(ubo.projMat * ubo.viewMat);
+
+    m_visibleCullables.clear();
+    m_cullingBvh.cull(frustum, m_visibleCullables);
+
+    // Back in declaration order, which keeps buffer binds as coherent as without culling.
+    m_visibleDrawItems = m_uncullableDrawItems;
+    for (auto cullable : m_visibleCullables) {
+        m_visibleDrawItems.push_back(m_cullableDrawItems[cullable]);
+    }
+    std::sort(m_visibleDrawItems.begin(), m_visibleDrawItems.end());
+
+    m_telemetry.frameCounters().culledDrawCount = static_cast<uint32_t>(m_drawItems.size() - m_visibleDrawItems.size());
+}
+
+void VulkanEngine::createOcclusionCulling() {
+    if (!m_isOcclusionCullingEnabled) return;
+
+    m_hiZPyramid.setDevice(&m_device);
+
+    HiZPyramidStructs::CreateInfo pyramidInfo = {};
+    pyramidInfo.physicalDevice = m_physicalDevice;
+    pyramidInfo.queue = m_graphicsQueue;
+    pyramidInfo.commandPool = m_commandPool;
+    pyramidInfo.descriptorAllocator = &m_descriptorAllocator;
+    m_hiZPyramid.init(pyramidInfo);
+
+    m_hiZPyramid.resize(m_swapchainExtent2D);
+
+    m_occlusionBuffers.objectResources.resize(MAX_FRAMES_IN_FLIGHT);
+    m_occlusionBuffers.objectMappedData.resize(MAX_FRAMES_IN_FLIGHT, nullptr);
+    m_occlusionBuffers.objectSlots.resize(MAX_FRAMES_IN_FLIGHT, BindlessDescriptors::InvalidSlot);
+    m_occlusionBuffers.commandResources.resize(MAX_FRAMES_IN_FLIGHT);
+    m_occlusionBuffers.commandSlots.resize(MAX_FRAMES_IN_FLIGHT, BindlessDescriptors::InvalidSlot);
+    m_occlusionBuffers.objectCapacities.resize(MAX_FRAMES_IN_FLIGHT, 0);
+    m_occlusionBuffers.commandCapacities.resize(MAX_FRAMES_IN_FLIGHT, 0);
+
+    // Never grows, so it outlives the reallocations of the object buffers.
+    m_occlusionBuffers.statisticsResources.resize(MAX_FRAMES_IN_FLIGHT);
+    m_occlusionBuffers.statisticsMappedData.resize(MAX_FRAMES_IN_FLIGHT, nullptr);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        auto& statisticsResource = m_occlusionBuffers.statisticsResources[i];
+        statisticsResource.requirements = createExclusiveBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(CullStatistics),
+                                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                                                statisticsResource.buffer, statisticsResource.memory);
+        vkMapMemory(m_device, statisticsResource.memory, 0, VK_WHOLE_SIZE, 0, &m_occlusionBuffers.statisticsMappedData[i]);
+        *static_cast<CullStatistics*>(m_occlusionBuffers.statisticsMappedData[i]) = {};
+
+        // Cached memory need not be coherent.
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = statisticsResource.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkFlushMappedMemoryRanges(m_device, 1, &range);
+    }
+
+    size_t commandCount = 0;
+    for (const auto& drawItem : m_drawItems) {
+        commandCount += std::max(drawItem.meshletCount, 1u);
+    }
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        reserveOcclusionBuffers(i, m_drawItems.size(), commandCount);
+    }
+}
+
+void VulkanEngine::reserveOcclusionBuffers(size_t frameIndex, size_t objectCount, size_t commandCount) {
+    auto& objectCapacity = m_occlusionBuffers.objectCapacities[frameIndex];
+    auto& commandCapacity = m_occlusionBuffers.commandCapacities[frameIndex];
+    if (objectCapacity >= objectCount && commandCapacity >= commandCount && objectCapacity != 0) return;
+
+    // Grow geometrically, like the instance buffer; never empty, so there is always a buffer to bind.
+    size_t newObjectCapacity = std::max({ objectCount, objectCapacity, static_cast<size_t>(1) });
+    size_t newCommandCapacity = std::max({ commandCount, commandCapacity, static_cast<size_t>(1) });
+    if (objectCapacity < objectCount) newObjectCapacity = std::max(newObjectCapacity, 2 * objectCapacity);
+    if (commandCapacity < commandCount) newCommandCapacity = std::max(newCommandCapacity, 2 * commandCapacity);
+
+    // Only called once the frame's previous submission has retired, so the old buffers are free to go.
+    destroyOcclusionBuffers(frameIndex);
+
+    auto& objectResource = m_occlusionBuffers.objectResources[frameIndex];
+    objectResource.requirements = createExclusiveBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                        sizeof(CullStatistics) + sizeof(CullObject) * newObjectCapacity,
+                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                        objectResource.buffer, objectResource.memory);
+    vkMapMemory(m_device, objectResource.memory, 0, VK_WHOLE_SIZE, 0, &m_occlusionBuffers.objectMappedData[frameIndex]);
+    *static_cast<CullStatistics*>(m_occlusionBuffers.objectMappedData[frameIndex]) = {};
+
+    // Early commands, then late ones.
+    auto& commandResource = m_occlusionBuffers.commandResources[frameIndex];
+    commandResource.requirements = createExclusiveBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                                         2 * sizeof(VkDrawIndexedIndirectCommand) * newCommandCapacity,
+                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                         commandResource.buffer, commandResource.memory);
+
+    objectCapacity = newObjectCapacity;
+    commandCapacity = newCommandCapacity;
+    m_occlusionBuffers.objectSlots[frameIndex] = m_bindlessDescriptors.registerBuffer(objectResource.buffer);
+    m_occlusionBuffers.commandSlots[frameIndex] = m_bindlessDescriptors.registerBuffer(commandResource.buffer);
+}
+
+void VulkanEngine::destroyOcclusionBuffers(size_t frameIndex) {
+    auto& objectResource = m_occlusionBuffers.objectResources[frameIndex];
+    if (objectResource.buffer == VK_NULL_HANDLE) return;
+
+    m_bindlessDescriptors.unregisterBuffer(m_occlusionBuffers.objectSlots[frameIndex]);
+    vkUnmapMemory(m_device, objectResource.memory);
+    vkDestroyBuffer(m_device, objectResource.buffer, nullptr);
+    vkFreeMemory(m_device, objectResource.memory, nullptr);
+    m_telemetry.trackFree(objectResource.requirements.size);
+
+    auto& commandResource = m_occlusionBuffers.commandResources[frameIndex];
+    m_bindlessDescriptors.unregisterBuffer(m_occlusionBuffers.commandSlots[frameIndex]);
+    vkDestroyBuffer(m_device, commandResource.buffer, nullptr);
+    vkFreeMemory(m_device, commandResource.memory, nullptr);
+    m_telemetry.trackFree(commandResource.requirements.size);
+
+    objectResource = {};
+    commandResource = {};
+    m_occlusionBuffers.objectMappedData[frameIndex] = nullptr;
+    m_occlusionBuffers.objectSlots[frameIndex] = BindlessDescriptors::InvalidSlot;
+    m_occlusionBuffers.commandSlots[frameIndex] = BindlessDescriptors::InvalidSlot;
+    m_occlusionBuffers.objectCapacities[frameIndex] = 0;
+    m_occlusionBuffers.commandCapacities[frameIndex] = 0;
+}
+
+void VulkanEngine::updateOcclusionBuffers() {
+    if (!m_isOcclusionCullingEnabled) return;
+
+    // The frame's fence has been waited, so the copy of what its previous submission counted has landed.
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = m_occlusionBuffers.statisticsResources[m_currFrameIndex].memory;
+    range.offset = 0;
+    range.size = VK_WHOLE_SIZE;
+    vkInvalidateMappedMemoryRanges(m_device, 1, &range);
+
+    const auto* statistics = static_cast<const CullStatistics*>(m_occlusionBuffers.statisticsMappedData[m_currFrameIndex]);
+    auto& counters = m_telemetry.frameCounters();
+    counters.occludedDrawCount = statistics->occludedDrawCount;
+    counters.occludedTriangleCount = statistics->occludedTriangleCount;
+    counters.clusterCulledCount = statistics->clusterCulledCount;
+    counters.clusterCulledTriangleCount = statistics->clusterCulledTriangleCount;
+
+    size_t commandCount = 0;
+    for (auto drawItemId : m_visibleDrawItems) {
+        commandCount += std::max(m_drawItems[drawItemId].meshletCount, 1u);
+    }
+    m_occlusionBuffers.commandCount = commandCount;
+
+    reserveOcclusionBuffers(m_currFrameIndex, m_visibleDrawItems.size(), commandCount);
+
+    auto* data = static_cast<CullStatistics*>(m_occlusionBuffers.objectMappedData[m_currFrameIndex]);
+    *data = {};
+
+    // Parallel to the visible draw items; the ones without bounds are never occluded as a whole.
+    auto* objects = reinterpret_cast<CullObject*>(data + 1);
+    uint32_t firstCommand = 0;
+    for (size_t i = 0; i < m_visibleDrawItems.size(); ++i) {
+        const auto& drawItem = m_drawItems[m_visibleDrawItems[i]];
+
+        auto& object = objects[i];
+        object.indexCount = drawItem.indexCount;
+        object.firstMeshlet = drawItem.firstMeshlet;
+        object.meshletCount = drawItem.meshletCount;
+        object.firstCommand = firstCommand;
+        firstCommand += std::max(drawItem.meshletCount, 1u);
+
+        // Only written, never read back: the mapping may be write-combined.
+        uint32_t flags = 0;
+        glm::mat4 worldMat = glm::mat4(1.0f);
+        if (m_scene == nullptr || drawItem.sceneNode == Scene::InvalidNode) {
+            flags = CullObject::AlwaysVisible;
+        }
+        else {
+            auto nodeIndex = m_scene->nodeIndex(drawItem.sceneNode);
+            const auto& bounds = m_scene->worldBounds()[nodeIndex];
+            object.center = glm::vec4(bounds.center, 0.0f);
+            object.extents = glm::vec4(bounds.extents, 0.0f);
+            worldMat = m_scene->worldMatrices()[nodeIndex];
+        }
+
+        if (drawItem.meshletCount != 0) {
+            auto modelMat = worldMat * drawItem.constants.modelMat;
+            object.modelMat = modelMat;
+
+            // Normal cones only rotate along when the scale is uniform and keeps the winding.
+            auto linearMat = glm::mat3(modelMat);
+            float minScale = std::min({ glm::length(linearMat[0]), glm::length(linearMat[1]), glm::length(linearMat[2]) });
+            float maxScale = std::max({ glm::length(linearMat[0]), glm::length(linearMat[1]), glm::length(linearMat[2]) });
+            if (glm::determinant(linearMat) > 0.0f && maxScale <= 1.01f * minScale) {
+                flags |= CullObject::ConeCullable;
+            }
+        }
+        object.flags = flags;
+    }
+    m_telemetry.trackUpload(sizeof(CullStatistics) + sizeof(CullObject) * m_visibleDrawItems.size());
+}
+
+void VulkanEngine::recordOcclusionCull(VkCommandBuffer commandBuffer, uint32_t phase) {
+    auto objectCount = static_cast<uint32_t>(m_visibleDrawItems.size());
+    if (objectCount == 0) return;
+
+    auto pipelineLayout = m_pipelineLayouts["occlusion_cull"];
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineRegistry.pipeline(m_occlusionCullPipeline));
+    ++m_telemetry.frameCounters().pipelineBindCount;
+
+    auto pyramidSet = m_descriptorAllocator.allocate(m_currFrameIndex, m_occlusionCullSetLayout);
+
+    VkDescriptorImageInfo pyramidInfo = {};
+    pyramidInfo.sampler = m_hiZPyramid.sampler();
+    pyramidInfo.imageView = m_hiZPyramid.view();
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorBufferInfo uniformBufferInfo = {};
+    uniformBufferInfo.buffer = m_uniformBuffer.resources[m_currFrameIndex].buffer;
+    uniformBufferInfo.offset = 0;
+    uniformBufferInfo.range = sizeof(UniformBufferObject);
+
+    VkWriteDescriptorSet descWrites[2] = {};
+    descWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descWrites[0].dstSet = pyramidSet;
+    descWrites[0].dstBinding = 0;
+    descWrites[0].dstArrayElement = 0;
+    descWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descWrites[0].descriptorCount = 1;
+    descWrites[0].pImageInfo = &pyramidInfo;
+
+    descWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descWrites[1].dstSet = pyramidSet;
+    descWrites[1].dstBinding = 1;
+    descWrites[1].dstArrayElement = 0;
+    descWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descWrites[1].descriptorCount = 1;
+    descWrites[1].pBufferInfo = &uniformBufferInfo;
+
+    vkUpdateDescriptorSets(m_device, 2, descWrites, 0, nullptr);
+
+    VkDescriptorSet descriptorSets[] = { pyramidSet, m_frameBindlessSet };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+    ++m_telemetry.frameCounters().descriptorSetBindCount;
+
+    // Phase 0 reprojects into the pyramid as the previous frame saw it, phase 1 uses the one just built.
+    const auto& ubo = m_uniformBuffer.data;
+
+    OcclusionCullParams params = {};
+    params.viewProjMat = phase == 0 ? m_pyramidViewProjMat : ubo.projMat * ubo.viewMat;
+    params.cameraPosition = glm::inverse(ubo.viewMat)[3];
+    params.depthWidth = m_hiZPyramid.depthExtent().width;
+    params.depthHeight = m_hiZPyramid.depthExtent().height;
+    params.objectBufferIndex = m_occlusionBuffers.objectSlots[m_currFrameIndex];
+    params.commandBufferIndex = m_occlusionBuffers.commandSlots[m_currFrameIndex];
+    params.meshletBufferIndex = m_meshletBuffer.slot != BindlessDescriptors::InvalidSlot ? m_meshletBuffer.slot : 0;
+    params.objectCount = objectCount;
+    params.commandCount = static_cast<uint32_t>(m_occlusionBuffers.commandCount);
+    params.phase = phase;
+    params.pyramidLevelCount = m_hiZPyramid.levelCount();
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+
+    // One workgroup per object, in rows of the 65535 every device supports.
+    constexpr uint32_t maxGroupCountX = 65535;
+    vkCmdDispatch(commandBuffer, std::min(objectCount, maxGroupCountX), (objectCount + maxGroupCountX - 1) / maxGroupCountX, 1);
+
+    if (phase == 1) {
+        // The statistics are copied out and read on the host once the frame's fence is signaled.
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_occlusionBuffers.objectResources[m_currFrameIndex].buffer;
+        barrier.offset = 0;
+        barrier.size = sizeof(CullStatistics);
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+
+        VkBufferCopy region = {};
+        region.srcOffset = 0;
+        region.dstOffset = 0;
+        region.size = sizeof(CullStatistics);
+        vkCmdCopyBuffer(commandBuffer, m_occlusionBuffers.objectResources[m_currFrameIndex].buffer,
+                        m_occlusionBuffers.statisticsResources[m_currFrameIndex].buffer, 1, &region);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.buffer = m_occlusionBuffers.statisticsResources[m_currFrameIndex].buffer;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             0, nullptr, 1, &barrier, 0, nullptr);
+    }
+}
+
+void VulkanEngine::recordHiZBuild(VkCommandBuffer commandBuffer, RenderGraph::ResourceHandle depth) {
+    m_hiZPyramid.recordBuild(commandBuffer, m_currFrameIndex, m_renderGraph.imageView(depth),
+                             m_pipelineRegistry.pipeline(m_hiZBuildPipeline), m_pipelineLayouts["hiz_build"], m_hiZBuildSetLayout);
+
+    auto& counters = m_telemetry.frameCounters();
+    ++counters.pipelineBindCount;
+    counters.descriptorSetBindCount += m_hiZPyramid.levelCount();
+
+    // What the next frame's first phase reprojects into.
+    const auto& ubo = m_uniformBuffer.data;
+    m_pyramidViewProjMat = ubo.projMat * ubo.viewMat;
+}
+
+void VulkanEngine::createShadowCascades() {
+    if (!m_isShadowEnabled) return;
+
+    m_shadowCascades.setDevice(&m_device);
+
+    ShadowCascadesStructs::CreateInfo shadowInfo = {};
+    shadowInfo.physicalDevice = m_physicalDevice;
+    shadowInfo.queue = m_graphicsQueue;
+    shadowInfo.commandPool = m_commandPool;
+    shadowInfo.bindlessDescriptors = &m_bindlessDescriptors;
+    shadowInfo.cascadeCount = static_cast<uint32_t>(m_shadowCascadeResources.size());
+    shadowInfo.resolution = m_originInfo.shadowMapResolution;
+    shadowInfo.firstCachedCascade = m_originInfo.firstCachedShadowCascade;
+    m_shadowCascades.init(shadowInfo);
+
+    m_shadowCasterDrawItems.resize(m_shadowCascades.cascadeCount());
+
+    auto& ubo = m_uniformBuffer.data;
+    ubo.shadowCascadeCount = m_shadowCascades.cascadeCount();
+    ubo.shadowMapResolution = m_shadowCascades.resolution();
+    for (uint32_t i = 0; i < m_shadowCascades.cascadeCount(); ++i) {
+        ubo.shadowMapIndices[i] = m_shadowCascades.slot(i);
+    }
+}
+
+void VulkanEngine::updateShadowCascades() {
+    // Skins move without their bounds changing.
+    for (SkinningSystem::Handle skin = 0; skin < m_skinningSystem.meshCount(); ++skin) {
+        if (m_skinningSystem.isPoseChanged(skin)) m_isEveryCasterChanged = true;
+    }
+
+    m_shadowCascades.update(*m_camera, m_lightDirection, m_changedCasterBounds, m_isEveryCasterChanged);
+    m_changedCasterBounds.clear();
+    m_isEveryCasterChanged = false;
+
+    // Cascades keep the matrices they were rendered with until rendered again.
+    auto& ubo = m_uniformBuffer.data;
+    for (uint32_t i = 0; i < m_shadowCascades.cascadeCount(); ++i) {
+        ubo.shadowSplitDepths[i] = m_shadowCascades.splitDepth(i);
+        ubo.shadowTexelDepths[i] = m_shadowCascades.texelDepth(i);
+        ubo.shadowMats[i] = m_shadowCascades.projMat(i) * m_shadowCascades.viewMat();
+    }
+
+    // The rest of the frame's uniforms is already written.
+    auto* mappedData = static_cast<char*>(m_uniformBuffer.mappedData[m_currFrameIndex]);
+    constexpr size_t shadowDataOffset = offsetof(UniformBufferObject, lightDirection);
+    memcpy(mappedData + shadowDataOffset, reinterpret_cast<const char*>(&ubo) + shadowDataOffset,
+           sizeof(ubo) - shadowDataOffset);
+    m_telemetry.trackUpload(sizeof(ubo) - shadowDataOffset);
+
+    auto& counters = m_telemetry.frameCounters();
+    counters.shadowCascadeRenderCount = m_shadowCascades.renderedCascadeCount();
+
+    for (uint32_t i = 0; i < m_shadowCascades.cascadeCount(); ++i) {
+        if (!m_shadowCascades.isRenderNeeded(i)) continue;
+
+        // Seen from the light, with the instance and material buffers of the frame.
+        auto cascadeUbo = ubo;
+        cascadeUbo.viewMat = m_shadowCascades.viewMat();
+        cascadeUbo.projMat = m_shadowCascades.projMat(i);
+        memcpy(mappedData + m_uniformBuffer.stride * (1 + i), &cascadeUbo, sizeof(cascadeUbo));
+        m_telemetry.trackUpload(sizeof(cascadeUbo));
+
+        // Casters come from the same hierarchy as the visible draw items, culled by the cascade's box.
+        auto& casters = m_shadowCasterDrawItems[i];
+        if (!m_originInfo.enableFrustumCulling || m_scene == nullptr) {
+            casters.resize(m_drawItems.size());
+            for (uint32_t j = 0; j < m_drawItems.size(); ++j) casters[j] = j;
+            continue;
+        }
+        m_visibleCullables.clear();
+        m_cullingBvh.cull(CullingBvh::extractFrustum(cascadeUbo.projMat * cascadeUbo.viewMat), m_visibleCullables);
+
+        casters = m_uncullableDrawItems;
+        for (auto cullable : m_visibleCullables) {
+            casters.push_back(m_cullableDrawItems[cullable]);
+        }
+        std::sort(casters.begin(), casters.end());
     }
 }
 
+void VulkanEngine::recordShadowCascade(VkCommandBuffer commandBuffer, uint32_t cascade) {
+    auto pipelineLayout = m_pipelineLayouts["main"];
+
+    setViewport(commandBuffer, { m_shadowCascades.resolution(), m_shadowCascades.resolution() });
+
+    auto cascadeSet = allocateFrameDescriptorSet(1 + cascade);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &cascadeSet, 0, nullptr);
+    ++m_telemetry.frameCounters().descriptorSetBindCount;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineRegistry.pipeline(m_shadowPipeline));
+    ++m_telemetry.frameCounters().pipelineBindCount;
+    recordDrawItems(commandBuffer, pipelineLayout, DrawPhase::All, &m_shadowCasterDrawItems[cascade]);
+
+    // Back to what the rest of the graph expects.
+    setViewport(commandBuffer, m_swapchainExtent2D);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &m_frameDescriptorSet, 0, nullptr);
+    ++m_telemetry.frameCounters().descriptorSetBindCount;
+}
+
+void VulkanEngine::createClusteredLighting() {
+    if (!m_isClusteredLightingEnabled) return;
+
+    m_clusteredLighting.setDevice(&m_device);
+
+    ClusteredLightingStructs::CreateInfo lightingInfo = {};
+    lightingInfo.physicalDevice = m_physicalDevice;
+    lightingInfo.bindlessDescriptors = &m_bindlessDescriptors;
+    lightingInfo.frameCount = MAX_FRAMES_IN_FLIGHT;
+    lightingInfo.clusterCounts = glm::max(glm::uvec3(m_originInfo.lightClusterCountX, m_originInfo.lightClusterCountY,
+                                                     m_originInfo.lightClusterCountZ), glm::uvec3(1));
+    lightingInfo.averageLightsPerCluster = m_originInfo.averageLightsPerCluster;
+    m_clusteredLighting.init(lightingInfo);
+
+    auto& ubo = m_uniformBuffer.data;
+    ubo.lightGridBufferIndex = m_clusteredLighting.gridSlot();
+    ubo.lightIndexBufferIndex = m_clusteredLighting.indexSlot();
+    ubo.lightCount = static_cast<uint32_t>(m_clusteredLighting.lightCount());
+    ubo.lightClusterCounts = glm::uvec4(m_clusteredLighting.clusterCounts(), 0);
+}
+
+void VulkanEngine::recordLightCull(VkCommandBuffer commandBuffer) {
+    auto pipelineLayout = m_pipelineLayouts["light_cull"];
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 1, 1, &m_frameBindlessSet, 0, nullptr);
+    ++m_telemetry.frameCounters().descriptorSetBindCount;
+
+    // The camera the main passes shade with.
+    const auto& ubo = m_uniformBuffer.data;
+    m_clusteredLighting.recordCulling(commandBuffer, m_currFrameIndex, m_pipelineRegistry.pipeline(m_lightCullPipeline), pipelineLayout,
+                                      ubo.viewMat, ubo.projMat, m_camera->nearZ(), m_camera->farZ());
+    ++m_telemetry.frameCounters().pipelineBindCount;
+}
+
+void VulkanEngine::createDescriptorAllocator() {
+    m_descriptorAllocator.setDevice(&m_device);
+    m_descriptorAllocator.init(MAX_FRAMES_IN_FLIGHT);
+}
+
+void VulkanEngine::createDescriptorSetLayout() {
+    // Layouts are cached by the allocator and shared by everything declaring the same bindings.
+    m_frameSetLayout = m_descriptorAllocator.acquireLayout({
+            { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT }
+    });
+}
+
 void VulkanEngine::createUniformBuffers() {
-    auto bufferSize = sizeof(UniformBufferObject);
+    auto alignment = m_physicalDeviceInfo.properties.limits.minUniformBufferOffsetAlignment;
+    m_uniformBuffer.stride = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+    auto bufferSize = m_uniformBuffer.stride * (1 + m_shadowCascadeResources.size());
 
-    m_uniformBuffer.resources.resize(m_swapchainImages.size());
+    m_uniformBuffer.resources.resize(MAX_FRAMES_IN_FLIGHT);
+    m_uniformBuffer.mappedData.resize(MAX_FRAMES_IN_FLIGHT);
 
-    for (size_t i = 0; i < m_swapchainImages.size(); ++i) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
         m_uniformBuffer.resources[i].requirements = createExclusiveBuffer(
                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, bufferSize,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                 m_uniformBuffer.resources[i].buffer, m_uniformBuffer.resources[i].memory);
+
+        // Keep uniform buffers persistently mapped; they are host coherent so no flush is needed.
+        vkMapMemory(m_device, m_uniformBuffer.resources[i].memory, 0, VK_WHOLE_SIZE, 0, &m_uniformBuffer.mappedData[i]);
     }
 }
 
 void VulkanEngine::updateUniformBuffers() {
-    UniformBufferObject ubo = {};
-    ubo.modelMat = glm::mat4(1.0f);
+    updateInstanceBuffer();
+
+    auto& ubo = m_uniformBuffer.data;
     m_camera->updateViewMatrix(ubo.viewMat);
     m_camera->updateProjMatrix(ubo.projMat);
-
-    void* data;
-    auto& memory = m_uniformBuffer.resources[m_currSwapchainImageIndex].memory;
-    vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(m_device, memory);
+    ubo.materialBufferIndex = m_materialBuffer.slot;
+    ubo.instanceBufferIndex = m_instanceBuffer.slots[m_currFrameIndex];
+    ubo.lightDirection = glm::vec4(m_lightDirection, 0.25f);
+
+    if (m_clusteredLighting.isInited()) {
+        // Slices are found from the log of view depth, z_k = near * (far / near)^(k / Z) solved for k.
+        auto clusterCounts = m_clusteredLighting.clusterCounts();
+        float logDepthRange = std::log(m_camera->farZ() / m_camera->nearZ());
+        ubo.lightBufferIndex = m_clusteredLighting.lightSlot(m_currFrameIndex);
+        ubo.lightClusterParams = glm::vec4(static_cast<float>(m_swapchainExtent2D.width) / clusterCounts.x,
+                                           static_cast<float>(m_swapchainExtent2D.height) / clusterCounts.y,
+                                           clusterCounts.z / logDepthRange,
+                                           clusterCounts.z * std::log(m_camera->nearZ()) / logDepthRange);
+    }
+
+    memcpy(m_uniformBuffer.mappedData[m_currFrameIndex], &ubo, sizeof(ubo));
+    m_telemetry.trackUpload(sizeof(ubo));
 }
 
-void VulkanEngine::createDescriptorPool() {
-    VkDescriptorPoolSize poolSize = {};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = m_swapchainImages.size();
+VkDescriptorSet VulkanEngine::allocateFrameDescriptorSet(uint32_t copy) {
+    auto set = m_descriptorAllocator.allocate(m_currFrameIndex, m_frameSetLayout);
 
-    VkDescriptorPoolCreateInfo poolInfo = {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = m_swapchainImages.size();
+    VkDescriptorBufferInfo descBufferInfo = {};
+    descBufferInfo.buffer = m_uniformBuffer.resources[m_currFrameIndex].buffer;
+    descBufferInfo.offset = m_uniformBuffer.stride * copy;
+    descBufferInfo.range = sizeof(UniformBufferObject);
 
-    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create descriptor pool.");
-    }
-}
+    VkWriteDescriptorSet descWrite = {};
+    descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descWrite.dstSet = set;
+    descWrite.dstBinding = 0;
+    descWrite.dstArrayElement = 0;
+    descWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descWrite.descriptorCount = 1;
+    descWrite.pBufferInfo = &descBufferInfo;
+    descWrite.pImageInfo = nullptr;
+    descWrite.pTexelBufferView = nullptr;
 
-void VulkanEngine::createDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(m_swapchainImages.size(), m_descSetLayouts["main"]);
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = m_swapchainImages.size();
-    allocInfo.pSetLayouts = layouts.data();
+    vkUpdateDescriptorSets(m_device, 1, &descWrite, 0, nullptr);
 
-    m_descriptorSets.resize(m_swapchainImages.size());
-    if (vkAllocateDescriptorSets(m_device, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate descriptor sets.");
-    }
+    return set;
+}
 
-    for (size_t i = 0; i < m_swapchainImages.size(); ++i) {
-        VkDescriptorBufferInfo descBufferInfo = {};
-        descBufferInfo.buffer = m_uniformBuffer.resources[i].buffer;
-        descBufferInfo.offset = 0;
-        descBufferInfo.range = sizeof(UniformBufferObject);
+void VulkanEngine::translateCamera(float dx, float dy, float dz) {
+    m_cameraInput.translateX += dx;
+    m_cameraInput.translateY += dy;
+    m_cameraInput.translateZ += dz;
+    m_cameraInput.timestampNs = m_profiler.nowNs();
+    m_cameraInputExchange.publish(m_cameraInput);
+}
 
-        VkWriteDescriptorSet descWrite = {};
-        descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descWrite.dstSet = m_descriptorSets[i];
-        descWrite.dstBinding = 0;
-        descWrite.dstArrayElement = 0;
-        descWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descWrite.descriptorCount = 1;
-        descWrite.pBufferInfo = &descBufferInfo;
-        descWrite.pImageInfo = nullptr;
-        descWrite.pTexelBufferView = nullptr;
+void VulkanEngine::rotateCamera(float dx, float dy) {
+    m_cameraInput.yaw += dx;
+    m_cameraInput.pitch += dy;
+    m_cameraInput.timestampNs = m_profiler.nowNs();
+    m_cameraInputExchange.publish(m_cameraInput);
+}
 
-        vkUpdateDescriptorSets(m_device, 1, &descWrite, 0, nullptr);
-    }
+void VulkanEngine::zoomCamera(float delta) {
+    m_cameraInput.zoom += delta;
+    m_cameraInput.timestampNs = m_profiler.nowNs();
+    m_cameraInputExchange.publish(m_cameraInput);
 }
 
-void VulkanEngine::translateCamera(float dx, float dy, float dz) {
+void VulkanEngine::setCameraMotion(float dx, float dy, float dz) {
+    m_cameraInput.motionX = dx;
+    m_cameraInput.motionY = dy;
+    m_cameraInput.motionZ = dz;
+    m_cameraInputExchange.publish(m_cameraInput);
+}
+
+void VulkanEngine::mTranslateCamera(float dx, float dy, float dz) {
     auto T = dx * m_camera->right() + dy * m_camera->up() + dz * m_camera->lookAt();
     m_camera->translate(T.x, T.y, T.z);
 }
 
-void VulkanEngine::rotateCamera(float dx, float dy) {
+void VulkanEngine::mRotateCamera(float dx, float dy) {
     m_camera->rotate(dy, dx);
+    m_cameraYaw += dx;
+    m_cameraPitch += dy;
 }
 
-void VulkanEngine::zoomCamera(float delta) {
+void VulkanEngine::mZoomCamera(float delta) {
     m_camera->zoom(delta);
 }
 
+void VulkanEngine::applyCameraInput() {
+    auto input = m_cameraInputExchange.read();
+    const auto& applied = m_appliedCameraInput;
+
+    if (input.translateX != applied.translateX || input.translateY != applied.translateY || input.translateZ != applied.translateZ) {
+        mTranslateCamera(static_cast<float>(input.translateX - applied.translateX),
+                         static_cast<float>(input.translateY - applied.translateY),
+                         static_cast<float>(input.translateZ - applied.translateZ));
+    }
+    if (input.yaw != applied.yaw || input.pitch != applied.pitch) {
+        mRotateCamera(static_cast<float>(input.yaw - applied.yaw), static_cast<float>(input.pitch - applied.pitch));
+    }
+    if (input.zoom != applied.zoom) {
+        mZoomCamera(static_cast<float>(input.zoom - applied.zoom));
+    }
+    if (input.timestampNs != applied.timestampNs) {
+        m_sampledInputTimestampNs = input.timestampNs;
+    }
+
+    // A held key is sampled right now, like any other input would have been.
+    if (input.motionX != 0.0 || input.motionY != 0.0 || input.motionZ != 0.0) {
+        mTranslateCamera(static_cast<float>(input.motionX), static_cast<float>(input.motionY), static_cast<float>(input.motionZ));
+        m_sampledInputTimestampNs = m_profiler.nowNs();
+    }
+
+    m_appliedCameraInput = input;
+}
+
+void VulkanEngine::resetCamera() {
+    buildCamera();
+}
+
+void VulkanEngine::moveCameraTo(const glm::vec3& eye) {
+    auto T = eye - m_camera->eye();
+    m_camera->translate(T.x, T.y, T.z);
+}
+
 void VulkanEngine::buildCamera() {
     m_camera = std::make_unique<Camera>(m_surfaceInfo.pixelWidth, m_surfaceInfo.pixelHeight, 90.0f);
 
     m_camera->setEye(glm::vec3(0.0f, 0.0f, -1.0f));
 
-    m_camera->setRight(glm::vec3(1.0f, 0.0f, 0.0f));
-    m_camera->setUp(glm::vec3(0.0f, 1.0f, 0.0f));
-    m_camera->setLookAt(glm::vec3(0.0f, 0.0f, 1.0f));
+    m_camera->setBasis(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    m_cameraYaw = 0.0f;
+    m_cameraPitch = 0.0f;
 }
\ No newline at end of file
@@ -11,8 +11,12 @@
 #ifndef VULKAN_ENGINE_H
 #define VULKAN_ENGINE_H
 
+#include <atomic>
+#include <exception>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -21,9 +25,27 @@
 
 #include <QDebug>
 
+#include "AsyncCompute.h"
+#include "BindlessDescriptors.h"
 #include "Camera.h"
+#include "ClusteredLighting.h"
+#include "CullingBvh.h"
+#include "DescriptorAllocator.h"
 #include "GraphicsResource.h"
+#include "HiZPyramid.h"
+#include "MeshletBuilder.h"
+#include "ParticleSystem.h"
+#include "PipelineRegistry.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "Scene.h"
 #include "ShaderContainer.h"
+#include "ShadowCascades.h"
+#include "SkinningSystem.h"
+#include "SnapshotExchange.h"
+#include "Telemetry.h"
+#include "TextureManager.h"
+#include "TransformMath.h"
 
 #define FUNC_PARAM_UNUSED(x) ((void)(x))
 
@@ -40,14 +62,128 @@ namespace VulkanEngineStructs {
         uint32_t pixelHeight = 0;
     };
 
+    enum class LatencyMode {
+        // Sample input at the start of the frame and let MAX_FRAMES_IN_FLIGHT frames queue up.
+        Throughput,
+        // Wait for the previous frame to retire and sample input right before the uniforms are written,
+        // trading CPU/GPU overlap for fresher input.
+        Low
+    };
+
+    struct PresentSettings {
+        // Falls back to FIFO, which every device supports, when the mode is not available.
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+
+        // 0 means minImageCount + 1; otherwise clamped to the surface limits.
+        uint32_t imageCount = 0;
+
+        LatencyMode latencyMode = LatencyMode::Throughput;
+    };
+
     struct CreateInfo {
         SurfaceInfo surface = {};
+
+        PresentSettings present = {};
+
+        // Lay down depth in a depth-only pass first, then shade with depth compare EQUAL
+        // so that every covered pixel runs the fragment shader exactly once.
+        bool enableDepthPrepass = false;
+
+        // Requested MSAA sample count; lowered to what the device supports for color and depth together.
+        VkSampleCountFlagBits sampleCount = VK_SAMPLE_COUNT_1_BIT;
+
+        // Record passes with VK_KHR_dynamic_rendering when the device supports it,
+        // otherwise fall back to render pass and framebuffer objects.
+        bool preferDynamicRendering = true;
+
+        // Time frame stages on the CPU and render graph passes on the GPU; see profiler().
+        bool enableProfiling = true;
+
+        // Count vertices, primitives and fragment invocations per frame when the device supports it.
+        bool enablePipelineStatistics = true;
+
+        // Skip draw items attached to scene nodes whose world bounds are outside the view frustum.
+        bool enableFrustumCulling = true;
+
+        // Test draw items that survive frustum culling against a depth pyramid on the GPU in two phases:
+        // what was visible last frame is drawn first, the rest is re-tested against that depth.
+        // Only with single-sampled depth the device can sample.
+        bool enableOcclusionCulling = true;
+
+        // Split declared meshes into meshlets at load and test each of them in the occlusion cull passes:
+        // against the frustum, by its normal cone and against the pyramid. Only with occlusion culling.
+        // The bounds come from the vertices an index buffer is first drawn with.
+        bool enableMeshletCulling = true;
+
+        // Submit async compute tasks to a dedicated compute queue when the device has one, so they overlap
+        // the rasterization of the frame; otherwise they run ahead of it on the graphics queue.
+        bool enableAsyncCompute = true;
+
+        // Size of the pool the declared particle emitters share; emission stops while it is full.
+        // 0 disables particles, as does declaring no emitter.
+        uint32_t maxParticleCount = 1 << 20;
+
+        // Cascaded shadow maps of the directional light over the camera frustum, up to
+        // UniformBufferObject::MaxShadowCascadeCount. 0 disables shadows and the directional light, which
+        // leaves shading unlit unless there are point lights.
+        uint32_t shadowCascadeCount = 4;
+
+        uint32_t shadowMapResolution = 2048;
+
+        // Cascades from this one on are only rendered again when their casters, the light or the camera
+        // call for it, at most one of them a frame unless their shadows would be wrong otherwise.
+        // The cascade count renders every cascade every frame.
+        uint32_t firstCachedShadowCascade = 2;
+
+        // Bin the declared point lights into clusters of the view frustum with a compute pass every frame,
+        // so fragments only shade the lights of their own cluster. Declaring no point light disables it.
+        bool enableClusteredLighting = true;
+
+        // Clusters across the screen and along the view depth.
+        uint32_t lightClusterCountX = 16;
+        uint32_t lightClusterCountY = 9;
+        uint32_t lightClusterCountZ = 24;
+
+        // Sizes the light index list all clusters share; what does not fit is dropped.
+        uint32_t averageLightsPerCluster = 32;
+
+        // Start the frame loop on its own thread at the end of init(); see startRenderThread().
+        bool enableRenderThread = false;
+    };
+
+    // Camera input accumulated on the GUI thread since init. The frame applies the difference to what it
+    // applied last time, so skipping intermediate snapshots loses no input.
+    struct CameraInput {
+        double translateX = 0.0; // Camera space.
+        double translateY = 0.0;
+        double translateZ = 0.0;
+        double yaw = 0.0;
+        double pitch = 0.0;
+        double zoom = 0.0;
+
+        // Not accumulated: the translation every frame makes while it is set, e.g. while a key is held.
+        double motionX = 0.0;
+        double motionY = 0.0;
+        double motionZ = 0.0;
+
+        // Profiler clock of the latest input, for the input to present latency.
+        uint64_t timestampNs = 0;
+    };
+
+    struct CameraState {
+        glm::vec3 eye = {};
+        float yaw = 0.0f;
+        float pitch = 0.0f;
     };
 
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphics = {};
         std::optional<uint32_t> present = {};
 
+        // Only families without graphics support, whose queues run beside the graphics one.
+        std::optional<uint32_t> compute = {};
+        std::optional<uint32_t> transfer = {}; // Without compute support either.
+
         bool isFullySupported() const { return graphics.has_value() && present.has_value(); };
     };
 
@@ -65,6 +201,20 @@ namespace VulkanEngineStructs {
 
         // Buffer infos.
         VkPhysicalDeviceMemoryProperties memoryProperties = {};
+
+        // Feature infos.
+        VkPhysicalDeviceProperties properties = {};
+        VkPhysicalDeviceFeatures features = {};
+
+        // VK_EXT_descriptor_indexing with everything the bindless table relies on.
+        bool descriptorIndexingSupported = false;
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties = {};
+
+        // VK_KHR_dynamic_rendering; always false when built against headers older than the extension.
+        bool dynamicRenderingSupported = false;
+
+        // VK_EXT_memory_budget.
+        bool memoryBudgetSupported = false;
     };
 }
 
@@ -89,11 +239,76 @@ public:
 
     void renderFrame();
 
-    inline bool renderEnable() { return m_renderEnable; }
-    inline void setRenderEnable(bool value) { m_renderEnable = value; }
+    // Run renderFrame() in a loop on a dedicated thread until stopRenderThread() or destruction.
+    // Meanwhile renderFrame() must not be called elsewhere, and camera input is handed over
+    // to the render thread at frame boundaries.
+    void startRenderThread();
+
+    // Rethrow what stopped the render thread, if anything did.
+    void stopRenderThread();
 
+    // From the GUI thread; still true after a failure, until stopRenderThread().
+    inline bool isRenderThreadRunning() const { return m_renderThread.joinable(); }
+
+    // The render thread left its loop on an exception; stopRenderThread() rethrows it.
+    inline bool hasRenderThreadFailed() const { return m_hasRenderThreadFailed.load(std::memory_order_acquire); }
+
+    inline bool renderEnable() { return m_renderEnable.load(std::memory_order_relaxed); }
+    inline void setRenderEnable(bool value) { m_renderEnable.store(value, std::memory_order_relaxed); }
+
+    // Only records the new size; the swapchain is recreated once at the next frame boundary,
+    // however many resizes arrive before it.
     void resize(uint32_t width, uint32_t height);
 
+    // Takes effect at the next frame boundary; the swapchain is recreated when the present mode
+    // or image count changes.
+    void setPresentSettings(const VulkanEngineStructs::PresentSettings& settings);
+
+    // As requested; the swapchain may have fallen back to what the surface supports, see telemetry().
+    inline VulkanEngineStructs::PresentSettings presentSettings() const { return m_presentSettingsExchange.read(); }
+
+    // The sample count actually used, after capping by the device limits.
+    inline VkSampleCountFlagBits sampleCount() { return m_sampleCount; }
+
+    // Whether occlusion culling was requested and the device and sample count allow it.
+    inline bool isOcclusionCullingEnabled() const { return m_isOcclusionCullingEnabled; }
+
+    inline bool isMeshletCullingEnabled() const { return m_isMeshletCullingEnabled; }
+
+    // Device memory bound to transient attachments such as depth and multisampled color; from the thread
+    // calling renderFrame(), others read telemetry().
+    inline VkDeviceSize transientAttachmentMemorySize() { return m_renderGraph.transientMemorySize(); }
+
+    // Frame summaries and trace export; toggle with profiler().setEnabled().
+    inline Profiler& profiler() { return m_profiler; }
+
+    // Compute tasks submitted every frame ahead of the graphics work; valid after init().
+    inline AsyncCompute& asyncCompute() { return m_asyncCompute; }
+
+    // Whether async compute tasks actually overlap graphics on a queue of their own.
+    inline bool isAsyncComputeQueueDedicated() const { return m_asyncCompute.hasDedicatedQueue(); }
+
+    inline bool isParticleSystemEnabled() const { return m_isParticleSystemEnabled; }
+
+    inline bool isShadowEnabled() const { return m_isShadowEnabled; }
+
+    // The way the directional light travels; from the thread calling renderFrame(), taking effect at the next frame.
+    inline void setLightDirection(const glm::vec3& direction) { m_lightDirection = glm::normalize(direction); }
+
+    inline glm::vec3 lightDirection() const { return m_lightDirection; }
+
+    // Return the id of the point light; all point lights must be declared before init.
+    uint32_t declarePointLight(const ClusteredLightingStructs::PointLight& light);
+
+    // From any thread, taking effect at the next frame.
+    void setPointLight(uint32_t lightId, const ClusteredLightingStructs::PointLight& light);
+
+    inline bool isClusteredLightingEnabled() const { return m_isClusteredLightingEnabled; }
+
+    // Memory and per-frame work counters of the last recorded frame, and the swapchain it was presented to;
+    // callable from any thread.
+    inline TelemetryStructs::Snapshot telemetry() const { return m_telemetry.snapshot(); }
+
 private:
     bool m_isInited = false;
 
@@ -107,7 +322,46 @@ private:
 
     size_t m_currFrameIndex = 0;
 
-    bool m_renderEnable = true;
+    std::atomic<bool> m_renderEnable = { true };
+
+    std::thread m_renderThread = {};
+
+    std::atomic<bool> m_shouldRenderThreadRun = { false };
+
+    // Written by the render thread before it leaves on a failure.
+    std::exception_ptr m_renderThreadException = {};
+    std::atomic<bool> m_hasRenderThreadFailed = { false };
+
+    void renderThreadLoop();
+
+    void joinRenderThread();
+
+    // Written by resize(), consumed at the start of a frame.
+    std::atomic<bool> m_isResizePending = { false };
+    std::atomic<uint32_t> m_pendingWidth = { 0 };
+    std::atomic<uint32_t> m_pendingHeight = { 0 };
+
+    // Set when acquire or present reports the swapchain suboptimal or out of date.
+    bool m_isSwapchainOutdated = false;
+
+    // Written by setPresentSettings(), consumed at the start of a frame like a resize.
+    SnapshotExchange<VulkanEngineStructs::PresentSettings> m_presentSettingsExchange = {};
+    std::atomic<bool> m_isPresentSettingsPending = { false };
+
+    // Written by setParticleEmitter() and setPointLight(), consumed at the start of a frame.
+    std::mutex m_pendingUpdateMutex = {};
+    std::vector<std::pair<uint32_t, ParticleStructs::Emitter>> m_pendingEmitterUpdates = {};
+    std::vector<std::pair<uint32_t, ClusteredLightingStructs::PointLight>> m_pendingLightUpdates = {};
+
+    void applyPendingUpdates();
+
+    // What the current swapchain was created with.
+    VulkanEngineStructs::PresentSettings m_presentSettings = {};
+    VkPresentModeKHR m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+    // Apply a pending resize or recreate an outdated swapchain; false when there is nothing
+    // to render to, e.g. the window is minimized.
+    bool prepareSwapchain();
 
     void recreateSwapchain();
 
@@ -139,6 +393,14 @@ private:
     VkQueue m_graphicsQueue = {};
     VkQueue m_presentQueue = {};
 
+    // The graphics queue and family when the device has no dedicated one, or it is not enabled.
+    VkQueue m_computeQueue = {};
+    uint32_t m_computeQueueFamilyIndex = 0;
+    VkQueue m_transferQueue = {};
+    uint32_t m_transferQueueFamilyIndex = 0;
+
+    bool m_isDynamicRenderingEnabled = false;
+
     void createLogicalDevice();
 
     VkSwapchainKHR m_swapchain = {};
@@ -149,37 +411,149 @@ private:
 
     VkExtent2D m_swapchainExtent2D = {};
 
-    void createSwapchain();
+    // The old swapchain, if any, is handed to the new one so presentation can continue across the switch.
+    void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 
     std::vector<VkImageView> m_swapchainImageViews = {};
 
     void createImageViews();
 
-    std::unordered_map<std::string, VkRenderPass> m_renderPasses = {};
+    VkFormat m_depthFormat = VK_FORMAT_UNDEFINED;
+
+    VkFormat selectDepthFormat();
+
+    VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+
+    VkSampleCountFlagBits selectSampleCount();
+
+    // Declared once; render passes, framebuffers, depth and barriers are compiled per swapchain.
+    RenderGraph m_renderGraph = {};
+
+    // Bound to the acquired swapchain image every frame.
+    RenderGraph::ResourceHandle m_backbuffer = RenderGraph::InvalidHandle;
+
+    // Only valid when the depth pre-pass is enabled.
+    RenderGraph::PassHandle m_depthPrepassPass = RenderGraph::InvalidHandle;
+
+    RenderGraph::PassHandle m_mainPass = RenderGraph::InvalidHandle;
+
+    // Only valid when particles are enabled.
+    RenderGraph::PassHandle m_particlePass = RenderGraph::InvalidHandle;
+
+    // One per shadow cascade when shadows are enabled; the images are bound to the shadow maps.
+    std::vector<RenderGraph::PassHandle> m_shadowCascadePasses = {};
+    std::vector<RenderGraph::ResourceHandle> m_shadowCascadeResources = {};
+
+    bool m_isOcclusionCullingEnabled = false;
+    bool m_isMeshletCullingEnabled = false;
+    bool m_isParticleSystemEnabled = false;
+    bool m_isSkinningEnabled = false;
+    bool m_isShadowEnabled = false;
+    bool m_isClusteredLightingEnabled = false;
+
+    // Only valid when clustered lighting is enabled; bound to the light grid and index list.
+    RenderGraph::ResourceHandle m_lightGridResource = RenderGraph::InvalidHandle;
+    RenderGraph::ResourceHandle m_lightIndexResource = RenderGraph::InvalidHandle;
+
+    // Only valid when skinning is enabled; bound to the vertex buffer of the skinning system.
+    RenderGraph::ResourceHandle m_skinnedVerticesResource = RenderGraph::InvalidHandle;
+
+    // Only valid when occlusion culling is enabled; the buffers are bound per frame in flight.
+    RenderGraph::ResourceHandle m_hiZPyramidResource = RenderGraph::InvalidHandle;
+    RenderGraph::ResourceHandle m_cullObjectsResource = RenderGraph::InvalidHandle;
+    RenderGraph::ResourceHandle m_drawCommandsResource = RenderGraph::InvalidHandle;
 
-    void createRenderPasses();
+    void buildRenderGraph();
 
-    std::vector<VkFramebuffer> m_swapchainFramebuffers = {};
+    Profiler m_profiler = {};
 
-    void createFramebuffers();
+    // Interned names of graph passes by pass handle, for GPU scopes.
+    std::vector<const char*> m_passScopeNames = {};
 
-    std::unordered_map<std::string, VkPipeline> m_graphicsPipelines = {};
+    void createProfiler();
+
+    Telemetry m_telemetry = {};
+
+    void createTelemetry();
+
+    // From the recording thread, at the end of every frame.
+    TelemetryStructs::FrameResources gatherFrameResources() const;
 
     ShaderContainer m_shaderContainer = {};
 
-    std::unordered_map<std::string, VkDescriptorSetLayout> m_descSetLayouts = {};
+    PipelineRegistry m_pipelineRegistry = {};
+
+    PipelineRegistry::Handle m_mainPipeline = PipelineRegistry::InvalidHandle;
+
+    // Only valid when the depth pre-pass is enabled.
+    PipelineRegistry::Handle m_depthPrepassPipeline = PipelineRegistry::InvalidHandle;
+
+    // Only valid when occlusion culling is enabled.
+    PipelineRegistry::Handle m_hiZBuildPipeline = PipelineRegistry::InvalidHandle;
+    PipelineRegistry::Handle m_occlusionCullPipeline = PipelineRegistry::InvalidHandle;
+
+    // Only valid when particles are enabled.
+    PipelineRegistry::Handle m_particlePipeline = PipelineRegistry::InvalidHandle;
+    PipelineRegistry::Handle m_particleEmitPipeline = PipelineRegistry::InvalidHandle;
+    PipelineRegistry::Handle m_particleSimulatePipeline = PipelineRegistry::InvalidHandle;
+    PipelineRegistry::Handle m_particleCompactPipeline = PipelineRegistry::InvalidHandle;
+
+    // Only valid when skinning is enabled.
+    PipelineRegistry::Handle m_skinningPipeline = PipelineRegistry::InvalidHandle;
+
+    // Only valid when shadows are enabled; depth only, shared by all cascades.
+    PipelineRegistry::Handle m_shadowPipeline = PipelineRegistry::InvalidHandle;
+
+    // Only valid when clustered lighting is enabled.
+    PipelineRegistry::Handle m_lightCullPipeline = PipelineRegistry::InvalidHandle;
+
     std::unordered_map<std::string, VkPipelineLayout> m_pipelineLayouts = {};
 
+    // Shader modules and the "main" layout, once per device.
+    void createGraphicsPipelineLayout();
+
+    // Rebuilt with the render passes when the swapchain is recreated.
     void createGraphicsPipelines();
 
+    // Only the ones occlusion culling, particles, skinning and clustered lighting need; they share the registry with the graphics pipelines.
+    void createComputePipelines();
+
     VkCommandPool m_commandPool = {};
 
     void createCommandPool();
 
+    // One command buffer per frame in flight, re-recorded every frame.
     std::vector<VkCommandBuffer> m_commandBuffers = {};
 
     void createCommandBuffers();
 
+    AsyncCompute m_asyncCompute = {};
+
+    void createAsyncCompute();
+
+    ParticleSystem m_particleSystem = {};
+
+    // Profiler clock of the last particle update; 0 before the first one.
+    uint64_t m_particleUpdateNs = 0;
+
+    // Simulated as an async compute task, drawn in the last pass of the graph.
+    void createParticleSystem();
+
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+    enum class DrawPhase {
+        All, // Direct draws of every visible draw item.
+        OcclusionEarly, // Indirect draws of what passed the test against the previous pyramid, per meshlet if any.
+        OcclusionLate // Indirect draws of what only passed the test against this frame's.
+    };
+
+    // Draw items are the visible ones unless given, e.g. the casters of a shadow cascade.
+    void recordDrawItems(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, DrawPhase phase,
+                         const std::vector<uint32_t>* drawItemIds = nullptr);
+
+    // Viewport and scissor are dynamic states of all registered pipelines.
+    void setViewport(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
     constexpr static size_t MAX_FRAMES_IN_FLIGHT = 2;
 
     std::unordered_map<std::string, std::vector<VkFence>> m_fences = {};
@@ -243,6 +617,35 @@ public:
 
     void declareIndices(const std::string& bufferLabel, const std::vector<uint32_t>& indices);
 
+    // Return the id of the draw item, which stays valid for the lifetime of the engine.
+    uint32_t declareDrawItem(const std::string& vertexBufferLabel, const std::string& indexBufferLabel,
+                             const glm::mat4& modelMat = glm::mat4(1.0f), uint32_t materialIndex = 0);
+
+    void setDrawItemTransform(uint32_t drawItemId, const glm::mat4& modelMat);
+
+    // Compose the model matrices of consecutive draw items from firstDrawItemId on in SIMD batches.
+    void setDrawItemTransforms(uint32_t firstDrawItemId, const TransformMath::TransformSoA& transforms);
+
+    void setDrawItemMaterial(uint32_t drawItemId, uint32_t materialIndex);
+
+    // Return the id of the skin. Its vertices are posed on the GPU once per frame into a vertex buffer
+    // of the label, which draw items use like any other; all skins must be declared before init.
+    // Meshlets are not built for index buffers drawn with them, as the bind pose bounds nothing.
+    uint32_t declareSkinnedVertices(const std::string& bufferLabel, const std::vector<SkinnedVertex>& vertices,
+                                    uint32_t jointCount, const std::vector<std::vector<glm::vec3>>& morphTargets = {});
+
+    // See SkinningSystem; from the thread calling renderFrame(), taking effect at the next frame.
+    void setSkinJointMatrices(uint32_t skinId, const std::vector<glm::mat4>& jointMats);
+
+    void setSkinMorphWeights(uint32_t skinId, const std::vector<float>& weights);
+
+    // The scene is updated and its world matrices uploaded at every frame, so it must only be
+    // modified from the thread calling renderFrame(). It is not owned; nullptr detaches it.
+    void setScene(Scene* scene);
+
+    // Place the draw item under a scene node; InvalidNode detaches it.
+    void setDrawItemNode(uint32_t drawItemId, Scene::NodeId node);
+
 private:
     struct BufferResource {
         VkBuffer  buffer = {};
@@ -269,6 +672,14 @@ private:
 
     std::unordered_map<std::string, VertexBuffer> m_vertexBuffers = {};
 
+    SkinningSystem m_skinningSystem = {};
+
+    // Labels of skinned vertex buffers to their skin ids.
+    std::unordered_map<std::string, SkinningSystem::Handle> m_skinnedVertexBuffers = {};
+
+    // Before draw items are resolved, as they are drawn from its vertex buffer.
+    void createSkinningSystem();
+
     std::string m_currBindVertexBufferLabel = {};
 
     void createCoherentVertexBuffer(const std::string& label, size_t vertexCount);
@@ -286,6 +697,10 @@ private:
     struct IndexBuffer {
         std::vector<uint32_t> data = {};
 
+        // Empty without meshlet culling; data is reordered to match when built.
+        std::vector<MeshletStructs::Meshlet> meshlets = {};
+        uint32_t firstMeshlet = 0; // Into the meshlet buffer.
+
         BufferResource clientResource = {};
         BufferResource serverResource = {};
 
@@ -301,12 +716,233 @@ private:
 
     void createAllDeclaredIndexBuffers();
 
+    // Before the index buffers are created, since it reorders their data.
+    void buildAllDeclaredMeshlets();
+
+    // All meshlets of all index buffers in one storage buffer, read by the occlusion cull passes.
+    struct MeshletBuffer {
+        BufferResource resource = {};
+        BindlessDescriptors::Slot slot = BindlessDescriptors::InvalidSlot;
+    };
+
+    MeshletBuffer m_meshletBuffer = {};
+
+    void createMeshletBuffer();
+
+    struct DrawItem {
+        std::string vertexBufferLabel = {};
+        std::string indexBufferLabel = {};
+
+        // Resolved from labels after buffers are created, so recording never looks up strings.
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize vertexBufferOffset = 0; // Skinned vertices of all skins share a buffer.
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        uint32_t indexCount = 0;
+
+        // Those of the index buffer; without any, the draw item is culled and drawn as a whole.
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
+
+        PerDrawConstants constants = {};
+
+        Scene::NodeId sceneNode = Scene::InvalidNode;
+    };
+
+    std::vector<DrawItem> m_drawItems = {};
+
+    // Scratch of setDrawItemTransforms(), kept to avoid reallocating every frame.
+    std::vector<glm::mat4> m_composedModelMats = {};
+
+    void resolveDrawItem(DrawItem& drawItem);
+
+    void resolveDrawItems();
+
+public:
+    // Texture 0 is plain white and used by materials without a texture.
+    constexpr static uint32_t DefaultTexture = 0;
+
+    // Return the id of the texture, which is referred by materials.
+    // The first candidate the device can sample is loaded, e.g. { "a.bc7.ktx", "a.astc.ktx", "a.png" }.
+    uint32_t declareTexture(const std::vector<std::string>& candidateFilenames);
+
+    // Return the index of the material, which is referred by draw items.
+    uint32_t declareMaterial(const glm::vec4& baseColor, uint32_t textureId = DefaultTexture);
+
+    // Return the id of the emitter; all emitters must be declared before init.
+    uint32_t declareParticleEmitter(const ParticleStructs::Emitter& emitter);
+
+    // From any thread, taking effect from the next frame on.
+    void setParticleEmitter(uint32_t emitterId, const ParticleStructs::Emitter& emitter);
+
 private:
+    BindlessDescriptors m_bindlessDescriptors = {};
+
+    // Only used to fill unused slots when descriptor indexing is not supported.
+    BufferResource m_bindlessFallbackBuffer = {};
+
+    void createBindlessDescriptors();
+
+    TextureManager m_textureManager = {};
+
+    struct TextureBinding {
+        std::vector<std::string> candidateFilenames = {};
+        TextureManager::Handle handle = TextureManager::InvalidHandle;
+        BindlessDescriptors::Slot slot = BindlessDescriptors::InvalidSlot;
+    };
+
+    std::vector<TextureBinding> m_textures = { TextureBinding{} }; // Filled with white when created.
+
+    void createAllDeclaredTextures();
+
+    struct MaterialBuffer {
+        // Texture indices hold texture ids until uploaded. Material 0 is plain white.
+        std::vector<Material> data = { Material{ glm::vec4(1.0f), DefaultTexture } };
+        BufferResource resource = {};
+        BindlessDescriptors::Slot slot = BindlessDescriptors::InvalidSlot;
+    };
+
+    MaterialBuffer m_materialBuffer = {};
+
+    void createMaterialBuffer();
+
+    std::vector<ParticleStructs::Emitter> m_particleEmitters = {};
+
+    Scene* m_scene = nullptr;
+
+    // Draw item instance indices were resolved against this version of the scene structure.
+    uint64_t m_resolvedSceneVersion = UINT64_MAX;
+
+    // One persistently mapped storage buffer per frame in flight: the identity matrix
+    // used by draw items outside the scene, followed by the world matrices of the scene.
+    struct InstanceBuffer {
+        std::vector<BufferResource> resources = {};
+        std::vector<void*> mappedData = {};
+        std::vector<size_t> capacities = {}; // In matrices.
+        std::vector<BindlessDescriptors::Slot> slots = {};
+    };
+
+    InstanceBuffer m_instanceBuffer = {};
+
+    void createInstanceBuffers();
+
+    void reserveInstanceBuffer(size_t frameIndex, size_t matrixCount);
+
+    void destroyInstanceBuffer(size_t frameIndex);
+
+    void updateInstanceBuffer();
+
+    // Bumped whenever draw items are resolved to scene nodes again.
+    uint64_t m_drawItemNodeSerial = 0;
+
+    // Draw items attached to scene nodes go through the hierarchy; the others are always drawn.
+    CullingBvh m_cullingBvh = {};
+    uint64_t m_cullingBvhSerial = UINT64_MAX;
+    size_t m_cullingBvhDrawItemCount = 0;
+
+    std::vector<uint32_t> m_cullableDrawItems = {};
+    std::vector<uint32_t> m_uncullableDrawItems = {};
+    std::vector<SceneStructs::Bounds> m_cullableBounds = {};
+    std::vector<uint32_t> m_movedCullables = {};
+    std::vector<uint32_t> m_visibleCullables = {};
+
+    // Ids of the draw items recorded this frame, in declaration order.
+    std::vector<uint32_t> m_visibleDrawItems = {};
+
+    void cullDrawItems();
+
+    HiZPyramid m_hiZPyramid = {};
+
+    // The view projection the pyramid was last built with; phase 0 tests against it.
+    glm::mat4 m_pyramidViewProjMat = glm::mat4(1.0f);
+
+    // Owned by the layout cache of the descriptor allocator.
+    VkDescriptorSetLayout m_hiZBuildSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_occlusionCullSetLayout = VK_NULL_HANDLE;
+
+    // One set per frame in flight: a persistently mapped object buffer holding CullStatistics and
+    // the bounds of the recorded draw items, and a device local buffer of indirect commands written
+    // by the GPU, one per meshlet (or per draw item without any) in each phase, early ones first.
+    // The object mapping may be write-combined, so the statistics are copied into a host cached
+    // buffer to be read back.
+    struct OcclusionBuffers {
+        std::vector<BufferResource> objectResources = {};
+        std::vector<void*> objectMappedData = {};
+        std::vector<BindlessDescriptors::Slot> objectSlots = {};
+
+        std::vector<BufferResource> statisticsResources = {};
+        std::vector<void*> statisticsMappedData = {};
+
+        std::vector<BufferResource> commandResources = {};
+        std::vector<BindlessDescriptors::Slot> commandSlots = {};
+
+        std::vector<size_t> objectCapacities = {}; // In draw items.
+        std::vector<size_t> commandCapacities = {}; // In commands per phase.
+
+        // Commands per phase of the frame being recorded.
+        size_t commandCount = 0;
+    };
+
+    OcclusionBuffers m_occlusionBuffers = {};
+
+    void createOcclusionCulling();
+
+    void reserveOcclusionBuffers(size_t frameIndex, size_t objectCount, size_t commandCount);
+
+    void destroyOcclusionBuffers(size_t frameIndex);
+
+    // Collect the statistics of the frame's previous submission and write the bounds of this one.
+    void updateOcclusionBuffers();
+
+    void recordOcclusionCull(VkCommandBuffer commandBuffer, uint32_t phase);
+
+    void recordHiZBuild(VkCommandBuffer commandBuffer, RenderGraph::ResourceHandle depth);
+
+    void recordSkinning(VkCommandBuffer commandBuffer);
+
+    ShadowCascades m_shadowCascades = {};
+
+    glm::vec3 m_lightDirection = glm::normalize(glm::vec3(0.3f, -1.0f, 0.5f));
+
+    // Casters changed since the last shadow update: world bounds before and after of scene draw items
+    // that moved, collected by the culling refit, or everything when that can not be bounded.
+    std::vector<SceneStructs::Bounds> m_changedCasterBounds = {};
+    bool m_isEveryCasterChanged = true;
+
+    // Per cascade, of the frame being recorded.
+    std::vector<std::vector<uint32_t>> m_shadowCasterDrawItems = {};
+
+    // Cleared with a one-shot submission and registered in the bindless table.
+    void createShadowCascades();
+
+    // After culling: fit the cascades, write their uniforms and collect their casters.
+    void updateShadowCascades();
+
+    void recordShadowCascade(VkCommandBuffer commandBuffer, uint32_t cascade);
+
+    ClusteredLighting m_clusteredLighting = {};
+
+    // Registered in the bindless table.
+    void createClusteredLighting();
+
+    void recordLightCull(VkCommandBuffer commandBuffer);
+
+private:
+    DescriptorAllocator m_descriptorAllocator = {};
+
+    void createDescriptorAllocator();
+
+    // Owned by the layout cache of the descriptor allocator.
+    VkDescriptorSetLayout m_frameSetLayout = VK_NULL_HANDLE;
+
     void createDescriptorSetLayout();
 
+    // One persistently mapped uniform buffer per frame in flight, holding the frame's uniforms
+    // followed by a copy for every shadow cascade.
     struct UniformBuffer {
         UniformBufferObject data = {};
         std::vector<BufferResource> resources = {};
+        std::vector<void*> mappedData = {};
+        VkDeviceSize stride = 0; // Between the copies, as aligned as uniform buffer offsets must be.
     };
 
     UniformBuffer m_uniformBuffer = {};
@@ -317,24 +953,71 @@ private:
 
     void updateUniformBuffers();
 
-    VkDescriptorPool m_descriptorPool = {};
-
-    void createDescriptorPool();
+    // Allocate and write the per-frame set from the current frame's transient pools;
+    // copy 0 holds the frame's uniforms, copy 1 + i those of shadow cascade i.
+    VkDescriptorSet allocateFrameDescriptorSet(uint32_t copy = 0);
 
-    std::vector<VkDescriptorSet> m_descriptorSets = {};
+    // The per-frame set bound for the whole graph, rebound by passes binding another.
+    VkDescriptorSet m_frameDescriptorSet = VK_NULL_HANDLE;
 
-    void createDescriptorSets();
+    // The bindless set of the frame being recorded, for compute passes binding it with their own layouts.
+    VkDescriptorSet m_frameBindlessSet = VK_NULL_HANDLE;
 
 public:
+    // Camera input from the GUI thread, or whichever thread calls renderFrame(). It is queued either way and
+    // applied by the next frame, right after its fence wait in the low latency mode.
+
     void translateCamera(float dx, float dy, float dz);
 
     void rotateCamera(float dx, float dy);
 
     void zoomCamera(float delta);
 
+    // Translate by this much every frame from the next one on, until changed; 0 stops.
+    void setCameraMotion(float dx, float dy, float dz);
+
+    // Camera as of the last rendered frame; safe from any thread.
+    inline VulkanEngineStructs::CameraState cameraState() const { return m_cameraStateExchange.read(); }
+
+    // Absolute camera control for replaying recorded camera paths; not while the render thread runs.
+
+    // Back to the initial eye and orientation; the accumulated rotation restarts from 0.
+    void resetCamera();
+
+    inline glm::vec3 cameraEye() const { return m_camera->eye(); }
+
+    void moveCameraTo(const glm::vec3& eye);
+
+    // Sums of rotateCamera() input since the last reset.
+    inline float cameraYaw() const { return m_cameraYaw; }
+    inline float cameraPitch() const { return m_cameraPitch; }
+
 private:
     std::unique_ptr<Camera> m_camera = nullptr;
 
+    float m_cameraYaw = 0.0f;
+    float m_cameraPitch = 0.0f;
+
+    void mTranslateCamera(float dx, float dy, float dz);
+
+    void mRotateCamera(float dx, float dy);
+
+    void mZoomCamera(float delta);
+
+    // Accumulated and published by the GUI thread.
+    VulkanEngineStructs::CameraInput m_cameraInput = {};
+    SnapshotExchange<VulkanEngineStructs::CameraInput> m_cameraInputExchange = {};
+
+    // What the frames have applied so far.
+    VulkanEngineStructs::CameraInput m_appliedCameraInput = {};
+
+    void applyCameraInput();
+
+    // Timestamp of the latest input applied to the frame being rendered; 0 when there was none.
+    uint64_t m_sampledInputTimestampNs = 0;
+
+    SnapshotExchange<VulkanEngineStructs::CameraState> m_cameraStateExchange = {};
+
     void buildCamera();
 };
 